@@ -0,0 +1,683 @@
+#include "bgzf.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+namespace {
+
+// Size of the gzip header up to and including XLEN.
+const std::size_t gzip_fixed_header = 12;
+// Size of the CRC32 and ISIZE fields after the compressed data.
+const std::size_t gzip_footer = 8;
+// Header of a block with only the BC extra field, as written here.
+const std::size_t bgzf_header = 18;
+// Blocks may be at most 64 kB in total.
+const std::size_t bgzf_max_block = 65536;
+// Uncompressed data per block, same as bgzip uses.
+const std::size_t bgzf_block_data = 0xff00;
+
+// The empty block that marks the end of a BGZF file.
+const unsigned char bgzf_eof_block[28] = {
+	0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+	0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00
+};
+
+
+inline py_int read_le16( const unsigned char *p )
+{
+	return p[0] | ( p[1] << 8 );
+}
+
+inline py_int read_le32( const unsigned char *p )
+{
+	return static_cast<py_int>( p[0] ) | ( static_cast<py_int>( p[1] ) << 8 ) |
+		( static_cast<py_int>( p[2] ) << 16 ) |
+		( static_cast<py_int>( p[3] ) << 24 );
+}
+
+inline void write_le16( unsigned char *p, py_uint v )
+{
+	p[0] = v & 0xff;
+	p[1] = ( v >> 8 ) & 0xff;
+}
+
+inline void write_le32( unsigned char *p, py_uint v )
+{
+	p[0] = v & 0xff;
+	p[1] = ( v >> 8 ) & 0xff;
+	p[2] = ( v >> 16 ) & 0xff;
+	p[3] = ( v >> 24 ) & 0xff;
+}
+
+
+/**
+   Parses the header of the BGZF block at p.
+
+   \param header_size  Is set to the size of the gzip header.
+   \param block_size   Is set to the total size of the block.
+
+   \returns false if this is not a BGZF block.
+*/
+bool parse_block_header( const char *data, std::size_t avail,
+                         std::size_t &header_size, std::size_t &block_size )
+{
+	const unsigned char *p = reinterpret_cast<const unsigned char*>( data );
+	if( avail < gzip_fixed_header ) return false;
+	if( p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !( p[3] & 4 ) ){
+		return false;
+	}
+
+	std::size_t xlen = read_le16( p + 10 );
+	header_size = gzip_fixed_header + xlen;
+	if( avail < header_size ) return false;
+
+	// Look for the BC subfield among the extra fields.
+	std::size_t i = gzip_fixed_header;
+	while( i + 4 <= header_size ){
+		std::size_t slen = read_le16( p + i + 2 );
+		if( p[i] == 'B' && p[i+1] == 'C' && slen == 2 ){
+			block_size = read_le16( p + i + 4 ) + 1;
+			return block_size >= header_size + gzip_footer;
+		}
+		i += 4 + slen;
+	}
+	return false;
+}
+
+
+bool file_mtime( const std::string &fname, struct timespec &t )
+{
+	struct stat st;
+	if( stat( fname.c_str(), &st ) ) return false;
+	t = st.st_mtim;
+	return true;
+}
+
+} // namespace
+
+
+
+bool bgzf_is_bgzf( const std::string &fname )
+{
+	char header[bgzf_header];
+	std::ifstream in( fname, std::ios::binary );
+	if( !in.read( header, sizeof(header) ) ) return false;
+
+	std::size_t header_size, block_size;
+	return parse_block_header( header, sizeof(header),
+	                           header_size, block_size );
+}
+
+
+
+bool bgzf_index::build( const char *data, std::size_t size )
+{
+	blocks.clear();
+	std::size_t coffset = 0;
+	py_int uoffset = 0;
+	while( coffset < size ){
+		std::size_t header_size, block_size;
+		if( !parse_block_header( data + coffset, size - coffset,
+		                         header_size, block_size ) ||
+		    coffset + block_size > size ){
+			std::cerr << "Corrupt BGZF block at byte " << coffset << "!\n";
+			blocks.clear();
+			return false;
+		}
+		const unsigned char *footer = reinterpret_cast<const unsigned char*>(
+			data + coffset + block_size - 4 );
+
+		bgzf_block b;
+		b.coffset = coffset;
+		b.csize   = block_size;
+		b.uoffset = uoffset;
+		b.usize   = read_le32( footer );
+		blocks.push_back( b );
+
+		coffset += block_size;
+		uoffset += b.usize;
+	}
+	return true;
+}
+
+
+bool bgzf_index::load( const std::string &gzi_name, const char *data,
+                       std::size_t size )
+{
+	std::FILE *in = std::fopen( gzi_name.c_str(), "rb" );
+	if( !in ) return false;
+
+	// The .gzi format lists the start of every block but the first,
+	// as pairs of compressed and uncompressed offsets.
+	uint64_t n = 0;
+	bool ok = std::fread( &n, sizeof(n), 1, in ) == 1 && n < size;
+	std::vector<uint64_t> offsets;
+	if( ok ){
+		offsets.resize( 2*n );
+		ok = std::fread( offsets.data(), sizeof(uint64_t), 2*n, in ) == 2*n;
+	}
+	std::fclose( in );
+	if( !ok ) return false;
+
+	blocks.clear();
+	bgzf_block b = { 0, 0, 0, 0 };
+	for( std::size_t i = 0; i <= n; ++i ){
+		if( i < n ){
+			py_int next_c = offsets[2*i];
+			py_int next_u = offsets[2*i+1];
+			if( next_c <= b.coffset || next_u < b.uoffset ||
+			    next_c > static_cast<py_int>( size ) ){
+				blocks.clear();
+				return false;
+			}
+			b.csize = next_c - b.coffset;
+			b.usize = next_u - b.uoffset;
+			blocks.push_back( b );
+			b.coffset = next_c;
+			b.uoffset = next_u;
+		}else{
+			// The last block is read from the file itself.
+			std::size_t header_size, block_size;
+			if( !parse_block_header( data + b.coffset, size - b.coffset,
+			                         header_size, block_size ) ||
+			    b.coffset + block_size != size ){
+				blocks.clear();
+				return false;
+			}
+			b.csize = block_size;
+			b.usize = read_le32( reinterpret_cast<const unsigned char*>(
+				                     data + size - 4 ) );
+			blocks.push_back( b );
+		}
+	}
+	return true;
+}
+
+
+bool bgzf_index::save( const std::string &gzi_name ) const
+{
+	std::FILE *out = std::fopen( gzi_name.c_str(), "wb" );
+	if( !out ) return false;
+
+	uint64_t n = blocks.empty() ? 0 : blocks.size() - 1;
+	bool ok = std::fwrite( &n, sizeof(n), 1, out ) == 1;
+	for( std::size_t i = 1; ok && i < blocks.size(); ++i ){
+		uint64_t pair[2] = { static_cast<uint64_t>( blocks[i].coffset ),
+		                     static_cast<uint64_t>( blocks[i].uoffset ) };
+		ok = std::fwrite( pair, sizeof(uint64_t), 2, out ) == 2;
+	}
+	ok = ( std::fclose( out ) == 0 ) && ok;
+
+	if( !ok ) std::remove( gzi_name.c_str() );
+	return ok;
+}
+
+
+bool bgzf_index::load_or_build( const std::string &fname, const char *data,
+                                std::size_t size )
+{
+	std::string gzi_name = sidecar_name( fname );
+	struct timespec t_file, t_gzi;
+	if( file_mtime( fname, t_file ) && file_mtime( gzi_name, t_gzi ) &&
+	    ( t_gzi.tv_sec > t_file.tv_sec ||
+	      ( t_gzi.tv_sec == t_file.tv_sec &&
+	        t_gzi.tv_nsec >= t_file.tv_nsec ) ) ){
+		if( load( gzi_name, data, size ) ) return true;
+	}
+
+	if( !build( data, size ) ) return false;
+	if( !save( gzi_name ) ){
+		std::cerr << "Could not save BGZF index to " << gzi_name
+		          << ", keeping it in memory only.\n";
+	}
+	return true;
+}
+
+
+std::size_t bgzf_index::find( py_int uoffset ) const
+{
+	// First block that starts after uoffset, the one before has it.
+	auto it = std::upper_bound( blocks.begin(), blocks.end(), uoffset,
+	                            []( py_int u, const bgzf_block &b )
+	                            { return u < b.uoffset; } );
+	while( it != blocks.begin() ){
+		--it;
+		// Skip empty blocks, like the end-of-file marker.
+		if( uoffset < it->uoffset + it->usize ) return it - blocks.begin();
+		if( it->usize ) break;
+	}
+	return blocks.size();
+}
+
+
+py_int bgzf_index::uncompressed_size() const
+{
+	if( blocks.empty() ) return 0;
+	return blocks.back().uoffset + blocks.back().usize;
+}
+
+
+
+bgzf_stream::bgzf_stream( const std::string &fname, int n_threads )
+	: file( fname ), n_threads( n_threads ), depth( 0 ), good_( true ),
+	  eof_( false ), next_task( 0 ), current( 0 ), have_current( false ),
+	  pos( nullptr ), end( nullptr ), stopping( false )
+{
+#ifndef HAVE_ZLIB
+	std::cerr << "Cannot read BGZF files without zlib support!\n";
+	std::terminate();
+#endif
+	if( !file.good() ){
+		std::cerr << "Failed to open file " << fname << "!\n";
+		std::terminate();
+	}
+	if( !index_.load_or_build( fname, file.data(), file.size() ) ){
+		std::cerr << "File " << fname << " is not a valid BGZF file!\n";
+		std::terminate();
+	}
+
+	if( this->n_threads == 0 ){
+		this->n_threads = 1;
+	}else if( this->n_threads < 0 ){
+		this->n_threads = std::thread::hardware_concurrency();
+		if( this->n_threads <= 0 ) this->n_threads = 1;
+	}
+	depth = 4*this->n_threads;
+	slots = std::vector<bgzf_slot>( depth );
+
+	start( 0 );
+}
+
+
+bgzf_stream::~bgzf_stream()
+{
+	stop();
+}
+
+
+void bgzf_stream::start( std::size_t first_block )
+{
+	next_task    = first_block;
+	current      = first_block;
+	have_current = false;
+	pos = end    = nullptr;
+	stopping     = false;
+	for( bgzf_slot &s : slots ) s.ready = false;
+
+	for( int i = 0; i < n_threads; ++i ){
+		threads.push_back( std::thread( &bgzf_stream::work, this ) );
+	}
+}
+
+
+void bgzf_stream::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( mtx );
+		stopping = true;
+	}
+	work_cv.notify_all();
+	for( std::thread &t : threads ) t.join();
+	threads.clear();
+}
+
+
+void bgzf_stream::work()
+{
+#ifdef HAVE_ZLIB
+	bgzf_inflater inflater;
+	while( true ){
+		std::size_t b;
+		{
+			std::unique_lock<std::mutex> lock( mtx );
+			work_cv.wait( lock, [this]{
+					return stopping || next_task >= index_.size() ||
+						next_task < current + depth; } );
+			if( stopping || next_task >= index_.size() ) return;
+			b = next_task++;
+		}
+
+		// Nobody touches the slot until the block is consumed.
+		bgzf_slot &s = slots[ b % depth ];
+		int status = inflater.inflate( file.data(), index_[b], s.data );
+
+		{
+			std::lock_guard<std::mutex> lock( mtx );
+			s.status = status;
+			s.ready  = true;
+		}
+		ready_cv.notify_all();
+	}
+#endif // HAVE_ZLIB
+}
+
+
+bool bgzf_stream::next_chunk()
+{
+	std::unique_lock<std::mutex> lock( mtx );
+	if( have_current ){
+		slots[ current % depth ].ready = false;
+		++current;
+		have_current = false;
+		work_cv.notify_all();
+	}
+	if( current >= index_.size() ) return false;
+
+	bgzf_slot &s = slots[ current % depth ];
+	ready_cv.wait( lock, [&s]{ return s.ready; } );
+	if( s.status ){
+		std::cerr << "Corrupt BGZF block " << current << "!\n";
+		good_ = false;
+		return false;
+	}
+	have_current = true;
+	pos = s.data.data();
+	end = pos + s.data.size();
+	return true;
+}
+
+
+bool bgzf_stream::getline( std::string &line )
+{
+	line.clear();
+	while( true ){
+		if( pos == end ){
+			if( !next_chunk() ){
+				eof_ = true;
+				return !line.empty();
+			}
+			continue;
+		}
+		const char *nl = static_cast<const char*>(
+			std::memchr( pos, '\n', end - pos ) );
+		if( nl ){
+			line.append( pos, nl );
+			pos = nl + 1;
+			return true;
+		}
+		line.append( pos, end );
+		pos = end;
+	}
+}
+
+
+bool bgzf_stream::skip_lines( std::size_t n )
+{
+	// Like getline, a last line without newline counts.
+	bool in_line = false;
+	while( n > 0 ){
+		if( pos == end ){
+			if( !next_chunk() ){
+				eof_ = true;
+				return n == 1 && in_line;
+			}
+			continue;
+		}
+		const char *nl;
+		while( n > 0 && ( nl = static_cast<const char*>(
+			                  std::memchr( pos, '\n', end - pos ) ) ) ){
+			pos = nl + 1;
+			--n;
+		}
+		if( n > 0 ){
+			in_line = in_line || pos < end;
+			pos = end;
+		}
+	}
+	return true;
+}
+
+
+int bgzf_stream::peek()
+{
+	while( pos == end ){
+		if( !next_chunk() ){
+			eof_ = true;
+			return EOF;
+		}
+	}
+	return static_cast<unsigned char>( *pos );
+}
+
+
+bool bgzf_stream::seek( py_int uoffset )
+{
+	if( uoffset < 0 || uoffset > index_.uncompressed_size() ) return false;
+
+	stop();
+	std::size_t b = index_.find( uoffset );
+	start( b );
+	good_ = true;
+	eof_  = false;
+	if( b == index_.size() ){
+		// At the very end.
+		return true;
+	}
+	if( !next_chunk() ) return false;
+	pos += uoffset - index_[b].uoffset;
+	return true;
+}
+
+
+
+#ifdef HAVE_ZLIB
+bgzf_inflater::bgzf_inflater()
+{
+	std::memset( &zs, 0, sizeof(zs) );
+	// Negative window bits for raw deflate data without gzip header.
+	if( inflateInit2( &zs, -15 ) != Z_OK ){
+		std::cerr << "Failed to initialise zlib!\n";
+		std::terminate();
+	}
+}
+
+
+bgzf_inflater::~bgzf_inflater()
+{
+	inflateEnd( &zs );
+}
+
+
+int bgzf_inflater::inflate( const char *data, const bgzf_block &b,
+                            std::vector<char> &out )
+{
+	const char *block = data + b.coffset;
+	std::size_t header_size, block_size;
+	if( !parse_block_header( block, b.csize, header_size, block_size ) ||
+	    static_cast<py_int>( block_size ) != b.csize ){
+		return -1;
+	}
+
+	out.resize( b.usize );
+	inflateReset( &zs );
+	zs.next_in   = reinterpret_cast<Bytef*>( const_cast<char*>( block ) +
+	                                         header_size );
+	zs.avail_in  = block_size - header_size - gzip_footer;
+	// zlib rejects a null output buffer, which out has if it was never
+	// used and the block is empty, like the EOF marker.
+	Bytef none;
+	zs.next_out  = out.empty() ? &none
+	                           : reinterpret_cast<Bytef*>( out.data() );
+	zs.avail_out = out.size();
+
+	int ret = ::inflate( &zs, Z_FINISH );
+	if( ret != Z_STREAM_END || zs.avail_out != 0 ) return -1;
+
+	const unsigned char *footer = reinterpret_cast<const unsigned char*>(
+		block + block_size - gzip_footer );
+	uLong crc = crc32( 0L, reinterpret_cast<const Bytef*>( out.data() ),
+	                   out.size() );
+	if( static_cast<py_int>( crc ) != read_le32( footer ) ) return -2;
+
+	return 0;
+}
+#endif // HAVE_ZLIB
+
+
+
+bgzf_writer::bgzf_writer( const std::string &fname, int level )
+	: fname( fname ), out( nullptr ), good_( false ), coffset( 0 ),
+	  uoffset( 0 )
+{
+#ifndef HAVE_ZLIB
+	std::cerr << "Cannot write BGZF files without zlib support!\n";
+	std::terminate();
+#else
+	std::memset( &zs, 0, sizeof(zs) );
+	if( deflateInit2( &zs, level, Z_DEFLATED, -15, 8,
+	                  Z_DEFAULT_STRATEGY ) != Z_OK ){
+		std::cerr << "Failed to initialise zlib!\n";
+		return;
+	}
+	out = std::fopen( fname.c_str(), "wb" );
+	if( !out ){
+		std::cerr << "Failed to open " << fname << " for writing!\n";
+		return;
+	}
+	buffer.reserve( bgzf_block_data );
+	cbuffer.resize( bgzf_max_block );
+	good_ = true;
+#endif
+}
+
+
+bgzf_writer::~bgzf_writer()
+{
+	if( out ) close();
+#ifdef HAVE_ZLIB
+	deflateEnd( &zs );
+#endif
+}
+
+
+bool bgzf_writer::write( const char *data, std::size_t n )
+{
+	while( good_ && n > 0 ){
+		std::size_t m = std::min( n, bgzf_block_data - buffer.size() );
+		buffer.insert( buffer.end(), data, data + m );
+		data += m;
+		n    -= m;
+		if( buffer.size() == bgzf_block_data ){
+			good_ = write_block( buffer.data(), buffer.size() );
+			buffer.clear();
+		}
+	}
+	return good_;
+}
+
+
+bool bgzf_writer::write_block( const char *data, std::size_t n )
+{
+#ifdef HAVE_ZLIB
+	unsigned char *c = reinterpret_cast<unsigned char*>( cbuffer.data() );
+
+	deflateReset( &zs );
+	zs.next_in   = reinterpret_cast<Bytef*>( const_cast<char*>( data ) );
+	zs.avail_in  = n;
+	zs.next_out  = c + bgzf_header;
+	zs.avail_out = bgzf_max_block - bgzf_header - gzip_footer;
+	int ret = deflate( &zs, Z_FINISH );
+	if( ret != Z_STREAM_END ){
+		// Did not compress well enough to fit, use two blocks.
+		if( ( ret != Z_OK && ret != Z_BUF_ERROR ) || n < 2 ) return false;
+		return write_block( data, n/2 ) &&
+			write_block( data + n/2, n - n/2 );
+	}
+
+	std::size_t block_size = bgzf_header + zs.total_out + gzip_footer;
+	std::memcpy( c, bgzf_eof_block, bgzf_header );
+	write_le16( c + 16, block_size - 1 );
+
+	uLong crc = crc32( 0L, reinterpret_cast<const Bytef*>( data ), n );
+	write_le32( c + block_size - 8, crc );
+	write_le32( c + block_size - 4, n );
+
+	if( std::fwrite( c, 1, block_size, out ) != block_size ) return false;
+
+	bgzf_block b = { coffset, static_cast<py_int>( block_size ), uoffset,
+	                 static_cast<py_int>( n ) };
+	index.add( b );
+	coffset += block_size;
+	uoffset += n;
+	return true;
+#else
+	return false;
+#endif // HAVE_ZLIB
+}
+
+
+bool bgzf_writer::close()
+{
+	if( !out ) return false;
+
+	if( good_ && !buffer.empty() ){
+		good_ = write_block( buffer.data(), buffer.size() );
+		buffer.clear();
+	}
+	if( good_ ){
+		good_ = std::fwrite( bgzf_eof_block, 1, sizeof(bgzf_eof_block),
+		                     out ) == sizeof(bgzf_eof_block);
+		bgzf_block b = { coffset, sizeof(bgzf_eof_block), uoffset, 0 };
+		index.add( b );
+	}
+	good_ = ( std::fclose( out ) == 0 ) && good_;
+	out = nullptr;
+
+	if( good_ && !index.save( bgzf_index::sidecar_name( fname ) ) ){
+		std::cerr << "Could not save BGZF index for " << fname << "!\n";
+	}
+	return good_;
+}
+
+
+
+extern "C" {
+
+int bgzf_recompress( const char *in_name, const char *out_name,
+                     py_int level )
+{
+#ifndef HAVE_ZLIB
+	std::cerr << "Cannot recompress without zlib support!\n";
+	return -1;
+#else
+	// gzread handles gzip files with several members
+	// as well as files that are not compressed at all.
+	gzFile in = gzopen( in_name, "rb" );
+	if( !in ){
+		std::cerr << "Failed to open " << in_name << "!\n";
+		return -1;
+	}
+
+	bgzf_writer w( out_name, level );
+	std::vector<char> buff( 1 << 20 );
+	int n = 0;
+	while( w.good() &&
+	       ( n = gzread( in, buff.data(), buff.size() ) ) > 0 ){
+		w.write( buff.data(), n );
+	}
+	int in_status = n < 0 ? -1 : 0;
+	gzclose( in );
+
+	if( in_status ){
+		std::cerr << "Failed to decompress " << in_name << "!\n";
+		w.close();
+		std::remove( out_name );
+		return -1;
+	}
+	if( !w.close() ){
+		std::cerr << "Failed to write " << out_name << "!\n";
+		return -1;
+	}
+	return 0;
+#endif // HAVE_ZLIB
+}
+
+}
@@ -0,0 +1,255 @@
+#ifndef BGZF_H
+#define BGZF_H
+
+/*!
+  \file bgzf.h
+  @brief Reading and writing block-gzipped (BGZF) files.
+
+  BGZF files are a series of small gzip members of at most 64 kB each,
+  with the compressed size of each member stored in a gzip extra field.
+  They are valid gzip files that gunzip and zcat read as usual, but the
+  blocks can be found without decompressing anything. That allows
+  decompressing blocks in parallel and jumping to any uncompressed
+  offset by only decompressing the one block it is in.
+
+  The decompressing and compressing parts need zlib (HAVE_ZLIB).
+
+  \ingroup cpp_lib
+*/
+
+#include "types.h"
+#include "mapped_file.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+
+/// Location of a single BGZF block.
+struct bgzf_block
+{
+	py_int coffset;  ///< Offset of the block in the compressed file
+	py_int csize;    ///< Size of the block, including header and footer
+	py_int uoffset;  ///< Offset of its data in the uncompressed stream
+	py_int usize;    ///< Size of its data when uncompressed
+};
+
+
+/// Returns true if the file fname starts with a BGZF block.
+bool bgzf_is_bgzf( const std::string &fname );
+
+
+/*!
+  @brief The access points of a BGZF file, i.e., where each block is.
+
+  The index is stored next to the compressed file in the .gzi format of
+  bgzip (file name + ".gzi"). If that is missing or older than the
+  file, it is rebuilt by walking over the block headers, which does not
+  decompress anything.
+
+  \ingroup cpp_lib
+*/
+class bgzf_index
+{
+public:
+	/// Builds the index from the block headers of a mapped BGZF file.
+	bool build( const char *data, std::size_t size );
+
+	/// Loads a .gzi index. The sizes of the last block are
+	/// taken from the mapped file.
+	bool load( const std::string &gzi_name, const char *data,
+	           std::size_t size );
+
+	/// Saves the index in .gzi format. Returns true on success.
+	bool save( const std::string &gzi_name ) const;
+
+	/// Loads the sidecar index of fname if it is up to date,
+	/// otherwise builds it and tries to save it.
+	bool load_or_build( const std::string &fname, const char *data,
+	                    std::size_t size );
+
+	/// Appends a block, used when writing.
+	void add( const bgzf_block &b ) { blocks.push_back( b ); }
+
+	std::size_t size() const { return blocks.size(); }
+	const bgzf_block &operator[]( std::size_t i ) const
+	{ return blocks[i]; }
+
+	/// Returns the block that contains uncompressed offset uoffset,
+	/// or size() if it is past the end.
+	std::size_t find( py_int uoffset ) const;
+
+	/// Total size of the uncompressed data.
+	py_int uncompressed_size() const;
+
+	/// Name of the sidecar index file for BGZF file fname.
+	static std::string sidecar_name( const std::string &fname )
+	{ return fname + ".gzi"; }
+
+private:
+	std::vector<bgzf_block> blocks;
+};
+
+
+/*!
+  @brief Decompresses a BGZF file block by block on background threads.
+
+  The blocks are decompressed by a pool of threads into a ring of
+  buffers in file order, and handed out as lines or characters. Seeking
+  to an uncompressed offset restarts the threads at the block that
+  contains the offset.
+
+  \ingroup cpp_lib
+*/
+class bgzf_stream
+{
+public:
+	/**
+	   \param fname      Name of the BGZF file.
+	   \param n_threads  Number of decompressing threads. If 0, one
+	                     thread is used, if negative, one per core.
+	*/
+	bgzf_stream( const std::string &fname, int n_threads = 0 );
+	~bgzf_stream();
+
+	/// Reads up to the next newline, like std::getline.
+	bool getline( std::string &line );
+
+	/// Returns the next character without consuming it, or EOF.
+	int peek();
+
+	/// Moves past the next n lines without copying them.
+	bool skip_lines( std::size_t n );
+
+	/// Moves to given offset in the uncompressed data.
+	bool seek( py_int uoffset );
+
+	bool eof()  const { return eof_; }
+	bool good() const { return good_ && !eof_; }
+
+	const bgzf_index &index() const { return index_; }
+
+private:
+	/// Buffer that holds one decompressed block.
+	struct bgzf_slot {
+		bgzf_slot() : ready(false), status(0) {}
+		std::vector<char> data;
+		bool ready;
+		int status;
+	};
+
+	mapped_file file;
+	bgzf_index index_;
+	int n_threads;
+	std::size_t depth;
+	bool good_;
+	bool eof_;
+
+	std::vector<bgzf_slot> slots;
+	std::size_t next_task;  //!< Next block to hand to a thread
+	std::size_t current;    //!< Block that is currently read from
+	bool have_current;      //!< True if current's slot is being read
+	const char *pos;        //!< Position in the current block
+	const char *end;        //!< End of the current block
+	bool stopping;
+
+	std::mutex mtx;
+	std::condition_variable work_cv;
+	std::condition_variable ready_cv;
+	std::vector<std::thread> threads;
+
+	void start( std::size_t first_block );
+	void stop();
+	void work();
+	bool next_chunk();
+};
+
+
+#ifdef HAVE_ZLIB
+/*!
+  @brief Decompresses single BGZF blocks, reusing the zlib state.
+
+  \ingroup cpp_lib
+*/
+class bgzf_inflater
+{
+public:
+	bgzf_inflater();
+	~bgzf_inflater();
+
+	/// Decompresses block b of the file at data into out.
+	/// Returns 0 on success and negative on corrupt blocks.
+	int inflate( const char *data, const bgzf_block &b,
+	             std::vector<char> &out );
+
+private:
+	z_stream zs;
+};
+#endif // HAVE_ZLIB
+
+
+/*!
+  @brief Writes a BGZF file and its .gzi index.
+
+  \ingroup cpp_lib
+*/
+class bgzf_writer
+{
+public:
+	/// Opens fname for writing with given zlib compression level.
+	bgzf_writer( const std::string &fname, int level = 6 );
+	~bgzf_writer();
+
+	/// Appends n bytes of uncompressed data.
+	bool write( const char *data, std::size_t n );
+
+	/// Writes the last block, the end-of-file marker and the index.
+	bool close();
+
+	bool good() const { return good_; }
+
+private:
+	std::string fname;
+	std::FILE *out;
+	bool good_;
+
+	std::vector<char> buffer;   //!< Data for the next block
+	std::vector<char> cbuffer;  //!< The compressed block
+	bgzf_index index;
+	py_int coffset, uoffset;
+
+#ifdef HAVE_ZLIB
+	z_stream zs;
+#endif
+
+	bool write_block( const char *data, std::size_t n );
+};
+
+
+extern "C" {
+
+/**
+   Re-compresses a gzipped (or plain) file into BGZF format, so that it
+   can be seeked and decompressed in parallel by dump_reader.
+
+   \param in_name   The file to recompress.
+   \param out_name  The BGZF file to write, its index is written to
+                    out_name + ".gzi".
+   \param level     zlib compression level (1-9).
+
+   \returns 0 on success, negative on failure.
+*/
+int bgzf_recompress( const char *in_name, const char *out_name,
+                     py_int level );
+
+}
+
+
+#endif // BGZF_H
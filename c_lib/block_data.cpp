@@ -2,6 +2,20 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cstdlib>
+
+
+namespace {
+
+/// Rounds \p bytes up to a multiple of block_data::ALIGNMENT.
+std::size_t aligned_size( std::size_t bytes )
+{
+	const std::size_t a = block_data::ALIGNMENT;
+	return ( bytes + a - 1 ) / a * a;
+}
+
+} // namespace
+
 
 extern "C" {
 
@@ -10,29 +24,33 @@ block_data::block_data() : x(nullptr), x_(nullptr), ids(nullptr),
                            types(nullptr), mol(nullptr), N(0),
                            tstep(0), xlo{0,0,0}, xhi{0,0,0},
                            periodic(0), atom_style(atom_styles::ATOMIC),
-                           boxline("       "), Ntypes(0), mass(nullptr)
+                           boxline("       "), Ntypes(0), mass(nullptr),
+                           arena(nullptr), capacity_(0)
 {}
 
-block_data::block_data( int N ) : x(nullptr), x_(nullptr), ids(nullptr),
-                                  types(nullptr), mol(nullptr), N(0),
-                                  tstep(0), xlo{0,0,0}, xhi{0,0,0},
-                                  periodic(0), atom_style(atom_styles::ATOMIC),
-                                  boxline("       "), Ntypes(0), mass(nullptr)
+block_data::block_data( int N ) : block_data()
 {
 	init(N);
 }
 
 	
 
-block_data::block_data( const block_data &o )
+block_data::block_data( const block_data &o ) : block_data()
 {
 	*this = o;
 }
 
 
-// TODO: Rewrite this into copy & swap:
+block_data::block_data( block_data &&o ) : block_data()
+{
+	swap( o );
+}
+
+
 void block_data::operator=( const block_data &o )
 {
+	if( this == &o ) return;
+
 	resize( o.N );
 	// This needs to copy _all_ the fields of block_data, _except_ x
 	// because x refers to the memory of x_!
@@ -55,34 +73,48 @@ void block_data::operator=( const block_data &o )
 	periodic   = o.periodic;
 	atom_style = o.atom_style;
 	boxline    = o.boxline;
+	other_cols = o.other_cols;
+	top        = o.top;
 
-	// Copy the other cols:
-	int N_other_cols = o.other_cols.size();
-	other_cols.resize( N_other_cols );
-	
-	for( int i = 0; i < o.other_cols.size(); ++i ){
-		
-		int M = o.other_cols[i].data.size();
-		other_cols[i].resize( M );
-		other_cols[i].header = o.other_cols[i].header;
-		for( int j = 0; j < M; ++i ){
-			other_cols[i].data[j] = o.other_cols[i].data[j];
+	if( o.mass ){
+		if( !mass || Ntypes != o.Ntypes ){
+			init_per_type_arrays( o.Ntypes );
 		}
+		std::copy( o.mass, o.mass + Ntypes + 1, mass );
 	}
 }
 
-/*
-void block_data::operator=( const block_data &o )
+
+void block_data::operator=( block_data &&o )
 {
-	block_data tmp(o);
-	tmp.swap(*this);
+	swap( o );
 }
 
-void block_data::swap( block_data &o ) throw()
+
+void block_data::swap( block_data &o )
 {
-	std::swap( *this, o );
+	std::swap( x,     o.x );
+	std::swap( x_,    o.x_ );
+	std::swap( ids,   o.ids );
+	std::swap( types, o.types );
+	std::swap( mol,   o.mol );
+	std::swap( N,     o.N );
+	std::swap( tstep, o.tstep );
+
+	std::swap( xlo, o.xlo );
+	std::swap( xhi, o.xhi );
+	std::swap( periodic,   o.periodic );
+	std::swap( atom_style, o.atom_style );
+
+	boxline.swap( o.boxline );
+	other_cols.swap( o.other_cols );
+
+	std::swap( top,    o.top );
+	std::swap( Ntypes, o.Ntypes );
+	std::swap( mass,   o.mass );
+	std::swap( arena,  o.arena );
+	std::swap( capacity_, o.capacity_ );
 }
-*/
 
 
 void block_data::copy_meta( const block_data &o )
@@ -102,15 +134,61 @@ void block_data::copy_meta( const block_data &o )
 
 }
 
-void block_data::delete_members()
+
+void block_data::reallocate( py_int cap, py_int keep )
 {
-	delete [] x_;
-	delete [] x;
-	delete [] ids;
-	delete [] types;
-	delete [] mol;
+	// Layout: x_, ids, types, mol, x, each on an aligned boundary.
+	const std::size_t x_bytes   = aligned_size( 3*cap*sizeof(py_float) );
+	const std::size_t int_bytes = aligned_size( cap*sizeof(py_int) );
+	const std::size_t row_bytes = aligned_size( cap*sizeof(py_float*) );
+	const std::size_t bytes = x_bytes + 3*int_bytes + row_bytes;
+
+	void *mem = nullptr;
+	if( bytes && posix_memalign( &mem, ALIGNMENT, bytes ) ){
+		std::cerr << "Failed to allocate " << bytes << " bytes for "
+		          << cap << " atoms!\n";
+		std::terminate();
+	}
+
+	char *p = static_cast<char*>( mem );
+	py_float *new_x_  = reinterpret_cast<py_float*>( p );
+	py_int *new_ids   = reinterpret_cast<py_int*>( p + x_bytes );
+	py_int *new_types = reinterpret_cast<py_int*>( p + x_bytes + int_bytes );
+	py_int *new_mol   = reinterpret_cast<py_int*>( p + x_bytes + 2*int_bytes );
+	py_float **new_x  = reinterpret_cast<py_float**>( p + x_bytes
+	                                                  + 3*int_bytes );
+	if( keep > 0 ){
+		std::copy( x_,    x_    + 3*keep, new_x_ );
+		std::copy( ids,   ids   + keep,   new_ids );
+		std::copy( types, types + keep,   new_types );
+		std::copy( mol,   mol   + keep,   new_mol );
+	}
+	for( py_int i = 0; i < cap; ++i ){
+		new_x[i] = new_x_ + 3*i;
+	}
 
-	if( mass ) delete [] mass;
+	std::free( arena );
+	arena = mem;
+	x_    = bytes ? new_x_ : nullptr;
+	ids   = bytes ? new_ids : nullptr;
+	types = bytes ? new_types : nullptr;
+	mol   = bytes ? new_mol : nullptr;
+	x     = bytes ? new_x : nullptr;
+	capacity_ = cap;
+}
+
+
+void block_data::delete_members()
+{
+	std::free( arena );
+	arena = nullptr;
+	x_  = nullptr;
+	x   = nullptr;
+	ids = types = mol = nullptr;
+	capacity_ = 0;
+
+	delete [] mass;
+	mass = nullptr;
 }
 
 
@@ -123,31 +201,29 @@ block_data::~block_data()
 
 void block_data::resize( int NN )
 {
-	if( NN < N ){
-		N = NN;
-	}else{
-		delete_members();
-		init( NN );
+	if( NN > capacity_ ){
+		// Grow by half at least, so that slowly growing frames do
+		// not reallocate every time.
+		reallocate( std::max<py_int>( NN, capacity_ + capacity_/2 ),
+		            std::min( N, capacity_ ) );
 	}
+	N = NN;
+}
+
+void block_data::reserve( int NN )
+{
+	if( NN > capacity_ ) reallocate( NN, std::min( N, capacity_ ) );
 }
 	
 void block_data::init( int NN )
 {
+	reallocate( NN, 0 );
 	N = NN;
-	x  = new py_float*[N];
-	x_ = new py_float[3*N];
-
-	ids   = new py_int[N];
-	types = new py_int[N];
-	mol   = new py_int[N];
-
-	for( py_int i = 0; i < N; ++i ){
-		x[i] = x_ + 3*i;
-	}
 }
 
 void block_data::init_per_type_arrays( int NNtypes )
 {
+	delete [] mass;
 	Ntypes = NNtypes;
 	mass = new double[NNtypes+1];
 }
@@ -155,6 +231,47 @@ void block_data::init_per_type_arrays( int NNtypes )
 } // extern "C";
 
 
+block_pool::~block_pool()
+{
+	for( block_data *b : free_blocks ) delete b;
+}
+
+
+block_data *block_pool::acquire()
+{
+	{
+		std::lock_guard<std::mutex> lock( mtx );
+		if( !free_blocks.empty() ){
+			block_data *b = free_blocks.back();
+			free_blocks.pop_back();
+			return b;
+		}
+	}
+	return new block_data;
+}
+
+
+void block_pool::release( block_data *b )
+{
+	if( !b ) return;
+	{
+		std::lock_guard<std::mutex> lock( mtx );
+		if( free_blocks.size() < max_free ){
+			free_blocks.push_back( b );
+			return;
+		}
+	}
+	delete b;
+}
+
+
+block_pool &block_pool::shared()
+{
+	static block_pool pool;
+	return pool;
+}
+
+
 void print_block_data_lmp( const block_data &b, const std::string &s )
 {
 	print_block_data_lmp( b, s, std::ofstream::out );
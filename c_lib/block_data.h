@@ -7,6 +7,7 @@
 #include <iosfwd>
 #include <vector>
 #include <list>
+#include <mutex>
 #include <string>
 
 
@@ -52,11 +53,21 @@ struct topology {
 };
 
 
+/**
+   Holds one frame of a dump.
+
+   The per-atom arrays x_, ids, types and mol, and the row pointers x
+   into x_, live in one allocation, the arena. Every array starts on a
+   64-byte boundary so that loops over them vectorize well. The arena
+   is only reallocated when a frame has more atoms than fit, so reading
+   many frames into the same block costs no allocations after the first.
+*/
 struct block_data
 {
-	// Needs a custom assignment operator and copy constructor to work.
-	py_float **x;
-	py_float *x_;
+	enum { ALIGNMENT = 64 };
+
+	py_float **x;   ///< Row pointers, x[i] points to x_ + 3*i
+	py_float *x_;   ///< Positions, x y z of every atom in turn
 	py_int *ids, *types;
 	py_int *mol;
 	py_int N, tstep;
@@ -79,16 +90,37 @@ struct block_data
 	// Deliberately void to prevent assignment chaining.
 	void operator=( const block_data &o );
 	block_data( const block_data &o );
-	//void swap( block_data &o ) throw(); // For copy-and-swap idiom.
+
+	/// Takes over the arrays of \p o, which is left empty.
+	block_data( block_data &&o );
+	/// Exchanges the contents with \p o, so \p o keeps the old arrays
+	/// of this block to be reused or freed.
+	void operator=( block_data &&o );
+
+	/// Exchanges all contents with \p o without copying any arrays.
+	void swap( block_data &o );
 
 	void copy_meta( const block_data &o );
-	
+
+	/// Sets the number of atoms to N. The arena is only reallocated
+	/// if it is too small to hold N atoms, and then the first atoms
+	/// are kept, so growing a block keeps its contents.
 	void resize( int N );
+	/// Makes room for at least N atoms without changing the number
+	/// of atoms.
+	void reserve( int N );
+	/// Number of atoms the arena has room for.
+	py_int capacity() const { return capacity_; }
+
 	void init( int N );
 	void init_per_type_arrays( int Ntypes );
 	void init_topology()
 	{}
 private:
+	void *arena;       ///< Memory of all per-atom arrays
+	py_int capacity_;  ///< Number of atoms the arena has room for.
+
+	void reallocate( py_int capacity, py_int keep );
 	void delete_members();
 };
 
@@ -116,41 +148,51 @@ void print_block_data_lmp( const block_data &b, const std::string &s,
                            std::ios_base::openmode mode );
 
 
-template <typename container>
-block_data filter_block( block_data b, const container &ids )
+/**
+   Keeps up to max_free blocks that are no longer used, so that code
+   that hands out a new block for every frame can recycle their arenas
+   instead of allocating new ones. It is safe to use from many threads.
+*/
+class block_pool
 {
-	block_data b_filter;
-	py_int M = 0;
-	b_filter = b;
-	
+public:
+	block_pool( std::size_t max_free = 8 ) : max_free( max_free ){}
+	~block_pool();
+
+	/// Returns a block that was released before, or a new one if there
+	/// is none. Its contents are whatever the last user left in it.
+	block_data *acquire();
+
+	/// Returns \p b to the pool, or deletes it if the pool is full.
+	void release( block_data *b );
+
+	/// Pool of the blocks handed to Python by dump_reader_take_block.
+	static block_pool &shared();
+
+private:
+	block_pool( const block_pool & ) = delete;
+	void operator=( const block_pool & ) = delete;
+
+	std::size_t max_free;
+	std::vector<block_data*> free_blocks;
+	std::mutex mtx;
+};
 
-	for( int i = 0; i < b.N; ++i ){
-		auto idx = std::find( ids.begin(), ids.end(), b.ids[i] );
-		if( idx != ids.end() ){
-			b_filter.x[M][0] = b.x[i][0];
-			b_filter.x[M][1] = b.x[i][1];
-			b_filter.x[M][2] = b.x[i][2];
-
-			b_filter.ids[M]  = b.ids[i];
-			b_filter.types[M]  = b.types[i];
-			if( b.mol ){
-				b_filter.mol[M]  = b.mol[i];
-			}
-			++M;
-		}
-	}
-	b_filter.resize( M );
-	return b_filter;
-}
 
 template <typename container>
-block_data filter_block_by_indices( block_data b, const container &indices )
+block_data filter_block_by_indices( const block_data &b,
+                                    const container &indices )
 {
-	block_data b_filter;
-	py_int M = 0;
-	b_filter = b;
-	
+	block_data b_filter( b.N );
+	b_filter.copy_meta( b );
+	b_filter.periodic = b.periodic;
+	b_filter.other_cols.resize( b.other_cols.size() );
+	for( std::size_t k = 0; k < b.other_cols.size(); ++k ){
+		b_filter.other_cols[k].header = b.other_cols[k].header;
+		b_filter.other_cols[k].resize( b.N );
+	}
 
+	py_int M = 0;
 	for( py_int i : indices ){
 		b_filter.x[M][0] = b.x[i][0];
 		b_filter.x[M][1] = b.x[i][1];
@@ -158,15 +200,32 @@ block_data filter_block_by_indices( block_data b, const container &indices )
 
 		b_filter.ids[M]  = b.ids[i];
 		b_filter.types[M]  = b.types[i];
-		if( b.mol ){
+		if( b.atom_style == atom_styles::MOLECULAR ){
 			b_filter.mol[M]  = b.mol[i];
 		}
+		for( std::size_t k = 0; k < b.other_cols.size(); ++k ){
+			b_filter.other_cols[k].data[M] = b.other_cols[k].data[i];
+		}
 		++M;
 	}
 	b_filter.resize( M );
+	for( dump_col &c : b_filter.other_cols ) c.resize( M );
 	return b_filter;
 }
 
+template <typename container>
+block_data filter_block( const block_data &b, const container &ids )
+{
+	std::vector<py_int> indices;
+	for( py_int i = 0; i < b.N; ++i ){
+		auto idx = std::find( ids.begin(), ids.end(), b.ids[i] );
+		if( idx != ids.end() ){
+			indices.push_back( i );
+		}
+	}
+	return filter_block_by_indices( b, indices );
+}
+
 
 
 // For some python functions that want to pass around a C++-type
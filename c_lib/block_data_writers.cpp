@@ -2,7 +2,10 @@
 #include "gsd/gsd.h"
 #include "dump_interpreter_gsd.h"
 #include "id_map.h"
+#include "util.h"
 
+#include <cmath>
+#include <cstdlib>
 #include <fstream>
 
 
@@ -57,6 +60,22 @@ void write_block_lammps_dump( const block_data &b, std::ostream &o )
 }
 
 
+void write_block_ltraj( const block_data &b, const std::string &fname,
+                        int codec, py_float precision )
+{
+	ltraj_writer w( fname, codec, 3, precision );
+	write_block_ltraj( b, w );
+}
+
+
+void write_block_ltraj( const block_data &b, ltraj_writer &w )
+{
+	if( !w.write( b ) ){
+		std::cerr << "Failed to write block to ltraj file!\n";
+	}
+}
+
+
 void write_block_lammps_data( const block_data &b, const std::string &fname )
 {
 	std::ofstream o(fname);
@@ -502,6 +521,33 @@ void write_block_to_file( const block_data *bh, const char *fname,
 			std::cerr << "HOOMD-blue GSD file.\n";
 			write_block_hoomd_gsd( *bh, fname );
 		}
+	}else if( data_format == "LTRAJ" ){
+		if( starts_with( file_format, "QUANTIZED" ) ){
+			// Optionally followed by the precision, "QUANTIZED:1e-4".
+			py_float precision = 1e-3;
+			if( file_format.size() > 9 ){
+				const char *spec = file_format.c_str() + 10;
+				char *end = nullptr;
+				if( file_format[9] == ':' ){
+					precision = std::strtod( spec, &end );
+				}
+				if( !end || end == spec || *end != '\0' ||
+				    !( precision > 0.0 ) || !std::isfinite( precision ) ){
+					std::cerr << "ltraj file, but " << file_format
+					          << " does not give a positive precision!\n";
+					return;
+				}
+			}
+			std::cerr << "ltraj file with positions quantized to "
+			          << precision << ".\n";
+			write_block_ltraj( *bh, fname, LTRAJ_CODEC_ZSTD, precision );
+		}else if( file_format == "ZSTD" ){
+			std::cerr << "ltraj file with zstd-compressed columns.\n";
+			write_block_ltraj( *bh, fname, LTRAJ_CODEC_ZSTD );
+		}else{
+			std::cerr << "ltraj file.\n";
+			write_block_ltraj( *bh, fname );
+		}
 	}else{
 		std::cerr << "no idea!\n";
 		std::cerr << "Data format " << data_format
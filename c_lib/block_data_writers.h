@@ -2,6 +2,7 @@
 #define BLOCK_DATA_WRITERS_H
 
 #include "block_data.h"
+#include "ltraj.h"
 #include <iosfwd>
 
 #include "gsd/gsd.h"
@@ -59,6 +60,30 @@ void write_block_hoomd_gsd( const block_data &b, const std::string &fname );
 void write_block_hoomd_gsd( const block_data &b, gsd_handle *gh );
 
 
+/**
+   Writes block data as the only frame of an ltraj file (see ltraj.h).
+
+   \param b     The block_data to write.
+   \param fname The name of the ltraj file to write \p b to.
+   \param codec Compression of the columns, LTRAJ_CODEC_NONE or
+                LTRAJ_CODEC_ZSTD.
+   \param precision If > 0, positions are stored rounded to multiples
+                    of this, see ltraj_writer.
+*/
+void write_block_ltraj( const block_data &b, const std::string &fname,
+                        int codec = LTRAJ_CODEC_NONE,
+                        py_float precision = 0 );
+
+
+/**
+   Appends block data as a new frame to an ltraj file.
+
+   \param b     The block_data to write.
+   \param w     Writer of an open ltraj file.
+*/
+void write_block_ltraj( const block_data &b, ltraj_writer &w );
+
+
 /**
    Reads data file in LAMMPS format to a block_data object.
    
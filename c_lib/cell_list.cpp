@@ -0,0 +1,233 @@
+#include "cell_list.h"
+#include "domain.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+void cell_list::build( const arr3f &x, py_int NN, py_float rrc,
+                       py_int pperiodic, const py_float *xlo,
+                       const py_float *xhi, py_int ddims )
+{
+	N    = NN;
+	dims = ddims == 2 ? 2 : 3;
+	rc   = rrc;
+	periodic = pperiodic;
+
+	if( xlo && xhi ){
+		for( int d = 0; d < 3; ++d ){
+			lo[d] = xlo[d];
+			L[d]  = xhi[d] - xlo[d];
+		}
+	}else{
+		// Without a box, use the bounding box of the atoms.
+		periodic = PERIODIC_NONE;
+		for( int d = 0; d < 3; ++d ){
+			py_float a = N ? x[0][d] : 0.0, b = a;
+			for( py_int i = 1; i < N; ++i ){
+				a = std::min( a, x[i][d] );
+				b = std::max( b, x[i][d] );
+			}
+			lo[d] = a;
+			L[d]  = b - a;
+		}
+	}
+
+	// Cells are at least rc wide, so pairs are at most one cell apart.
+	// Rounding down rather than up keeps the last cell from being
+	// thinner than the others, which would make periodic pairs across
+	// it be missed.
+	n_cells = 1;
+	for( int d = 0; d < 3; ++d ){
+		n[d] = 1;
+		if( d < dims && rc > 0 && L[d] > 0 ){
+			double nd = std::floor( L[d] / rc );
+			n[d] = std::max<py_int>( 1, std::min<double>( nd, 1 << 20 ) );
+		}
+		n_cells *= n[d];
+	}
+	// Small cut-offs in sparse systems would make many empty cells,
+	// so cap their number at a few per atom.
+	const py_int max_cells = std::max<py_int>( 27, 4*N );
+	while( n_cells > max_cells ){
+		n_cells = 1;
+		for( int d = 0; d < 3; ++d ){
+			n[d] = std::max<py_int>( 1, n[d] / 2 );
+			n_cells *= n[d];
+		}
+	}
+	for( int d = 0; d < 3; ++d ){
+		w_inv[d] = L[d] > 0 ? n[d] / L[d] : 0.0;
+	}
+
+	// Counting sort of the atoms by cell.
+	atom_cell.resize( N );
+	cell_start.assign( n_cells + 1, 0 );
+	for( py_int i = 0; i < N; ++i ){
+		py_int c[3];
+		for( int d = 0; d < 3; ++d ){
+			py_int cd = std::floor( ( x[i][d] - lo[d] ) * w_inv[d] );
+			if( periodic & ( 1 << d ) ){
+				cd %= n[d];
+				if( cd < 0 ) cd += n[d];
+			}else{
+				cd = std::max<py_int>( 0, std::min( cd, n[d] - 1 ) );
+			}
+			c[d] = cd;
+		}
+		atom_cell[i] = c[0] + n[0]*( c[1] + n[1]*c[2] );
+		++cell_start[ atom_cell[i] + 1 ];
+	}
+	for( py_int c = 0; c < n_cells; ++c ){
+		cell_start[c+1] += cell_start[c];
+	}
+
+	std::vector<py_int> place( cell_start.begin(), cell_start.end() - 1 );
+	order.resize( N );
+	xs.resize( 3*N );
+	for( py_int i = 0; i < N; ++i ){
+		py_int k = place[ atom_cell[i] ]++;
+		order[k] = i;
+		xs[3*k]   = x[i][0];
+		xs[3*k+1] = x[i][1];
+		xs[3*k+2] = x[i][2];
+	}
+
+	make_stencil();
+}
+
+
+void cell_list::make_stencil()
+{
+	// For every cell, the distinct adjacent cells with a larger index.
+	// Pairs within a cell are handled separately, and every pair of
+	// cells is visited from the lower one only.
+	adj_start.assign( n_cells + 1, 0 );
+	adj.clear();
+
+	const py_int dz_max = dims == 2 ? 0 : 1;
+	py_int around[27];
+	py_int c = 0;
+	for( py_int cz = 0; cz < n[2]; ++cz ){
+		for( py_int cy = 0; cy < n[1]; ++cy ){
+			for( py_int cx = 0; cx < n[0]; ++cx, ++c ){
+				int n_around = 0;
+				for( py_int dz = -dz_max; dz <= dz_max; ++dz ){
+					for( py_int dy = -1; dy <= 1; ++dy ){
+						for( py_int dx = -1; dx <= 1; ++dx ){
+							py_int o[3] = { cx + dx, cy + dy, cz + dz };
+							bool inside = true;
+							for( int d = 0; d < 3; ++d ){
+								if( o[d] >= 0 && o[d] < n[d] ) continue;
+								if( periodic & ( 1 << d ) ){
+									o[d] = ( o[d] + n[d] ) % n[d];
+								}else{
+									inside = false;
+								}
+							}
+							if( !inside ) continue;
+							py_int oc = o[0] + n[0]*( o[1] + n[1]*o[2] );
+							if( oc > c ) around[n_around++] = oc;
+						}
+					}
+				}
+				// With fewer than three cells along a periodic
+				// direction, some cells are adjacent on both sides.
+				std::sort( around, around + n_around );
+				n_around = std::unique( around, around + n_around ) - around;
+				adj.insert( adj.end(), around, around + n_around );
+				adj_start[c+1] = adj.size();
+			}
+		}
+	}
+}
+
+
+void cell_list::make_pairs( neighbor_list &neighs, bool half,
+                            py_int itype, py_int jtype,
+                            const py_int *types, int extras,
+                            bool cell_order ) const
+{
+	const py_float rc2 = rc*rc;
+	const bool wrap[3] = { ( periodic & PERIODIC_X ) != 0,
+	                       ( periodic & PERIODIC_Y ) != 0,
+	                       ( periodic & PERIODIC_Z ) != 0 };
+	const bool typed = ( itype || jtype ) && types;
+	const py_float L_inv[3] = { wrap[0] ? 1.0 / L[0] : 0.0,
+	                            wrap[1] ? 1.0 / L[1] : 0.0,
+	                            wrap[2] ? 1.0 / L[2] : 0.0 };
+
+	// Tries atoms k and l, in cell order.
+	auto try_pair = [&]( py_int k, py_int l, neighbor_list &out )
+	{
+		py_float r[3];
+		for( int d = 0; d < 3; ++d ){
+			r[d] = xs[3*l+d] - xs[3*k+d];
+			if( wrap[d] ) r[d] -= L[d] * std::nearbyint( r[d] * L_inv[d] );
+		}
+		if( dims == 2 ) r[2] = 0.0;
+		py_float r2 = r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+		if( r2 > rc2 ) return;
+
+		py_int i = order[k], j = order[l];
+		if( typed ){
+			bool is_itype_in = types[i] == itype || types[j] == itype ||
+				itype == 0;
+			bool is_jtype_in = types[i] == jtype || types[j] == jtype ||
+				jtype == 0;
+			if( !is_itype_in || !is_jtype_in ) return;
+		}
+
+		py_float rr = extras & neighbor_list::DISTANCES ? std::sqrt( r2 ) : 0.0;
+		if( cell_order ){
+			i = k;
+			j = l;
+		}
+		if( !half ){
+			out.add_pair( i, j, rr, r );
+		}else if( i < j ){
+			out.add( i, j, rr, r );
+		}else{
+			const py_float mr[3] = { -r[0], -r[1], -r[2] };
+			out.add( j, i, rr, mr );
+		}
+	};
+
+	// Every thread takes a range of cells with about as many atoms and
+	// adds its pairs to its own part. The parts are merged in order, so
+	// the list is the same as with one thread.
+	const int n_threads = threads_for( N, 1024 );
+	std::vector<neighbor_list> parts( n_threads - 1 );
+	neighs.reset( N, extras );
+	for( neighbor_list &p : parts ) p.reset( N, extras );
+
+	run_threads( n_threads, [&]( int t )
+	{
+		neighbor_list &out = t == 0 ? neighs : parts[t-1];
+		auto first_cell = [&]( int u ){
+			if( u == n_threads ) return n_cells;
+			return py_int( std::lower_bound( cell_start.begin(),
+			                                 cell_start.end() - 1,
+			                                 N*u / n_threads ) -
+			               cell_start.begin() );
+		};
+		const py_int c0 = first_cell( t ), c1 = first_cell( t + 1 );
+
+		for( py_int c = c0; c < c1; ++c ){
+			const py_int b = cell_start[c], e = cell_start[c+1];
+			for( py_int k = b; k < e; ++k ){
+				for( py_int l = k + 1; l < e; ++l ){
+					try_pair( k, l, out );
+				}
+				for( py_int a = adj_start[c]; a < adj_start[c+1]; ++a ){
+					const py_int oc = adj[a];
+					for( py_int l = cell_start[oc]; l < cell_start[oc+1]; ++l ){
+						try_pair( k, l, out );
+					}
+				}
+			}
+		}
+	} );
+	neighs.finalize( parts );
+}
@@ -0,0 +1,101 @@
+#ifndef CELL_LIST_H
+#define CELL_LIST_H
+
+/*!
+  \file cell_list.h
+  @brief A linked-cell method for finding all pairs within a cut-off.
+
+  \ingroup cpp_lib
+*/
+
+#include "types.h"
+#include "neighbor_list.h"
+
+#include <vector>
+
+
+/*! @brief Sorts atoms into cells at least as wide as a cut-off, so that
+           all pairs within that cut-off are found by looking only at
+           atoms in the same and in adjacent cells.
+
+  The atoms are sorted by cell with a counting sort, and their positions
+  are copied in that order, so the atoms of a cell and of the cells next
+  to it are close together in memory. The cells adjacent to every cell
+  are worked out once per build, with periodic wrapping, so the pair
+  loop does no index arithmetic.
+
+  Each pair of cells is visited once, so each pair of atoms is looked
+  at once. A half list stores it once, as j in the row of i for i < j;
+  a full list stores it in both rows.
+
+  make_pairs splits the cells over get_n_threads() threads for large
+  systems. The list it makes does not depend on the number of threads.
+
+  \ingroup cpp_lib
+*/
+class cell_list {
+public:
+	cell_list() : N(0), dims(3), n_cells(0), periodic(0)
+	{
+		n[0] = n[1] = n[2] = 0;
+	}
+
+	/**
+	   Sorts the \p N atoms in \p x into cells of at least \p rc wide.
+	   If \p xlo or \p xhi is nullptr, the box is the bounding box of
+	   the atoms and is not periodic. Atoms outside the box are wrapped
+	   back in along periodic directions and put in the edge cells
+	   along the others.
+	*/
+	void build( const arr3f &x, py_int N, py_float rc, py_int periodic,
+	            const py_float *xlo, const py_float *xhi, py_int dims );
+
+	/**
+	   Adds all pairs closer than the cut-off to \p neighs, which is
+	   reset to N atoms first, and finalizes it.
+
+	   \param half   Store each pair only once, in the row of the
+	                 lower index.
+	   \param itype  If not 0, only pairs with an atom of this type
+	   \param jtype  If not 0, only pairs with an atom of this type
+	   \param types  Atom types, only used if itype or jtype is not 0
+	   \param extras What neighs stores besides the indices, see
+	                 neighbor_list::extras
+	   \param cell_order  Store atoms by their place in cell order, see
+	                 atom_at, rather than by their index.
+	*/
+	void make_pairs( neighbor_list &neighs, bool half,
+	                 py_int itype = 0, py_int jtype = 0,
+	                 const py_int *types = nullptr,
+	                 int extras = neighbor_list::INDICES_ONLY,
+	                 bool cell_order = false ) const;
+
+	/// Number of cells along each direction
+	const py_int *cells() const { return n; }
+	/// Cell atom i is in
+	py_int cell_of( py_int i ) const { return atom_cell[i]; }
+	/// Index of the atom at place k when the atoms are sorted by cell
+	py_int atom_at( py_int k ) const { return order[k]; }
+
+private:
+	py_int N, dims;
+	py_float rc;
+	py_int n[3];                   ///< Number of cells per direction
+	py_int n_cells;
+	py_float lo[3], L[3];          ///< Box origin and lengths
+	py_float w_inv[3];             ///< Inverse cell widths
+	py_int periodic;
+
+	std::vector<py_int> cell_start;  ///< Offset of each cell in order
+	std::vector<py_int> order;       ///< Atom indices sorted by cell
+	std::vector<py_int> atom_cell;   ///< Cell of each atom
+	std::vector<py_float> xs;        ///< Positions in the order of order
+
+	std::vector<py_int> adj_start;   ///< Offset of each cell in adj
+	std::vector<py_int> adj;         ///< Distinct cells adjacent to each
+
+	void make_stencil();
+};
+
+
+#endif /* CELL_LIST_H */
@@ -0,0 +1,256 @@
+#include "dump_index.h"
+#include "block_data.h"
+#include "lammps_frame_parser.h"
+#include "mapped_file.h"
+#include "text_readers.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+namespace {
+
+// Magic and version at the start of an index file.
+const char index_magic[8] = { 'L', 'T', 'I', 'D', 'X', '\0', '\0', '1' };
+
+// True if s is a number and nothing else, apart from trailing blanks.
+bool all_parsed( const char *s, const char *end )
+{
+	if( end == s ) return false;
+	while( *end == ' ' || *end == '\t' || *end == '\r' ) ++end;
+	return *end == '\0';
+}
+
+bool parse_number( const std::string &s, py_int &val )
+{
+	char *end = nullptr;
+	val = std::strtoll( s.c_str(), &end, 10 );
+	return all_parsed( s.c_str(), end );
+}
+
+bool parse_number( const std::string &s, py_float &val )
+{
+	char *end = nullptr;
+	val = std::strtod( s.c_str(), &end );
+	return all_parsed( s.c_str(), end );
+}
+
+}
+
+
+dump_index::dump_index() : file_size( -1 ), file_mtime( -1 )
+{}
+
+
+bool dump_index::file_stamp( const std::string &fname,
+                             py_int &size, py_int &mtime )
+{
+	struct stat st;
+	if( stat( fname.c_str(), &st ) ) return false;
+
+	size  = st.st_size;
+	mtime = static_cast<py_int>( st.st_mtim.tv_sec ) * 1000000000 +
+		st.st_mtim.tv_nsec;
+	return true;
+}
+
+
+bool dump_index::build( const std::string &dname )
+{
+	entries.clear();
+	if( !file_stamp( dname, file_size, file_mtime ) ){
+		std::cerr << "Cannot index " << dname << ", it does not exist!\n";
+		return false;
+	}
+
+	mapped_file file( dname );
+	if( !file.good() ) return false;
+
+	lammps_frame_parser parser;
+	block_data meta;
+	const char *p = file.data();
+	while( true ){
+		const char *frame_start = p;
+		int status = parser.skip_frame( p, file.end(), meta );
+		if( status > 0 ) break;
+		if( status < 0 ){
+			std::cerr << "Indexing stopped at incomplete or "
+			          << "malformed frame at byte "
+			          << frame_start - file.data() << "!\n";
+			break;
+		}
+
+		// skip_frame also skipped empty lines before the frame.
+		while( *frame_start == '\n' || *frame_start == ' ' ||
+		       *frame_start == '\t' || *frame_start == '\r' ){
+			++frame_start;
+		}
+
+		dump_index_entry e;
+		e.offset = frame_start - file.data();
+		e.tstep  = meta.tstep;
+		e.N      = meta.N;
+		std::copy( meta.xlo, meta.xlo + 3, e.xlo );
+		std::copy( meta.xhi, meta.xhi + 3, e.xhi );
+		entries.push_back( e );
+	}
+	return true;
+}
+
+
+bool dump_index::build( const std::string &dname, text_reader &r )
+{
+	entries.clear();
+	if( !file_stamp( dname, file_size, file_mtime ) ){
+		std::cerr << "Cannot index " << dname << ", it does not exist!\n";
+		return false;
+	}
+
+	std::string line;
+	py_int offset = 0, line_start = 0;
+	dump_index_entry e = { -1, 0, -1, {0,0,0}, {0,0,0} };
+	// Stays true as long as the header lines parse. A truncated file
+	// can end in a partial line.
+	bool ok = true;
+	while( ok && r.getline( line ) ){
+		line_start = offset;
+		offset += line.size() + 1;
+
+		if( starts_with( line, "ITEM: TIMESTEP" ) ){
+			e.offset = line_start;
+			ok = r.getline( line ) && parse_number( line, e.tstep );
+			offset += line.size() + 1;
+		}else if( starts_with( line, "ITEM: NUMBER OF ATOMS" ) ){
+			ok = r.getline( line ) && parse_number( line, e.N );
+			offset += line.size() + 1;
+		}else if( starts_with( line, "ITEM: BOX BOUNDS" ) ){
+			for( int d = 0; ok && d < 3; ++d ){
+				ok = r.getline( line );
+				if( !ok ) break;
+				offset += line.size() + 1;
+				std::vector<std::string> words = split( line );
+				ok = words.size() >= 2 &&
+					parse_number( words[0], e.xlo[d] ) &&
+					parse_number( words[1], e.xhi[d] );
+			}
+		}else if( starts_with( line, "ITEM: ATOMS" ) ){
+			if( e.offset < 0 || e.N < 0 ){
+				ok = false;
+				break;
+			}
+			py_int i = 0;
+			for( ; i < e.N && r.getline( line ); ++i ){
+				offset += line.size() + 1;
+			}
+			if( i < e.N ){
+				std::cerr << "Indexing stopped at incomplete frame "
+				          << "at byte " << e.offset << "!\n";
+				break;
+			}
+			entries.push_back( e );
+			e.offset = -1;
+			e.N = -1;
+		}
+	}
+	if( !ok ){
+		std::cerr << "Indexing stopped at malformed frame "
+		          << "at byte " << line_start << "!\n";
+	}
+	return true;
+}
+
+
+bool dump_index::load( const std::string &idx_name, const std::string &dname )
+{
+	py_int size, mtime;
+	if( !file_stamp( dname, size, mtime ) ) return false;
+
+	std::FILE *in = std::fopen( idx_name.c_str(), "rb" );
+	if( !in ) return false;
+
+	// The entries must fill the rest of the index file exactly, so a
+	// corrupt count cannot make us allocate too much.
+	py_int idx_size, idx_mtime;
+	const py_int header = sizeof(index_magic) + 3*sizeof(py_int);
+	const py_int entry  = sizeof(dump_index_entry);
+
+	char magic[8];
+	py_int stored_size, stored_mtime, n_entries;
+	bool ok = file_stamp( idx_name, idx_size, idx_mtime ) &&
+		idx_size >= header && ( idx_size - header ) % entry == 0 &&
+		std::fread( magic, sizeof(magic), 1, in ) == 1 &&
+		std::memcmp( magic, index_magic, sizeof(magic) ) == 0 &&
+		std::fread( &stored_size,  sizeof(py_int), 1, in ) == 1 &&
+		std::fread( &stored_mtime, sizeof(py_int), 1, in ) == 1 &&
+		std::fread( &n_entries,    sizeof(py_int), 1, in ) == 1 &&
+		stored_size == size && stored_mtime == mtime &&
+		n_entries == ( idx_size - header ) / entry;
+
+	if( ok ){
+		entries.resize( n_entries );
+		ok = std::fread( entries.data(), sizeof(dump_index_entry),
+		                 n_entries, in ) ==
+			static_cast<std::size_t>( n_entries );
+	}
+	std::fclose( in );
+
+	if( !ok ){
+		entries.clear();
+		return false;
+	}
+	file_size  = size;
+	file_mtime = mtime;
+	return true;
+}
+
+
+bool dump_index::save( const std::string &idx_name ) const
+{
+	std::FILE *out = std::fopen( idx_name.c_str(), "wb" );
+	if( !out ) return false;
+
+	py_int n_entries = entries.size();
+	bool ok = std::fwrite( index_magic, sizeof(index_magic), 1, out ) == 1 &&
+		std::fwrite( &file_size,  sizeof(py_int), 1, out ) == 1 &&
+		std::fwrite( &file_mtime, sizeof(py_int), 1, out ) == 1 &&
+		std::fwrite( &n_entries,  sizeof(py_int), 1, out ) == 1 &&
+		std::fwrite( entries.data(), sizeof(dump_index_entry),
+		             n_entries, out ) ==
+		static_cast<std::size_t>( n_entries );
+	ok = ( std::fclose( out ) == 0 ) && ok;
+
+	if( !ok ) std::remove( idx_name.c_str() );
+	return ok;
+}
+
+
+bool dump_index::load_or_build( const std::string &dname, text_reader *r )
+{
+	std::string idx_name = sidecar_name( dname );
+	if( load( idx_name, dname ) ) return true;
+
+	bool built = r ? build( dname, *r ) : build( dname );
+	if( !built ) return false;
+	if( !save( idx_name ) ){
+		std::cerr << "Could not save frame index to " << idx_name
+		          << ", keeping it in memory only.\n";
+	}
+	return true;
+}
+
+
+std::size_t dump_index::find_timestep( py_int t ) const
+{
+	// Time steps in a dump are increasing, so bisect.
+	auto it = std::lower_bound( entries.begin(), entries.end(), t,
+	                            []( const dump_index_entry &e, py_int tt )
+	                            { return e.tstep < tt; } );
+	return it - entries.begin();
+}
@@ -0,0 +1,109 @@
+#ifndef DUMP_INDEX_H
+#define DUMP_INDEX_H
+
+/*!
+  \file dump_index.h
+  @brief An index of frame offsets for random access into dump files.
+
+  \ingroup cpp_lib
+*/
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+class text_reader;
+
+
+/// Describes where a single frame is in a dump file.
+struct dump_index_entry
+{
+	py_int offset;      ///< Byte offset of the start of the frame
+	py_int tstep;       ///< Time step of the frame
+	py_int N;           ///< Number of atoms in the frame
+	py_float xlo[3];    ///< Lower box bounds
+	py_float xhi[3];    ///< Upper box bounds
+};
+
+
+/*!
+  @brief Stores the byte offset and meta info of every frame in a dump file.
+
+  The index is built once by a fast scan over the file that only reads
+  the frame headers and jumps over the atom lines. It is persisted in
+  a sidecar file (dump name + ".idx") together with the size and
+  modification time of the dump, so that it is only rebuilt if the dump
+  changes.
+
+  \ingroup cpp_lib
+*/
+class dump_index
+{
+public:
+	dump_index();
+
+	/**
+	   Builds the index by scanning a plain text LAMMPS dump file.
+
+	   \returns true on success.
+	*/
+	bool build( const std::string &dname );
+
+	/**
+	   Builds the index of dump \p dname by reading its text line by
+	   line from \p r, for dumps that cannot be mapped, like
+	   compressed ones. Offsets are in the text \p r returns.
+
+	   \returns true on success.
+	*/
+	bool build( const std::string &dname, text_reader &r );
+
+	/**
+	   Loads the index from \p idx_name if it matches dump \p dname.
+
+	   \returns true if the index was loaded and is up to date.
+	*/
+	bool load( const std::string &idx_name, const std::string &dname );
+
+	/// Saves the index to \p idx_name. Returns true on success.
+	bool save( const std::string &idx_name ) const;
+
+	/**
+	   Loads the index from the sidecar file of dump \p dname, or
+	   builds it and tries to save it if that fails. If \p r is given,
+	   the index is built from the text it reads.
+
+	   \returns true if a valid index is available afterwards.
+	*/
+	bool load_or_build( const std::string &dname, text_reader *r = nullptr );
+
+	/// Appends an entry, for formats that store their own index.
+	void add( const dump_index_entry &e ) { entries.push_back( e ); }
+
+	/// Number of frames in the index.
+	std::size_t size() const { return entries.size(); }
+
+	/// Returns the entry of frame i.
+	const dump_index_entry &operator[]( std::size_t i ) const
+	{ return entries[i]; }
+
+	/// Returns the index of the first frame with time step >= t,
+	/// or size() if there is no such frame.
+	std::size_t find_timestep( py_int t ) const;
+
+	/// Name of the sidecar index file for dump file dname.
+	static std::string sidecar_name( const std::string &dname )
+	{ return dname + ".idx"; }
+
+private:
+	std::vector<dump_index_entry> entries;
+	py_int file_size;   //!< Size of the dump when it was indexed.
+	py_int file_mtime;  //!< Modification time (ns) of the indexed dump.
+
+	static bool file_stamp( const std::string &fname,
+	                        py_int &size, py_int &mtime );
+};
+
+
+#endif // DUMP_INDEX_H
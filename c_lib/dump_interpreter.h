@@ -3,9 +3,12 @@
 
 #include <iosfwd>
 #include <string>
+#include <vector>
 
 #include "block_data.h"
 
+class dump_index;
+
 
 class dump_interpreter
 {
@@ -28,6 +31,30 @@ public:
 		return next_block(b);
 	}
 
+	/// Moves to given byte offset in the (uncompressed) dump, which
+	/// must be the start of a block. Returns 0 on success and
+	/// negative if the interpreter cannot seek.
+	virtual int seek( std::size_t offset ){ return -1; }
+
+	/// Fills \p idx from an index the dump format has itself, with
+	/// offsets that seek understands. Returns false if it has none.
+	virtual bool build_index( dump_index &idx ) const { return false; }
+
+	/// Restricts parsing to the given columns, see
+	/// lammps_frame_parser::select_columns. Returns false if the
+	/// interpreter always reads all columns.
+	virtual bool select_columns( const std::vector<std::string> &columns )
+	{
+		return false;
+	}
+
+	/// Switches follow mode on or off. In follow mode, a frame that is
+	/// cut off by the end of the file is not an error: the interpreter
+	/// stays at the start of that frame and returns 1, so it can be
+	/// read once the file has grown. Returns false if the interpreter
+	/// cannot follow a file that is still being written.
+	virtual bool follow( bool on ){ return false; }
+
 	virtual bool eof()  const = 0;
 	virtual bool good() const = 0;
 	
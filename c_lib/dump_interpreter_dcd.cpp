@@ -1,10 +1,254 @@
 #include "dump_interpreter_dcd.h"
+#include "domain.h"
 
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
 
 
+namespace {
+
+uint32_t bswap32( uint32_t v )
+{
+	return ( v >> 24 ) | ( ( v >> 8 ) & 0xff00 ) |
+		( ( v << 8 ) & 0xff0000 ) | ( v << 24 );
+}
+
+uint64_t bswap64( uint64_t v )
+{
+	return ( static_cast<uint64_t>( bswap32( v & 0xffffffff ) ) << 32 ) |
+		bswap32( v >> 32 );
+}
+
+} // namespace
+
+
+
+dump_interpreter_dcd::dump_interpreter_dcd( const std::string &dname )
+	: dump_interpreter( dname ), namd_units( true ), file( dname, false ),
+	  good_( true ), swap_bytes( false ), has_cell( false ),
+	  four_dims( false ), N( 0 ), istart( 0 ), nsavc( 1 ),
+	  header_size( 0 ), stride( 0 ), n_frames( 0 ), current( 0 )
+{
+	if( !file.good() ){
+		std::cerr << "Failed to map DCD file " << dname << "!\n";
+		std::terminate();
+	}
+	if( !read_header() ){
+		std::cerr << dname << " is not a DCD file I can read!\n";
+		std::terminate();
+	}
+}
+
+
+int32_t dump_interpreter_dcd::get_int( const char *p ) const
+{
+	uint32_t v;
+	std::memcpy( &v, p, sizeof(v) );
+	if( swap_bytes ) v = bswap32( v );
+	return static_cast<int32_t>( v );
+}
+
+
+bool dump_interpreter_dcd::read_record( std::size_t &pos, const char *&data,
+                                        std::size_t &size ) const
+{
+	if( pos + 4 > file.size() ) return false;
+	int32_t len = get_int( file.data() + pos );
+	if( len < 0 || pos + 8 + len > file.size() ||
+	    get_int( file.data() + pos + 4 + len ) != len ){
+		return false;
+	}
+	data = file.data() + pos + 4;
+	size = len;
+	pos += 8 + len;
+	return true;
+}
+
+
+bool dump_interpreter_dcd::read_header()
+{
+	if( file.size() < 92 ) return false;
+
+	// The first record is 84 bytes long, which tells the byte order.
+	swap_bytes = false;
+	if( get_int( file.data() ) != 84 ){
+		swap_bytes = true;
+		if( get_int( file.data() ) != 84 ) return false;
+	}
+
+	std::size_t pos = 0;
+	const char *rec;
+	std::size_t size;
+	if( !read_record( pos, rec, size ) || std::memcmp( rec, "CORD", 4 ) ){
+		return false;
+	}
+	int32_t icntrl[20];
+	for( int i = 0; i < 20; ++i ) icntrl[i] = get_int( rec + 4 + 4*i );
+
+	istart = icntrl[1];
+	nsavc  = icntrl[2] > 0 ? icntrl[2] : 1;
+	if( icntrl[8] != 0 ){
+		std::cerr << "DCD files with fixed atoms are not supported!\n";
+		return false;
+	}
+	// Only CHARMM-style files (version in the last field) can have
+	// unit cells and a fourth dimension.
+	bool charmm = icntrl[19] != 0;
+	has_cell  = charmm && icntrl[10];
+	four_dims = charmm && icntrl[11];
+
+	// Title record, then the number of atoms.
+	if( !read_record( pos, rec, size ) ) return false;
+	if( !read_record( pos, rec, size ) || size != 4 ) return false;
+	N = get_int( rec );
+	if( N < 0 ) return false;
+
+	header_size = pos;
+	stride = 3 * ( 8 + 4*N );
+	if( has_cell )  stride += 8 + 6*sizeof(double);
+	if( four_dims ) stride += 8 + 4*N;
+
+	// The frame count in the header is not updated by all writers,
+	// so trust the file size instead.
+	n_frames = ( file.size() - header_size ) / stride;
+	if( icntrl[0] > 0 && static_cast<std::size_t>( icntrl[0] ) != n_frames ){
+		std::cerr << "DCD header claims " << icntrl[0] << " frames, "
+		          << "but the file has " << n_frames << ".\n";
+	}
+	return true;
+}
+
+
+void dump_interpreter_dcd::read_cell( const char *frame, py_float *xlo,
+                                      py_float *xhi ) const
+{
+	// The cell is A, gamma, B, beta, alpha, C. Only the lengths are
+	// used, so triclinic cells end up orthogonal.
+	double cell[6];
+	std::memcpy( cell, frame + 4, sizeof(cell) );
+	if( swap_bytes ){
+		for( double &c : cell ){
+			uint64_t v;
+			std::memcpy( &v, &c, sizeof(v) );
+			v = bswap64( v );
+			std::memcpy( &c, &v, sizeof(v) );
+		}
+	}
+	xlo[0] = xlo[1] = xlo[2] = 0.0;
+	xhi[0] = cell[0];
+	xhi[1] = cell[2];
+	xhi[2] = cell[5];
+}
+
+
+int dump_interpreter_dcd::read_frame( std::size_t i, block_data &block ) const
+{
+	if( i >= n_frames ) return 1;
+
+	const char *frame = file.data() + header_size + i*stride;
+	const char *planes = frame;
+	if( has_cell ){
+		if( get_int( frame ) != 6*sizeof(double) ) return -1;
+		planes += 8 + 6*sizeof(double);
+	}
+
+	block.resize( N );
+	block.tstep = istart + static_cast<py_int>( i ) * nsavc;
+	block.atom_style = atom_styles::ATOMIC;
+	block.other_cols.clear();
+
+	for( int d = 0; d < 3; ++d ){
+		const char *p = planes + d * ( 8 + 4*N );
+		if( get_int( p ) != 4*N || get_int( p + 4 + 4*N ) != 4*N ){
+			return -1;
+		}
+		p += 4;
+		for( py_int j = 0; j < N; ++j, p += 4 ){
+			uint32_t v;
+			std::memcpy( &v, p, sizeof(v) );
+			if( swap_bytes ) v = bswap32( v );
+			float f;
+			std::memcpy( &f, &v, sizeof(f) );
+			block.x[j][d] = f;
+		}
+	}
+
+	for( py_int j = 0; j < N; ++j ){
+		block.ids[j]   = j + 1;
+		block.types[j] = 1;
+		block.mol[j]   = 0;
+	}
+
+	if( has_cell ){
+		read_cell( frame, block.xlo, block.xhi );
+		block.periodic = PERIODIC_FULL;
+		block.boxline  = "ITEM: BOX BOUNDS pp pp pp";
+	}else{
+		for( int d = 0; d < 3; ++d ){
+			block.xlo[d] =  std::numeric_limits<py_float>::max();
+			block.xhi[d] = -std::numeric_limits<py_float>::max();
+			for( py_int j = 0; j < N; ++j ){
+				block.xlo[d] = std::min( block.xlo[d], block.x[j][d] );
+				block.xhi[d] = std::max( block.xhi[d], block.x[j][d] );
+			}
+		}
+		if( N == 0 ){
+			std::fill( block.xlo, block.xlo + 3, 0.0 );
+			std::fill( block.xhi, block.xhi + 3, 0.0 );
+		}
+		block.periodic = PERIODIC_NONE;
+		block.boxline  = "ITEM: BOX BOUNDS ff ff ff";
+	}
+	return 0;
+}
+
 
 int dump_interpreter_dcd::next_block( block_data &block )
 {
+	int status = read_frame( current, block );
+	if( status < 0 ){
+		std::cerr << "Corrupt DCD frame " << current << "!\n";
+		good_ = false;
+		return status;
+	}
+	if( status == 0 ) ++current;
+	return status;
+}
+
+
+int dump_interpreter_dcd::seek( std::size_t offset )
+{
+	if( offset == 0 ){
+		current = 0;
+		return 0;
+	}
+	if( offset < header_size || ( offset - header_size ) % stride ){
+		return -1;
+	}
+	std::size_t i = ( offset - header_size ) / stride;
+	if( i > n_frames ) return -1;
+	current = i;
 	return 0;
 }
-	
+
+
+bool dump_interpreter_dcd::build_index( dump_index &idx ) const
+{
+	for( std::size_t i = 0; i < n_frames; ++i ){
+		dump_index_entry e;
+		e.offset = header_size + i*stride;
+		e.tstep  = istart + static_cast<py_int>( i ) * nsavc;
+		e.N      = N;
+		if( has_cell ){
+			read_cell( file.data() + e.offset, e.xlo, e.xhi );
+		}else{
+			// Would need to read all positions, leave it open.
+			std::fill( e.xlo, e.xlo + 3, 0.0 );
+			std::fill( e.xhi, e.xhi + 3, 0.0 );
+		}
+		idx.add( e );
+	}
+	return true;
+}
@@ -3,29 +3,84 @@
 
 #include "block_data.h"
 #include "dump_reader.h"
+#include "mapped_file.h"
 
 
+/**
+   Reads CHARMM/NAMD DCD trajectories.
+
+   A DCD file is a header followed by frames that all have the same
+   size: an optional unit cell and one float32 plane each for x, y and
+   z, all as Fortran records. The file is memory-mapped and the planes
+   are converted into the block straight from the mapping. Because the
+   frame size is fixed, frame i is found by arithmetic, so seeking and
+   skipping cost nothing and the frame index needs no scan.
+
+   DCD files carry no ids or types, the atoms get ids 1...N and type 1.
+   Without a unit cell, the box is the bounding box of the atoms and not
+   periodic. Files with fixed atoms are not supported.
+*/
 class dump_interpreter_dcd : public dump_interpreter
 {
 public:
 	// To convert NAMD units to A/ps/fs.
 	static constexpr double PDBVELVACTOR = 20.45482706;
 	static constexpr double TIMEFACTOR   = 48.88821;
-	
 
-	dump_interpreter_dcd( std::string &dname )
-		: dump_interpreter(dname), namd_units(true)
-	{}
+
+	dump_interpreter_dcd( const std::string &dname );
 	virtual ~dump_interpreter_dcd(){}
 
 	virtual int next_block( block_data &block );
-	
-        
-	
-	
-	
+
+	virtual int skip_block()
+	{
+		if( current >= n_frames ) return 1;
+		++current;
+		return 0;
+	}
+
+	virtual int seek( std::size_t offset );
+
+	virtual bool build_index( dump_index &idx ) const;
+
+	virtual bool eof() const
+	{
+		return current >= n_frames;
+	}
+	virtual bool good() const
+	{
+		return file.good() && good_;
+	}
+
+	/// Reads frame i without moving the reader.
+	int read_frame( std::size_t i, block_data &block ) const;
+
+	/// Number of atoms per frame.
+	py_int atoms() const { return N; }
+
 private:
 	bool namd_units;
+
+	mapped_file file;
+	bool good_;
+	bool swap_bytes;     //!< File has the other byte order
+	bool has_cell;       //!< Frames start with a unit cell
+	bool four_dims;      //!< Frames have a fourth plane, ignored
+
+	py_int N;
+	py_int istart;       //!< Time step of the first frame
+	py_int nsavc;        //!< Time steps between frames
+	std::size_t header_size;
+	std::size_t stride;  //!< Bytes per frame
+	std::size_t n_frames;
+	std::size_t current;
+
+	bool read_header();
+	bool read_record( std::size_t &pos, const char *&data,
+	                  std::size_t &size ) const;
+	int32_t get_int( const char *p ) const;
+	void read_cell( const char *frame, py_float *xlo, py_float *xhi ) const;
 };
 
 
@@ -1,15 +1,83 @@
 #include "dump_interpreter_gsd.h"
+#include "domain.h"
 #include "util.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 
 #define MY_CERR std::cerr << status << " ( " << gh << " ) "
 
 
+namespace {
+
+/// Per-particle chunks that can be selected, with the names of their
+/// columns in other_cols and their defaults in the HOOMD schema.
+struct particle_chunk
+{
+	const char *name;
+	int M;
+	const char *headers[4];
+	double defaults[4];
+};
+
+const particle_chunk particle_chunks[] = {
+	{ "velocity",       3, { "vx", "vy", "vz" },             { 0, 0, 0 } },
+	{ "image",          3, { "ix", "iy", "iz" },             { 0, 0, 0 } },
+	{ "orientation",    4, { "quatw", "quati", "quatj", "quatk" },
+	                                                         { 1, 0, 0, 0 } },
+	{ "angmom",         4, { "angmomw", "angmomx", "angmomy", "angmomz" },
+	                                                         { 0, 0, 0, 0 } },
+	{ "moment_inertia", 3, { "inertiax", "inertiay", "inertiaz" },
+	                                                         { 0, 0, 0 } },
+	{ "mass",           1, { "mass" },                       { 1 } },
+	{ "charge",         1, { "q" },                          { 0 } },
+	{ "diameter",       1, { "diameter" },                   { 1 } },
+	{ "body",           1, { "body" },                       { -1 } }
+};
+const int n_particle_chunks = sizeof(particle_chunks) / sizeof(particle_chunk);
+
+
+/// Converts n values of given GSD type to doubles.
+bool convert_chunk( const char *src, uint8_t type, std::size_t n, double *dest )
+{
+	switch( type ){
+		case GSD_TYPE_UINT8:
+			for( std::size_t i = 0; i < n; ++i )
+				dest[i] = reinterpret_cast<const uint8_t*>( src )[i];
+			return true;
+		case GSD_TYPE_INT8:
+			for( std::size_t i = 0; i < n; ++i )
+				dest[i] = reinterpret_cast<const int8_t*>( src )[i];
+			return true;
+		case GSD_TYPE_UINT32:
+			for( std::size_t i = 0; i < n; ++i )
+				dest[i] = reinterpret_cast<const uint32_t*>( src )[i];
+			return true;
+		case GSD_TYPE_INT32:
+			for( std::size_t i = 0; i < n; ++i )
+				dest[i] = reinterpret_cast<const int32_t*>( src )[i];
+			return true;
+		case GSD_TYPE_FLOAT:
+			for( std::size_t i = 0; i < n; ++i )
+				dest[i] = reinterpret_cast<const float*>( src )[i];
+			return true;
+		case GSD_TYPE_DOUBLE:
+			std::memcpy( dest, src, n*sizeof(double) );
+			return true;
+		default:
+			return false;
+	}
+}
+
+} // namespace
+
+
+
 dump_interpreter_gsd::dump_interpreter_gsd( const std::string &fname )
 	: dump_interpreter( fname ), status( 0 ),
-	  gh( nullptr ), current_frame( -1 ), eof_( true ), good_( false )
+	  gh( nullptr ), current_frame( 0 ), eof_( true ), good_( false )
 {
 	MY_CERR << "Attempting to open gsd file " << fname << ".\n";
 	gh = new gsd_handle;
@@ -43,152 +111,240 @@ dump_interpreter_gsd::~dump_interpreter_gsd()
 	
 }
 
-int dump_interpreter_gsd::get_chunk_data( const std::string &name, void *dest )
+const gsd_index_entry *dump_interpreter_gsd::find_chunk( uint64_t frame,
+                                                         const char *name ) const
 {
-	const gsd_index_entry *idx  = gsd_find_chunk( gh, current_frame,
-	                                              name.c_str() );
-	if( !idx ){
-		/*
-		MY_CERR << "find_chunk failed to find " << name
-		        << " for frame " << current_frame << "\n";
-		*/
-		return 1;
-	}
+	const gsd_index_entry *e = gsd_find_chunk( gh, frame, name );
+	if( !e && frame > 0 ) e = gsd_find_chunk( gh, 0, name );
+	return e;
+}
 
-	status = gsd_read_chunk( gh, dest, idx );
-	
-	// MY_CERR << "Read chunk " << name << " at " << idx << ".\n";
-	return status;
+
+bool dump_interpreter_gsd::read_chunk( const gsd_index_entry *e, uint8_t type,
+                                       uint64_t count, void *dest ) const
+{
+	if( e->type != type || e->N * e->M != count ){
+		std::cerr << "GSD chunk has the wrong type or size!\n";
+		return false;
+	}
+	return gsd_read_chunk( gh, dest, e ) == 0;
 }
 
 
-int dump_interpreter_gsd::next_block( block_data &b )
+int dump_interpreter_gsd::get_chunk_data( const std::string &name, void *dest )
 {
-	++current_frame;
-	const gsd_index_entry *entry;
+	const gsd_index_entry *e = find_chunk( current_frame, name.c_str() );
+	if( !e ) return 1;
+	status = gsd_read_chunk( gh, dest, e );
+	return status;
+}
 
-	// Read out all the chunks you want to add to your dumpfile.
-	uint64_t tstep;
-	uint8_t  dims;
-	float    box[6];
 
-	uint32_t N;
+int dump_interpreter_gsd::read_meta( uint64_t frame, block_data &b ) const
+{
+	// Defaults of the HOOMD schema.
+	uint64_t step = 0;
+	uint32_t N = 0;
+	float box[6] = { 1, 1, 1, 0, 0, 0 };
 
-	bool default_type = false;
-	
-	if( get_chunk_data( "configuration/step", &tstep ) ) {
-		// Assume EOF, because this would be first block
-		eof_ = true;
-		return 0;
+	const gsd_index_entry *e;
+	bool ok = true;
+	if( ( e = find_chunk( frame, "configuration/step" ) ) ){
+		ok = ok && read_chunk( e, GSD_TYPE_UINT64, 1, &step );
 	}
-	if ( get_chunk_data( "configuration/dimensions", &dims ) ) {
-		// This is not good.
-		good_ = false;
-		return -1;
+	if( ( e = find_chunk( frame, "configuration/box" ) ) ){
+		ok = ok && read_chunk( e, GSD_TYPE_FLOAT, 6, box );
 	}
-	if( get_chunk_data( "configuration/box", box ) ){
-		good_ = false;
-		return -1;
+	if( ( e = find_chunk( frame, "particles/N" ) ) ){
+		ok = ok && read_chunk( e, GSD_TYPE_UINT32, 1, &N );
 	}
-	if( get_chunk_data( "particles/N", &N ) ){
-		good_ = false;
+	if( !ok ){
+		std::cerr << "Failed to read configuration of GSD frame "
+		          << frame << "!\n";
 		return -1;
 	}
 
-	b.tstep = tstep;
-	b.xlo[0] = -0.5*box[0];
-	b.xlo[1] = -0.5*box[1];
-	b.xlo[2] = -0.5*box[2];
-	b.xhi[0] =  0.5*box[0];
-	b.xhi[1] =  0.5*box[1];
-	b.xhi[2] =  0.5*box[2];
-	
-	b.resize(N);
+	b.N = N;
+	b.tstep = step;
+	for( int d = 0; d < 3; ++d ){
+		b.xlo[d] = -0.5*box[d];
+		b.xhi[d] =  0.5*box[d];
+	}
+	b.periodic = PERIODIC_FULL;
+	if( box[3] != 0 || box[4] != 0 || box[5] != 0 ){
+		b.boxline = "ITEM: BOX BOUNDS xy xz yz pp pp pp";
+	}else{
+		b.boxline = "ITEM: BOX BOUNDS pp pp pp";
+	}
+	return 0;
+}
 
-	float *x           = new float[3*N];
-	uint32_t *type_ids = new uint32_t[N];
-	
 
-	status = get_chunk_data( "particles/position", x );
-	if( status == 1 ){
-		// This means types was not in the file. Probably because
-		// everything is the default 1.
-		std::cerr << "Didn't find particles/position!\n";
-		return -2;
+int dump_interpreter_gsd::read_frame( uint64_t frame, block_data &b )
+{
+	int status = read_meta( frame, b );
+	if( status ) return status;
+
+	const py_int N = b.N;
+	b.resize( N );
+	b.atom_style = atom_styles::ATOMIC;
+
+	const gsd_index_entry *e = find_chunk( frame, "particles/position" );
+	if( e ){
+		positions.resize( 3*N );
+		if( !read_chunk( e, GSD_TYPE_FLOAT, 3*N, positions.data() ) ){
+			return -1;
+		}
+		std::copy( positions.begin(), positions.end(), b.x_ );
+	}else{
+		std::fill( b.x_, b.x_ + 3*N, 0.0 );
 	}
-	
-	status = get_chunk_data( "particles/typeid",  type_ids );
-	if( status == 1 ){
-		// This means types was not in the file. Probably because
-		// everything is the default 1.
-		std::cerr << "Didn't find particles/typeid!\n";
-		default_type = true;
-	}
-
-	if( !default_type ){
-		// At this point you know the type ids. Count them:
-		int n_types = 0;
-		for( int i = 0; i < N; ++i ){
-			int type_id_inc = type_ids[i]+1;
-			if( type_id_inc > n_types ) n_types = type_id_inc;
+
+	// Type names are not kept, the types are the type ids plus one.
+	e = find_chunk( frame, "particles/typeid" );
+	if( e ){
+		type_ids.resize( N );
+		if( !read_chunk( e, GSD_TYPE_UINT32, N, type_ids.data() ) ){
+			return -1;
 		}
-		/*
-		std::cerr << "Found " << n_types << " particle types. "
-		          << "Reading in type names...\n";
-		*/
-		constexpr int buff_size = TYPE_BUFFER_SIZE;
-		gsd_utf8_char *type_names = new gsd_utf8_char[ n_types * buff_size ];
-		
-		status = get_chunk_data( "particles/types", type_names );
-		for( int i = 0; i < n_types; ++i ){
-			gsd_utf8_char *name_i = type_names + i*buff_size;
-			char name_buffer[buff_size];
-			int j = 0;
-			while( name_i[j].c[0] ){
-				name_buffer[j] = name_i[j].c[0];
-				++j;
+		for( py_int i = 0; i < N; ++i ) b.types[i] = type_ids[i] + 1;
+	}else{
+		std::fill( b.types, b.types + N, 1 );
+	}
+	for( py_int i = 0; i < N; ++i ) b.ids[i] = i + 1;
+
+	// Selected chunks go to other_cols, one column per component.
+	std::size_t n_other = 0;
+	for( int c : selected ) n_other += particle_chunks[c].M;
+	b.other_cols.resize( n_other );
+
+	std::size_t k = 0;
+	for( int c : selected ){
+		const particle_chunk &pc = particle_chunks[c];
+		std::string name = std::string( "particles/" ) + pc.name;
+		e = find_chunk( frame, name.c_str() );
+		for( int m = 0; m < pc.M; ++m ){
+			b.other_cols[k+m].header = pc.headers[m];
+			b.other_cols[k+m].resize( N );
+		}
+		if( !e ){
+			for( int m = 0; m < pc.M; ++m ){
+				std::fill( b.other_cols[k+m].data.begin(),
+				           b.other_cols[k+m].data.end(),
+				           pc.defaults[m] );
 			}
-			name_buffer[j] = '\0';
-			std::string name = name_buffer;
-			
-			//std::cerr << "Name " << i+1 << " = " << name << "\n";
+			k += pc.M;
+			continue;
+		}
+		if( e->N != static_cast<uint64_t>( N ) ||
+		    e->M != static_cast<uint32_t>( pc.M ) ){
+			std::cerr << "GSD chunk " << name << " has the wrong "
+			          << "size!\n";
+			return -1;
+		}
+		std::size_t n = N * pc.M;
+		chunk.resize( n * gsd_sizeof_type( static_cast<gsd_type>( e->type ) ) );
+		values.resize( n );
+		if( gsd_read_chunk( gh, chunk.data(), e ) ){
+			return -1;
+		}
+		if( !convert_chunk( chunk.data(), e->type, n, values.data() ) ){
+			std::cerr << "GSD chunk " << name << " has an "
+			          << "unsupported type!\n";
+			return -1;
 		}
+		// The components are interleaved in the chunk.
+		for( int m = 0; m < pc.M; ++m ){
+			double *dest = b.other_cols[k+m].data.data();
+			for( py_int i = 0; i < N; ++i ){
+				dest[i] = values[i*pc.M + m];
+			}
+		}
+		k += pc.M;
+	}
+	return 0;
+}
 
-		
 
-		delete [] type_names;
+int dump_interpreter_gsd::next_block( block_data &b )
+{
+	if( !good_ ) return -1;
+	if( current_frame >= gsd_get_nframes( gh ) ){
+		eof_ = true;
+		return 1;
 	}
-	
+	int status = read_frame( current_frame, b );
+	if( status ){
+		good_ = false;
+		return status;
+	}
+	++current_frame;
+	return 0;
+}
 
-	// MY_CERR << "Read positions and types.\n";
-	for( int i = 0; i < N; ++i ){
-		b.x[i][0] = x[3*i  ];
-		b.x[i][1] = x[3*i+1];
-		b.x[i][2] = x[3*i+2];
 
-		b.ids[i]   = i+1;
-		
+int dump_interpreter_gsd::skip_block()
+{
+	if( current_frame >= gsd_get_nframes( gh ) ){
+		eof_ = true;
+		return 1;
+	}
+	++current_frame;
+	return 0;
+}
+
+
+int dump_interpreter_gsd::seek( std::size_t offset )
+{
+	if( offset > gsd_get_nframes( gh ) ) return -1;
+	current_frame = offset;
+	eof_ = false;
+	return 0;
+}
+
+
+bool dump_interpreter_gsd::build_index( dump_index &idx ) const
+{
+	uint64_t n_frames = gsd_get_nframes( gh );
+	block_data meta;
+	for( uint64_t f = 0; f < n_frames; ++f ){
+		if( read_meta( f, meta ) ) return false;
+		dump_index_entry e;
+		e.offset = f;
+		e.tstep  = meta.tstep;
+		e.N      = meta.N;
+		std::copy( meta.xlo, meta.xlo + 3, e.xlo );
+		std::copy( meta.xhi, meta.xhi + 3, e.xhi );
+		idx.add( e );
 	}
+	return true;
+}
+
 
-	if( !default_type ){
-		for( int i = 0; i < N; ++i ){
-			// Reconstruct the type as an integer rather than
-			// the named type. I am not happy about this loss
-			// of info, but ok.
-			b.types[i] = type_ids[i] + 1;
+bool dump_interpreter_gsd::select_columns( const std::vector<std::string> &columns )
+{
+	selected.clear();
+	for( const std::string &col : columns ){
+		std::string name = col;
+		if( starts_with( name, "particles/" ) ) name = name.substr( 10 );
+		if( name == "id" || name == "type" || name == "typeid" ||
+		    name == "x" || name == "y" || name == "z" ||
+		    name == "position" ){
+			continue;
 		}
-	}else{
-		for( int i = 0; i < N; ++i ){
-			b.types[i] = 1;
+		int c = 0;
+		while( c < n_particle_chunks && name != particle_chunks[c].name ){
+			++c;
+		}
+		if( c == n_particle_chunks ){
+			std::cerr << "GSD files have no particle chunk "
+			          << col << "!\n";
+			continue;
+		}
+		if( std::find( selected.begin(), selected.end(), c ) ==
+		    selected.end() ){
+			selected.push_back( c );
 		}
 	}
-	b.mol = nullptr;
-	b.atom_style = atom_styles::ATOMIC;
-	b.boxline = "ITEM: BOX BOUNDS pp pp pp";
-
-	delete [] x;
-	delete [] type_ids;
-	
-	return 0;
-	
+	return true;
 }
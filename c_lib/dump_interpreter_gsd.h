@@ -6,6 +6,7 @@
 
 #include <string>
 #include <iosfwd>
+#include <vector>
 
 #include "gsd/gsd.h"
 
@@ -19,28 +20,74 @@ union gsd_utf8_char_templ
 typedef gsd_utf8_char_templ<char> gsd_utf8_char;
 
 
-// A dump interpreter for the HOOMD-blue GSD schema.
+/**
+   A dump interpreter for the HOOMD-blue GSD schema.
+
+   As the schema requires, a chunk that is missing from a frame takes
+   its value from frame 0, and if frame 0 does not have it either, the
+   schema default. So trajectories that only store what changed are read
+   correctly. The chunk buffers are kept between frames.
+
+   Frames are found through the GSD index, so skipping and seeking read
+   nothing. The offsets this interpreter seeks to are frame numbers.
+
+   Positions and type ids are always read. Other per-particle chunks,
+   like particles/velocity, are only read if they are requested with
+   select_columns, and end up in other_cols.
+*/
 class dump_interpreter_gsd : public dump_interpreter
 {
 public:
 	enum { TYPE_BUFFER_SIZE = 64 };
-	
+
 	dump_interpreter_gsd( const std::string &fname );
 	virtual ~dump_interpreter_gsd();
 	virtual int next_block( block_data &b );
 
+	/// Frames are found through the GSD index, nothing to read.
+	virtual int skip_block();
+
+	/// Moves to frame number \p offset.
+	virtual int seek( std::size_t offset );
+
+	virtual bool build_index( dump_index &idx ) const;
+
+	/**
+	   Selects the per-particle chunks to read besides positions and
+	   type ids, named with or without the particles/ prefix, e.g.
+	   "velocity" or "particles/orientation". id, type, x, y and z
+	   are accepted and always read.
+	*/
+	virtual bool select_columns( const std::vector<std::string> &columns );
+
+	/// Reads chunk \p name of the current frame, or of frame 0 if the
+	/// current frame does not have it. Returns 1 if neither has it.
 	int get_chunk_data( const std::string &name, void *dest );
 
 	virtual bool eof()  const { return eof_; }
 	virtual bool good() const { return good_; }
-	
+
 private:
 	int status;
 	gsd_handle *gh;
 
-	uint64_t current_frame;
+	uint64_t current_frame;  //!< Frame that is read next
 
 	bool eof_, good_;
+
+	std::vector<float>    positions;  //!< Buffer for particles/position
+	std::vector<uint32_t> type_ids;   //!< Buffer for particles/typeid
+	std::vector<char>     chunk;      //!< Buffer for selected chunks
+	std::vector<double>   values;     //!< Selected chunk as doubles
+
+	std::vector<int> selected;        //!< Selected particle chunks
+
+	const gsd_index_entry *find_chunk( uint64_t frame,
+	                                   const char *name ) const;
+	bool read_chunk( const gsd_index_entry *e, uint8_t type,
+	                 uint64_t count, void *dest ) const;
+	int read_meta( uint64_t frame, block_data &b ) const;
+	int read_frame( uint64_t frame, block_data &b );
 };
 
 
@@ -3,20 +3,51 @@
 
 #include "block_data.h"
 #include "dump_reader.h"
+#include "lammps_frame_parser.h"
 #include "text_readers.h"
 
 
+/**
+   Reads LAMMPS text dumps line by line through a text_reader, so it
+   works for compressed files too. The lines of a frame are collected
+   in a buffer that is parsed by a lammps_frame_parser, so all text
+   dumps are parsed the same way.
+
+   Plain text dumps can be followed while they are written. A frame
+   counts as complete once the newline after its last atom line is
+   there; until then the reader goes back to the start of the frame.
+*/
 class dump_interpreter_lammps : public dump_interpreter
 {
 public:
-	dump_interpreter_lammps( const std::string &dname, int file_type = 0 );
+	/// n_threads is only used for BGZF files, where it is the number
+	/// of decompressing threads.
+	dump_interpreter_lammps( const std::string &dname, int file_type = 0,
+	                         int n_threads = 0 );
 	virtual ~dump_interpreter_lammps();
-	
+
 	virtual int next_block( block_data &block );
 
 	virtual int next_block_meta( block_data &block );
 	virtual int next_block_body( block_data &block );
 
+	/// Reads only the header and jumps over the atom lines.
+	virtual int skip_block();
+
+	virtual int seek( std::size_t offset )
+	{
+		return r->seek( offset ) ? 0 : -1;
+	}
+
+	virtual bool select_columns( const std::vector<std::string> &columns )
+	{
+		parser.select_columns( columns );
+		return true;
+	}
+
+	/// Only plain text dumps can be followed.
+	virtual bool follow( bool on );
+
 	virtual bool eof() const
 	{
 		if ( r ) return r->eof();
@@ -28,39 +59,24 @@ public:
 		else    return false;
 	}
 
-	enum dump_styles {
-		ATOMIC = 0,
-		CUSTOM
-	};
-	
 private:
-	enum { BIT_X = 1,
-	       BIT_Y = 2,
-	       BIT_Z = 3 };
-
 	text_reader *r;
-	
-	int id_idx;
-	int type_idx;
-	int x_idx;
-	int y_idx;
-	int z_idx;
-	int mol_idx;
-
-	int n_cols;
-	std::vector<std::string> headers;
-	
-	std::vector<int>         other_cols;
-	std::vector<std::string> other_col_headers;
-
-	int atom_style;
-	int scaled;
-	std::string last_line;
-	block_data last_meta;
-
-	int dump_style;
-
-	void set_headers( const std::string &h_line );
+	lammps_frame_parser parser;
+
+	std::string line;
+	std::string buffer;  //!< Lines of the frame that is parsed
+	block_data meta;     //!< Header of skipped frames
+
+	bool following;          //!< True in follow mode
+	std::size_t frame_start; //!< Offset of the frame read in follow mode
+
+	/// Reads the ITEM lines of the next frame into buffer.
+	int read_header_lines();
+	/// Remembers where the next frame starts in follow mode.
+	void mark_frame_start();
+	/// In follow mode, turns a frame that was cut off into EOF and
+	/// goes back to its start. Otherwise returns status.
+	int check_complete( int status );
 };
 
 
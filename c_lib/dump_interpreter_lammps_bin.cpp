@@ -1,15 +1,16 @@
 #include "dump_interpreter_lammps_bin.h"
+#include "domain.h"
+#include "util.h"
 
-#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
 
 
-/**
-   This interpreter leverages the heavy lifting to a modification of the
-   binary2txt tool that comes with LAMMPS.
+/*
+   The layout follows write_header_binary of dump atom/custom and
+   tools/binary2txt.cpp in LAMMPS.
 */
-#include <cstdio>
-#include <cstring>
-
 
 #if !defined(LAMMPS_SMALLSMALL) && !defined(LAMMPS_BIGBIG) && !defined(LAMMPS_SMALLBIG)
 #define LAMMPS_SMALLBIG
@@ -18,186 +19,368 @@
 #if defined(LAMMPS_SMALLBIG)
 typedef int tagint;
 typedef int64_t bigint;
-#define BIGINT_FORMAT "%" PRId64
 #elif defined(LAMMPS_SMALLSMALL)
 typedef int tagint;
 typedef int bigint;
-#define BIGINT_FORMAT "%d"
 #else /* LAMMPS_BIGBIG */
 typedef int64_t tagint;
 typedef int64_t bigint;
-#define BIGINT_FORMAT "%" PRId64
 #endif
 
 
 
 dump_interpreter_lammps_bin::dump_interpreter_lammps_bin(
 	const std::string &dname, int file_type )
-	: dump_interpreter( dname ), in( nullptr ), id_idx(0), type_idx(1),
-	  x_idx(2), y_idx(3), z_idx(4)
+	: dump_interpreter( dname ), in( nullptr ), good_( true ),
+	  map_size_one( 0 ), atom_style( atom_styles::ATOMIC ), scaled( 0 )
 {
-	in = fopen( dname.c_str(), "rb" );
+	in = std::fopen( dname.c_str(), "rb" );
+	if( !in ){
+		std::cerr << "Failed to open binary dump " << dname << "!\n";
+	}
 }
 
-		
+
 dump_interpreter_lammps_bin::~dump_interpreter_lammps_bin()
 {
-	if( in ) fclose( in );
+	if( in ) std::fclose( in );
 }
 
 
-int dump_interpreter_lammps_bin::next_block( block_data &block )
+bool dump_interpreter_lammps_bin::read_string( std::string &s )
 {
-	if( !in ) return -1;
-	
-	if( feof(in) ){
-		return 1;
-	}
-	int size_one, nchunk;
-	int status = next_block_meta( block, size_one, nchunk );
-	if( !status ){
-		return next_block_body( block, size_one, nchunk );
-	}else if( status > 1 ){
-		// EOF.
-		if( status == 1 ) std::cerr << "EOF reached.\n";
-		return status;
-	}else{
-		std::cerr << "Failed to get meta!\n";
-		return -1;
+	int len = 0;
+	if( !read( len ) || len < 0 ) return false;
+	s.resize( len );
+	return len == 0 || std::fread( &s[0], 1, len, in ) == std::size_t( len );
+}
+
+
+int dump_interpreter_lammps_bin::read_header()
+{
+	bigint ntimestep;
+	if( !read( ntimestep ) ){
+		// Nothing left is EOF, a partial time step is not.
+		return std::feof( in ) && !std::ferror( in ) ? 1 : -1;
+	}
+
+	bool ok = true;
+	h.revision = 0;
+	if( ntimestep < 0 ){
+		// Newer layout: The negative length of a magic string,
+		// the string, endianness and revision come first.
+		std::string magic( -ntimestep, '\0' );
+		int endian = 0;
+		ok = std::fread( &magic[0], 1, magic.size(), in ) == magic.size() &&
+			read( endian ) && read( h.revision ) && read( ntimestep );
+		if( ok && endian != 1 ){
+			std::cerr << "Binary dump was written with the other "
+			          << "byte order!\n";
+			return -1;
+		}
+	}
+
+	bigint natoms = 0;
+	ok = ok && read( natoms ) && read( h.triclinic ) &&
+		std::fread( h.boundary, sizeof(int), 6, in ) == 6;
+	for( int d = 0; d < 3; ++d ){
+		ok = ok && read( h.lo[d] ) && read( h.hi[d] );
+	}
+	h.tilt[0] = h.tilt[1] = h.tilt[2] = 0.0;
+	if( ok && h.triclinic ){
+		ok = read( h.tilt[0] ) && read( h.tilt[1] ) && read( h.tilt[2] );
+	}
+	ok = ok && read( h.size_one );
+
+	h.has_time = false;
+	h.columns.clear();
+	if( ok && h.revision > 1 ){
+		// The unit style is only written with the first frame.
+		std::string units;
+		char time_flag = 0;
+		ok = read_string( units ) && read( time_flag );
+		if( !units.empty() ) h.units = units;
+		h.has_time = time_flag != 0;
+		if( ok && h.has_time ) ok = read( h.time );
+		ok = ok && read_string( h.columns );
 	}
+	ok = ok && read( h.nchunk );
 
+	if( !ok || natoms < 0 || h.size_one <= 0 || h.nchunk < 0 ){
+		std::cerr << "Malformed header in binary dump!\n";
+		return -1;
+	}
+	h.tstep = ntimestep;
+	h.N     = natoms;
+	return 0;
 }
 
 
-int dump_interpreter_lammps_bin::next_block_meta( block_data &block,
-                                                  int &size_one, int &nchunk )
+int dump_interpreter_lammps_bin::set_columns()
 {
-	bigint ntimestep, natoms;
-	double xlo[3], xhi[3];
-	int boundary[3][2];
-	char boundstr[9];
-	int triclinic;
-	int xy,xz,yz;
-
-	while( true ){
-		fread( &ntimestep, sizeof(bigint), 1, in );
-		if( !in ) return -1;
-		
-		if( feof(in) ){
-			return 1;
-		}
+	if( !roles.empty() && h.columns == map_columns &&
+	    h.size_one == map_size_one ){
+		return 0;
+	}
+	map_columns  = h.columns;
+	map_size_one = h.size_one;
+	roles.clear();
+	other_idx.clear();
+	other_headers.clear();
+	scaled = 0;
+	atom_style = atom_styles::ATOMIC;
 
-		fread(&natoms,sizeof(bigint),1,in);
-		fread(&triclinic,sizeof(int),1,in);
-		fread(&boundary[0][0],6*sizeof(int),1,in);
-		fread(xlo  ,sizeof(double),1,in);
-		fread(xhi  ,sizeof(double),1,in);
-		fread(xlo+1,sizeof(double),1,in);
-		fread(xhi+1,sizeof(double),1,in);
-		fread(xlo+2,sizeof(double),1,in);
-		fread(xhi+2,sizeof(double),1,in);
-		if (triclinic) {
-			fread(&xy,sizeof(double),1,in);
-			fread(&xz,sizeof(double),1,in);
-			fread(&yz,sizeof(double),1,in);
+	std::vector<std::string> words;
+	if( h.columns.empty() ){
+		// The old layout has no names, assume dump atom.
+		static const char *defaults[] = { "id", "type", "x", "y", "z" };
+		for( int k = 0; k < h.size_one; ++k ){
+			if( k < 5 ) words.push_back( defaults[k] );
+			else        words.push_back( "col" + std::to_string( k ) );
 		}
-		fread(&size_one,sizeof(int),1,in);
-		fread(&nchunk,sizeof(int),1,in);
-
-		last_meta.N = natoms;
-		last_meta.tstep = ntimestep;
-		last_meta.xlo[0] = xlo[0];
-		last_meta.xlo[1] = xlo[1];
-		last_meta.xlo[2] = xlo[2];
-
-		last_meta.xhi[0] = xhi[0];
-		last_meta.xhi[1] = xhi[1];
-		last_meta.xhi[2] = xhi[2];
-
-		int m = 0;
-		for (int idim = 0; idim < 3; idim++) {
-			for (int iside = 0; iside < 2; iside++) {
-				if (boundary[idim][iside] == 0){
-					boundstr[m++] = 'p';
-				}else if (boundary[idim][iside] == 1){
-					boundstr[m++] = 'f';
-				}else if (boundary[idim][iside] == 2){
-					boundstr[m++] = 's';
-				}else if (boundary[idim][iside] == 3){
-					boundstr[m++] = 'm';
-				}
-			}
-			boundstr[m++] = ' ';
+	}else{
+		words = split( h.columns );
+	}
+	if( static_cast<int>( words.size() ) != h.size_one ){
+		std::cerr << "Binary dump has " << h.size_one << " values per "
+		          << "atom but " << words.size() << " column names!\n";
+		roles.clear();
+		return -1;
+	}
+
+	bool have[7] = { false, false, false, false, false, false, false };
+	for( const std::string &w : words ){
+		int r = COL_OTHER;
+		if( w == "id" ){
+			r = COL_ID;
+		}else if( w == "type" ){
+			r = COL_TYPE;
+		}else if( w == "mol" ){
+			r = COL_MOL;
+		}else if( w == "x" || w == "xu" || w == "xs" || w == "xsu" ){
+			r = COL_X;
+		}else if( w == "y" || w == "yu" || w == "ys" || w == "ysu" ){
+			r = COL_Y;
+		}else if( w == "z" || w == "zu" || w == "zs" || w == "zsu" ){
+			r = COL_Z;
 		}
-		boundstr[8] = '\0';
+		// As in text dumps, only the first of duplicates is used.
+		if( r != COL_OTHER && have[r] ) r = COL_OTHER;
+		have[r] = true;
 
-		last_meta.periodic = 0;
-		if( (boundary[0][0] == 0) && (boundary[0][1] == 0) ){
-			last_meta.periodic += BIT_X;
+		if( r >= COL_X && w.size() > 1 && w[1] == 's' ){
+			scaled |= 1 << ( r - COL_X );
 		}
-		if( (boundary[1][0] == 0) && (boundary[1][1] == 0) ){
-			last_meta.periodic += BIT_Y;
+		roles.push_back( r );
+		if( r == COL_OTHER ){
+			other_idx.push_back( other_headers.size() );
+			other_headers.push_back( w );
+		}else{
+			other_idx.push_back( -1 );
 		}
-		if( (boundary[2][0] == 0) && (boundary[2][1] == 0) ){
-			last_meta.periodic += BIT_Z;
+	}
+
+	if( !have[COL_ID] || !have[COL_TYPE] || !have[COL_X] ||
+	    !have[COL_Y] || !have[COL_Z] ){
+		std::cerr << "Column mapping failed for binary dump columns '"
+		          << h.columns << "'!\n";
+		roles.clear();
+		return -1;
+	}
+	if( have[COL_MOL] ) atom_style = atom_styles::MOLECULAR;
+	return 0;
+}
+
+
+int dump_interpreter_lammps_bin::next_block( block_data &block )
+{
+	int status = next_block_meta( block );
+	if( status ) return status;
+	return next_block_body( block );
+}
+
+
+int dump_interpreter_lammps_bin::next_block_meta( block_data &block )
+{
+	if( !in || !good_ ) return -1;
+
+	int status = read_header();
+	if( status == 0 && set_columns() ) status = -1;
+	if( status ){
+		if( status < 0 ) good_ = false;
+		return status;
+	}
+
+	block.resize( h.N );
+	block.tstep = h.tstep;
+	block.atom_style = atom_style;
+
+	static const char bc[] = { 'p', 'f', 's', 'm' };
+	static const int periodic_bits[] = { PERIODIC_X, PERIODIC_Y, PERIODIC_Z };
+	std::string bounds;
+	block.periodic = PERIODIC_NONE;
+	for( int d = 0; d < 3; ++d ){
+		block.xlo[d] = h.lo[d];
+		block.xhi[d] = h.hi[d];
+		for( int s = 0; s < 2; ++s ){
+			int b = h.boundary[2*d + s];
+			bounds += ( b >= 0 && b < 4 ) ? bc[b] : '?';
 		}
+		bounds += d < 2 ? " " : "";
+		if( h.boundary[2*d] == 0 && h.boundary[2*d+1] == 0 ){
+			block.periodic |= periodic_bits[d];
+		}
+	}
+	block.boxline = "ITEM: BOX BOUNDS ";
+	if( h.triclinic ) block.boxline += "xy xz yz ";
+	block.boxline += bounds;
+	return 0;
+}
 
-		last_meta.boxline  = "ITEM: BOX BOUNDS ";
-		last_meta.boxline += boundstr;
-		
 
-		return 0;
+void dump_interpreter_lammps_bin::scatter( const double *data, py_int n,
+                                           py_int offset,
+                                           block_data &block ) const
+{
+	const int size_one = h.size_one;
+	for( int k = 0; k < size_one; ++k ){
+		const double *src = data + k;
+		switch( roles[k] ){
+			case COL_ID: {
+				py_int *dst = block.ids + offset;
+				for( py_int j = 0; j < n; ++j ) dst[j] = src[j*size_one];
+				break;
+			}
+			case COL_TYPE: {
+				py_int *dst = block.types + offset;
+				for( py_int j = 0; j < n; ++j ) dst[j] = src[j*size_one];
+				break;
+			}
+			case COL_MOL: {
+				py_int *dst = block.mol + offset;
+				for( py_int j = 0; j < n; ++j ) dst[j] = src[j*size_one];
+				break;
+			}
+			case COL_X:
+			case COL_Y:
+			case COL_Z: {
+				py_float *dst = block.x_ + 3*offset + ( roles[k] - COL_X );
+				for( py_int j = 0; j < n; ++j ){
+					dst[3*j] = src[j*size_one];
+				}
+				break;
+			}
+			default: {
+				double *dst = block.other_cols[other_idx[k]].data.data()
+					+ offset;
+				for( py_int j = 0; j < n; ++j ) dst[j] = src[j*size_one];
+				break;
+			}
+		}
 	}
 }
 
-int dump_interpreter_lammps_bin::next_block_body( block_data &block,
-                                                  int size_one, int nchunk )
+
+int dump_interpreter_lammps_bin::next_block_body( block_data &block )
 {
-	block.copy_meta( last_meta );
-	block.resize( block.N );
-	
-	int maxbuf = 0;
-	double *buf = nullptr;
-	int n = 0;
-
-	for( int i = 0; i < nchunk; i++ ){
-		fread(&n,sizeof(int),1,in);
-
-		// extend buffer to fit chunk size
-		
-		if( n > maxbuf ){
-			if (buf) delete [] buf;
-			buf = new double[n];
-			maxbuf = n;
+	const py_int N = block.N;
+	block.other_cols.resize( other_headers.size() );
+	for( std::size_t k = 0; k < other_headers.size(); ++k ){
+		block.other_cols[k].header = other_headers[k];
+		block.other_cols[k].resize( N );
+	}
+
+	// Every processor wrote a chunk, append them in order.
+	py_int offset = 0;
+	for( int c = 0; c < h.nchunk; ++c ){
+		int n = 0;
+		if( !read( n ) || n < 0 || n % h.size_one ){
+			std::cerr << "Malformed chunk in binary dump frame at t = "
+			          << block.tstep << "!\n";
+			good_ = false;
+			return -1;
+		}
+		py_int n_atoms = n / h.size_one;
+		if( offset + n_atoms > N ){
+			std::cerr << "Binary dump frame at t = " << block.tstep
+			          << " has more atoms than its header says!\n";
+			good_ = false;
+			return -1;
+		}
+		if( buf.size() < static_cast<std::size_t>( n ) ) buf.resize( n );
+		if( std::fread( buf.data(), sizeof(double), n, in ) !=
+		    static_cast<std::size_t>( n ) ){
+			std::cerr << "Binary dump frame at t = " << block.tstep
+			          << " is incomplete!\n";
+			good_ = false;
+			return -1;
 		}
+		scatter( buf.data(), n_atoms, offset, block );
+		offset += n_atoms;
+	}
+	if( offset != N ){
+		std::cerr << "Binary dump frame at t = " << block.tstep
+		          << " has " << offset << " atoms instead of " << N
+		          << "!\n";
+		good_ = false;
+		return -1;
+	}
 
-		// read chunk and write as size_one values per line
-
-		fread(buf,sizeof(double),n,in);
-		n /= size_one;
-		block.copy_meta( last_meta );
-		block.resize(n);
-		int m = 0;
-		for( int j = 0; j < n; j++ ){
-			for( int k = 0; k < size_one; k++ ){
-				// fprintf(fptxt,"%g ",buf[m++]);
-				if( k == id_idx ){
-					block.ids[j] = buf[m++];
-				}else if( k == type_idx ){
-					block.types[j] = buf[m++];					
-				}else if( k == x_idx ){
-					block.x[j][0] = buf[m++];
-				}else if( k == y_idx ){
-					block.x[j][1] = buf[m++];
-				}else if( k == z_idx ){
-					block.x[j][2] = buf[m++];
-				}
+	if( scaled ){
+		for( int d = 0; d < 3; ++d ){
+			if( !( scaled & (1 << d) ) ) continue;
+			double L = block.xhi[d] - block.xlo[d];
+			for( py_int i = 0; i < N; ++i ){
+				block.x_[3*i+d] = block.xlo[d] + L*block.x_[3*i+d];
 			}
 		}
 	}
-	
-	if( buf ) delete [] buf;
+	return 0;
+}
+
+
+int dump_interpreter_lammps_bin::skip_block()
+{
+	if( !in || !good_ ) return -1;
+
+	int status = read_header();
+	if( status ){
+		if( status < 0 ) good_ = false;
+		return status;
+	}
 
+	// Seeking past the end succeeds, so compare with the file length
+	// to catch a frame that was cut off.
+	long pos = std::ftell( in );
+	long end = -1;
+	if( pos >= 0 && !std::fseek( in, 0, SEEK_END ) ){
+		end = std::ftell( in );
+	}
+	if( end < 0 || std::fseek( in, pos, SEEK_SET ) ){
+		good_ = false;
+		return -1;
+	}
+
+	for( int i = 0; i < h.nchunk; ++i ){
+		int n = 0;
+		if( !read( n ) || n < 0 ) pos = end + 1;
+		else pos += sizeof(n) + n*sizeof(double);
+		if( pos > end || std::fseek( in, pos, SEEK_SET ) ){
+			std::cerr << "Binary dump frame at t = " << h.tstep
+			          << " is incomplete!\n";
+			good_ = false;
+			return -1;
+		}
+	}
 	return 0;
 }
 
+
+int dump_interpreter_lammps_bin::seek( std::size_t offset )
+{
+	if( !in ) return -1;
+	std::clearerr( in );
+	if( std::fseek( in, offset, SEEK_SET ) ) return -1;
+	good_ = true;
+	return 0;
+}
@@ -6,17 +6,40 @@
 #include "dump_interpreter.h"
 
 #include <cstdio>
+#include <string>
+#include <vector>
 
+
+/**
+   Reads binary LAMMPS dumps as written by dump atom/custom with a
+   .bin file name.
+
+   Every frame is a header followed by one chunk of doubles per writing
+   processor, with size_one values per atom. Both the old layout and the
+   newer one (magic string, endianness and revision, unit style, time and
+   column names) are understood. Without column names, the columns are
+   taken to be id type x y z, and any further ones end up in other_cols.
+
+   The chunks are read into one buffer that is kept between frames and
+   appended to the block at the offset where the previous chunk ended.
+   Each column is then scattered into the block in one loop, using a
+   column map that is only rebuilt when the column names change.
+*/
 class dump_interpreter_lammps_bin : public dump_interpreter
 {
 public:
 	dump_interpreter_lammps_bin( const std::string &dname, int file_type = 3 );
 	virtual ~dump_interpreter_lammps_bin();
-	
+
 	virtual int next_block( block_data &block );
 
-	virtual int next_block_meta( block_data &block, int &size_one, int &nchunk );
-	virtual int next_block_body( block_data &block, int size_one, int nchunk );
+	virtual int next_block_meta( block_data &block );
+	virtual int next_block_body( block_data &block );
+
+	/// Reads the header and seeks over the chunks.
+	virtual int skip_block();
+
+	virtual int seek( std::size_t offset );
 
 	virtual bool eof() const
 	{
@@ -25,33 +48,66 @@ public:
 	}
 	virtual bool good() const
 	{
-		if( in ) return !std::ferror(in);
+		if( in ) return !std::ferror(in) && good_;
 		else     return false;
 	}
-	
+
 private:
-	enum { BIT_X = 1,
-	       BIT_Y = 2,
-	       BIT_Z = 3 };
-	
-	int id_idx;
-	int type_idx;
-	int x_idx;
-	int y_idx;
-	int z_idx;
-
-	int n_cols;
-	std::vector<std::string> headers;
-	
-	std::vector<int>         other_cols;
-	std::vector<std::string> other_col_headers;
+	/// The header of a frame.
+	struct frame_header
+	{
+		py_int tstep;
+		py_int N;
+		int triclinic;
+		int boundary[6];
+		double lo[3], hi[3];
+		double tilt[3];      ///< xy, xz, yz
+		int size_one;        ///< Values per atom
+		int nchunk;          ///< Number of chunks that follow
+		int revision;        ///< 0 for the old layout
+		std::string units;
+		bool has_time;
+		double time;
+		std::string columns; ///< Column names, empty in the old layout
+	};
 
+	/// What to do with each column of a chunk.
+	enum column_roles {
+		COL_OTHER = 0,
+		COL_ID,
+		COL_TYPE,
+		COL_MOL,
+		COL_X,
+		COL_Y,
+		COL_Z
+	};
+
+	std::FILE *in;
+	bool good_;
+	frame_header h;
+
+	std::vector<double> buf;     //!< Chunk buffer, kept between frames
+
+	// The column map, set up from h.columns and h.size_one:
+	std::string map_columns;     //!< Columns the map was made for
+	int map_size_one;
+	std::vector<int> roles;      //!< Role of each column.
+	std::vector<int> other_idx;  //!< Index into other_cols for COL_OTHER.
+	std::vector<std::string> other_headers;
 	int atom_style;
 	int scaled;
-	std::string last_line;
-	block_data last_meta;
 
-	std::FILE *in;
+	int read_header();
+	int set_columns();
+	void scatter( const double *data, py_int n, py_int offset,
+	              block_data &block ) const;
+
+	template <typename T>
+	bool read( T &v )
+	{
+		return std::fread( &v, sizeof(T), 1, in ) == 1;
+	}
+	bool read_string( std::string &s );
 };
 
 
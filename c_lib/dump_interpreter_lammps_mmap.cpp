@@ -0,0 +1,114 @@
+#include "dump_interpreter_lammps_mmap.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+
+dump_interpreter_lammps_mmap::dump_interpreter_lammps_mmap(
+	const std::string &dname )
+	: dump_interpreter( dname ), file( dname ), pos( nullptr ),
+	  good_( true ), following( false )
+{
+	if( !file.good() ){
+		std::cerr << "Failed to map dump file " << dname << "!\n";
+		std::terminate();
+	}
+	pos = file.data();
+}
+
+dump_interpreter_lammps_mmap::~dump_interpreter_lammps_mmap()
+{}
+
+
+int dump_interpreter_lammps_mmap::next_block( block_data &block )
+{
+	if( !good_ ) return -1;
+	if( following ) return follow_frame( &block );
+
+	const char *p = pos;
+	int status = parser.next_frame( p, file.end(), block );
+	if( status < 0 ){
+		good_ = false;
+		std::cerr << "Failed to parse block!\n";
+		return status;
+	}
+
+	pos = p;
+	return status;
+}
+
+
+int dump_interpreter_lammps_mmap::skip_block()
+{
+	if( !good_ ) return -1;
+	if( following ) return follow_frame( nullptr );
+
+	const char *p = pos;
+	int status = parser.skip_frame( p, file.end(), meta );
+	if( status < 0 ){
+		good_ = false;
+		std::cerr << "Failed to skip block!\n";
+		return status;
+	}
+
+	pos = p;
+	return status;
+}
+
+
+int dump_interpreter_lammps_mmap::follow_frame( block_data *block )
+{
+	int status = complete_frame( block );
+	if( status != 1 ) return status;
+
+	// Map what was written since and try again.
+	std::size_t offset = pos - file.data();
+	if( !file.remap() || offset > file.size() ){
+		std::cerr << "Failed to map " << dname() << " again!\n";
+		good_ = false;
+		return -1;
+	}
+	pos = file.data() + offset;
+	return complete_frame( block );
+}
+
+
+int dump_interpreter_lammps_mmap::complete_frame( block_data *block )
+{
+	// Only look at complete lines.
+	const char *end = file.end();
+	while( end > pos && end[-1] != '\n' ) --end;
+
+	// Check quietly that the whole frame is there before parsing it.
+	const char *p = pos;
+	int status = parser.skip_frame( p, end, meta );
+	if( status > 0 ) return 1;
+	if( status < 0 ){
+		// A frame that is followed by another one is not
+		// being written, it is broken.
+		static const char next[] = "\nITEM: TIMESTEP";
+		const char *q = pos;
+		while( q < end && std::isspace( *q ) ) ++q;
+		if( std::search( q, end, next, next + std::strlen( next ) )
+		    == end ){
+			return 1;
+		}
+		std::cerr << "Failed to parse block!\n";
+		good_ = false;
+		return status;
+	}
+
+	if( block ){
+		p = pos;
+		status = parser.next_frame( p, end, *block );
+		if( status ){
+			std::cerr << "Failed to parse block!\n";
+			good_ = false;
+			return status;
+		}
+	}
+	pos = p;
+	return 0;
+}
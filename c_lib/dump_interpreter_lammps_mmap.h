@@ -0,0 +1,75 @@
+#ifndef DUMP_INTERPRETER_LAMMPS_MMAP_H
+#define DUMP_INTERPRETER_LAMMPS_MMAP_H
+
+#include "block_data.h"
+#include "dump_interpreter.h"
+#include "lammps_frame_parser.h"
+#include "mapped_file.h"
+
+
+/**
+   Reads plain text LAMMPS dumps by memory-mapping the file and parsing
+   it in place with a lammps_frame_parser. This avoids all per-line
+   allocations of dump_interpreter_lammps.
+
+   In follow mode, only frames whose last line has its newline are read.
+   When there is no such frame, the file is mapped again to see what was
+   written since.
+*/
+class dump_interpreter_lammps_mmap : public dump_interpreter
+{
+public:
+	dump_interpreter_lammps_mmap( const std::string &dname );
+	virtual ~dump_interpreter_lammps_mmap();
+
+	virtual int next_block( block_data &block );
+
+	/// Reads only the header and jumps over the atom lines.
+	virtual int skip_block();
+
+	virtual int seek( std::size_t offset )
+	{
+		if( offset > file.size() ) return -1;
+		pos = file.data() + offset;
+		good_ = true;
+		return 0;
+	}
+
+	virtual bool select_columns( const std::vector<std::string> &columns )
+	{
+		parser.select_columns( columns );
+		return true;
+	}
+
+	virtual bool follow( bool on )
+	{
+		following = on;
+		return true;
+	}
+
+	virtual bool eof() const
+	{
+		return pos == file.end();
+	}
+	virtual bool good() const
+	{
+		return file.good() && good_;
+	}
+
+private:
+	mapped_file file;
+	const char *pos;
+	bool good_;
+
+	lammps_frame_parser parser;
+	block_data meta;   //!< Header of skipped frames
+	bool following;    //!< True in follow mode
+
+	/// Reads (or if block is nullptr skips) a frame in follow mode.
+	int follow_frame( block_data *block );
+	/// Like follow_frame, but without mapping the file again.
+	int complete_frame( block_data *block );
+};
+
+
+#endif // DUMP_INTERPRETER_LAMMPS_MMAP_H
@@ -0,0 +1,195 @@
+#include "dump_interpreter_lammps_parallel.h"
+
+#include <iostream>
+#include <limits>
+
+
+dump_interpreter_lammps_parallel::dump_interpreter_lammps_parallel(
+	const std::string &dname, int n_workers, int queue_depth,
+	const std::vector<std::string> &columns )
+	: dump_interpreter( dname ), file( dname ), n_workers( n_workers ),
+	  queue_depth( queue_depth ), good_( true ), columns( columns ),
+	  n_split( 0 ),
+	  n_delivered( 0 ), n_frames( 0 ), split_status( 0 ), stopping( false )
+{
+	if( !file.good() ){
+		std::cerr << "Failed to map dump file " << dname << "!\n";
+		std::terminate();
+	}
+
+	if( this->n_workers <= 0 ){
+		this->n_workers = std::thread::hardware_concurrency();
+		if( this->n_workers <= 0 ) this->n_workers = 1;
+	}
+	if( this->queue_depth <= 0 ){
+		this->queue_depth = 2*this->n_workers;
+	}
+	slots = std::vector<frame_slot>( this->queue_depth );
+
+	start( file.data() );
+}
+
+
+dump_interpreter_lammps_parallel::~dump_interpreter_lammps_parallel()
+{
+	stop();
+}
+
+
+void dump_interpreter_lammps_parallel::start( const char *pos )
+{
+	n_split      = 0;
+	n_delivered  = 0;
+	n_frames     = std::numeric_limits<std::size_t>::max();
+	split_status = 0;
+	stopping     = false;
+	good_        = true;
+	tasks.clear();
+	for( frame_slot &s : slots ){
+		s.ready  = false;
+		s.status = 0;
+	}
+
+	splitter = std::thread( &dump_interpreter_lammps_parallel::split,
+	                        this, pos );
+	for( int i = 0; i < n_workers; ++i ){
+		worker_threads.push_back(
+			std::thread( &dump_interpreter_lammps_parallel::work, this ) );
+	}
+}
+
+
+void dump_interpreter_lammps_parallel::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( mtx );
+		stopping = true;
+	}
+	split_cv.notify_all();
+	work_cv.notify_all();
+
+	if( splitter.joinable() ) splitter.join();
+	for( std::thread &t : worker_threads ) t.join();
+	worker_threads.clear();
+}
+
+
+void dump_interpreter_lammps_parallel::split( const char *pos )
+{
+	// The splitter only needs the header of each frame to know how
+	// many lines to jump over, the atom lines are left to the workers.
+	lammps_frame_parser parser;
+	parser.select_columns( columns );
+	block_data meta;
+	const char *p = pos;
+
+	while( true ){
+		{
+			std::unique_lock<std::mutex> lock( mtx );
+			split_cv.wait( lock, [this]{
+					return stopping || n_split <
+						n_delivered + queue_depth; } );
+			if( stopping ) return;
+		}
+
+		const char *begin = p;
+		int status = parser.skip_frame( p, file.end(), meta );
+
+		std::lock_guard<std::mutex> lock( mtx );
+		if( status ){
+			if( status < 0 ){
+				std::cerr << "Dump frame " << n_split
+				          << " is malformed or incomplete!\n";
+			}
+			split_status = status;
+			n_frames = n_split;
+			work_cv.notify_all();
+			done_cv.notify_all();
+			return;
+		}
+		frame_task t = { n_split, begin, p };
+		tasks.push_back( t );
+		++n_split;
+		work_cv.notify_one();
+	}
+}
+
+
+void dump_interpreter_lammps_parallel::work()
+{
+	// Every worker needs its own parser because it remembers
+	// the column layout of the last frame it parsed.
+	lammps_frame_parser parser;
+	parser.select_columns( columns );
+
+	while( true ){
+		frame_task t;
+		{
+			std::unique_lock<std::mutex> lock( mtx );
+			work_cv.wait( lock, [this]{
+					return stopping || !tasks.empty() ||
+						split_status != 0; } );
+			if( stopping || tasks.empty() ) return;
+			t = tasks.front();
+			tasks.pop_front();
+		}
+
+		// The splitter stays queue_depth frames ahead at most,
+		// so nobody else touches this slot until it is ready.
+		frame_slot &s = slots[ t.seq % queue_depth ];
+		const char *p = t.begin;
+		int status = parser.next_frame( p, t.end, s.block );
+
+		{
+			std::lock_guard<std::mutex> lock( mtx );
+			s.status = status;
+			s.ready  = true;
+		}
+		done_cv.notify_all();
+	}
+}
+
+
+int dump_interpreter_lammps_parallel::next_block( block_data &block )
+{
+	if( !good_ ) return -1;
+
+	std::unique_lock<std::mutex> lock( mtx );
+	frame_slot &s = slots[ n_delivered % queue_depth ];
+	done_cv.wait( lock, [this, &s]{
+			return s.ready || n_delivered >= n_frames; } );
+
+	if( !s.ready ){
+		if( split_status < 0 ) good_ = false;
+		return split_status;
+	}
+	if( s.status ){
+		good_ = false;
+		std::cerr << "Failed to parse block!\n";
+		return s.status;
+	}
+
+	block.swap( s.block );
+	s.ready = false;
+	++n_delivered;
+	lock.unlock();
+
+	split_cv.notify_one();
+	return 0;
+}
+
+
+int dump_interpreter_lammps_parallel::seek( std::size_t offset )
+{
+	if( offset > file.size() ) return -1;
+	stop();
+	start( file.data() + offset );
+	return 0;
+}
+
+
+bool dump_interpreter_lammps_parallel::eof() const
+{
+	std::lock_guard<std::mutex> lock( mtx );
+	return split_status > 0 && n_delivered >= n_frames;
+}
@@ -0,0 +1,114 @@
+#ifndef DUMP_INTERPRETER_LAMMPS_PARALLEL_H
+#define DUMP_INTERPRETER_LAMMPS_PARALLEL_H
+
+#include "block_data.h"
+#include "dump_interpreter.h"
+#include "lammps_frame_parser.h"
+#include "mapped_file.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+   Reads plain text LAMMPS dumps with several threads.
+
+   The file is memory-mapped. A splitter thread only scans the frame
+   headers to find where each frame starts and ends, and hands the
+   frames to a pool of workers that parse them concurrently into a ring
+   of queue_depth blocks. next_block hands out the frames in file order
+   by swapping the parsed block with the one passed in, so the caller's
+   old block is recycled for a later frame and no block is copied.
+
+   The splitter never runs more than queue_depth frames ahead of the
+   caller, which bounds the memory use.
+*/
+class dump_interpreter_lammps_parallel : public dump_interpreter
+{
+public:
+	/**
+	   \param dname        Name of the dump file.
+	   \param n_workers    Number of parsing threads. If <= 0, one per core.
+	   \param queue_depth  Number of frames that can be parsed ahead.
+	                       If <= 0, twice the number of workers.
+	   \param columns      Columns to parse, all if empty. See
+	                       lammps_frame_parser::select_columns.
+	*/
+	dump_interpreter_lammps_parallel( const std::string &dname,
+	                                  int n_workers, int queue_depth,
+	                                  const std::vector<std::string> &columns =
+	                                  std::vector<std::string>() );
+	virtual ~dump_interpreter_lammps_parallel();
+
+	virtual int next_block( block_data &block );
+
+	/// The frame is parsed ahead already, so this only hands it
+	/// out into a scratch block, which costs no copy.
+	virtual int skip_block()
+	{
+		return next_block( skipped );
+	}
+
+	virtual int seek( std::size_t offset );
+
+	virtual bool eof() const;
+	virtual bool good() const
+	{
+		return file.good() && good_;
+	}
+
+	int workers() const { return n_workers; }
+	int depth()   const { return queue_depth; }
+
+private:
+	/// A frame found by the splitter.
+	struct frame_task {
+		std::size_t seq;     ///< Number of the frame since start
+		const char *begin;
+		const char *end;
+	};
+
+	/// A slot in the ring of parsed frames.
+	struct frame_slot {
+		frame_slot() : status(0), ready(false) {}
+		block_data block;
+		int status;          ///< Return value of the parser
+		bool ready;          ///< True if block holds a parsed frame
+	};
+
+	mapped_file file;
+	int n_workers;
+	int queue_depth;
+	bool good_;
+	std::vector<std::string> columns;  //!< Columns the parsers read
+	block_data skipped;                //!< Receives skipped frames
+
+	std::vector<frame_slot> slots;
+	std::deque<frame_task> tasks;
+
+	std::size_t n_split;     //!< Frames found by the splitter
+	std::size_t n_delivered; //!< Frames handed out by next_block
+	std::size_t n_frames;    //!< Total frames, known once the splitter is done
+	int split_status;        //!< 0 while splitting, then 1 (EOF) or < 0
+	bool stopping;
+
+	mutable std::mutex mtx;
+	std::condition_variable split_cv;  //!< Wakes up the splitter
+	std::condition_variable work_cv;   //!< Wakes up the workers
+	std::condition_variable done_cv;   //!< Wakes up next_block
+
+	std::thread splitter;
+	std::vector<std::thread> worker_threads;
+
+	void start( const char *pos );
+	void stop();
+
+	void split( const char *pos );
+	void work();
+};
+
+
+#endif // DUMP_INTERPRETER_LAMMPS_PARALLEL_H
@@ -0,0 +1,298 @@
+#include "dump_interpreter_ltraj.h"
+#include "dump_index.h"
+#include "ltraj_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#ifdef HAVE_LIB_ZSTD
+#include <zstd.h>
+#endif
+
+
+dump_interpreter_ltraj::dump_interpreter_ltraj( const std::string &dname )
+	: dump_interpreter( dname ), file( dname, false ), current( 0 ),
+	  good_( true ), dctx( nullptr )
+{
+	if( !file.good() ){
+		std::cerr << "Failed to map ltraj file " << dname << "!\n";
+		std::terminate();
+	}
+	if( file.size() < 16 || std::memcmp( file.data(), "LTRAJ", 6 ) ){
+		std::cerr << dname << " is not an ltraj file!\n";
+		std::terminate();
+	}
+	py_int version;
+	std::memcpy( &version, file.data() + 8, sizeof(version) );
+	if( version < 1 || version > ltraj_version ){
+		std::cerr << dname << " has ltraj version " << version
+		          << ", which this version of the lib cannot read!\n";
+		std::terminate();
+	}
+
+	if( !read_footer() ){
+		std::cerr << "ltraj file " << dname << " has no index, "
+		          << "it was probably not closed properly. Scanning "
+		          << "the frames instead.\n";
+		scan_frames();
+	}
+}
+
+
+dump_interpreter_ltraj::~dump_interpreter_ltraj()
+{
+#ifdef HAVE_LIB_ZSTD
+	if( dctx ) ZSTD_freeDCtx( dctx );
+#endif
+}
+
+
+bool dump_interpreter_ltraj::check_header( py_int offset ) const
+{
+	py_int size = file.size();
+	if( offset < 0 || offset + static_cast<py_int>(
+		    sizeof(ltraj_frame_header) ) > size ){
+		return false;
+	}
+	const ltraj_frame_header *h =
+		reinterpret_cast<const ltraj_frame_header*>( file.data() + offset );
+	return std::memcmp( h->magic, "LTFRAME", 8 ) == 0 &&
+		h->frame_size > 0 && offset + h->frame_size <= size;
+}
+
+
+bool dump_interpreter_ltraj::read_footer()
+{
+	py_int size = file.size();
+	if( size < static_cast<py_int>( sizeof(ltraj_trailer) ) ) return false;
+
+	ltraj_trailer t;
+	std::memcpy( &t, file.end() - sizeof(t), sizeof(t) );
+	if( std::memcmp( t.magic, "LTINDEX", 8 ) ) return false;
+
+	// Bound n_frames by the file size before multiplying, so that a
+	// corrupt count cannot overflow.
+	const py_int entry = sizeof(ltraj_index_entry);
+	if( t.n_frames < 0 || t.n_frames > size / entry ||
+	    t.index_offset < 0 || t.index_offset > size ){
+		return false;
+	}
+	py_int index_size = t.n_frames * entry;
+	if( t.index_offset + index_size + static_cast<py_int>( sizeof(t) )
+	    != size ){
+		return false;
+	}
+
+	frames.resize( t.n_frames );
+	std::memcpy( frames.data(), file.data() + t.index_offset, index_size );
+	return true;
+}
+
+
+void dump_interpreter_ltraj::scan_frames()
+{
+	frames.clear();
+	py_int offset = ltraj_alignment;
+	while( check_header( offset ) ){
+		const ltraj_frame_header *h =
+			reinterpret_cast<const ltraj_frame_header*>(
+				file.data() + offset );
+		ltraj_index_entry e;
+		e.offset = offset;
+		e.tstep  = h->tstep;
+		e.N      = h->N;
+		std::copy( h->xlo, h->xlo + 3, e.xlo );
+		std::copy( h->xhi, h->xhi + 3, e.xhi );
+		frames.push_back( e );
+		offset += h->frame_size;
+	}
+}
+
+
+int dump_interpreter_ltraj::read_frame( std::size_t i, ltraj_frame_view &v )
+{
+	if( i >= frames.size() ) return 1;
+
+	py_int offset = frames[i].offset;
+	if( !check_header( offset ) ){
+		std::cerr << "Corrupt ltraj frame at byte " << offset << "!\n";
+		good_ = false;
+		return -1;
+	}
+	const char *frame = file.data() + offset;
+	const ltraj_frame_header *h =
+		reinterpret_cast<const ltraj_frame_header*>( frame );
+	const ltraj_column *cols =
+		reinterpret_cast<const ltraj_column*>( h + 1 );
+	if( h->n_columns < 0 ||
+	    static_cast<py_int>( sizeof(*h) + h->n_columns * sizeof(*cols) )
+	    > h->frame_size ){
+		std::cerr << "Corrupt ltraj frame at byte " << offset << "!\n";
+		good_ = false;
+		return -1;
+	}
+
+	v.tstep = h->tstep;
+	v.N     = h->N;
+	std::copy( h->xlo, h->xlo + 3, v.xlo );
+	std::copy( h->xhi, h->xhi + 3, v.xhi );
+	v.periodic   = h->periodic;
+	v.atom_style = h->atom_style;
+	v.boxline.assign( h->boxline,
+	                  strnlen( h->boxline, sizeof(h->boxline) ) );
+
+	v.columns.resize( h->n_columns );
+	if( buffers.size() < v.columns.size() ){
+		buffers.resize( v.columns.size() );
+	}
+	for( py_int j = 0; j < h->n_columns; ++j ){
+		const ltraj_column &c = cols[j];
+		ltraj_column_view &cv = v.columns[j];
+		// Check N and width before multiplying them, a corrupt
+		// header must not overflow the size of the column.
+		if( h->N < 0 || c.width <= 0 ||
+		    h->N > std::numeric_limits<py_int>::max() / 8 / c.width ){
+			std::cerr << "Corrupt column in ltraj frame at byte "
+			          << offset << "!\n";
+			good_ = false;
+			return -1;
+		}
+		py_int raw_size = h->N * c.width * 8;
+		if( c.offset < 0 || c.stored_size < 0 ||
+		    c.offset + c.stored_size > h->frame_size ||
+		    ( c.codec == LTRAJ_CODEC_NONE && c.stored_size != raw_size ) ){
+			std::cerr << "Corrupt column in ltraj frame at byte "
+			          << offset << "!\n";
+			good_ = false;
+			return -1;
+		}
+		cv.name.assign( c.name, strnlen( c.name, sizeof(c.name) ) );
+		cv.dtype = c.dtype;
+		cv.width = c.width;
+		cv.N     = h->N;
+
+		if( c.codec == LTRAJ_CODEC_NONE ){
+			cv.data = frame + c.offset;
+			continue;
+		}
+#ifdef HAVE_LIB_ZSTD
+		if( !dctx ) dctx = ZSTD_createDCtx();
+#endif
+		std::vector<char> &buff = buffers[j];
+		buff.resize( raw_size );
+		bool ok = false;
+		if( c.codec == LTRAJ_CODEC_DELTA || c.codec == LTRAJ_CODEC_QUANT ){
+			ok = ltraj_decode_column( c.codec, frame + c.offset,
+			                          c.stored_size, h->N, c.width,
+			                          dctx, buff.data() );
+		}else if( c.codec == LTRAJ_CODEC_ZSTD ){
+#ifdef HAVE_LIB_ZSTD
+			std::size_t n = ZSTD_decompressDCtx( dctx, buff.data(),
+			                                     raw_size,
+			                                     frame + c.offset,
+			                                     c.stored_size );
+			ok = !ZSTD_isError( n ) &&
+				static_cast<py_int>( n ) == raw_size;
+#else
+			std::cerr << "Reading zstd-compressed ltraj columns "
+			          << "needs zstd!\n";
+#endif
+		}
+		if( !ok ){
+			std::cerr << "Failed to decode column " << cv.name
+			          << " (codec " << c.codec << ") of ltraj frame "
+			          << "at byte " << offset << "!\n";
+			good_ = false;
+			return -1;
+		}
+		cv.data = buff.data();
+	}
+	return 0;
+}
+
+
+int dump_interpreter_ltraj::next_frame( ltraj_frame_view &v )
+{
+	int status = read_frame( current, v );
+	if( status == 0 ) ++current;
+	return status;
+}
+
+
+int dump_interpreter_ltraj::next_block( block_data &block )
+{
+	int status = next_frame( view );
+	if( status ) return status;
+
+	block.resize( view.N );
+	block.tstep = view.tstep;
+	std::copy( view.xlo, view.xlo + 3, block.xlo );
+	std::copy( view.xhi, view.xhi + 3, block.xhi );
+	block.periodic   = view.periodic;
+	block.atom_style = view.atom_style;
+	block.boxline    = view.boxline;
+
+	py_int N = view.N;
+	std::size_t n_other = 0;
+	for( const ltraj_column_view &c : view.columns ){
+		if( c.name == "id" ){
+			std::copy( c.ints(), c.ints() + N, block.ids );
+		}else if( c.name == "type" ){
+			std::copy( c.ints(), c.ints() + N, block.types );
+		}else if( c.name == "mol" ){
+			std::copy( c.ints(), c.ints() + N, block.mol );
+		}else if( c.name == "x" ){
+			std::copy( c.floats(), c.floats() + 3*N, block.x_ );
+		}else{
+			if( block.other_cols.size() <= n_other ){
+				block.other_cols.resize( n_other + 1 );
+			}
+			dump_col &dc = block.other_cols[n_other++];
+			dc.header = c.name;
+			if( c.dtype == LTRAJ_INT64 ){
+				dc.data.assign( c.ints(), c.ints() + N*c.width );
+			}else{
+				dc.data.assign( c.floats(),
+				                c.floats() + N*c.width );
+			}
+		}
+	}
+	block.other_cols.resize( n_other );
+	return 0;
+}
+
+
+int dump_interpreter_ltraj::seek( std::size_t offset )
+{
+	// Offsets in the index are increasing.
+	auto it = std::lower_bound( frames.begin(), frames.end(),
+	                            static_cast<py_int>( offset ),
+	                            []( const ltraj_index_entry &e, py_int o )
+	                            { return e.offset < o; } );
+	if( it != frames.end() && it->offset == static_cast<py_int>( offset ) ){
+		current = it - frames.begin();
+		return 0;
+	}
+	if( offset == 0 ){
+		current = 0;
+		return 0;
+	}
+	return -1;
+}
+
+
+bool dump_interpreter_ltraj::build_index( dump_index &idx ) const
+{
+	for( const ltraj_index_entry &f : frames ){
+		dump_index_entry e;
+		e.offset = f.offset;
+		e.tstep  = f.tstep;
+		e.N      = f.N;
+		std::copy( f.xlo, f.xlo + 3, e.xlo );
+		std::copy( f.xhi, f.xhi + 3, e.xhi );
+		idx.add( e );
+	}
+	return true;
+}
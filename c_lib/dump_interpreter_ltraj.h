@@ -0,0 +1,78 @@
+#ifndef DUMP_INTERPRETER_LTRAJ_H
+#define DUMP_INTERPRETER_LTRAJ_H
+
+#include "block_data.h"
+#include "dump_interpreter.h"
+#include "ltraj.h"
+#include "mapped_file.h"
+
+#include <vector>
+
+struct ZSTD_DCtx_s;
+
+
+/**
+   Reads ltraj files (see ltraj.h) by memory-mapping them.
+
+   Besides next_block, which copies a frame into a block_data, the
+   frames can be read as ltraj_frame_views with next_frame or
+   read_frame. Uncompressed columns of a view point straight into the
+   mapped file, so nothing is copied. Compressed columns are
+   decompressed into buffers of the interpreter. Either way, a view
+   stays valid until the next frame is read.
+*/
+class dump_interpreter_ltraj : public dump_interpreter
+{
+public:
+	dump_interpreter_ltraj( const std::string &dname );
+	virtual ~dump_interpreter_ltraj();
+
+	virtual int next_block( block_data &block );
+
+	virtual int skip_block()
+	{
+		if( current >= frames.size() ) return 1;
+		++current;
+		return 0;
+	}
+
+	virtual int seek( std::size_t offset );
+
+	virtual bool build_index( dump_index &idx ) const;
+
+	virtual bool eof() const
+	{
+		return current >= frames.size();
+	}
+	virtual bool good() const
+	{
+		return file.good() && good_;
+	}
+
+	/// Reads the next frame as a view.
+	/// Returns 0 on success, 1 at the end and negative on errors.
+	int next_frame( ltraj_frame_view &v );
+
+	/// Reads frame i as a view without moving the reader.
+	int read_frame( std::size_t i, ltraj_frame_view &v );
+
+	/// Number of frames in the file.
+	std::size_t n_frames() const { return frames.size(); }
+
+private:
+	mapped_file file;
+	std::vector<ltraj_index_entry> frames;
+	std::size_t current;     //!< Next frame next_block reads
+	bool good_;
+
+	ltraj_frame_view view;   //!< Used by next_block
+	std::vector<std::vector<char> > buffers;
+	ZSTD_DCtx_s *dctx;
+
+	bool read_footer();
+	void scan_frames();
+	bool check_header( py_int offset ) const;
+};
+
+
+#endif // DUMP_INTERPRETER_LTRAJ_H
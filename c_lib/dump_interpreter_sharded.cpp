@@ -0,0 +1,291 @@
+#include "dump_interpreter_sharded.h"
+#include "dump_reader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+
+#include <glob.h>
+#include <sys/stat.h>
+
+
+namespace {
+
+/// Finds a printf conversion like %d or %08d in \p s and stores its
+/// length in \p len. Returns std::string::npos if there is none.
+std::size_t find_conversion( const std::string &s, std::size_t &len )
+{
+	for( std::size_t i = 0; i < s.size(); ++i ){
+		if( s[i] != '%' ) continue;
+		std::size_t j = i + 1;
+		while( j < s.size() && std::isdigit( s[j] ) ) ++j;
+		if( j < s.size() && s[j] == 'd' ){
+			len = j + 1 - i;
+			return i;
+		}
+	}
+	return std::string::npos;
+}
+
+
+/// Compares file names, taking runs of digits as numbers.
+bool natural_less( const std::string &a, const std::string &b )
+{
+	std::size_t i = 0, j = 0;
+	while( i < a.size() && j < b.size() ){
+		if( std::isdigit( a[i] ) && std::isdigit( b[j] ) ){
+			std::size_t ie = i, je = j;
+			while( ie < a.size() && std::isdigit( a[ie] ) ) ++ie;
+			while( je < b.size() && std::isdigit( b[je] ) ) ++je;
+			std::size_t i0 = i, j0 = j;
+			while( i0 + 1 < ie && a[i0] == '0' ) ++i0;
+			while( j0 + 1 < je && b[j0] == '0' ) ++j0;
+			// More digits is a larger number.
+			if( ie - i0 != je - j0 ) return ie - i0 < je - j0;
+			int c = a.compare( i0, ie - i0, b, j0, je - j0 );
+			if( c ) return c < 0;
+			i = ie;
+			j = je;
+		}else{
+			if( a[i] != b[j] ) return a[i] < b[j];
+			++i;
+			++j;
+		}
+	}
+	if( a.size() - i != b.size() - j ) return a.size() - i < b.size() - j;
+	return a < b;
+}
+
+} // namespace
+
+
+
+dump_interpreter_sharded::dump_interpreter_sharded(
+	const std::string &pattern, const std::vector<std::string> &files,
+	int dformat, int fformat, int n_workers, int queue_depth )
+	: dump_interpreter( pattern ), files( files ), dformat( dformat ),
+	  fformat( fformat ), n_workers( n_workers ),
+	  queue_depth( queue_depth ), good_( true ), started( false ),
+	  first( 0 ), current( 0 ), in_file( 0 ), first_in_file( 0 ),
+	  next_file( 0 ), stopping( false )
+{
+	if( this->n_workers <= 0 ){
+		this->n_workers = std::thread::hardware_concurrency();
+		if( this->n_workers <= 0 ) this->n_workers = 1;
+	}
+	if( this->queue_depth <= 0 ){
+		this->queue_depth = 2*this->n_workers;
+	}
+	slots = std::vector<shard_slot>( this->queue_depth );
+}
+
+
+dump_interpreter_sharded::~dump_interpreter_sharded()
+{
+	stop();
+}
+
+
+bool dump_interpreter_sharded::is_pattern( const std::string &fname )
+{
+	struct stat st;
+	if( stat( fname.c_str(), &st ) == 0 ) return false;
+
+	std::size_t len = 0;
+	return fname.find_first_of( "*?[" ) != std::string::npos ||
+		find_conversion( fname, len ) != std::string::npos;
+}
+
+
+std::vector<std::string> dump_interpreter_sharded::find_files(
+	const std::string &pattern )
+{
+	std::string glob_pattern = pattern;
+	std::size_t len = 0;
+	std::size_t conv = find_conversion( pattern, len );
+	if( conv != std::string::npos ) glob_pattern.replace( conv, len, "*" );
+
+	std::vector<std::string> names;
+	glob_t g;
+	if( glob( glob_pattern.c_str(), 0, nullptr, &g ) == 0 ){
+		for( std::size_t i = 0; i < g.gl_pathc; ++i ){
+			names.push_back( g.gl_pathv[i] );
+		}
+	}
+	globfree( &g );
+
+	if( conv != std::string::npos ){
+		// Keep the names the pattern prints for some number.
+		std::string prefix = pattern.substr( 0, conv );
+		std::string suffix = pattern.substr( conv + len );
+		std::string spec = pattern.substr( conv, len - 1 ) + "lld";
+		std::vector<std::string> matches;
+		for( const std::string &name : names ){
+			if( name.size() <= prefix.size() + suffix.size() ||
+			    !starts_with( name, prefix ) || !ends_with( name, suffix ) ){
+				continue;
+			}
+			std::string number = name.substr( prefix.size(),
+			                                  name.size() - prefix.size()
+			                                  - suffix.size() );
+			if( number.find_first_not_of( "0123456789" ) !=
+			    std::string::npos || number.size() > 18 ){
+				continue;
+			}
+			char printed[32];
+			std::snprintf( printed, sizeof(printed), spec.c_str(),
+			               std::stoll( number ) );
+			if( number == printed ) matches.push_back( name );
+		}
+		names.swap( matches );
+	}
+
+	std::sort( names.begin(), names.end(), natural_less );
+	return names;
+}
+
+
+void dump_interpreter_sharded::start()
+{
+	current   = first;
+	in_file   = first_in_file;
+	next_file = first;
+	stopping  = false;
+	good_     = true;
+	for( shard_slot &s : slots ){
+		s.ready    = false;
+		s.status   = 0;
+		s.n_blocks = 0;
+	}
+
+	std::size_t n_threads = std::min<std::size_t>( n_workers,
+	                                               files.size() - first );
+	for( std::size_t i = 0; i < n_threads; ++i ){
+		worker_threads.push_back(
+			std::thread( &dump_interpreter_sharded::work, this ) );
+	}
+	started = true;
+}
+
+
+void dump_interpreter_sharded::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( mtx );
+		stopping = true;
+	}
+	work_cv.notify_all();
+
+	for( std::thread &t : worker_threads ) t.join();
+	worker_threads.clear();
+	started = false;
+}
+
+
+void dump_interpreter_sharded::read_file( const std::string &fname,
+                                          shard_slot &s ) const
+{
+	dump_reader r( fname, dformat, fformat, 0, 0, columns );
+	s.n_blocks = 0;
+	while( true ){
+		if( s.n_blocks == s.blocks.size() ) s.blocks.emplace_back();
+		s.status = r.next_block( s.blocks[s.n_blocks] );
+		if( s.status ) break;
+		++s.n_blocks;
+	}
+}
+
+
+void dump_interpreter_sharded::work()
+{
+	while( true ){
+		std::size_t k;
+		{
+			std::unique_lock<std::mutex> lock( mtx );
+			work_cv.wait( lock, [this]{
+					return stopping || next_file >= files.size() ||
+						next_file < current + queue_depth; } );
+			if( stopping || next_file >= files.size() ) return;
+			k = next_file++;
+		}
+
+		// Files are read queue_depth ahead at most, so nobody
+		// else touches this slot until it is handed out.
+		shard_slot &s = slots[ k % queue_depth ];
+		read_file( files[k], s );
+
+		{
+			std::lock_guard<std::mutex> lock( mtx );
+			s.ready = true;
+		}
+		done_cv.notify_all();
+	}
+}
+
+
+int dump_interpreter_sharded::next_block( block_data &block )
+{
+	if( !good_ ) return -1;
+	if( !started ){
+		if( first >= files.size() ) return 1;
+		start();
+	}
+
+	std::unique_lock<std::mutex> lock( mtx );
+	while( current < files.size() ){
+		shard_slot &s = slots[ current % queue_depth ];
+		done_cv.wait( lock, [&s]{ return s.ready; } );
+
+		if( in_file < s.n_blocks ){
+			block.swap( s.blocks[in_file] );
+			++in_file;
+			return 0;
+		}
+		if( s.status < 0 ){
+			std::cerr << "Failed to read " << files[current] << "!\n";
+			good_ = false;
+			return s.status;
+		}
+
+		// All frames of this file are handed out, free its slot.
+		s.ready = false;
+		++current;
+		in_file = 0;
+		work_cv.notify_all();
+	}
+	return 1;
+}
+
+
+int dump_interpreter_sharded::seek( std::size_t offset )
+{
+	if( offset > files.size() ) return -1;
+	stop();
+	first = offset;
+	current = offset;
+	in_file = 0;
+	first_in_file = 0;
+	good_ = true;
+	return 0;
+}
+
+
+bool dump_interpreter_sharded::select_columns(
+	const std::vector<std::string> &columns )
+{
+	// The readers are made when the workers start. They start over at
+	// the frame the caller is at, the file it is in is read again.
+	stop();
+	first = current;
+	first_in_file = in_file;
+	this->columns = columns;
+	return true;
+}
+
+
+bool dump_interpreter_sharded::eof() const
+{
+	std::lock_guard<std::mutex> lock( mtx );
+	return current >= files.size();
+}
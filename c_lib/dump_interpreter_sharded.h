@@ -0,0 +1,120 @@
+#ifndef DUMP_INTERPRETER_SHARDED_H
+#define DUMP_INTERPRETER_SHARDED_H
+
+#include "block_data.h"
+#include "dump_interpreter.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+   Reads a dump that is split over many files, like the ones LAMMPS
+   writes for dump file names with a *, as one trajectory.
+
+   Every file is read by its own dump_reader, on a pool of threads that
+   each take the next file that is not read yet. The frames of a file
+   are kept in one of queue_depth slots until next_block has handed them
+   out, so they are returned in the order of the files, and the files
+   are never read more than queue_depth files ahead of the caller.
+
+   The offsets this interpreter seeks to are file numbers.
+*/
+class dump_interpreter_sharded : public dump_interpreter
+{
+public:
+	/**
+	   \param pattern      Pattern the files were found with.
+	   \param files        The files, in order, see find_files.
+	   \param dformat      Dump format of the files.
+	   \param fformat      File format of the files.
+	   \param n_workers    Number of files read at the same time.
+	                       If <= 0, one per core.
+	   \param queue_depth  Number of files that can be read ahead.
+	                       If <= 0, twice the number of workers.
+	*/
+	dump_interpreter_sharded( const std::string &pattern,
+	                          const std::vector<std::string> &files,
+	                          int dformat, int fformat,
+	                          int n_workers, int queue_depth );
+	virtual ~dump_interpreter_sharded();
+
+	virtual int next_block( block_data &block );
+
+	/// The files are read ahead already, so this only hands the
+	/// frame out into a scratch block, which costs no copy.
+	virtual int skip_block()
+	{
+		return next_block( skipped );
+	}
+
+	/// Moves to the first frame of file number \p offset.
+	virtual int seek( std::size_t offset );
+
+	/// Passes the columns on to the reader of every file.
+	virtual bool select_columns( const std::vector<std::string> &columns );
+
+	virtual bool eof() const;
+	virtual bool good() const { return good_; }
+
+	/// Returns true if \p fname is a glob or printf pattern rather
+	/// than the name of a file.
+	static bool is_pattern( const std::string &fname );
+
+	/**
+	   Returns the files that match \p pattern, ordered by the numbers
+	   in their names, so dump.1000.gz comes after dump.200.gz.
+
+	   The pattern is either a glob pattern, like dump.*.gz, or contains
+	   a printf conversion for the number, like dump.%d.gz or
+	   dump.%08d.gz.
+	*/
+	static std::vector<std::string> find_files( const std::string &pattern );
+
+private:
+	/// A slot holding the frames of one file.
+	struct shard_slot {
+		shard_slot() : n_blocks(0), status(0), ready(false) {}
+		std::deque<block_data> blocks; ///< Frames, kept between files
+		std::size_t n_blocks;  ///< Number of frames read into blocks
+		int status;            ///< 1 if all frames were read, or < 0
+		bool ready;            ///< True if the file was read
+	};
+
+	std::vector<std::string> files;
+	int dformat, fformat;
+	int n_workers;
+	int queue_depth;
+	bool good_;
+	std::vector<std::string> columns;  //!< Columns the readers parse
+	block_data skipped;                //!< Receives skipped frames
+
+	std::vector<shard_slot> slots;
+
+	bool started;          //!< True if the workers are running
+	std::size_t first;     //!< File the workers start at
+	std::size_t current;   //!< File next_block hands out frames of
+	std::size_t in_file;   //!< Frames of current handed out so far
+	std::size_t first_in_file; //!< Frames of first to skip on start
+	std::size_t next_file; //!< File the next free worker reads
+	bool stopping;
+
+	mutable std::mutex mtx;
+	std::condition_variable work_cv;   //!< Wakes up the workers
+	std::condition_variable done_cv;   //!< Wakes up next_block
+
+	std::vector<std::thread> worker_threads;
+
+	void start();
+	void stop();
+
+	void work();
+	void read_file( const std::string &fname, shard_slot &s ) const;
+};
+
+
+#endif // DUMP_INTERPRETER_SHARDED_H
@@ -1,4 +1,7 @@
 #include "dump_reader.h"
+#include "dump_reader_prefetch.h"
+#include "bgzf.h"
+#include "text_readers.h"
 #include "id_map.h"
 
 #include <iostream>
@@ -6,20 +9,29 @@
 #include <sstream>
 #include <memory>
 #include <algorithm>
+#include <chrono>
 
 #include <boost/iostreams/filter/gzip.hpp>
 
 #include "dump_interpreter_lammps.h"
+#include "dump_interpreter_lammps_mmap.h"
+#include "dump_interpreter_lammps_parallel.h"
+#include "dump_interpreter_sharded.h"
 #include "dump_interpreter_lammps_bin.h"
 #include "dump_interpreter_dcd.h"
 #include "dump_interpreter_gsd.h"
+#include "dump_interpreter_ltraj.h"
 
 
 dump_reader::dump_reader( const std::string &fname )
-	: dump_format(-1), file_format(-1), interp(nullptr)
+	: dump_format(-1), file_format(-1), n_workers(0), queue_depth(0),
+	  sharded(false), interp(nullptr), index(nullptr), index_tried(false),
+	  current_block_(0), following(false), follow_timeout(-1), watch(nullptr)
 {
-	guess_dump_type( fname );
-	guess_file_type( fname );
+	find_shards( fname );
+	const std::string &first = shards.empty() ? fname : shards[0];
+	guess_dump_type( first );
+	guess_file_type( first );
 
 	setup_interpreter( fname );
 }
@@ -27,19 +39,47 @@ dump_reader::dump_reader( const std::string &fname )
 
 
 dump_reader::dump_reader( const std::string &fname, int dformat, int fformat )
-	: dump_format( dformat ), file_format( fformat ), interp(nullptr)
+	: dump_reader( fname, dformat, fformat, 0, 0 )
+{}
+
+
+dump_reader::dump_reader( const std::string &fname, int dformat, int fformat,
+                          int n_workers, int queue_depth,
+                          const std::vector<std::string> &columns )
+	: dump_format( dformat ), file_format( fformat ),
+	  n_workers( n_workers ), queue_depth( queue_depth ),
+	  columns( columns ), sharded(false), interp(nullptr),
+	  index(nullptr), index_tried(false), current_block_(0),
+	  following(false), follow_timeout(-1), watch(nullptr)
 {
-	if( dump_format < 0 ) guess_dump_type( fname );
-	if( file_format < 0 ) guess_file_type( fname );
+	find_shards( fname );
+	const std::string &first = shards.empty() ? fname : shards[0];
+	if( dump_format < 0 ) guess_dump_type( first );
+	if( file_format < 0 ) guess_file_type( first );
 
 	setup_interpreter( fname );
 }
 
+void dump_reader::find_shards( const std::string &fname )
+{
+	if( !dump_interpreter_sharded::is_pattern( fname ) ) return;
+	sharded = true;
+	shards = dump_interpreter_sharded::find_files( fname );
+	if( shards.empty() ){
+		std::cerr << "No files match " << fname << "!\n";
+	}
+}
+
 void dump_reader::guess_file_type( const std::string &fname )
 {
 	if( ends_with( fname, ".gz" ) ){
-		file_format = GZIP;
-	}else if( ends_with( fname, ".bin" ) ){
+		file_format = guess_gzip_type( fname );
+	}else if( ends_with( fname, ".zst" ) ){
+		file_format = ZSTD;
+	}else if( ends_with( fname, ".lz4" ) ){
+		file_format = LZ4;
+	}else if( ends_with( fname, ".bin" ) || ends_with( fname, ".ltraj" ) ||
+	          ends_with( fname, ".dcd" ) ){
 		file_format = BIN;
 	}else{
 		std::cerr << "File format assumed to be plain text.\n";
@@ -47,22 +87,39 @@ void dump_reader::guess_file_type( const std::string &fname )
 	}
 }
 
+int dump_reader::guess_gzip_type( const std::string &fname ) const
+{
+#ifdef HAVE_ZLIB
+	if( bgzf_is_bgzf( fname ) ) return BGZF;
+#endif
+	return GZIP;
+}
+
 void dump_reader::guess_dump_type( const std::string &fname )
 {
 	if( ends_with( fname, ".gsd" ) ){
 		dump_format = GSD;
 	}else if( ends_with( fname, ".dump" ) ){
 		dump_format = LAMMPS;
-		file_format = PLAIN;
+		if( file_format < 0 ) file_format = PLAIN;
 	}else if( ends_with( fname, ".dump.gz" ) ){
 		dump_format = LAMMPS;
-		file_format = GZIP;
+		if( file_format < 0 ) file_format = guess_gzip_type( fname );
+	}else if( ends_with( fname, ".dump.zst" ) ){
+		dump_format = LAMMPS;
+		if( file_format < 0 ) file_format = ZSTD;
+	}else if( ends_with( fname, ".dump.lz4" ) ){
+		dump_format = LAMMPS;
+		if( file_format < 0 ) file_format = LZ4;
 	}else if( ends_with( fname, ".dump.bin" ) ){
 		dump_format = LAMMPS;
-		file_format = BIN;
+		if( file_format < 0 ) file_format = BIN;
+	}else if( ends_with( fname, ".ltraj" ) ){
+		dump_format = LTRAJ;
+		if( file_format < 0 ) file_format = BIN;
 	}else if( ends_with( fname, ".dcd" ) ){
 		dump_format = NAMD;
-		file_format = BIN;
+		if( file_format < 0 ) file_format = BIN;
 	}else{
 		std::cerr << "Extension of dump file " << fname
 		          << " not recognized! If you are certain of the "
@@ -76,10 +133,42 @@ void dump_reader::guess_dump_type( const std::string &fname )
 dump_reader::~dump_reader()
 {
 	if( interp ) delete interp;
+	if( index )  delete index;
+	if( watch )  delete watch;
 }
 
 void dump_reader::setup_interpreter( const std::string &fname )
 {
+	if( sharded ){
+		interp = new dump_interpreter_sharded( fname, shards, dump_format,
+		                                       file_format, n_workers,
+		                                       queue_depth );
+		select_columns();
+		return;
+	}
+
+	if( n_workers ){
+		if( dump_format == LAMMPS &&
+		    ( file_format == PLAIN || file_format == MMAP ) ){
+			interp = new dump_interpreter_lammps_parallel( fname,
+			                                               n_workers,
+			                                               queue_depth,
+			                                               columns );
+			return;
+		}
+		if( dump_format == LAMMPS && file_format == BGZF ){
+			interp = new dump_interpreter_lammps( fname, BGZF,
+			                                      n_workers );
+			select_columns();
+			return;
+		}
+		std::cerr << "Parallel reading is not supported for dump format "
+		          << dformat_to_str( dump_format ) << " with file format "
+		          << fformat_to_str( file_format )
+		          << ", reading serially.\n";
+		n_workers = 0;
+	}
+
 	if( dump_format == LAMMPS ){
 		if( file_format == PLAIN ){
 			interp = new dump_interpreter_lammps( fname );
@@ -87,53 +176,244 @@ void dump_reader::setup_interpreter( const std::string &fname )
 			interp = new dump_interpreter_lammps( fname, GZIP );
 		}else if( file_format == BIN ){
 			interp = new dump_interpreter_lammps_bin( fname, BIN );
+		}else if( file_format == MMAP ){
+			interp = new dump_interpreter_lammps_mmap( fname );
+		}else if( file_format == BGZF ){
+			interp = new dump_interpreter_lammps( fname, BGZF );
+		}else if( file_format == ZSTD ){
+			interp = new dump_interpreter_lammps( fname, ZSTD );
+		}else if( file_format == LZ4 ){
+			interp = new dump_interpreter_lammps( fname, LZ4 );
 		}
 	}else if( dump_format == GSD ){
 		interp = new dump_interpreter_gsd( fname );
+	}else if( dump_format == LTRAJ ){
+		interp = new dump_interpreter_ltraj( fname );
 	}else if( dump_format == NAMD ){
-		
+		interp = new dump_interpreter_dcd( fname );
+	}
+	select_columns();
+}
+
+
+void dump_reader::select_columns()
+{
+	if( columns.empty() || !interp ) return;
+	if( !interp->select_columns( columns ) ){
+		std::cerr << "Dump format " << dformat_to_str( dump_format )
+		          << " with file format " << fformat_to_str( file_format )
+		          << " cannot select columns, reading all of them.\n";
 	}
 }
 
 
 int dump_reader::next_block( block_data &block )
 {
-	return interp->next_block( block );
+	int status = interp->next_block( block );
+	if( status > 0 && following ) status = follow_block( &block );
+	if( !status ) ++current_block_;
+	return status;
 }
 
 int dump_reader::last_block( block_data &block )
 {
-	int status = interp->next_block( block );
-	while( !status ){
-		status = interp->next_block( block );
+	if( get_index( true ) ){
+		if( index->size() == 0 ) return 1;
+		int status = seek_block( index->size() - 1 );
+		if( status ) return status;
+		return next_block( block );
 	}
-	return status;
+
+	// Without index, read all blocks. At EOF the block is unchanged,
+	// but after a parse error it is not, so report that.
+	int status = next_block( block );
+	if( status ) return status;
+	while( ( status = next_block( block ) ) == 0 );
+	return status < 0 ? status : 0;
 }
 
 
 
 int dump_reader::skip_blocks( int Nblocks )
 {
-	int status = 0;
+	// The index of a dump that is still growing is not up to date.
+	if( !following && get_index( false ) ){
+		// The index has no entry for the end of the file, so the last
+		// block is skipped instead of seeking past it.
+		std::size_t n = current_block_ + Nblocks;
+		if( n == 0 || n < index->size() ) return seek_block( n );
+		int status = seek_block( n - 1 );
+		return status ? status : skip_block();
+	}
+
 	for( int i = 0; i < Nblocks; ++i ){
-		status = skip_block();
-		if( !status ){
+		int status = skip_block();
+		if( status ){
 			return status;
 		}
 	}
-	return status;
+	return 0;
 }
 
 
 int dump_reader::skip_block ( )
 {
-	return interp->skip_block();
+	int status = interp->skip_block();
+	if( status > 0 && following ) status = follow_block( nullptr );
+	if( !status ) ++current_block_;
+	return status;
+}
+
+
+bool dump_reader::follow( bool on, double timeout )
+{
+	if( !interp->follow( on ) ){
+		std::cerr << "Dump format " << dformat_to_str( dump_format )
+		          << " with file format " << fformat_to_str( file_format )
+		          << " cannot be followed!\n";
+		return false;
+	}
+	following = on;
+	follow_timeout = timeout;
+	if( on && !watch ) watch = new file_watch( interp->dname() );
+	return true;
+}
+
+
+int dump_reader::follow_block( block_data *block )
+{
+	// Also look at the file this often, in case a write was missed.
+	const double poll_interval = 0.25;
+	typedef std::chrono::steady_clock clock;
+
+	// Anything written before size was taken is picked up by
+	// trying once more right away, anything after by its growth.
+	std::size_t size = watch->size();
+	clock::time_point last_change = clock::now();
+	int status = block ? interp->next_block( *block ) : interp->skip_block();
+	while( status > 0 ){
+		double waited = std::chrono::duration<double>(
+			clock::now() - last_change ).count();
+		double slice = poll_interval;
+		if( follow_timeout >= 0 ){
+			if( waited >= follow_timeout ) return 1;
+			slice = std::min( slice, follow_timeout - waited );
+		}
+		watch->wait( slice );
+
+		std::size_t new_size = watch->size();
+		if( new_size == size ) continue;
+		size = new_size;
+		last_change = clock::now();
+		status = block ? interp->next_block( *block ) : interp->skip_block();
+	}
+	return status;
+}
+
+
+void dump_reader::rewind()
+{
+	current_block_ = 0;
+	if( interp->seek( 0 ) ){
+		// Cannot seek, start over with a fresh interpreter.
+		std::string fname = interp->dname();
+		delete interp;
+		interp = nullptr;
+		setup_interpreter( fname );
+		if( following ) interp->follow( true );
+	}
+}
+
+
+bool dump_reader::can_index() const
+{
+	if( sharded || dump_format != LAMMPS ) return false;
+	if( file_format == ZSTD ){
+		return text_reader_zstd::is_seekable( interp->dname() );
+	}
+	return file_format == PLAIN || file_format == MMAP ||
+		file_format == BGZF;
+}
+
+
+bool dump_reader::get_index( bool build )
+{
+	if( index ) return true;
+
+	const std::string &fname = interp->dname();
+	if( !index_tried ){
+		index_tried = true;
+		dump_index *idx = new dump_index;
+		// Some formats carry their own index.
+		if( interp->build_index( *idx ) ){
+			index = idx;
+			return true;
+		}
+		if( can_index() &&
+		    idx->load( dump_index::sidecar_name( fname ), fname ) ){
+			index = idx;
+			return true;
+		}
+		delete idx;
+	}
+	if( !build || !can_index() ) return false;
+
+	dump_index *idx = new dump_index;
+	bool ok = false;
+	if( file_format == BGZF ){
+		// Index the uncompressed text, so that seeking
+		// only decompresses the block of the frame.
+		text_reader_bgzf r( fname, n_workers );
+		ok = idx->load_or_build( fname, &r );
+	}else if( file_format == ZSTD ){
+		text_reader_zstd r( fname );
+		ok = idx->load_or_build( fname, &r );
+	}else{
+		ok = idx->load_or_build( fname );
+	}
+	if( !ok ){
+		delete idx;
+		return false;
+	}
+	index = idx;
+	return true;
+}
+
+
+int dump_reader::seek_block( std::size_t n )
+{
+	if( !get_index( true ) ){
+		std::cerr << "Dump format " << dformat_to_str( dump_format )
+		          << " with file format " << fformat_to_str( file_format )
+		          << " does not support seeking!\n";
+		return -1;
+	}
+	if( n >= index->size() ) return 1;
+
+	int status = interp->seek( (*index)[n].offset );
+	if( status ) return status;
+	current_block_ = n;
+	return 0;
+}
+
+
+int dump_reader::seek_timestep( py_int t )
+{
+	if( !get_index( true ) ){
+		// Let seek_block report the error.
+		return seek_block( 0 );
+	}
+	return seek_block( index->find_timestep( t ) );
 }
 
 
 
 std::size_t dump_reader::block_count()
 {
+	if( get_index( true ) ){
+		return index->size();
+	}
+
 	std::size_t i = 0;
 	while( true ){
 		block_data b;
@@ -153,11 +433,33 @@ std::size_t dump_reader::block_count()
 extern "C" {
 	dump_reader_handle *get_dump_reader_handle( const char *dname,
 	                                            py_int dformat, py_int fformat )
+{
+	return get_dump_reader_handle_parallel( dname, dformat, fformat, 0, 0 );
+}
+
+dump_reader_handle *get_dump_reader_handle_parallel( const char *dname,
+                                                     py_int dformat,
+                                                     py_int fformat,
+                                                     py_int n_workers,
+                                                     py_int queue_depth )
+{
+	return get_dump_reader_handle_columns( dname, dformat, fformat,
+	                                       n_workers, queue_depth, "" );
+}
+
+dump_reader_handle *get_dump_reader_handle_columns( const char *dname,
+                                                    py_int dformat,
+                                                    py_int fformat,
+                                                    py_int n_workers,
+                                                    py_int queue_depth,
+                                                    const char *columns )
 {
 	std::cerr << "dname = " << dname << "\n";
 	dump_reader_handle *dh = new dump_reader_handle;
         std::string name( dname );
-        dh->reader = new dump_reader( name, dformat, fformat );
+        dh->reader = new dump_reader( name, dformat, fformat,
+                                      n_workers, queue_depth,
+                                      split( columns ) );
 	dh->last_block = new block_data;
 	
 	return dh;
@@ -166,17 +468,46 @@ extern "C" {
 void release_dump_reader_handle( dump_reader_handle *dh )
 {
 	if( dh ){
+		// The prefetcher uses the reader, so delete it first.
+		if( dh->prefetch ) delete dh->prefetch;
 		if( dh->reader ) delete dh->reader;
 		if( dh->last_block ) delete dh->last_block;
 		delete dh;
 	}
 }
 
+void dump_reader_set_prefetch( dump_reader_handle *dh, py_int depth )
+{
+	if( dh->prefetch ){
+		// Blocks that were read ahead are lost, so go back
+		// to where the caller is.
+		std::size_t current = dh->prefetch->current_block();
+		delete dh->prefetch;
+		dh->prefetch = nullptr;
+		if( dh->reader->current_block() != current ){
+			dh->reader->rewind();
+			dh->reader->skip_blocks( current );
+		}
+	}
+	if( depth > 0 ){
+		dh->prefetch = new dump_reader_prefetch( *dh->reader, depth );
+	}
+}
+
+py_int dump_reader_follow( dump_reader_handle *dh, py_int on,
+                           py_float timeout )
+{
+	// The reading thread must not be in the reader meanwhile.
+	dump_reader_set_prefetch( dh, 0 );
+	return dh->reader->follow( on, timeout ) ? 1 : 0;
+}
+
 int dump_reader_next_block( dump_reader_handle *dh )
 {
 	// std::cerr << "Calling next_block on dh @ " << dh << "\n";
 	block_data &block = *dh->last_block;
-	int status = dh->reader->next_block( block );
+	int status = dh->prefetch ? dh->prefetch->next_block( block )
+		: dh->reader->next_block( block );
 	if( status ){
 		if( status > 0 ){
 			std::cerr << "Dump file at EOF.\n";
@@ -275,11 +606,129 @@ void dump_reader_get_block_data( dump_reader_handle *dh,
 
 }
 
+block_data *dump_reader_take_block( dump_reader_handle *dh )
+{
+	// The handle gets the arena of a block Python is done with,
+	// so the next frame is read without allocating.
+	block_data *b = block_pool::shared().acquire();
+	b->swap( *dh->last_block );
+	return b;
+}
+
+void dump_reader_block_arrays( block_data *b, py_float **x, py_int **ids,
+                               py_int **types, py_int **mol )
+{
+	*x     = b->x_;
+	*ids   = b->ids;
+	*types = b->types;
+	*mol   = b->atom_style == atom_styles::MOLECULAR ? b->mol : nullptr;
+}
+
+void dump_reader_release_block( block_data *b )
+{
+	block_pool::shared().release( b );
+}
+
 int dump_reader_fast_forward( dump_reader_handle *dh,
                                py_int N_blocks )
 {
+	if( dh->prefetch ) return dh->prefetch->skip_blocks( N_blocks );
 	return dh->reader->skip_blocks( N_blocks );
 }
 
+py_int dump_reader_read_frames( dump_reader_handle *dh, py_int n_frames,
+                                py_int stride, const py_int *ids,
+                                py_int n_ids, py_float *x, py_int *tsteps,
+                                py_float *boxes )
+{
+	if( n_frames < 0 || stride < 1 || n_ids < 0 || !x ){
+		std::cerr << "Invalid arguments to dump_reader_read_frames!\n";
+		return -1;
+	}
+
+	block_data &block = *dh->last_block;
+	id_map slots;                  // Place of each atom id in x
+	std::vector<py_int> row_ids;   // Ids of the last block, row by row
+	std::vector<py_int> row_slot;  // Place in x of each of its rows
+	if( ids ) slots = id_map( ids, n_ids );
+
+	for( py_int f = 0; f < n_frames; ++f ){
+		int status = 0;
+		if( f > 0 && stride > 1 ){
+			status = dump_reader_fast_forward( dh, stride - 1 );
+		}
+		if( !status ){
+			status = dh->prefetch ? dh->prefetch->next_block( block )
+				: dh->reader->next_block( block );
+		}
+		if( status ) return status > 0 ? f : status;
+
+		const py_int N = block.N;
+		if( !ids && f == 0 ){
+			if( N != n_ids ){
+				std::cerr << "First block has " << N << " atoms, not "
+				          << n_ids << "!\n";
+				return -1;
+			}
+			std::vector<py_int> sorted( block.ids, block.ids + N );
+			std::sort( sorted.begin(), sorted.end() );
+			slots = id_map( sorted );
+		}
+
+		// Dumps usually list the atoms in the same order every
+		// time, then the places of the last block can be reused.
+		if( row_ids.size() != static_cast<std::size_t>( N ) ||
+		    !std::equal( row_ids.begin(), row_ids.end(), block.ids ) ){
+			row_ids.assign( block.ids, block.ids + N );
+			row_slot.resize( N );
+			slots.map_ids( block.ids, row_slot.data(), N );
+			py_int found = N - std::count( row_slot.begin(),
+			                               row_slot.end(), -1 );
+			if( found != n_ids ){
+				std::cerr << "Block at t = " << block.tstep << " has "
+				          << found << " of the " << n_ids
+				          << " atoms asked for!\n";
+				return -1;
+			}
+		}
+
+		py_float *xf = x + 3*n_ids*f;
+		for( py_int i = 0; i < N; ++i ){
+			py_int s = row_slot[i];
+			if( s < 0 ) continue;
+			xf[3*s]   = block.x_[3*i];
+			xf[3*s+1] = block.x_[3*i+1];
+			xf[3*s+2] = block.x_[3*i+2];
+		}
+		if( tsteps ) tsteps[f] = block.tstep;
+		if( boxes ){
+			for( int d = 0; d < 3; ++d ){
+				boxes[6*f + d]     = block.xlo[d];
+				boxes[6*f + 3 + d] = block.xhi[d];
+			}
+		}
+	}
+	return n_frames;
+}
+
+int dump_reader_seek_block( dump_reader_handle *dh, py_int n )
+{
+	if( n < 0 ) return -1;
+	if( dh->prefetch ) return dh->prefetch->seek_block( n );
+	return dh->reader->seek_block( n );
+}
+
+int dump_reader_seek_timestep( dump_reader_handle *dh, py_int t )
+{
+	if( dh->prefetch ) return dh->prefetch->seek_timestep( t );
+	return dh->reader->seek_timestep( t );
+}
+
+py_int dump_reader_block_count( dump_reader_handle *dh )
+{
+	if( dh->prefetch ) return dh->prefetch->block_count();
+	return dh->reader->block_count();
+}
+
 	
 } // extern "C"
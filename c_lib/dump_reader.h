@@ -12,6 +12,8 @@
 
 #include "block_data.h"
 #include "dump_interpreter.h"
+#include "dump_index.h"
+#include "file_watch.h"
 #include "util.h"
 
 
@@ -27,14 +29,19 @@ public:
 		PLAIN   = 0,
 		GZIP    = 1,
 		ISTREAM = 2,
-		BIN     = 3
+		BIN     = 3,
+		MMAP    = 4, ///< Plain text, memory-mapped and parsed in place
+		BGZF    = 5, ///< Block-gzipped text, can seek and use threads
+		ZSTD    = 6, ///< zstd-compressed text, seekable zstd can seek
+		LZ4     = 7  ///< LZ4-compressed text (LZ4 frame format)
 	};
 
 	/// Specifies various dump formats
 	enum DUMP_FORMATS {
 		LAMMPS  = 0,
 		GSD     = 1,
-		NAMD    = 2
+		NAMD    = 2,
+		LTRAJ   = 3  ///< Native columnar format, see ltraj.h
 	};
 
 	/**
@@ -57,6 +64,14 @@ public:
 				return "INPUT STREAM";
 			case BIN:
 				return "BINARY";
+			case MMAP:
+				return "MEMORY-MAPPED PLAIN TEXT";
+			case BGZF:
+				return "BLOCK-GZIPPED TEXT";
+			case ZSTD:
+				return "ZSTD-COMPRESSED TEXT";
+			case LZ4:
+				return "LZ4-COMPRESSED TEXT";
 		}
 	}
 
@@ -78,13 +93,49 @@ public:
 				return "GSD";
 			case NAMD:
 				return "NAMD";
+			case LTRAJ:
+				return "LTRAJ";
 		}
 	}
 
 	
-	/// Construct dump reader from file.
+	/**
+	   Construct dump reader from file.
+
+	   \p fname can also be a glob pattern like dump.*.gz, or contain a
+	   printf conversion like dump.%d.gz, for dumps that LAMMPS split
+	   into one file per time step. The files are then read as one
+	   dump, ordered by the numbers in their names, and the dump and
+	   file format are guessed from the first one.
+	*/
 	dump_reader( const std::string &fname );
 	dump_reader( const std::string &fname, int dformat, int fformat );
+
+	/**
+	   Constructs a dump reader that parses frames on several threads.
+
+	   \param n_workers    Number of parsing threads. 0 means serial
+	                       reading, negative means one thread per core.
+	   \param queue_depth  Maximum number of frames parsed ahead of the
+	                       caller. If <= 0, twice the number of workers.
+
+	   Only LAMMPS text dumps (PLAIN or MMAP) can be parsed in parallel.
+	   For BGZF files, n_workers threads decompress the file instead.
+	   Other formats are read serially. The blocks are still returned
+	   in the order they are in the file.
+
+	   For dumps split over files (see above), n_workers files are
+	   read at the same time, one per core if n_workers <= 0, and
+	   queue_depth is the number of files read ahead.
+
+	   \param columns      If not empty, only these columns of LAMMPS
+	                       text dumps are parsed, the rest is skipped.
+	                       See lammps_frame_parser::select_columns.
+	*/
+	dump_reader( const std::string &fname, int dformat, int fformat,
+	             int n_workers, int queue_depth,
+	             const std::vector<std::string> &columns =
+	             std::vector<std::string>() );
 	
 	/// Cleanup:
 	virtual ~dump_reader();
@@ -98,8 +149,8 @@ public:
 	int next_block( block_data &block );
 
 	/// To return read the last block in the file. If successful,
-	/// returns true and block_data contains the next block.
-	/// Else returns false and block_data is unchanged.
+	/// returns 0 and block_data contains the last block.
+	/// Uses the frame index if the dump supports one.
         int last_block( block_data &block );
 
 	/// Checks if the internal file is good or not.
@@ -107,7 +158,7 @@ public:
 	bool good() const { return interp->good(); }
 	
 
-	/// Fast-forward a number of blocks.
+	/// Fast-forward a number of blocks. Returns 0 on success.
         int skip_blocks( int Nblocks );
 
 	/// Fast-forward one block.
@@ -116,18 +167,83 @@ public:
 	/// Rewinds to the beginning.
 	void rewind();
 	
-	/// Returns the number of blocks in the file.
+	/// Returns the number of blocks in the file. For indexable dumps
+	/// this does not read the file, otherwise it consumes the reader.
 	std::size_t block_count();
 
+	/**
+	   Moves the reader to block \p n (counting from 0) using the
+	   frame index, so that the next call to next_block reads it.
+
+	   \returns 0 on success, positive if there are not that many
+	            blocks and negative if the dump cannot be indexed.
+	*/
+	int seek_block( std::size_t n );
+
+	/**
+	   Moves the reader to the first block whose time step is at
+	   least \p t using the frame index.
+
+	   \returns 0 on success, positive if there is no such block
+	            and negative if the dump cannot be indexed.
+	*/
+	int seek_timestep( py_int t );
+
+	/// Returns the number of blocks read or skipped so far.
+	std::size_t current_block() const { return current_block_; }
+
+	/**
+	   Switches follow mode on or off, for dumps that a simulation is
+	   still writing. In follow mode, next_block and skip_block wait at
+	   the end of the dump for more frames instead of returning 1, and
+	   a frame that is only partly written is read once it is complete.
+	   They give up and return 1 once the file has not grown for
+	   \p timeout seconds. A negative timeout waits forever.
+
+	   Only plain and memory-mapped LAMMPS text dumps can be followed.
+
+	   \returns false if this dump cannot be followed.
+	*/
+	bool follow( bool on, double timeout = -1 );
+
 	
 private:
 	int dump_format;  //!< Stores the dump format
 	int file_format;  //!< Stores the file format
 
+	int n_workers;    //!< Number of parsing threads, 0 for serial
+	int queue_depth;  //!< Frames the parallel reader may read ahead
+	std::vector<std::string> columns;  //!< Columns to parse, all if empty
+	bool sharded;                      //!< True if split over files
+	std::vector<std::string> shards;   //!< Files of a split dump, in order
+
 	dump_interpreter *interp; //!< Points to an internal dump_interpreter
 
+	dump_index *index;        //!< Frame index, if built or loaded
+	bool index_tried;         //!< True if loading the sidecar was tried
+	std::size_t current_block_; //!< Number of the next block to read
+
+	bool following;           //!< True in follow mode
+	double follow_timeout;    //!< Seconds to wait for the dump to grow
+	file_watch *watch;        //!< Wakes follow mode up on writes
+
+	/// Waits in follow mode until the next block (or if block is
+	/// nullptr, skipping it) succeeds or follow_timeout runs out.
+	int follow_block( block_data *block );
+
+	/// True if this dump can be indexed for random access.
+	bool can_index() const;
+	/// Makes sure index is available. Only scans the dump if build.
+	bool get_index( bool build );
+	/// Passes columns on to the interpreter, if any are selected.
+	void select_columns();
+
+	/// Finds the files of a dump split over files if fname is a pattern
+	void find_shards     ( const std::string &fname );
 	/// Guesses file type from name
 	void guess_file_type ( const std::string &fname );
+	/// Tells BGZF from plain gzip files by their header
+	int  guess_gzip_type ( const std::string &fname ) const;
 	/// Guesses dump type from name
 	void guess_dump_type ( const std::string &fname );	
 };
@@ -135,13 +251,17 @@ private:
 
 
 
+class dump_reader_prefetch;
+
 extern "C" {
 
 /// This struct is used for interfacing between Python and the C++ lib.
 struct dump_reader_handle {
-	dump_reader_handle() : reader(nullptr), last_block(nullptr){}
+	dump_reader_handle() : reader(nullptr), last_block(nullptr),
+	                       prefetch(nullptr){}
 	dump_reader *reader;
 	block_data  *last_block;
+	dump_reader_prefetch *prefetch; ///< Reads ahead if not nullptr
 };
 
 /**
@@ -157,6 +277,28 @@ struct dump_reader_handle {
 dump_reader_handle *get_dump_reader_handle( const char *dname,
                                             py_int dformat, py_int fformat );
 
+/**
+   Like get_dump_reader_handle, but the dump is parsed by \p n_workers
+   threads with at most \p queue_depth frames read ahead.
+   See dump_reader::dump_reader for their meaning.
+*/
+dump_reader_handle *get_dump_reader_handle_parallel( const char *dname,
+                                                     py_int dformat,
+                                                     py_int fformat,
+                                                     py_int n_workers,
+                                                     py_int queue_depth );
+
+/**
+   Like get_dump_reader_handle_parallel, but only the columns in the
+   space-separated list \p columns are parsed. An empty list means all.
+*/
+dump_reader_handle *get_dump_reader_handle_columns( const char *dname,
+                                                    py_int dformat,
+                                                    py_int fformat,
+                                                    py_int n_workers,
+                                                    py_int queue_depth,
+                                                    const char *columns );
+
 /**
    Releases a dump_reader_handle ensuring proper clean-up.
 
@@ -164,6 +306,22 @@ dump_reader_handle *get_dump_reader_handle( const char *dname,
 */
 void release_dump_reader_handle( dump_reader_handle *dh );
 
+/**
+   Makes the dump_reader_handle \p dh read \p depth blocks ahead on a
+   background thread, see dump_reader_prefetch. A depth of 0 turns
+   reading ahead off again.
+*/
+void dump_reader_set_prefetch( dump_reader_handle *dh, py_int depth );
+
+/**
+   Switches follow mode of the dump_reader_handle \p dh on or off, see
+   dump_reader::follow. Reading ahead is turned off first, turn it on
+   again afterwards if needed. Returns 1 on success and 0 if the dump
+   cannot be followed.
+*/
+py_int dump_reader_follow( dump_reader_handle *dh, py_int on,
+                           py_float timeout );
+
 /**
    Makes the dump_reader_handle \p dh read in a new block and store
    it in its matching \p last_block field.
@@ -197,9 +355,75 @@ void dump_reader_get_block_data( dump_reader_handle *dh,
                                  py_int N, py_float *x, py_int *ids,
                                  py_int *types, py_int *mol );
 
+/**
+   Hands the block last read by \p dh over to the caller, so that its
+   arrays can be used in place instead of being copied out with
+   dump_reader_get_block_data. The handle reads the next block into
+   the arrays of a block that was released before, see block_pool, or
+   into a new block if there is none. Get the meta info with dump_reader_get_block_meta first.
+
+   The block stays valid until it is given to dump_reader_release_block,
+   even if \p dh is released before.
+*/
+block_data *dump_reader_take_block( dump_reader_handle *dh );
+
+/**
+   Stores pointers to the arrays of block \p b, which has b->N atoms.
+   \p x points to N x 3 positions. \p mol is nullptr if the block has
+   no molecule ids.
+*/
+void dump_reader_block_arrays( block_data *b, py_float **x, py_int **ids,
+                               py_int **types, py_int **mol );
+
+/// Returns a block handed out by dump_reader_take_block to the shared
+/// block_pool, so that its arrays are reused for a later frame.
+void dump_reader_release_block( block_data *b );
+
 int dump_reader_fast_forward( dump_reader_handle *dh,
                               py_int N_blocks );
 
+/**
+   Reads up to \p n_frames blocks of \p dh in one call, for analyses of
+   the time series of single atoms. Between two blocks that are read,
+   \p stride - 1 blocks are skipped.
+
+   The atoms of every block are written in the order of the \p n_ids
+   atom ids in \p ids, and every block must have all of them. If \p ids
+   is nullptr, the ids of the first block, sorted, are used, and it must
+   have \p n_ids atoms.
+
+   Blocks are read through the prefetcher of \p dh if it has one, so
+   the next blocks are parsed (in parallel if the reader has workers)
+   while the current one is sorted.
+
+   \param x       Positions, \p n_frames x \p n_ids x 3.
+   \param tsteps  Time steps, \p n_frames. Can be nullptr.
+   \param boxes   xlo, ylo, zlo, xhi, yhi, zhi of every block,
+                  \p n_frames x 6. Can be nullptr.
+
+   \returns The number of blocks read, less than \p n_frames if the
+            dump ended, or negative on failure.
+*/
+py_int dump_reader_read_frames( dump_reader_handle *dh, py_int n_frames,
+                                py_int stride, const py_int *ids,
+                                py_int n_ids, py_float *x, py_int *tsteps,
+                                py_float *boxes );
+
+/**
+   Moves the dump_reader_handle \p dh to block \p n, see
+   dump_reader::seek_block.
+*/
+int dump_reader_seek_block( dump_reader_handle *dh, py_int n );
+
+/**
+   Moves the dump_reader_handle \p dh to the first block with time step
+   at least \p t, see dump_reader::seek_timestep.
+*/
+int dump_reader_seek_timestep( dump_reader_handle *dh, py_int t );
+
+/// Returns the number of blocks in the dump of \p dh.
+py_int dump_reader_block_count( dump_reader_handle *dh );
+
 	
 
 } // extern "C"
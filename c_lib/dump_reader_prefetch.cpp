@@ -0,0 +1,163 @@
+#include "dump_reader_prefetch.h"
+
+
+dump_reader_prefetch::dump_reader_prefetch( dump_reader &reader, int depth )
+	: reader( reader ), depth( depth > 0 ? depth : 1 ),
+	  slots( this->depth ), head( 0 ), tail( 0 ), done( false ),
+	  stopping( false )
+{
+	start();
+}
+
+
+dump_reader_prefetch::~dump_reader_prefetch()
+{
+	stop();
+}
+
+
+void dump_reader_prefetch::start()
+{
+	// After EOF or an error there is nothing left to read.
+	if( done ) return;
+	stopping = false;
+	worker = std::thread( &dump_reader_prefetch::run, this );
+}
+
+
+void dump_reader_prefetch::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( mtx );
+		stopping = true;
+	}
+	cv.notify_all();
+	if( worker.joinable() ) worker.join();
+}
+
+
+void dump_reader_prefetch::discard()
+{
+	head = tail = 0;
+	done = false;
+}
+
+
+void dump_reader_prefetch::run()
+{
+	while( true ){
+		std::unique_lock<std::mutex> lock( mtx );
+		cv.wait( lock, [this]{ return stopping || tail - head < depth; } );
+		if( stopping ) return;
+
+		// Nobody else touches this slot until tail is incremented.
+		prefetch_slot &s = slots[ tail % depth ];
+		lock.unlock();
+		int status = reader.next_block( s.block );
+		lock.lock();
+
+		s.status = status;
+		++tail;
+		if( status ) done = true;
+		cv.notify_all();
+		if( status ) return;
+	}
+}
+
+
+int dump_reader_prefetch::next_block( block_data &block )
+{
+	std::unique_lock<std::mutex> lock( mtx );
+	// The thread only stops after storing a non-zero status, so
+	// there is always a slot coming.
+	cv.wait( lock, [this]{ return head < tail; } );
+
+	prefetch_slot &s = slots[ head % depth ];
+	if( s.status ) return s.status;
+
+	block.swap( s.block );
+	++head;
+	cv.notify_all();
+	return 0;
+}
+
+
+int dump_reader_prefetch::skip_blocks( int Nblocks )
+{
+	stop();
+
+	int status = 0;
+	while( Nblocks > 0 && head < tail ){
+		status = slots[ head % depth ].status;
+		if( status ) break;
+		++head;
+		--Nblocks;
+	}
+	if( !status && Nblocks > 0 ){
+		status = reader.skip_blocks( Nblocks );
+	}
+
+	start();
+	return status;
+}
+
+
+int dump_reader_prefetch::seek_block( std::size_t n )
+{
+	stop();
+	// The reader is already past the blocks in the ring, so they are
+	// only dropped if the seek worked.
+	int status = reader.seek_block( n );
+	if( !status ) discard();
+	start();
+	return status;
+}
+
+
+int dump_reader_prefetch::seek_timestep( py_int t )
+{
+	stop();
+	// The reader is already past the blocks in the ring, so they are
+	// only dropped if the seek worked.
+	int status = reader.seek_timestep( t );
+	if( !status ) discard();
+	start();
+	return status;
+}
+
+
+void dump_reader_prefetch::rewind()
+{
+	stop();
+	discard();
+	reader.rewind();
+	start();
+}
+
+
+std::size_t dump_reader_prefetch::block_count()
+{
+	stop();
+	std::size_t n = reader.block_count();
+	start();
+	return n;
+}
+
+
+bool dump_reader_prefetch::eof() const
+{
+	std::lock_guard<std::mutex> lock( mtx );
+	return done && tail - head == 1 && slots[ head % depth ].status > 0;
+}
+
+
+std::size_t dump_reader_prefetch::current_block()
+{
+	stop();
+	std::size_t n = reader.current_block();
+	for( std::size_t i = head; i < tail; ++i ){
+		if( !slots[ i % depth ].status ) --n;
+	}
+	start();
+	return n;
+}
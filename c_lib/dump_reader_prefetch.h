@@ -0,0 +1,88 @@
+#ifndef DUMP_READER_PREFETCH_H
+#define DUMP_READER_PREFETCH_H
+
+/*!
+  @file dump_reader_prefetch.h
+  @brief Reads blocks ahead on a background thread.
+
+  \ingroup cpp_lib
+*/
+
+#include "block_data.h"
+#include "dump_reader.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+   @brief Wraps a dump_reader and reads the next blocks in the background.
+
+   While the caller works on block k, a background thread already reads
+   blocks k+1, ..., k+depth into a ring of blocks. next_block swaps the
+   next ready block with the one passed in, so the caller's previous
+   block is reused for reading a later one. Once the blocks have reached
+   their final size, reading does not allocate anymore.
+
+   The dump_reader must outlive the prefetcher and must not be used
+   directly while the prefetcher exists, use the methods here instead.
+*/
+class dump_reader_prefetch
+{
+public:
+	/**
+	   \param reader  The dump_reader to read from.
+	   \param depth   Number of blocks to read ahead, at least 1.
+	*/
+	dump_reader_prefetch( dump_reader &reader, int depth = 2 );
+	~dump_reader_prefetch();
+
+	/// Like dump_reader::next_block, but the block is usually ready.
+	int next_block( block_data &block );
+
+	/// Like dump_reader::skip_blocks. Uses read-ahead blocks first.
+	int skip_blocks( int Nblocks );
+
+	int seek_block( std::size_t n );
+	int seek_timestep( py_int t );
+	void rewind();
+	std::size_t block_count();
+
+	bool eof() const;
+
+	/// Number of blocks handed out or skipped so far, which is less
+	/// than reader.current_block() if blocks were read ahead.
+	std::size_t current_block();
+
+private:
+	/// A block read by the background thread.
+	struct prefetch_slot {
+		prefetch_slot() : status(0) {}
+		block_data block;
+		int status;          ///< Return value of next_block
+	};
+
+	dump_reader &reader;
+	std::size_t depth;       //!< Number of slots
+
+	std::vector<prefetch_slot> slots;
+	std::size_t head;        //!< Next slot to hand out
+	std::size_t tail;        //!< Next slot to read into
+	bool done;               //!< The reader returned a non-zero status
+	bool stopping;
+
+	mutable std::mutex mtx;
+	std::condition_variable cv;
+
+	std::thread worker;
+
+	void start();
+	void stop();
+	void discard();
+	void run();
+};
+
+
+#endif // DUMP_READER_PREFETCH_H
@@ -0,0 +1,220 @@
+#ifndef FAST_PARSE_H
+#define FAST_PARSE_H
+
+/*!
+  \file fast_parse.h
+  @brief Allocation-free tokenizing and number parsing on raw char buffers.
+
+  These work on [p, end) ranges that need not be null-terminated (e.g. a
+  memory-mapped file). Every function returns the position right after
+  what it consumed, and never reads past end.
+
+  \ingroup cpp_lib
+*/
+
+#include "types.h"
+
+#include <cstring>
+#include <cstdlib>
+
+
+namespace fast_parse {
+
+/// Powers of ten that are exactly representable as doubles.
+static const double exact_pow10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21,
+	1e22
+};
+
+inline bool is_blank( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/// Skips spaces and tabs (not newlines).
+inline const char *skip_blanks( const char *p, const char *end )
+{
+	while( p < end && is_blank( *p ) ) ++p;
+	return p;
+}
+
+/// Returns pointer to the next '\n' or end.
+inline const char *find_eol( const char *p, const char *end )
+{
+	const void *nl = std::memchr( p, '\n', end - p );
+	return nl ? static_cast<const char*>( nl ) : end;
+}
+
+/// Returns pointer to the first char of the next line, or end.
+inline const char *next_line( const char *p, const char *end )
+{
+	p = find_eol( p, end );
+	return p < end ? p + 1 : end;
+}
+
+/// Skips n lines, returns end if there are less than n lines left.
+inline const char *skip_lines( const char *p, const char *end, py_int n )
+{
+	for( py_int i = 0; i < n && p < end; ++i ){
+		p = next_line( p, end );
+	}
+	return p;
+}
+
+/// Skips over one whitespace-separated token and the blanks before it.
+inline const char *skip_token( const char *p, const char *end )
+{
+	p = skip_blanks( p, end );
+	while( p < end && !is_blank( *p ) && *p != '\n' ) ++p;
+	return p;
+}
+
+/// True if [p, end) starts with the null-terminated string s.
+inline bool starts_with( const char *p, const char *end, const char *s )
+{
+	std::size_t n = std::strlen( s );
+	return static_cast<std::size_t>( end - p ) >= n &&
+		std::memcmp( p, s, n ) == 0;
+}
+
+/**
+   Parses a (signed) integer.
+
+   \param p    Where to start, leading blanks are skipped.
+   \param end  End of the buffer.
+   \param val  Will contain the parsed value.
+   \param ok   Is set to false if no digits were found.
+
+   \returns    Position right after the last digit.
+*/
+inline const char *parse_int( const char *p, const char *end,
+                              py_int &val, bool &ok )
+{
+	p = skip_blanks( p, end );
+	bool neg = false;
+	if( p < end && ( *p == '-' || *p == '+' ) ){
+		neg = ( *p == '-' );
+		++p;
+	}
+	const char *start = p;
+	py_uint v = 0;
+	while( p < end && static_cast<unsigned>( *p - '0' ) < 10u ){
+		v = 10*v + static_cast<unsigned>( *p - '0' );
+		++p;
+	}
+	if( p == start ) ok = false;
+	val = neg ? -static_cast<py_int>( v ) : static_cast<py_int>( v );
+	return p;
+}
+
+/**
+   Slow path for parse_float, for tokens the fast path cannot
+   guarantee to round correctly (long mantissas, huge exponents,
+   nan, inf).
+*/
+inline const char *parse_float_slow( const char *p, const char *end,
+                                     double &val, bool &ok )
+{
+	char buff[64];
+	const char *tok_end = skip_token( p, end );
+	std::size_t n = tok_end - p;
+	if( n == 0 || n >= sizeof(buff) ){
+		ok = false;
+		return tok_end;
+	}
+	std::memcpy( buff, p, n );
+	buff[n] = '\0';
+	char *conv_end = nullptr;
+	val = std::strtod( buff, &conv_end );
+	if( conv_end != buff + n ) ok = false;
+	return tok_end;
+}
+
+/**
+   Parses a floating point number.
+
+   Uses the exact fast path (mantissa < 2^53, |exponent| <= 22) for
+   everything a LAMMPS dump typically contains and falls back to strtod
+   otherwise, so the result is always correctly rounded.
+
+   \param p    Where to start, leading blanks are skipped.
+   \param end  End of the buffer.
+   \param val  Will contain the parsed value.
+   \param ok   Is set to false if the token was not a number.
+
+   \returns    Position right after the parsed number.
+*/
+inline const char *parse_float( const char *p, const char *end,
+                                double &val, bool &ok )
+{
+	p = skip_blanks( p, end );
+	const char *start = p;
+	bool neg = false;
+	if( p < end && ( *p == '-' || *p == '+' ) ){
+		neg = ( *p == '-' );
+		++p;
+	}
+
+	py_uint mant = 0;
+	int n_digits = 0;
+	int exp10 = 0;
+	const char *digits_start = p;
+	while( p < end && static_cast<unsigned>( *p - '0' ) < 10u ){
+		mant = 10*mant + static_cast<unsigned>( *p - '0' );
+		++n_digits;
+		++p;
+	}
+	if( p < end && *p == '.' ){
+		++p;
+		while( p < end && static_cast<unsigned>( *p - '0' ) < 10u ){
+			mant = 10*mant + static_cast<unsigned>( *p - '0' );
+			++n_digits;
+			--exp10;
+			++p;
+		}
+	}
+	if( p == digits_start || ( p == digits_start + 1 && *digits_start == '.' ) ){
+		// No digits at all, could be nan or inf.
+		return parse_float_slow( start, end, val, ok );
+	}
+
+	if( p < end && ( *p == 'e' || *p == 'E' ) ){
+		++p;
+		bool exp_neg = false;
+		if( p < end && ( *p == '-' || *p == '+' ) ){
+			exp_neg = ( *p == '-' );
+			++p;
+		}
+		int e = 0;
+		const char *exp_start = p;
+		while( p < end && static_cast<unsigned>( *p - '0' ) < 10u ){
+			if( e < 10000 ) e = 10*e + ( *p - '0' );
+			++p;
+		}
+		if( p == exp_start ){
+			ok = false;
+			return p;
+		}
+		exp10 += exp_neg ? -e : e;
+	}
+
+	// Leading zeros do not count towards precision, but 19 digits
+	// always fit in a 64-bit mantissa regardless.
+	if( n_digits > 19 || mant > ( py_uint(1) << 53 ) ||
+	    exp10 < -22 || exp10 > 22 ){
+		return parse_float_slow( start, end, val, ok );
+	}
+
+	double d = static_cast<double>( mant );
+	if( exp10 < 0 ) d /= exact_pow10[-exp10];
+	else            d *= exact_pow10[exp10];
+
+	val = neg ? -d : d;
+	return p;
+}
+
+} // namespace fast_parse
+
+
+#endif // FAST_PARSE_H
@@ -0,0 +1,59 @@
+#include "file_watch.h"
+
+#include <chrono>
+#include <thread>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif // __linux__
+
+
+file_watch::file_watch( const std::string &fname )
+	: fname_( fname ), fd_( -1 )
+{
+#ifdef __linux__
+	fd_ = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( fd_ >= 0 && inotify_add_watch( fd_, fname_.c_str(),
+	                                   IN_MODIFY | IN_CLOSE_WRITE ) < 0 ){
+		// Fall back to polling.
+		close( fd_ );
+		fd_ = -1;
+	}
+#endif // __linux__
+}
+
+file_watch::~file_watch()
+{
+	if( fd_ >= 0 ) close( fd_ );
+}
+
+
+void file_watch::wait( double seconds )
+{
+	if( seconds <= 0 ) return;
+#ifdef __linux__
+	if( fd_ >= 0 ){
+		pollfd p = { fd_, POLLIN, 0 };
+		if( poll( &p, 1, static_cast<int>( seconds * 1000 ) ) > 0 ){
+			// Only the wake-up matters, drop the events.
+			char events[4096];
+			while( read( fd_, events, sizeof(events) ) > 0 );
+		}
+		return;
+	}
+#endif // __linux__
+	std::this_thread::sleep_for( std::chrono::duration<double>( seconds ) );
+}
+
+
+std::size_t file_watch::size() const
+{
+	struct stat st;
+	if( stat( fname_.c_str(), &st ) ) return 0;
+	return st.st_size;
+}
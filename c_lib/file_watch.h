@@ -0,0 +1,47 @@
+#ifndef FILE_WATCH_H
+#define FILE_WATCH_H
+
+/*!
+  \file file_watch.h
+  @brief Waits for a file that is being written to change.
+
+  \ingroup cpp_lib
+*/
+
+#include <string>
+#include <cstddef>
+
+
+/*!
+  @brief Waits for writes to a file.
+
+  On Linux, inotify wakes wait() up as soon as the file is written to.
+  Elsewhere, or if inotify is not available, wait() just sleeps, so
+  callers should check size() after every wait() either way.
+
+  \ingroup cpp_lib
+*/
+class file_watch
+{
+public:
+	/// Watches file fname.
+	file_watch( const std::string &fname );
+	~file_watch();
+
+	/// Waits until the file is written to or \p seconds have passed.
+	void wait( double seconds );
+
+	/// Current size of the file in bytes, 0 if it cannot be stat'ed.
+	std::size_t size() const;
+
+private:
+	std::string fname_;
+	int fd_;   //!< inotify descriptor, -1 when polling
+
+	// Not copyable:
+	file_watch( const file_watch & );
+	void operator=( const file_watch & );
+};
+
+
+#endif // FILE_WATCH_H
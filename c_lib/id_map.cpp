@@ -1,27 +1,114 @@
 #include "id_map.h"
 
+#include <algorithm>
+#include <limits>
+
+// Marks a free slot in the hash table. An id with this value cannot be
+// stored there, but ids that large do not come from real dumps.
+const py_int id_map::EMPTY = std::numeric_limits<py_int>::min();
+
+
 id_map::id_map( const arr1i &ids )
+	: N(0), id_min(0), mask(0), shift(0)
 {
+	std::vector<py_int> tmp( ids.size() );
 	for( uint i = 0; i < ids.size(); ++i ){
-		m[ids[i]] = i;
+		tmp[i] = ids[i];
 	}
+	build( tmp.data(), tmp.size() );
 }
 
 id_map::id_map( const py_int *ids, py_int N )
+	: N(0), id_min(0), mask(0), shift(0)
 {
-	for( uint i = 0; i < N; ++i ){
-		m[ids[i]] = i;
+	build( ids, N );
+}
+
+
+void id_map::build( const py_int *ids, py_int NN )
+{
+	N = NN;
+	last.assign( ids, ids + N );
+	dense.clear();
+	keys.clear();
+	vals.clear();
+	if( N == 0 ) return;
+
+	const auto range = std::minmax_element( ids, ids + N );
+	id_min = *range.first;
+	std::uint64_t span = static_cast<std::uint64_t>( *range.second ) -
+		static_cast<std::uint64_t>( id_min );
+
+	// An array is both smaller and faster unless the ids are sparse.
+	if( span < static_cast<std::uint64_t>( 2*N + 1024 ) ){
+		dense.assign( span + 1, -1 );
+		for( py_int i = 0; i < N; ++i ){
+			dense[ ids[i] - id_min ] = i;
+		}
+		return;
+	}
+
+	// Keep the table at most half full.
+	std::uint64_t size = 16;
+	shift = 60;
+	while( size < static_cast<std::uint64_t>( 2*N ) ){
+		size *= 2;
+		--shift;
+	}
+	mask = size - 1;
+	keys.assign( size, EMPTY );
+	vals.assign( size, -1 );
+	for( py_int i = 0; i < N; ++i ){
+		set( ids[i], i );
 	}
 }
 
-py_int id_map::operator[]( py_int id ) const
+
+void id_map::set( py_int id, py_int idx )
 {
-	std::map<py_int,py_int>::const_iterator i = m.find(id);
-	if( i == m.end() ){
-		return -1;
-	}else{
-		return i->second;
+	if( keys.empty() ){
+		dense[ id - id_min ] = idx;
+		return;
+	}
+	std::uint64_t s = slot( id );
+	while( keys[s] != EMPTY && keys[s] != id ){
+		s = ( s + 1 ) & mask;
+	}
+	keys[s] = id;
+	vals[s] = idx;
+}
+
+
+void id_map::erase( py_int id, py_int idx )
+{
+	if( keys.empty() ){
+		if( dense[ id - id_min ] == idx ) dense[ id - id_min ] = -1;
+		return;
+	}
+
+	std::uint64_t i = slot( id );
+	while( keys[i] != id ){
+		if( keys[i] == EMPTY ) return;
+		i = ( i + 1 ) & mask;
+	}
+	if( vals[i] != idx ) return;
+
+	// Shift later entries of the probe sequence back into the hole,
+	// so lookups never need tombstones.
+	std::uint64_t j = i;
+	while( true ){
+		j = ( j + 1 ) & mask;
+		if( keys[j] == EMPTY ) break;
+		std::uint64_t k = slot( keys[j] );
+		bool stays = ( i <= j ) ? ( i < k && k <= j )
+		                        : ( i < k || k <= j );
+		if( stays ) continue;
+		keys[i] = keys[j];
+		vals[i] = vals[j];
+		i = j;
 	}
+	keys[i] = EMPTY;
+	vals[i] = -1;
 }
 
 
@@ -29,3 +116,65 @@ py_int id_map::id_to_index( py_int id ) const
 {
 	return (*this)[id];
 }
+
+
+void id_map::map_ids( const py_int *ids_in, py_int *idx_out, py_int n ) const
+{
+	if( keys.empty() ){
+		// No branches but the range check, so this vectorizes.
+		const std::uint64_t size = dense.size();
+		const std::uint64_t lo = static_cast<std::uint64_t>( id_min );
+		const py_int *d = dense.data();
+		for( py_int i = 0; i < n; ++i ){
+			std::uint64_t k = static_cast<std::uint64_t>( ids_in[i] ) - lo;
+			idx_out[i] = k < size ? d[k] : -1;
+		}
+	}else{
+		for( py_int i = 0; i < n; ++i ){
+			idx_out[i] = find( ids_in[i] );
+		}
+	}
+}
+
+
+py_int id_map::update( const py_int *ids, py_int NN )
+{
+	if( NN != N ){
+		build( ids, NN );
+		return NN;
+	}
+
+	std::vector<py_int> changed;
+	for( py_int i = 0; i < N; ++i ){
+		if( ids[i] != last[i] ) changed.push_back( i );
+	}
+	py_int n_changed = changed.size();
+	if( n_changed == 0 ) return 0;
+
+	// Patching only pays off if few places changed. The array can
+	// only take ids in its range.
+	bool rebuild = n_changed > N / 4;
+	if( !rebuild && keys.empty() ){
+		for( py_int i : changed ){
+			std::uint64_t k = static_cast<std::uint64_t>( ids[i] ) -
+				static_cast<std::uint64_t>( id_min );
+			if( k >= dense.size() ){
+				rebuild = true;
+				break;
+			}
+		}
+	}
+	if( rebuild ){
+		build( ids, NN );
+		return n_changed;
+	}
+
+	// Atoms that swapped places have their old id at one place and
+	// their new one at another, so remove all before adding any.
+	for( py_int i : changed ) erase( last[i], i );
+	for( py_int i : changed ){
+		set( ids[i], i );
+		last[i] = ids[i];
+	}
+	return n_changed;
+}
@@ -4,44 +4,108 @@
 /*!
   \file id_map.h
   @brief Some tools for indexing based on ids.
-  
+
   \ingroup cpp_lib
 */
 
 #include "types.h"
-#include <map>
+#include <cstdint>
 #include <vector>
 
 
 /*! @brief This class contains some tools for mapping ids onto array indices.
 
+  If the ids fill most of the range between the smallest and the largest
+  one, as atom ids usually do, the index of every id in that range is
+  kept in an array. Otherwise the ids go into an open-addressing hash
+  table. Either way a lookup costs no more than a few memory accesses.
+
+  If an id occurs more than once, it maps onto its last index, or onto
+  any of them after update.
+
   \ingroup cpp_lib
 */
 class id_map {
 public:
 	/// Empty constructor
-	id_map( ) {}
+	id_map( ) : N(0), id_min(0), mask(0), shift(0) {}
 	/// Constructor based on given atom ids
 	id_map( const arr1i &ids );
 	id_map( const py_int *ids, py_int N );
-	
+
 	template <typename int_type>
 	id_map( const std::vector<int_type> &ids )
+		: N(0), id_min(0), mask(0), shift(0)
 	{
-		for( uint i = 0; i < ids.size(); ++i ){
-			m[ids[i]] = i;
-		}
-
+		std::vector<py_int> tmp( ids.begin(), ids.end() );
+		build( tmp.data(), tmp.size() );
 	}
 
-	/// Returns the index in ids (and other arrays) of given id
-	py_int operator[]( py_int id ) const;
+	/// Returns the index in ids (and other arrays) of given id, or
+	/// -1 if it is not in the map.
+	py_int operator[]( py_int id ) const
+	{
+		if( !keys.empty() ) return find( id );
+
+		// Ids below id_min wrap around to large k.
+		std::uint64_t k = static_cast<std::uint64_t>( id ) -
+			static_cast<std::uint64_t>( id_min );
+		return k < dense.size() ? dense[k] : -1;
+	}
 
 	/// Larger, "named" function names for if you are not sure:
 	py_int id_to_index( py_int id ) const;
-	
+
+	/// Stores the index of each of the \p n ids in \p ids_in in
+	/// \p idx_out, or -1 for ids that are not in the map.
+	void map_ids( const py_int *ids_in, py_int *idx_out, py_int n ) const;
+
+	/**
+	   Makes the map describe \p ids instead of the ids it was built
+	   from. Only the places where \p ids differs from the last ids are
+	   looked at, so this is cheap for frames that list the atoms in
+	   (nearly) the same order. Returns the number of those places.
+	*/
+	py_int update( const py_int *ids, py_int N );
+
+	/// True if the map uses the hash table rather than the array.
+	bool hashed() const { return !keys.empty(); }
+
 private:
-	std::map<py_int, py_int> m; ///< std::map the mapping is stored in
+	py_int N;                   ///< Number of ids the map was made from
+	std::vector<py_int> last;   ///< Those ids, for update
+
+	// Dense storage:
+	py_int id_min;              ///< Id stored in dense[0]
+	std::vector<py_int> dense;  ///< Index of id_min + k, or -1
+
+	// Hash storage:
+	std::vector<py_int> keys;   ///< Ids, or EMPTY
+	std::vector<py_int> vals;   ///< Their indices
+	std::uint64_t mask;         ///< Table size minus one
+	int shift;                  ///< 64 minus log2 of the table size
+
+	static const py_int EMPTY;
+
+	void build( const py_int *ids, py_int N );
+
+	std::uint64_t slot( py_int id ) const
+	{
+		// Fibonacci hashing spreads consecutive ids over the table.
+		return ( static_cast<std::uint64_t>( id ) *
+		         UINT64_C( 0x9E3779B97F4A7C15 ) ) >> shift;
+	}
+
+	py_int find( py_int id ) const
+	{
+		for( std::uint64_t s = slot( id ); ; s = ( s + 1 ) & mask ){
+			if( keys[s] == id )    return vals[s];
+			if( keys[s] == EMPTY ) return -1;
+		}
+	}
+
+	void set( py_int id, py_int idx );
+	void erase( py_int id, py_int idx );
 };
 
 
@@ -0,0 +1,364 @@
+#include "kd_tree.h"
+#include "domain.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+
+kd_tree::kd_tree() : N(0), dims(3), periodic(PERIODIC_NONE)
+{
+	for( int d = 0; d < 3; ++d ){
+		box_lo[d] = L[d] = L_inv[d] = 0.0;
+		wrap[d] = false;
+	}
+}
+
+
+kd_tree::kd_tree( const arr3f &x, py_int N, py_int periodic,
+                  const py_float *xlo, const py_float *xhi, py_int dims )
+	: kd_tree()
+{
+	build( x, N, periodic, xlo, xhi, dims );
+}
+
+
+void kd_tree::build( const arr3f &x, py_int NN, py_int pperiodic,
+                     const py_float *xlo, const py_float *xhi, py_int ddims )
+{
+	N    = NN;
+	dims = ddims == 2 ? 2 : 3;
+	periodic = xlo && xhi ? pperiodic : PERIODIC_NONE;
+	for( int d = 0; d < 3; ++d ){
+		box_lo[d] = xlo ? xlo[d] : 0.0;
+		L[d]      = xlo && xhi ? xhi[d] - xlo[d] : 0.0;
+		wrap[d]   = ( periodic & ( 1 << d ) ) && L[d] > 0 && d < dims;
+		L_inv[d]  = wrap[d] ? 1.0 / L[d] : 0.0;
+	}
+
+	std::vector<py_float> xw( 3*N );
+	for( py_int i = 0; i < N; ++i ) wrap_point( x[i], &xw[3*i] );
+
+	idx_.resize( N );
+	for( py_int i = 0; i < N; ++i ) idx_[i] = i;
+
+	// The right child is never smaller than the left one, so the last
+	// node is found by always going right.
+	py_int last = 0;
+	for( py_int size = N; size > LEAF_SIZE; size -= size / 2 ){
+		last = 2*last + 2;
+	}
+	nodes.assign( N > 0 ? last + 1 : 0, node() );
+	if( N == 0 ){
+		pts.clear();
+		return;
+	}
+
+	// Split the top of the tree on this thread, until there are enough
+	// subtrees to give every thread a few, and build those in parallel.
+	const int n_threads = threads_for( N, 16384 );
+	int levels = 0;
+	while( ( 1 << levels ) < 4*n_threads && levels < 20 ) ++levels;
+	std::vector<py_int> tasks;
+	split_top( 0, 0, N, n_threads > 1 ? levels : 0, xw, tasks );
+
+	run_threads( n_threads, [&]( int t )
+	{
+		for( std::size_t s = t; 3*s < tasks.size(); s += n_threads ){
+			build_node( tasks[3*s], tasks[3*s+1], tasks[3*s+2], xw );
+		}
+	} );
+
+	pts.resize( 3*N );
+	for( py_int p = 0; p < N; ++p ){
+		std::copy( &xw[3*idx_[p]], &xw[3*idx_[p]] + 3, &pts[3*p] );
+	}
+}
+
+
+void kd_tree::wrap_point( const py_float *x, py_float *w ) const
+{
+	for( int d = 0; d < 3; ++d ){
+		w[d] = x[d];
+		if( wrap[d] ){
+			w[d] -= L[d] * std::floor( ( w[d] - box_lo[d] ) * L_inv[d] );
+		}
+	}
+}
+
+
+int kd_tree::widest( const node &nd ) const
+{
+	int dim = 0;
+	for( int d = 1; d < dims; ++d ){
+		if( nd.hi[d] - nd.lo[d] > nd.hi[dim] - nd.lo[dim] ) dim = d;
+	}
+	return dim;
+}
+
+
+py_int kd_tree::split_node( py_int n, py_int b, py_int e,
+                           const std::vector<py_float> &xw )
+{
+	node &nd = nodes[n];
+	nd.begin = b;
+	nd.end   = e;
+	for( int d = 0; d < 3; ++d ){
+		nd.lo[d] =  std::numeric_limits<py_float>::infinity();
+		nd.hi[d] = -std::numeric_limits<py_float>::infinity();
+	}
+	for( py_int p = b; p < e; ++p ){
+		for( int d = 0; d < 3; ++d ){
+			nd.lo[d] = std::min( nd.lo[d], xw[3*idx_[p]+d] );
+			nd.hi[d] = std::max( nd.hi[d], xw[3*idx_[p]+d] );
+		}
+	}
+	if( e - b <= LEAF_SIZE ) return -1;
+
+	const int dim = widest( nd );
+	const py_int mid = b + ( e - b ) / 2;
+	std::nth_element( idx_.begin() + b, idx_.begin() + mid, idx_.begin() + e,
+	                  [&]( py_int i, py_int j ){
+		                  return xw[3*i+dim] < xw[3*j+dim]; } );
+	return mid;
+}
+
+
+void kd_tree::split_top( py_int n, py_int b, py_int e, int levels,
+                         const std::vector<py_float> &xw,
+                         std::vector<py_int> &tasks )
+{
+	if( levels == 0 || e - b <= LEAF_SIZE ){
+		tasks.push_back( n );
+		tasks.push_back( b );
+		tasks.push_back( e );
+		return;
+	}
+	const py_int mid = split_node( n, b, e, xw );
+	split_top( 2*n + 1, b, mid, levels - 1, xw, tasks );
+	split_top( 2*n + 2, mid, e, levels - 1, xw, tasks );
+}
+
+
+void kd_tree::build_node( py_int n, py_int b, py_int e,
+                          const std::vector<py_float> &xw )
+{
+	const py_int mid = split_node( n, b, e, xw );
+	if( mid < 0 ) return;
+	build_node( 2*n + 1, b, mid, xw );
+	build_node( 2*n + 2, mid, e, xw );
+}
+
+
+py_float kd_tree::point_dist2( py_int p, const py_float *q, py_float *r ) const
+{
+	for( int d = 0; d < 3; ++d ){
+		r[d] = pts[3*p+d] - q[d];
+		if( wrap[d] ) r[d] -= L[d] * std::nearbyint( r[d] * L_inv[d] );
+	}
+	if( dims == 2 ) r[2] = 0.0;
+	return r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+}
+
+
+py_float kd_tree::box_dist2( const node &nd, const py_float *q ) const
+{
+	py_float s = 0.0;
+	for( int d = 0; d < dims; ++d ){
+		py_float t = 0.0;
+		if( q[d] < nd.lo[d] ){
+			t = nd.lo[d] - q[d];
+			// The image of q one box up is past the box of the node.
+			if( wrap[d] ) t = std::min( t, q[d] + L[d] - nd.hi[d] );
+		}else if( q[d] > nd.hi[d] ){
+			t = q[d] - nd.hi[d];
+			if( wrap[d] ) t = std::min( t, nd.lo[d] - q[d] + L[d] );
+		}
+		s += t*t;
+	}
+	return s;
+}
+
+
+void kd_tree::knn_node( py_int n, const py_float *q, py_int k, py_int skip,
+                        std::vector<match> &heap ) const
+{
+	const node &nd = nodes[n];
+	if( nd.end - nd.begin <= LEAF_SIZE ){
+		for( py_int p = nd.begin; p < nd.end; ++p ){
+			if( idx_[p] == skip ) continue;
+			py_float r[3];
+			match m( point_dist2( p, q, r ), idx_[p] );
+			if( static_cast<py_int>( heap.size() ) < k ){
+				heap.push_back( m );
+				std::push_heap( heap.begin(), heap.end() );
+			}else if( m < heap.front() ){
+				std::pop_heap( heap.begin(), heap.end() );
+				heap.back() = m;
+				std::push_heap( heap.begin(), heap.end() );
+			}
+		}
+		return;
+	}
+
+	py_int c[2] = { 2*n + 1, 2*n + 2 };
+	py_float cd[2] = { box_dist2( nodes[c[0]], q ), box_dist2( nodes[c[1]], q ) };
+	if( cd[1] < cd[0] ){
+		std::swap( c[0], c[1] );
+		std::swap( cd[0], cd[1] );
+	}
+	for( int s = 0; s < 2; ++s ){
+		if( static_cast<py_int>( heap.size() ) == k &&
+		    cd[s] > heap.front().first ){
+			break;
+		}
+		knn_node( c[s], q, k, skip, heap );
+	}
+}
+
+
+py_int kd_tree::knn( const py_float *q, py_int k, py_int *idx, py_float *r2,
+                     py_int skip ) const
+{
+	if( N == 0 || k <= 0 ) return 0;
+
+	py_float qw[3];
+	wrap_point( q, qw );
+	std::vector<match> heap;
+	heap.reserve( k );
+	knn_node( 0, qw, k, skip, heap );
+
+	// Ties are broken by index, so the result does not depend on the
+	// shape of the tree.
+	std::sort_heap( heap.begin(), heap.end() );
+	for( std::size_t m = 0; m < heap.size(); ++m ){
+		idx[m] = heap[m].second;
+		r2[m]  = heap[m].first;
+	}
+	return heap.size();
+}
+
+
+void kd_tree::knn( const arr3f &q, py_int M, py_int k, py_int *idx,
+                   py_float *r2, bool skip_self ) const
+{
+	const int n_threads = threads_for( M*std::max<py_int>( k, 1 ), 4096 );
+	run_threads( n_threads, [&]( int t )
+	{
+		for( py_int i = M*t / n_threads; i < M*(t+1) / n_threads; ++i ){
+			py_int found = knn( q[i], k, idx + k*i, r2 + k*i,
+			                    skip_self ? i : -1 );
+			for( py_int m = found; m < k; ++m ){
+				idx[k*i+m] = -1;
+				r2[k*i+m]  = std::numeric_limits<py_float>::infinity();
+			}
+		}
+	} );
+}
+
+
+void kd_tree::radius_node( py_int n, const py_float *q, py_float rr2,
+                           py_int skip, py_int row, neighbor_list *out,
+                           std::vector<py_int> *idx,
+                           std::vector<py_float> *r2 ) const
+{
+	const node &nd = nodes[n];
+	if( box_dist2( nd, q ) > rr2 ) return;
+
+	if( nd.end - nd.begin > LEAF_SIZE ){
+		radius_node( 2*n + 1, q, rr2, skip, row, out, idx, r2 );
+		radius_node( 2*n + 2, q, rr2, skip, row, out, idx, r2 );
+		return;
+	}
+	for( py_int p = nd.begin; p < nd.end; ++p ){
+		if( idx_[p] == skip ) continue;
+		py_float r[3];
+		py_float d2 = point_dist2( p, q, r );
+		if( d2 > rr2 ) continue;
+		if( out ){
+			out->add( row, idx_[p], std::sqrt( d2 ), r );
+		}else{
+			idx->push_back( idx_[p] );
+			if( r2 ) r2->push_back( d2 );
+		}
+	}
+}
+
+
+void kd_tree::radius( const py_float *q, py_float r, std::vector<py_int> &idx,
+                      std::vector<py_float> *r2, py_int skip ) const
+{
+	if( N == 0 ) return;
+	py_float qw[3];
+	wrap_point( q, qw );
+	radius_node( 0, qw, r*r, skip, 0, nullptr, &idx, r2 );
+}
+
+
+void kd_tree::radius( const arr3f &q, py_int M, py_float r, neighbor_list &out,
+                      bool skip_self, int extras ) const
+{
+	// As for the neighbor lists, every thread fills its own part.
+	const int n_threads = N > 0 ? threads_for( M, 1024 ) : 1;
+	std::vector<neighbor_list> parts( n_threads - 1 );
+	out.reset( M, extras );
+	for( neighbor_list &p : parts ) p.reset( M, extras );
+
+	if( N > 0 ){
+		run_threads( n_threads, [&]( int t )
+		{
+			neighbor_list &o = t == 0 ? out : parts[t-1];
+			for( py_int i = M*t / n_threads; i < M*(t+1) / n_threads; ++i ){
+				py_float qw[3];
+				wrap_point( q[i], qw );
+				radius_node( 0, qw, r*r, skip_self ? i : -1, i, &o,
+				             nullptr, nullptr );
+			}
+		} );
+	}
+	out.finalize( parts );
+}
+
+
+
+extern "C" {
+
+kd_tree *get_kd_tree_handle( void *x, py_int N, py_int periodic,
+                             py_float *xlo, py_float *xhi, py_int dims )
+{
+	if( !x && N > 0 ){
+		std::cerr << "Error! x was NULL!\n";
+		return nullptr;
+	}
+	arr3f xx( x, N );
+	return new kd_tree( xx, N, periodic, xlo, xhi, dims );
+}
+
+
+void release_kd_tree_handle( kd_tree *tree )
+{
+	delete tree;
+}
+
+
+void kd_tree_knn( kd_tree *tree, void *q, py_int M, py_int k,
+                  py_int skip_self, py_int *idx, py_float *dist )
+{
+	arr3f qq( q, M );
+	tree->knn( qq, M, k, idx, dist, skip_self );
+	for( py_int m = 0; m < M*k; ++m ) dist[m] = std::sqrt( dist[m] );
+}
+
+
+neighbor_buffer *kd_tree_radius( kd_tree *tree, void *q, py_int M,
+                                 py_float r, py_int skip_self )
+{
+	arr3f qq( q, M );
+	neighbor_list out;
+	tree->radius( qq, M, r, out, skip_self, neighbor_list::INDICES_ONLY );
+	return make_neighbor_buffer( out, nullptr );
+}
+
+} // extern "C"
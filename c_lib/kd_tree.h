@@ -0,0 +1,172 @@
+#ifndef KD_TREE_H
+#define KD_TREE_H
+
+/*!
+  \file kd_tree.h
+  @brief A k-d tree for nearest neighbor and radius queries, in periodic
+         boxes too.
+
+  \ingroup cpp_lib
+*/
+
+#include "types.h"
+#include "neighbor_list.h"
+#include "neighborize.h"
+
+#include <utility>
+#include <vector>
+
+
+/*! @brief A k-d tree over a set of points, for finding the k nearest
+           points, or all points within some distance, of query points.
+
+  The tree splits the points at the median along the direction in which
+  they spread most, until at most LEAF_SIZE are left. Because the splits
+  are at the median, the shape of the tree only depends on the number
+  of points, so its nodes are stored in one array with the children of
+  node n at 2n+1 and 2n+2, and subtrees are built on several threads.
+
+  Distances along the periodic directions in \p periodic (see
+  PERIODICITIES in domain.h) are minimum-image distances, so every
+  point is found at most once, at its nearest image. Points and queries
+  outside the box are wrapped back in along those directions.
+
+  Queries return squared distances, which are what the tree compares.
+  Batched queries run on get_n_threads() threads.
+
+  \ingroup cpp_lib
+*/
+class kd_tree {
+public:
+	enum { LEAF_SIZE = 8 };
+
+	kd_tree();
+
+	/**
+	   Builds the tree over the \p N points in \p x. If \p xlo or \p xhi
+	   is nullptr, nothing is periodic. If \p dims is 2, z is ignored.
+	*/
+	kd_tree( const arr3f &x, py_int N, py_int periodic = 0,
+	         const py_float *xlo = nullptr, const py_float *xhi = nullptr,
+	         py_int dims = 3 );
+
+	/// Builds the tree again, see the constructor.
+	void build( const arr3f &x, py_int N, py_int periodic = 0,
+	            const py_float *xlo = nullptr, const py_float *xhi = nullptr,
+	            py_int dims = 3 );
+
+	/// Number of points in the tree
+	py_int size() const { return N; }
+
+	/**
+	   Finds the \p k points nearest to \p q, apart from point \p skip
+	   if it is not -1. Stores their indices in \p idx and their
+	   squared distances in \p r2, nearest first, and returns how many
+	   were found, which is less than k only if the tree has fewer
+	   points.
+	*/
+	py_int knn( const py_float *q, py_int k, py_int *idx, py_float *r2,
+	            py_int skip = -1 ) const;
+
+	/**
+	   Finds the \p k nearest points for each of the \p M queries in
+	   \p q. The results of query i are in idx[k*i] up to idx[k*(i+1)]
+	   and likewise in r2. Where fewer than k are found, the rest of
+	   idx is -1 and of r2 infinity. If \p skip_self, the queries are
+	   the points of the tree and query i does not find point i itself.
+	*/
+	void knn( const arr3f &q, py_int M, py_int k, py_int *idx,
+	          py_float *r2, bool skip_self = false ) const;
+
+	/**
+	   Appends the indices of all points within distance \p r of \p q,
+	   apart from point \p skip, to \p idx, and their squared distances
+	   to \p r2 if it is not nullptr. The order is not defined.
+	*/
+	void radius( const py_float *q, py_float r, std::vector<py_int> &idx,
+	             std::vector<py_float> *r2 = nullptr,
+	             py_int skip = -1 ) const;
+
+	/**
+	   Stores all points within distance \p r of each of the \p M
+	   queries in \p q in \p out, with row i for query i. \p extras
+	   says what else \p out stores, see neighbor_list::extras. The
+	   displacements are from the query to the point. For skip_self,
+	   see knn.
+	*/
+	void radius( const arr3f &q, py_int M, py_float r, neighbor_list &out,
+	             bool skip_self = false,
+	             int extras = neighbor_list::DISTANCES ) const;
+
+private:
+	struct node {
+		py_float lo[3], hi[3];  ///< Bounding box of the points
+		py_int begin, end;      ///< Range of the points in pts
+	};
+
+	py_int N, dims, periodic;
+	py_float box_lo[3], L[3], L_inv[3];
+	bool wrap[3];
+
+	std::vector<node> nodes;
+	std::vector<py_float> pts;  ///< Points in tree order, wrapped
+	std::vector<py_int> idx_;   ///< Their indices
+
+	typedef std::pair<py_float, py_int> match;
+
+	void wrap_point( const py_float *x, py_float *w ) const;
+	void build_node( py_int n, py_int b, py_int e,
+	                 const std::vector<py_float> &xw );
+	void split_top( py_int n, py_int b, py_int e, int levels,
+	                const std::vector<py_float> &xw,
+	                std::vector<py_int> &tasks );
+	py_int split_node( py_int n, py_int b, py_int e,
+	                   const std::vector<py_float> &xw );
+	int widest( const node &nd ) const;
+
+	py_float point_dist2( py_int p, const py_float *q, py_float *r ) const;
+	py_float box_dist2( const node &nd, const py_float *q ) const;
+
+	void knn_node( py_int n, const py_float *q, py_int k, py_int skip,
+	               std::vector<match> &heap ) const;
+	void radius_node( py_int n, const py_float *q, py_float rr2,
+	                  py_int skip, py_int row, neighbor_list *out,
+	                  std::vector<py_int> *idx,
+	                  std::vector<py_float> *r2 ) const;
+};
+
+
+extern "C" {
+
+/**
+   Returns a new kd_tree over the \p N points in \p x, see
+   kd_tree::kd_tree. Free it with release_kd_tree_handle.
+*/
+kd_tree *get_kd_tree_handle( void *x, py_int N, py_int periodic,
+                             py_float *xlo, py_float *xhi, py_int dims );
+
+/// Frees a kd_tree made by get_kd_tree_handle.
+void release_kd_tree_handle( kd_tree *tree );
+
+/**
+   Finds the \p k nearest points in \p tree of each of the \p M points
+   in \p q, see kd_tree::knn. \p idx and \p dist need room for M*k
+   values. Unlike in kd_tree::knn, dist gets distances, not squared
+   distances.
+*/
+void kd_tree_knn( kd_tree *tree, void *q, py_int M, py_int k,
+                  py_int skip_self, py_int *idx, py_float *dist );
+
+/**
+   Finds all points in \p tree within distance \p r of each of the
+   \p M points in \p q, and returns them in a buffer with one row per
+   query, as indices into the points of the tree. Release the buffer
+   with release_neighbor_buffer.
+*/
+neighbor_buffer *kd_tree_radius( kd_tree *tree, void *q, py_int M,
+                                 py_float r, py_int skip_self );
+
+}
+
+
+#endif /* KD_TREE_H */
@@ -0,0 +1,339 @@
+#include "lammps_frame_parser.h"
+#include "fast_parse.h"
+#include "domain.h"
+#include "util.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace fast_parse;
+
+lammps_frame_parser::lammps_frame_parser()
+	: atom_style( atom_styles::ATOMIC ), scaled( 0 ), parsed( 0 )
+{}
+
+
+void lammps_frame_parser::select_columns( const std::vector<std::string> &columns )
+{
+	selection = columns;
+	// Make the next ATOMS header set up the roles again.
+	atoms_line.clear();
+}
+
+
+int lammps_frame_parser::next_frame( const char *&p, const char *end,
+                                     block_data &block )
+{
+	int status = next_frame_meta( p, end, block );
+	if( status ) return status;
+
+	return next_frame_body( p, end, block );
+}
+
+
+int lammps_frame_parser::next_frame_meta( const char *&p, const char *end,
+                                          block_data &block )
+{
+	py_int N = -1;
+	int status = read_header( p, end, block, N );
+	if( status ) return status;
+
+	// Does not reallocate if the block is large enough already.
+	block.resize( N );
+	block.atom_style = atom_style;
+	return 0;
+}
+
+
+int lammps_frame_parser::next_frame_header( const char *&p, const char *end,
+                                            block_data &meta )
+{
+	py_int N = -1;
+	int status = read_header( p, end, meta, N );
+	if( status ) return status;
+
+	meta.N = N;
+	meta.atom_style = atom_style;
+	return 0;
+}
+
+
+int lammps_frame_parser::skip_frame( const char *&p, const char *end,
+                                     block_data &meta )
+{
+	int status = next_frame_header( p, end, meta );
+	if( status ) return status;
+
+	if( meta.N > 0 ){
+		const char *q = skip_lines( p, end, meta.N - 1 );
+		if( q == end ){
+			// Fewer than N atom lines.
+			return -1;
+		}
+		p = next_line( q, end );
+	}
+	return 0;
+}
+
+
+int lammps_frame_parser::read_header( const char *&p, const char *end,
+                                      block_data &block, py_int &N )
+{
+	// Skip trailing empty lines so that a final newline is not
+	// mistaken for another frame.
+	while( p < end && ( *p == '\n' || is_blank( *p ) ) ) ++p;
+	if( p == end ) return 1;
+
+	bool ok = true;
+	N = -1;
+	while( p < end ){
+		const char *eol = find_eol( p, end );
+		if( eol == end ){
+			// Header lines are always followed by something.
+			return -1;
+		}
+		if( starts_with( p, eol, "ITEM: TIMESTEP" ) ){
+			p = parse_int( eol + 1, end, block.tstep, ok );
+			p = next_line( p, end );
+		}else if( starts_with( p, eol, "ITEM: NUMBER OF ATOMS" ) ){
+			p = parse_int( eol + 1, end, N, ok );
+			p = next_line( p, end );
+		}else if( starts_with( p, eol, "ITEM: BOX BOUNDS" ) ){
+			block.boxline.assign( p, eol );
+			if( !block.boxline.empty() && block.boxline.back() == '\r' ){
+				block.boxline.pop_back();
+			}
+
+			// The last three words are the boundary flags, the
+			// words before them (xy xz yz) mark triclinic boxes.
+			std::vector<std::string> words = split( block.boxline );
+			block.periodic = PERIODIC_NONE;
+			if( words.size() >= 6 ){
+				std::size_t w0 = words.size() - 3;
+				if( words[w0]   == "pp" ) block.periodic |= PERIODIC_X;
+				if( words[w0+1] == "pp" ) block.periodic |= PERIODIC_Y;
+				if( words[w0+2] == "pp" ) block.periodic |= PERIODIC_Z;
+			}
+
+			p = eol + 1;
+			for( int d = 0; d < 3; ++d ){
+				p = parse_float( p, end, block.xlo[d], ok );
+				p = parse_float( p, end, block.xhi[d], ok );
+				p = next_line( p, end );
+			}
+		}else if( starts_with( p, eol, "ITEM: UNITS" ) ||
+		          starts_with( p, eol, "ITEM: TIME" ) ){
+			// Written by newer LAMMPS versions, not stored.
+			p = next_line( eol + 1, end );
+		}else if( starts_with( p, eol, "ITEM: ATOMS" ) ){
+			if( !ok || N < 0 ){
+				std::cerr << "Malformed header in dump frame!\n";
+				return -1;
+			}
+			if( atoms_line.compare( 0, std::string::npos,
+			                        p, eol - p ) != 0 ){
+				if( set_columns( p, eol ) ) return -1;
+			}
+			p = eol + 1;
+			return 0;
+		}else{
+			std::cerr << "Encountered line '"
+			          << std::string( p, eol )
+			          << "' and have no clue what to do!\n";
+			return -1;
+		}
+	}
+	return -1;
+}
+
+
+int lammps_frame_parser::next_frame_body( const char *&p, const char *end,
+                                          block_data &block )
+{
+	const py_int N = block.N;
+	const std::size_t n_cols = roles.size();
+
+	block.other_cols.resize( other_headers.size() );
+	for( std::size_t k = 0; k < other_headers.size(); ++k ){
+		block.other_cols[k].header = other_headers[k];
+		block.other_cols[k].resize( N );
+	}
+
+	// Arrays of columns that are not parsed are zeroed.
+	if( !( parsed & ( 1 << COL_ID ) ) )   std::fill( block.ids, block.ids + N, 0 );
+	if( !( parsed & ( 1 << COL_TYPE ) ) ) std::fill( block.types, block.types + N, 0 );
+	if( !( parsed & ( 1 << COL_X ) ) || !( parsed & ( 1 << COL_Y ) ) ||
+	    !( parsed & ( 1 << COL_Z ) ) ){
+		std::fill( block.x_, block.x_ + 3*N, 0.0 );
+	}
+
+	bool ok = true;
+	const int *role = roles.data();
+	for( py_int i = 0; i < N; ++i ){
+		if( p >= end ){
+			std::cerr << "Dump frame at t = " << block.tstep
+			          << " is incomplete!\n";
+			return -1;
+		}
+		py_float *xi = block.x_ + 3*i;
+		for( std::size_t c = 0; c < n_cols; ++c ){
+			switch( role[c] ){
+				case COL_ID:
+					p = parse_int( p, end, block.ids[i], ok );
+					break;
+				case COL_TYPE:
+					p = parse_int( p, end, block.types[i], ok );
+					break;
+				case COL_MOL:
+					p = parse_int( p, end, block.mol[i], ok );
+					break;
+				case COL_X:
+					p = parse_float( p, end, xi[0], ok );
+					break;
+				case COL_Y:
+					p = parse_float( p, end, xi[1], ok );
+					break;
+				case COL_Z:
+					p = parse_float( p, end, xi[2], ok );
+					break;
+				case COL_SKIP:
+					p = skip_token( p, end );
+					break;
+				default:
+					p = parse_float( p, end,
+					                 block.other_cols[other_idx[c]].data[i],
+					                 ok );
+					break;
+			}
+		}
+		p = next_line( p, end );
+		if( !ok ){
+			std::cerr << "Failed to parse atom line " << i
+			          << " of dump frame at t = " << block.tstep
+			          << "!\n";
+			return -1;
+		}
+	}
+
+	if( scaled ){
+		for( int d = 0; d < 3; ++d ){
+			if( !( scaled & (1 << d) ) ) continue;
+			double L = block.xhi[d] - block.xlo[d];
+			for( py_int i = 0; i < N; ++i ){
+				block.x_[3*i+d] = block.xlo[d] + L*block.x_[3*i+d];
+			}
+		}
+	}
+
+	return 0;
+}
+
+
+namespace {
+
+// True if selected column c is column w, which has given role.
+bool column_matches( const std::string &c, const std::string &w, int role )
+{
+	// Names that select any variant of the core columns, in the
+	// order of lammps_frame_parser::column_roles.
+	static const char *names[] = { "", "id", "type", "mol", "x", "y", "z" };
+	return c == w || ( role > 0 && role < 7 && c == names[role] );
+}
+
+}
+
+bool lammps_frame_parser::is_selected( const std::string &w, int role ) const
+{
+	if( selection.empty() ) return true;
+	for( const std::string &c : selection ){
+		if( column_matches( c, w, role ) ) return true;
+	}
+	return false;
+}
+
+
+int lammps_frame_parser::set_columns( const char *p, const char *eol )
+{
+	atoms_line.assign( p, eol );
+	roles.clear();
+	other_idx.clear();
+	other_headers.clear();
+	scaled = 0;
+	parsed = 0;
+	atom_style = atom_styles::ATOMIC;
+
+	std::vector<std::string> words = split( atoms_line.substr( 11 ) );
+	if( words.empty() ){
+		// Plain dump atom, columns are fixed.
+		words = { "id", "type", "xs", "ys", "zs" };
+	}
+
+	bool have[COL_SKIP] = { false, false, false, false, false, false, false };
+	std::vector<bool> found( selection.size(), false );
+	for( const std::string &w : words ){
+		int r = COL_OTHER;
+		if( w == "id" ){
+			r = COL_ID;
+		}else if( w == "type" ){
+			r = COL_TYPE;
+		}else if( w == "mol" ){
+			r = COL_MOL;
+		}else if( w == "x" || w == "xu" || w == "xs" || w == "xsu" ){
+			r = COL_X;
+		}else if( w == "y" || w == "yu" || w == "ys" || w == "ysu" ){
+			r = COL_Y;
+		}else if( w == "z" || w == "zu" || w == "zs" || w == "zsu" ){
+			r = COL_Z;
+		}
+
+		// If a quantity appears twice (e.g. x and xu), only the
+		// first one is used, the others end up in other_cols.
+		if( r != COL_OTHER && have[r] ) r = COL_OTHER;
+		have[r] = true;
+
+		if( is_selected( w, r ) ){
+			for( std::size_t k = 0; k < selection.size(); ++k ){
+				if( column_matches( selection[k], w, r ) ){
+					found[k] = true;
+				}
+			}
+			if( r >= COL_X && w.size() > 1 && w[1] == 's' ){
+				scaled |= 1 << ( r - COL_X );
+			}
+		}else{
+			r = COL_SKIP;
+		}
+		parsed |= 1 << r;
+
+		roles.push_back( r );
+		if( r == COL_OTHER ){
+			other_idx.push_back( other_headers.size() );
+			other_headers.push_back( w );
+		}else{
+			other_idx.push_back( -1 );
+		}
+	}
+
+	bool ok = true;
+	if( selection.empty() ){
+		ok = have[COL_ID] && have[COL_TYPE] && have[COL_X] &&
+			have[COL_Y] && have[COL_Z];
+	}else{
+		for( std::size_t k = 0; k < selection.size(); ++k ){
+			if( !found[k] ){
+				std::cerr << "Selected column " << selection[k]
+				          << " is not in the dump!\n";
+				ok = false;
+			}
+		}
+	}
+	if( !ok ){
+		std::cerr << "Column mapping failed for header '"
+		          << atoms_line << "'!\n";
+		atoms_line.clear();
+		return -1;
+	}
+	if( parsed & ( 1 << COL_MOL ) ) atom_style = atom_styles::MOLECULAR;
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+#ifndef LAMMPS_FRAME_PARSER_H
+#define LAMMPS_FRAME_PARSER_H
+
+/*!
+  \file lammps_frame_parser.h
+  @brief Parses LAMMPS text dump frames straight from a char buffer.
+
+  \ingroup cpp_lib
+*/
+
+#include "block_data.h"
+
+#include <string>
+#include <vector>
+
+
+/*!
+  @brief Parses frames of a LAMMPS text dump that are in memory.
+
+  Unlike dump_interpreter_lammps, this does not go through std::string
+  or std::stringstream per line. Every atom line is tokenized in place
+  and the numbers are written straight into the block_data arrays.
+  The buffer can be anything, typically it is a memory-mapped file.
+
+  The parser only remembers the column layout of the last ATOMS header
+  it saw, so copies of it can be used to parse different frames of the
+  same file concurrently.
+
+  \ingroup cpp_lib
+*/
+class lammps_frame_parser
+{
+public:
+	lammps_frame_parser();
+
+	/**
+	   Parses the frame that starts at \p p.
+
+	   \param p     Start of the frame. On success it is moved to
+	                the start of the next frame.
+	   \param end   End of the buffer.
+	   \param block The block_data to store the frame in.
+
+	   \returns 0 on success, 1 if there was no frame left, and
+	            negative if the frame was malformed or incomplete.
+	*/
+	int next_frame( const char *&p, const char *end, block_data &block );
+
+	/**
+	   Parses only the ITEM headers of the frame at \p p and stores
+	   them in \p block. Leaves \p p at the first atom line.
+	*/
+	int next_frame_meta( const char *&p, const char *end, block_data &block );
+
+	/**
+	   Parses the atom lines of a frame whose meta was just read into
+	   \p block by next_frame_meta.
+	*/
+	int next_frame_body( const char *&p, const char *end, block_data &block );
+
+	/**
+	   Like next_frame_meta, but only sets the N of \p meta and does
+	   not resize its arrays. Leaves \p p at the first atom line, so
+	   the caller can jump over meta.N lines to skip the frame.
+	*/
+	int next_frame_header( const char *&p, const char *end,
+	                       block_data &meta );
+
+	/**
+	   Reads only the ITEM headers of the frame at \p p into \p meta
+	   and moves \p p past the frame without parsing any atom lines.
+	   Like after next_frame_meta, \p meta only holds meta info
+	   afterwards: its N is set but its arrays are untouched.
+
+	   \returns 0 on success, 1 if there was no frame left, and
+	            negative if the frame was malformed or incomplete.
+	*/
+	int skip_frame( const char *&p, const char *end, block_data &meta );
+
+	/**
+	   Makes the parser convert only the given columns of the atom
+	   lines and skip over the others. Columns are named as in the
+	   ATOMS header, and id, type, mol, x, y and z also select the
+	   other variants of the column (e.g. x selects xs or xu). Arrays
+	   of the block whose columns are not selected are zeroed. An empty
+	   selection parses all columns.
+	*/
+	void select_columns( const std::vector<std::string> &columns );
+
+private:
+	/// What to do with each column in the ATOMS section.
+	enum column_roles {
+		COL_OTHER = 0,
+		COL_ID,
+		COL_TYPE,
+		COL_MOL,
+		COL_X,
+		COL_Y,
+		COL_Z,
+		COL_SKIP      ///< Not selected, not converted
+	};
+
+	std::vector<int> roles;      //!< Role of each column.
+	std::vector<int> other_idx;  //!< Index into other_cols for COL_OTHER.
+	std::vector<std::string> other_headers;
+	std::string atoms_line;      //!< Header line the roles were set from.
+	std::vector<std::string> selection; //!< Columns to parse, empty for all
+	int atom_style;
+	int scaled;
+	int parsed;                  //!< Bit (1 << role) set if role is parsed
+
+	bool is_selected( const std::string &w, int role ) const;
+
+	int set_columns( const char *p, const char *eol );
+	int read_header( const char *&p, const char *end,
+	                 block_data &meta, py_int &N );
+};
+
+
+#endif // LAMMPS_FRAME_PARSER_H
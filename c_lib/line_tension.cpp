@@ -3,13 +3,13 @@
 #include "neighborize.h"
 
 double estimate_line_tension( const block_data &edge_block,
-                              const std::vector<std::list<py_int> > &neighs,
+                              const neighbor_list &neighs,
                               std::size_t nn_expect, double F_per_particle )
 {
 	double avg_gamma = 0.0;
 	double count = 0.0;
 	for( py_int i = 0; i < edge_block.N; ++i ){
-		int nn = neighs[i].size();
+		int nn = neighs.degree(i);
 		if( nn == 0 ) continue;
 		
 		int deficit = nn_expect - nn;
@@ -48,7 +48,7 @@ py_float get_line_tension( void *x, py_int N, py_int *ids,
 	block_data b;
 	block_data_from_foreign( x, N, ids, types, nullptr, periodic, xlo, xhi, dims,
 	                         tstep, boxline, b );
-	std::vector<std::list<py_int> > neighs;
+	neighbor_list neighs;
 	neighborize_block( b, neighs );
 	py_float gamma = estimate_line_tension( b, neighs,
 	                                        nn_expect,
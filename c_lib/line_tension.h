@@ -2,9 +2,9 @@
 #define LINE_TENSION_H
 
 #include "types.h"
+#include "neighbor_list.h"
 
 #include <vector>
-#include <list>
 
 extern "C" {
 py_float get_line_tension( void *x, py_int N, py_int *ids,
@@ -15,8 +15,8 @@ py_float get_line_tension( void *x, py_int N, py_int *ids,
 }
 
 double estimate_line_tension( const class block_data &edge_block,
-                              const std::vector<std::list<py_int> > &neighs,
-                              double F_per_particle );
+                              const neighbor_list &neighs,
+                              std::size_t nn_expect, double F_per_particle );
 
 
 
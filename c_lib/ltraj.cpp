@@ -0,0 +1,266 @@
+#include "ltraj.h"
+#include "ltraj_codec.h"
+#include "dump_reader.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef HAVE_LIB_ZSTD
+#include <zstd.h>
+#endif
+
+
+namespace {
+
+const char file_magic[8]  = { 'L', 'T', 'R', 'A', 'J', '\0', '\0', '\0' };
+
+// Round n up to the next multiple of the alignment.
+py_int aligned( py_int n )
+{
+	return ( n + ltraj_alignment - 1 ) / ltraj_alignment * ltraj_alignment;
+}
+
+// A column of a block_data before it is written.
+struct raw_column
+{
+	const char *name;
+	int dtype;
+	py_int width;
+	const void *data;
+};
+
+} // namespace
+
+
+const ltraj_column_view *ltraj_frame_view::column( const std::string &name ) const
+{
+	for( const ltraj_column_view &c : columns ){
+		if( c.name == name ) return &c;
+	}
+	return nullptr;
+}
+
+
+
+ltraj_writer::ltraj_writer( const std::string &fname, int codec, int level,
+                            py_float precision )
+	: out( nullptr ), codec( codec ), level( level ), precision( precision ),
+	  good_( false ), offset( 0 ), cctx( nullptr )
+{
+	if( codec != LTRAJ_CODEC_NONE && codec != LTRAJ_CODEC_ZSTD ){
+		std::cerr << "Unknown ltraj codec " << codec << ", writing "
+		          << "uncompressed columns.\n";
+		this->codec = LTRAJ_CODEC_NONE;
+	}
+#ifdef HAVE_LIB_ZSTD
+	if( this->codec == LTRAJ_CODEC_ZSTD || precision > 0 ){
+		cctx = ZSTD_createCCtx();
+	}
+#else
+	if( codec == LTRAJ_CODEC_ZSTD ){
+		std::cerr << "ltraj zstd compression needs zstd, only "
+		          << "delta-coding integer columns.\n";
+	}
+#endif
+
+	out = std::fopen( fname.c_str(), "wb" );
+	if( !out ){
+		std::cerr << "Could not open " << fname << " for writing!\n";
+		return;
+	}
+	good_ = std::fwrite( file_magic, sizeof(file_magic), 1, out ) == 1 &&
+		std::fwrite( &ltraj_version, sizeof(ltraj_version), 1, out ) == 1;
+	offset = sizeof(file_magic) + sizeof(ltraj_version);
+	good_ = good_ && write_padding( aligned( offset ) - offset );
+}
+
+
+ltraj_writer::~ltraj_writer()
+{
+	close();
+#ifdef HAVE_LIB_ZSTD
+	if( cctx ) ZSTD_freeCCtx( cctx );
+#endif
+}
+
+
+bool ltraj_writer::write_padding( py_int n )
+{
+	static const char zeros[ltraj_alignment] = {};
+	offset += n;
+	return n == 0 || std::fwrite( zeros, 1, n, out ) ==
+		static_cast<std::size_t>( n );
+}
+
+
+bool ltraj_writer::write( const block_data &b )
+{
+	if( !good_ ) return false;
+
+	std::vector<raw_column> raw;
+	raw.push_back( { "id",   LTRAJ_INT64,   1, b.ids } );
+	raw.push_back( { "type", LTRAJ_INT64,   1, b.types } );
+	if( b.atom_style == atom_styles::MOLECULAR && b.mol ){
+		raw.push_back( { "mol", LTRAJ_INT64, 1, b.mol } );
+	}
+	raw.push_back( { "x",    LTRAJ_FLOAT64, 3, b.x_ } );
+	for( const dump_col &c : b.other_cols ){
+		if( static_cast<py_int>( c.data.size() ) < b.N ){
+			std::cerr << "Column " << c.header << " has fewer "
+			          << "values than atoms!\n";
+			return false;
+		}
+		raw.push_back( { c.header.c_str(), LTRAJ_FLOAT64, 1,
+		                 c.data.data() } );
+	}
+
+	std::size_t n_cols = raw.size();
+	std::vector<ltraj_column> cols( n_cols );
+	cbuffers.resize( n_cols );
+
+	// Column data comes after the header and column table.
+	py_int pos = aligned( sizeof(ltraj_frame_header) +
+	                      n_cols * sizeof(ltraj_column) );
+	for( std::size_t i = 0; i < n_cols; ++i ){
+		ltraj_column &c = cols[i];
+		std::memset( &c, 0, sizeof(c) );
+		if( std::strlen( raw[i].name ) >= sizeof(c.name) ){
+			std::cerr << "Column name " << raw[i].name
+			          << " is too long for ltraj!\n";
+			return false;
+		}
+		std::strcpy( c.name, raw[i].name );
+		c.dtype  = raw[i].dtype;
+		c.codec  = LTRAJ_CODEC_NONE;
+		c.width  = raw[i].width;
+		c.offset = pos;
+		c.stored_size = b.N * raw[i].width * 8;
+
+		int col_codec = LTRAJ_CODEC_NONE;
+		if( precision > 0 && std::strcmp( c.name, "x" ) == 0 ){
+			col_codec = LTRAJ_CODEC_QUANT;
+		}else if( c.dtype == LTRAJ_INT64 &&
+		          ( codec == LTRAJ_CODEC_ZSTD || precision > 0 ) ){
+			col_codec = LTRAJ_CODEC_DELTA;
+		}else if( codec == LTRAJ_CODEC_ZSTD ){
+			col_codec = LTRAJ_CODEC_ZSTD;
+		}
+		std::vector<char> &cb = cbuffers[i];
+		py_int csize = -1;
+		if( c.stored_size == 0 ){
+			// Nothing to compress.
+		}else if( col_codec == LTRAJ_CODEC_DELTA ||
+		          col_codec == LTRAJ_CODEC_QUANT ){
+			if( ltraj_encode_column( col_codec, raw[i].data, b.N,
+			                         c.width, precision, cctx,
+			                         level, cb ) ){
+				csize = cb.size();
+			}else if( col_codec == LTRAJ_CODEC_QUANT ){
+				std::cerr << "Cannot quantize positions of frame "
+				          << b.tstep << ", storing them as they "
+				          << "are.\n";
+			}
+		}else if( col_codec == LTRAJ_CODEC_ZSTD ){
+#ifdef HAVE_LIB_ZSTD
+			cb.resize( ZSTD_compressBound( c.stored_size ) );
+			std::size_t n = ZSTD_compressCCtx( cctx, cb.data(),
+			                                   cb.size(), raw[i].data,
+			                                   c.stored_size, level );
+			if( !ZSTD_isError( n ) ) csize = n;
+#endif
+		}
+		// Keep columns that do not shrink uncompressed.
+		if( csize >= 0 && csize < c.stored_size ){
+			c.codec = col_codec;
+			c.stored_size = csize;
+		}
+		pos = aligned( pos + c.stored_size );
+	}
+
+	ltraj_frame_header h;
+	std::memset( &h, 0, sizeof(h) );
+	std::memcpy( h.magic, "LTFRAME", 8 );
+	h.frame_size = pos;
+	h.tstep      = b.tstep;
+	h.N          = b.N;
+	std::copy( b.xlo, b.xlo + 3, h.xlo );
+	std::copy( b.xhi, b.xhi + 3, h.xhi );
+	h.periodic   = b.periodic;
+	h.atom_style = b.atom_style;
+	h.n_columns  = n_cols;
+	std::strncpy( h.boxline, b.boxline.c_str(), sizeof(h.boxline) - 1 );
+
+	py_int frame_start = offset;
+	bool ok = std::fwrite( &h, sizeof(h), 1, out ) == 1 &&
+		std::fwrite( cols.data(), sizeof(ltraj_column), n_cols, out ) ==
+		n_cols;
+	offset += sizeof(h) + n_cols * sizeof(ltraj_column);
+
+	for( std::size_t i = 0; ok && i < n_cols; ++i ){
+		const ltraj_column &c = cols[i];
+		ok = write_padding( frame_start + c.offset - offset );
+		const void *data = c.codec == LTRAJ_CODEC_NONE ? raw[i].data
+			: cbuffers[i].data();
+		ok = ok && std::fwrite( data, 1, c.stored_size, out ) ==
+			static_cast<std::size_t>( c.stored_size );
+		offset += c.stored_size;
+	}
+	ok = ok && write_padding( frame_start + h.frame_size - offset );
+
+	if( !ok ){
+		std::cerr << "Failed to write ltraj frame!\n";
+		good_ = false;
+		return false;
+	}
+
+	ltraj_index_entry e;
+	e.offset = frame_start;
+	e.tstep  = b.tstep;
+	e.N      = b.N;
+	std::copy( b.xlo, b.xlo + 3, e.xlo );
+	std::copy( b.xhi, b.xhi + 3, e.xhi );
+	index.push_back( e );
+	return true;
+}
+
+
+bool ltraj_writer::close()
+{
+	if( !out ) return good_;
+
+	if( good_ ){
+		ltraj_trailer t;
+		t.index_offset = offset;
+		t.n_frames     = index.size();
+		std::memcpy( t.magic, "LTINDEX", 8 );
+		good_ = std::fwrite( index.data(), sizeof(ltraj_index_entry),
+		                     index.size(), out ) == index.size() &&
+			std::fwrite( &t, sizeof(t), 1, out ) == 1;
+	}
+	good_ = ( std::fclose( out ) == 0 ) && good_;
+	out = nullptr;
+	return good_;
+}
+
+
+
+extern "C" {
+
+py_int ltraj_convert( const char *in_name, const char *out_name,
+                      py_int codec, py_float precision )
+{
+	dump_reader r( in_name );
+	if( !r.good() ) return -1;
+
+	ltraj_writer w( out_name, codec, 3, precision );
+	block_data b;
+	py_int n = 0;
+	while( r.next_block( b ) == 0 ){
+		if( !w.write( b ) ) return -2;
+		++n;
+	}
+	if( !w.close() ) return -2;
+	return n;
+}
+
+}
@@ -0,0 +1,221 @@
+#ifndef LTRAJ_H
+#define LTRAJ_H
+
+/*!
+  \file ltraj.h
+  @brief The native columnar trajectory format of lammpstools.
+
+  An ltraj file stores every frame as a set of columns (ids, types,
+  mol, x and any custom per-atom columns), each contiguous and aligned
+  to 64 bytes, so that a reader that maps the file can use the columns
+  in place. Each column can be compressed independently. The file ends
+  with an index of all frames, so random access needs no scan.
+
+  Layout, all numbers in native byte order:
+
+    file header    "LTRAJ\0\0\0", version
+    frame 0        ltraj_frame_header, n_columns x ltraj_column,
+                   padding, column data (each 64-byte aligned)
+    frame 1 ...
+    footer         n_frames x ltraj_index_entry, ltraj_trailer
+
+  Every frame starts at a multiple of 64 bytes. If the footer is missing
+  because the writer did not finish, the frames are found by walking
+  over the frame headers instead.
+
+  Columns can be compressed with zstd, and positions can be stored
+  lossily with a fixed precision, see ltraj_codec.h. Plain zstd needs
+  libzstd (HAVE_LIB_ZSTD), the other codecs compress better with it.
+
+  \ingroup cpp_lib
+*/
+
+#include "block_data.h"
+#include "types.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct ZSTD_CCtx_s;
+
+
+/// Data types of ltraj columns.
+enum ltraj_dtypes {
+	LTRAJ_INT64   = 0,
+	LTRAJ_FLOAT64 = 1
+};
+
+/// Compression of ltraj columns.
+enum ltraj_codecs {
+	LTRAJ_CODEC_NONE  = 0,
+	LTRAJ_CODEC_ZSTD  = 1,
+	LTRAJ_CODEC_DELTA = 2, ///< Lossless, for integer columns
+	LTRAJ_CODEC_QUANT = 3  ///< Lossy fixed precision, for positions
+};
+
+/// Alignment of frames and columns in the file.
+const py_int ltraj_alignment = 64;
+
+/// Version in the file header. Readers reject newer versions.
+const py_int ltraj_version = 1;
+
+
+/// Header of every frame.
+struct ltraj_frame_header
+{
+	char    magic[8];     ///< "LTFRAME\0"
+	py_int  frame_size;   ///< Bytes up to the next frame, incl. padding
+	py_int  tstep;
+	py_int  N;
+	py_float xlo[3];
+	py_float xhi[3];
+	py_int  periodic;
+	py_int  atom_style;
+	py_int  n_columns;
+	char    boxline[72];  ///< Zero-terminated
+};
+
+
+/// Describes one column of a frame.
+struct ltraj_column
+{
+	char    name[32];     ///< Zero-terminated
+	int32_t dtype;        ///< One of ltraj_dtypes
+	int32_t codec;        ///< One of ltraj_codecs
+	py_int  width;        ///< Values per atom, 3 for x
+	py_int  offset;       ///< Start of the data, from the frame start
+	py_int  stored_size;  ///< Bytes stored, compressed or not
+};
+
+
+/// Entry of the footer index.
+struct ltraj_index_entry
+{
+	py_int  offset;       ///< Start of the frame in the file
+	py_int  tstep;
+	py_int  N;
+	py_float xlo[3];
+	py_float xhi[3];
+};
+
+
+/// Last bytes of a finished file.
+struct ltraj_trailer
+{
+	py_int  index_offset; ///< Start of the footer index
+	py_int  n_frames;
+	char    magic[8];     ///< "LTINDEX\0"
+};
+
+
+/// A column of a frame as it is in memory. data points either into the
+/// mapped file or into a decompression buffer of the reader.
+struct ltraj_column_view
+{
+	std::string name;
+	int dtype;
+	py_int width;
+	py_int N;
+	const void *data;
+
+	const py_int   *ints()   const
+	{ return static_cast<const py_int*>( data ); }
+	const py_float *floats() const
+	{ return static_cast<const py_float*>( data ); }
+};
+
+
+/// All columns and the meta info of a frame.
+struct ltraj_frame_view
+{
+	py_int tstep;
+	py_int N;
+	py_float xlo[3];
+	py_float xhi[3];
+	py_int periodic;
+	py_int atom_style;
+	std::string boxline;
+	std::vector<ltraj_column_view> columns;
+
+	/// Returns the column called name, or nullptr if there is none.
+	const ltraj_column_view *column( const std::string &name ) const;
+};
+
+
+/**
+   @brief Writes block_data frames to an ltraj file.
+
+   The footer index is written by close() or the destructor. Frames that
+   are written before a crash can still be read, only slower to open.
+
+   With LTRAJ_CODEC_ZSTD, integer columns are delta-coded and float
+   columns zstd-compressed. If a precision is given, the positions are
+   quantized to it (see ltraj_codec.h) and integer columns delta-coded,
+   which is lossy but typically shrinks the file several times. Columns
+   that do not get smaller are stored uncompressed.
+
+   \ingroup cpp_lib
+*/
+class ltraj_writer
+{
+public:
+	/**
+	   \param fname  The file to write.
+	   \param codec  LTRAJ_CODEC_NONE or LTRAJ_CODEC_ZSTD.
+	   \param level  zstd compression level.
+	   \param precision  If > 0, positions are rounded to multiples
+	                     of this.
+	*/
+	ltraj_writer( const std::string &fname,
+	              int codec = LTRAJ_CODEC_NONE, int level = 3,
+	              py_float precision = 0 );
+	~ltraj_writer();
+
+	/// Appends block b as a new frame. Returns true on success.
+	bool write( const block_data &b );
+
+	/// Writes the footer index and closes the file.
+	bool close();
+
+	bool good() const { return good_; }
+
+private:
+	std::FILE *out;
+	int codec, level;
+	py_float precision;
+	bool good_;
+	py_int offset;      //!< Current end of the file
+
+	std::vector<ltraj_index_entry> index;
+	std::vector<std::vector<char> > cbuffers;
+	ZSTD_CCtx_s *cctx;
+
+	bool write_padding( py_int n );
+
+	// Not copyable:
+	ltraj_writer( const ltraj_writer & );
+	void operator=( const ltraj_writer & );
+};
+
+
+extern "C" {
+
+/**
+   Converts any dump that dump_reader can read into an ltraj file.
+
+   \param in_name   The dump to convert.
+   \param out_name  The ltraj file to write.
+   \param codec     LTRAJ_CODEC_NONE or LTRAJ_CODEC_ZSTD.
+   \param precision If > 0, positions are stored lossily, rounded to
+                    multiples of this.
+
+   \returns the number of frames written, or negative on failure.
+*/
+py_int ltraj_convert( const char *in_name, const char *out_name,
+                      py_int codec, py_float precision );
+
+}
+
+
+#endif // LTRAJ_H
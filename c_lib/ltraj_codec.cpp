@@ -0,0 +1,180 @@
+#include "ltraj_codec.h"
+#include "ltraj.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifdef HAVE_LIB_ZSTD
+#include <zstd.h>
+#endif
+
+
+namespace {
+
+// Precedes the byte planes of a DELTA or QUANT column.
+struct codec_header
+{
+	py_float precision;  ///< Quantum of QUANT columns, 1 for DELTA
+	int32_t  n_bytes;    ///< Bytes per value, 1, 2, 4 or 8
+	int32_t  zstd;       ///< 1 if the planes are zstd-compressed
+};
+
+
+py_uint zigzag( py_uint d )
+{
+	return ( d << 1 ) ^ static_cast<py_uint>(
+		static_cast<py_int>( d ) >> 63 );
+}
+
+py_uint unzigzag( py_uint z )
+{
+	return ( z >> 1 ) ^ ( ~( z & 1 ) + 1 );
+}
+
+} // namespace
+
+
+
+bool ltraj_encode_column( int codec, const void *data, py_int N,
+                          py_int width, py_float precision,
+                          ZSTD_CCtx_s *cctx, int level,
+                          std::vector<char> &out )
+{
+	py_int n = N * width;
+	std::vector<py_int> q( n );
+	if( codec == LTRAJ_CODEC_QUANT ){
+		if( !( precision > 0 ) ) return false;
+		const py_float *x = static_cast<const py_float*>( data );
+		py_float scale = 1.0 / precision;
+		for( py_int i = 0; i < n; ++i ){
+			py_float v = x[i] * scale;
+			if( !std::isfinite( v ) || std::fabs( v ) > 4e18 ){
+				return false;
+			}
+			q[i] = std::llround( v );
+		}
+	}else if( codec == LTRAJ_CODEC_DELTA ){
+		const py_int *v = static_cast<const py_int*>( data );
+		std::copy( v, v + n, q.begin() );
+		precision = 1.0;
+	}else{
+		return false;
+	}
+
+	// Differences between consecutive atoms, per component. The
+	// unsigned arithmetic wraps around instead of overflowing.
+	std::vector<py_uint> z( n );
+	py_uint z_max = 0;
+	for( py_int d = 0; d < width; ++d ){
+		py_uint prev = 0;
+		for( py_int i = 0; i < N; ++i ){
+			py_uint v = static_cast<py_uint>( q[i*width + d] );
+			py_uint zz = zigzag( v - prev );
+			z[d*N + i] = zz;
+			z_max |= zz;
+			prev = v;
+		}
+	}
+
+	codec_header h;
+	h.precision = precision;
+	h.n_bytes   = 1;
+	while( h.n_bytes < 8 && ( z_max >> ( 8*h.n_bytes ) ) ) h.n_bytes *= 2;
+	h.zstd = 0;
+
+	std::vector<char> planes( n * h.n_bytes );
+	for( int b = 0; b < h.n_bytes; ++b ){
+		char *p = planes.data() + b*n;
+		for( py_int i = 0; i < n; ++i ){
+			p[i] = static_cast<char>( ( z[i] >> ( 8*b ) ) & 0xff );
+		}
+	}
+
+	out.resize( sizeof(h) );
+#ifdef HAVE_LIB_ZSTD
+	if( cctx && !planes.empty() ){
+		out.resize( sizeof(h) + ZSTD_compressBound( planes.size() ) );
+		std::size_t csize = ZSTD_compressCCtx( cctx, out.data() + sizeof(h),
+		                                       out.size() - sizeof(h),
+		                                       planes.data(),
+		                                       planes.size(), level );
+		if( !ZSTD_isError( csize ) && csize < planes.size() ){
+			h.zstd = 1;
+			out.resize( sizeof(h) + csize );
+		}else{
+			out.resize( sizeof(h) );
+		}
+	}
+#endif
+	if( !h.zstd ){
+		out.insert( out.end(), planes.begin(), planes.end() );
+	}
+	std::memcpy( out.data(), &h, sizeof(h) );
+	return true;
+}
+
+
+bool ltraj_decode_column( int codec, const char *data, py_int size,
+                          py_int N, py_int width, ZSTD_DCtx_s *dctx,
+                          void *out )
+{
+	if( codec != LTRAJ_CODEC_QUANT && codec != LTRAJ_CODEC_DELTA ){
+		return false;
+	}
+	codec_header h;
+	if( size < static_cast<py_int>( sizeof(h) ) ) return false;
+	std::memcpy( &h, data, sizeof(h) );
+	if( h.n_bytes != 1 && h.n_bytes != 2 && h.n_bytes != 4 &&
+	    h.n_bytes != 8 ){
+		return false;
+	}
+
+	py_int n = N * width;
+	py_int planes_size = n * h.n_bytes;
+	const char *planes = data + sizeof(h);
+	size -= sizeof(h);
+
+	std::vector<char> buffer;
+	if( h.zstd ){
+#ifdef HAVE_LIB_ZSTD
+		if( !dctx ) return false;
+		buffer.resize( planes_size );
+		std::size_t usize = ZSTD_decompressDCtx( dctx, buffer.data(),
+		                                         planes_size, planes,
+		                                         size );
+		if( ZSTD_isError( usize ) ||
+		    static_cast<py_int>( usize ) != planes_size ){
+			return false;
+		}
+		planes = buffer.data();
+#else
+		std::cerr << "Decoding this ltraj column needs zstd!\n";
+		return false;
+#endif
+	}else if( size != planes_size ){
+		return false;
+	}
+
+	const unsigned char *p = reinterpret_cast<const unsigned char*>( planes );
+	py_int   *iout = static_cast<py_int*>( out );
+	py_float *fout = static_cast<py_float*>( out );
+	for( py_int d = 0; d < width; ++d ){
+		py_uint v = 0;
+		for( py_int i = 0; i < N; ++i ){
+			py_int k = d*N + i;
+			py_uint zz = 0;
+			for( int b = 0; b < h.n_bytes; ++b ){
+				zz |= static_cast<py_uint>( p[b*n + k] ) << ( 8*b );
+			}
+			v += unzigzag( zz );
+			if( codec == LTRAJ_CODEC_QUANT ){
+				fout[i*width + d] =
+					static_cast<py_int>( v ) * h.precision;
+			}else{
+				iout[i*width + d] = static_cast<py_int>( v );
+			}
+		}
+	}
+	return true;
+}
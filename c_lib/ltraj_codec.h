@@ -0,0 +1,63 @@
+#ifndef LTRAJ_CODEC_H
+#define LTRAJ_CODEC_H
+
+/*!
+  \file ltraj_codec.h
+  @brief Encoding and decoding of compressed ltraj columns.
+
+  Besides plain zstd, ltraj columns can be stored with two integer
+  codecs, in the spirit of the XTC format:
+
+  - LTRAJ_CODEC_DELTA (lossless, for integer columns) stores each
+    component as the difference to the previous atom.
+  - LTRAJ_CODEC_QUANT (lossy, for float columns) first rounds the values
+    to a multiple of a given precision and then stores them like DELTA.
+
+  The differences are zigzag-encoded, cut to the fewest bytes that hold
+  all of them and split into byte planes (all lowest bytes first, then
+  all second bytes, ...). The planes are mostly zeros or nearly random
+  bytes, which zstd's entropy coder compresses well. Without zstd the
+  planes are stored as they are.
+
+  \ingroup cpp_lib
+*/
+
+#include "types.h"
+
+#include <vector>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+
+/**
+   Encodes a column of \p N atoms with \p width values each.
+
+   \param codec      LTRAJ_CODEC_DELTA for py_int data or
+                     LTRAJ_CODEC_QUANT for py_float data.
+   \param data       The column, N x width values.
+   \param precision  For QUANT, values are rounded to multiples of this.
+   \param cctx       zstd context, may be nullptr without zstd.
+   \param level      zstd compression level.
+   \param out        Receives the encoded column.
+
+   \returns true on success, false if the data cannot be encoded
+            (e.g., positions that are not finite).
+*/
+bool ltraj_encode_column( int codec, const void *data, py_int N,
+                          py_int width, py_float precision,
+                          ZSTD_CCtx_s *cctx, int level,
+                          std::vector<char> &out );
+
+/**
+   Decodes a column encoded by ltraj_encode_column into \p out, which
+   must have room for N x width py_ints (DELTA) or py_floats (QUANT).
+
+   \returns true on success, false if the data is corrupt.
+*/
+bool ltraj_decode_column( int codec, const char *data, py_int size,
+                          py_int N, py_int width, ZSTD_DCtx_s *dctx,
+                          void *out );
+
+
+#endif // LTRAJ_CODEC_H
@@ -0,0 +1,76 @@
+#include "mapped_file.h"
+
+#include <iostream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+mapped_file::mapped_file( const std::string &fname, bool sequential )
+	: fname_( fname ), data_( nullptr ), size_( 0 ),
+	  sequential_( sequential ), good_( false )
+{
+	good_ = map();
+}
+
+mapped_file::~mapped_file()
+{
+	unmap();
+}
+
+bool mapped_file::remap()
+{
+	unmap();
+	good_ = map();
+	return good_;
+}
+
+bool mapped_file::map()
+{
+	int fd = open( fname_.c_str(), O_RDONLY );
+	if( fd < 0 ){
+		std::cerr << "Failed to open file " << fname_ << "!\n";
+		return false;
+	}
+
+	struct stat st;
+	if( fstat( fd, &st ) ){
+		std::cerr << "Failed to stat file " << fname_ << "!\n";
+		close( fd );
+		return false;
+	}
+
+	size_ = st.st_size;
+	if( size_ == 0 ){
+		// mmap does not like empty files, but an empty file is
+		// still a perfectly good (empty) file.
+		close( fd );
+		return true;
+	}
+
+	void *p = mmap( nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( p == MAP_FAILED ){
+		std::cerr << "Failed to mmap file " << fname_ << "!\n";
+		size_ = 0;
+		return false;
+	}
+	if( sequential_ ){
+		madvise( p, size_, MADV_SEQUENTIAL );
+	}
+
+	data_ = static_cast<const char*>( p );
+	return true;
+}
+
+void mapped_file::unmap()
+{
+	if( data_ ){
+		munmap( const_cast<char*>( data_ ), size_ );
+	}
+	data_ = nullptr;
+	size_ = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+/*!
+  \file mapped_file.h
+  @brief A small read-only wrapper around mmap'ed files.
+
+  \ingroup cpp_lib
+*/
+
+#include <string>
+#include <cstddef>
+
+
+/*!
+  @brief Maps a whole file read-only into memory.
+
+  The mapping is released in the destructor. If the file could not be
+  opened or mapped, good() returns false and data() is nullptr.
+
+  \ingroup cpp_lib
+*/
+class mapped_file
+{
+public:
+	/// Maps file fname. If sequential is true, the kernel is told
+	/// the file will be read front-to-back so it can read ahead.
+	mapped_file( const std::string &fname, bool sequential = true );
+	~mapped_file();
+
+	/// Pointer to first byte of the mapped file.
+	const char *data()  const { return data_; }
+	/// Pointer one past the last byte of the mapped file.
+	const char *end()   const { return data_ + size_; }
+	/// Size of the file in bytes.
+	std::size_t size()  const { return size_; }
+
+	/// True if the file was succesfully mapped.
+	bool good() const { return good_; }
+
+	/// Remaps the file, e.g. because it has grown since.
+	bool remap();
+
+private:
+	std::string fname_;
+	const char *data_;
+	std::size_t size_;
+	bool sequential_;
+	bool good_;
+
+	bool map();
+	void unmap();
+
+	// Not copyable:
+	mapped_file( const mapped_file & );
+	void operator=( const mapped_file & );
+};
+
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,168 @@
+#include "neighbor_list.h"
+#include "parallel.h"
+
+#include <numeric>
+
+
+neighbor_list::neighbor_list( py_int N, int extras )
+	: N(0), extras_(INDICES_ONLY)
+{
+	reset( N, extras );
+}
+
+
+void neighbor_list::reset( py_int NN, int extras )
+{
+	N = NN;
+	extras_ = extras;
+	offsets_.assign( N + 1, 0 );
+	indices_.clear();
+	dist_.clear();
+	disp_.clear();
+
+	pair_i.clear();
+	pair_j.clear();
+	pair_r.clear();
+	pair_dx.clear();
+}
+
+
+void neighbor_list::finalize()
+{
+	sort_into_rows( std::vector<neighbor_list*>( 1, this ) );
+}
+
+
+void neighbor_list::finalize( std::vector<neighbor_list> &parts )
+{
+	std::vector<neighbor_list*> sources( 1, this );
+	for( neighbor_list &p : parts ) sources.push_back( &p );
+	sort_into_rows( sources );
+}
+
+
+void neighbor_list::sort_into_rows( const std::vector<neighbor_list*> &sources )
+{
+	const bool with_r  = extras_ & DISTANCES;
+	const bool with_dx = extras_ & DISPLACEMENTS;
+
+	// Counting sort of the pairs by i.
+	std::size_t M = 0;
+	offsets_.assign( N + 1, 0 );
+	for( const neighbor_list *src : sources ){
+		for( py_int i : src->pair_i ) ++offsets_[i+1];
+		M += src->pair_i.size();
+	}
+	std::partial_sum( offsets_.begin(), offsets_.end(), offsets_.begin() );
+
+	std::vector<py_int> place( offsets_.begin(), offsets_.end() - 1 );
+	indices_.resize( M );
+	dist_.resize( with_r ? M : 0 );
+	disp_.resize( with_dx ? 3*M : 0 );
+	for( const neighbor_list *src : sources ){
+		for( std::size_t p = 0; p < src->pair_i.size(); ++p ){
+			py_int k = place[ src->pair_i[p] ]++;
+			indices_[k] = src->pair_j[p];
+			if( with_r ) dist_[k] = src->pair_r[p];
+			if( with_dx ){
+				disp_[3*k]   = src->pair_dx[3*p];
+				disp_[3*k+1] = src->pair_dx[3*p+1];
+				disp_[3*k+2] = src->pair_dx[3*p+2];
+			}
+		}
+	}
+
+	// Sort every row and drop duplicates. The rows are independent, so
+	// threads each take a range of rows with about as many entries.
+	std::vector<py_int> count( N );
+	const int n_threads = threads_for( M );
+	run_threads( n_threads, [&]( int t )
+	{
+		py_int i0 = std::lower_bound( offsets_.begin(), offsets_.end() - 1,
+		                              py_int( M*t / n_threads ) ) - offsets_.begin();
+		py_int i1 = std::lower_bound( offsets_.begin(), offsets_.end() - 1,
+		                              py_int( M*(t+1) / n_threads ) ) - offsets_.begin();
+		if( t == n_threads - 1 ) i1 = N;
+		std::vector<py_int> order, j_tmp;
+		std::vector<py_float> r_tmp, dx_tmp;
+		for( py_int i = i0; i < i1; ++i ){
+			count[i] = sort_row( offsets_[i], offsets_[i+1],
+			                     order, j_tmp, r_tmp, dx_tmp );
+		}
+	} );
+
+	// Close the gaps the duplicates left.
+	py_int w = 0;
+	for( py_int i = 0; i < N; ++i ){
+		const py_int b = offsets_[i];
+		offsets_[i] = w;
+		if( w != b ){
+			std::copy( indices_.begin() + b, indices_.begin() + b + count[i],
+			           indices_.begin() + w );
+			if( with_r ){
+				std::copy( dist_.begin() + b, dist_.begin() + b + count[i],
+				           dist_.begin() + w );
+			}
+			if( with_dx ){
+				std::copy( disp_.begin() + 3*b, disp_.begin() + 3*( b + count[i] ),
+				           disp_.begin() + 3*w );
+			}
+		}
+		w += count[i];
+	}
+	offsets_[N] = w;
+	indices_.resize( w );
+	if( with_r )  dist_.resize( w );
+	if( with_dx ) disp_.resize( 3*w );
+
+	for( neighbor_list *src : sources ){
+		src->pair_i.clear();
+		src->pair_j.clear();
+		src->pair_r.clear();
+		src->pair_dx.clear();
+	}
+}
+
+
+py_int neighbor_list::sort_row( py_int b, py_int e, std::vector<py_int> &order,
+                                std::vector<py_int> &j_tmp,
+                                std::vector<py_float> &r_tmp,
+                                std::vector<py_float> &dx_tmp )
+{
+	const bool with_r  = extras_ & DISTANCES;
+	const bool with_dx = extras_ & DISPLACEMENTS;
+
+	py_int w = b;
+	if( !with_r && !with_dx ){
+		std::sort( indices_.begin() + b, indices_.begin() + e );
+		for( py_int k = b; k < e; ++k ){
+			if( k > b && indices_[k] == indices_[k-1] ) continue;
+			indices_[w++] = indices_[k];
+		}
+		return w - b;
+	}
+
+	order.resize( e - b );
+	std::iota( order.begin(), order.end(), b );
+	std::stable_sort( order.begin(), order.end(),
+	                  [this]( py_int k, py_int l ){
+		                  return indices_[k] < indices_[l]; } );
+	// The row is read through order, so write it to scratch space
+	// first and then copy it back to the front of the row.
+	j_tmp.clear();
+	r_tmp.clear();
+	dx_tmp.clear();
+	for( py_int k : order ){
+		if( !j_tmp.empty() && indices_[k] == j_tmp.back() ) continue;
+		j_tmp.push_back( indices_[k] );
+		if( with_r ) r_tmp.push_back( dist_[k] );
+		if( with_dx ){
+			dx_tmp.insert( dx_tmp.end(), disp_.begin() + 3*k,
+			               disp_.begin() + 3*k + 3 );
+		}
+	}
+	std::copy( j_tmp.begin(), j_tmp.end(), indices_.begin() + b );
+	if( with_r ) std::copy( r_tmp.begin(), r_tmp.end(), dist_.begin() + b );
+	if( with_dx ) std::copy( dx_tmp.begin(), dx_tmp.end(), disp_.begin() + 3*b );
+	return j_tmp.size();
+}
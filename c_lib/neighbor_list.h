@@ -0,0 +1,169 @@
+#ifndef NEIGHBOR_LIST_H
+#define NEIGHBOR_LIST_H
+
+/*!
+  \file neighbor_list.h
+  @brief A neighbor list in compressed sparse row form.
+
+  \ingroup cpp_lib
+*/
+
+#include "types.h"
+
+#include <algorithm>
+#include <vector>
+
+
+/*! @brief Neighbor list of N atoms in compressed sparse row form.
+
+  The neighbors of atom i are the atom indices indices()[offsets()[i]]
+  up to indices()[offsets()[i+1]], sorted and without duplicates. If
+  asked for, the distance to every neighbor and the displacement
+  vector x_j - x_i are stored alongside.
+
+  A list is filled by calling add for every pair and then finalize,
+  which sorts the pairs into rows. Pairs can be added in any order.
+  reset keeps the memory, so building a list for every frame into the
+  same object does not allocate once it is large enough.
+
+  \ingroup cpp_lib
+*/
+class neighbor_list {
+public:
+	/// What is stored besides the neighbor indices.
+	enum extras {
+		INDICES_ONLY  = 0, ///< Only the neighbor indices
+		DISTANCES     = 1, ///< The distance to every neighbor
+		DISPLACEMENTS = 2  ///< The vector to every neighbor
+	};
+
+	/// The neighbors of one atom, usable in range-based for loops.
+	class row {
+	public:
+		row( const py_int *b, const py_int *e ) : b(b), e(e) {}
+
+		const py_int *begin() const { return b; }
+		const py_int *end()   const { return e; }
+		py_int size()  const { return e - b; }
+		bool   empty() const { return e == b; }
+		py_int operator[]( py_int k ) const { return b[k]; }
+
+	private:
+		const py_int *b, *e;
+	};
+
+	neighbor_list() : N(0), extras_(INDICES_ONLY), offsets_(1, 0) {}
+	neighbor_list( py_int N, int extras = INDICES_ONLY );
+
+	/// Empties the list and makes room for \p N atoms, keeping the
+	/// memory that was allocated before.
+	void reset( py_int N, int extras = INDICES_ONLY );
+
+	/// Adds j as neighbor of i.
+	void add( py_int i, py_int j )
+	{
+		pair_i.push_back( i );
+		pair_j.push_back( j );
+		if( extras_ & DISTANCES )     pair_r.push_back( 0.0 );
+		if( extras_ & DISPLACEMENTS ) pair_dx.insert( pair_dx.end(), 3, 0.0 );
+	}
+
+	/// Adds j as neighbor of i at distance \p r and displacement
+	/// \p dx = x_j - x_i. What the list does not store is ignored.
+	void add( py_int i, py_int j, py_float r, const py_float *dx )
+	{
+		pair_i.push_back( i );
+		pair_j.push_back( j );
+		if( extras_ & DISTANCES )     pair_r.push_back( r );
+		if( extras_ & DISPLACEMENTS ) pair_dx.insert( pair_dx.end(), dx, dx + 3 );
+	}
+
+	/// Adds i and j as each other's neighbors.
+	void add_pair( py_int i, py_int j )
+	{
+		add( i, j );
+		add( j, i );
+	}
+
+	/// Adds i and j as each other's neighbors, \p dx = x_j - x_i.
+	void add_pair( py_int i, py_int j, py_float r, const py_float *dx )
+	{
+		const py_float mdx[3] = { -dx[0], -dx[1], -dx[2] };
+		add( i, j, r, dx );
+		add( j, i, r, mdx );
+	}
+
+	/// Sorts the pairs added since the last reset into rows.
+	void finalize();
+
+	/**
+	   Like finalize, but also takes the pairs added to each of
+	   \p parts, as if they had been added to this list after its own
+	   in that order. The parts are emptied. This way threads can each
+	   fill their own part without locking.
+	*/
+	void finalize( std::vector<neighbor_list> &parts );
+
+	/// Number of atoms
+	py_int size() const { return N; }
+	/// Total number of neighbors of all atoms
+	py_int n_entries() const { return indices_.size(); }
+
+	/// The neighbors of atom i
+	row operator[]( py_int i ) const
+	{
+		return row( indices_.data() + offsets_[i],
+		            indices_.data() + offsets_[i+1] );
+	}
+
+	/// Number of neighbors of atom i
+	py_int degree( py_int i ) const { return offsets_[i+1] - offsets_[i]; }
+
+	/// True if j is a neighbor of i, in O(log(degree(i))).
+	bool has( py_int i, py_int j ) const
+	{
+		row r = (*this)[i];
+		return std::binary_search( r.begin(), r.end(), j );
+	}
+
+	/// N + 1 offsets into indices()
+	const py_int *offsets() const { return offsets_.data(); }
+	/// Neighbor indices of all atoms, row after row
+	const py_int *indices() const { return indices_.data(); }
+
+	bool has_distances()     const { return extras_ & DISTANCES; }
+	bool has_displacements() const { return extras_ & DISPLACEMENTS; }
+
+	/// Distances to the neighbors of atom i, in the order of (*this)[i]
+	const py_float *distances( py_int i ) const
+	{
+		return dist_.data() + offsets_[i];
+	}
+
+	/// Displacements to the neighbors of atom i, three per neighbor
+	const py_float *displacements( py_int i ) const
+	{
+		return disp_.data() + 3*offsets_[i];
+	}
+
+private:
+	py_int N;
+	int extras_;
+
+	std::vector<py_int>   offsets_;
+	std::vector<py_int>   indices_;
+	std::vector<py_float> dist_;
+	std::vector<py_float> disp_;
+
+	// Pairs added since the last reset:
+	std::vector<py_int>   pair_i, pair_j;
+	std::vector<py_float> pair_r, pair_dx;
+
+	void sort_into_rows( const std::vector<neighbor_list*> &sources );
+	py_int sort_row( py_int b, py_int e, std::vector<py_int> &order,
+	                 std::vector<py_int> &j_tmp, std::vector<py_float> &r_tmp,
+	                 std::vector<py_float> &dx_tmp );
+};
+
+
+#endif /* NEIGHBOR_LIST_H */
@@ -10,9 +10,7 @@
 
 
 #include "types.h"
-
-#include <list>
-#include <vector>
+#include "neighbor_list.h"
 
 /*!
   Enum of the neighborization methods.
@@ -27,9 +25,45 @@ enum NEIGHBORIZE_METHODS {
 
 extern "C" {
 
+/*!
+  @brief A neighbor list owned by the library, in compressed sparse row
+         form.
+
+  The neighbors of atom i are neighs[offsets[i]] up to (but not
+  including) neighs[offsets[i+1]], as atom ids. Free it with
+  release_neighbor_buffer.
+*/
+struct neighbor_buffer
+{
+	py_int N;        ///< Number of atoms
+	py_int *offsets; ///< N + 1 offsets into neighs
+	py_int *neighs;  ///< Ids of the neighbors of all atoms
+};
+
+/*!
+  @brief Determine some form of neighbor list of a group of particles,
+         and return it in a buffer that Python can view directly.
+
+  The parameters are the same as for neighborize, without pname.
+
+  @returns The neighbor list. Release it with release_neighbor_buffer.
+*/
+neighbor_buffer *neighborize_to_buffer( void *x, py_int N, py_int *ids,
+                                        py_int *types, py_float rc,
+                                        py_int periodic,
+                                        py_float *xlo, py_float *xhi,
+                                        py_int dims, py_int method,
+                                        py_int itype, py_int jtype );
+
+/// Frees a neighbor_buffer made by neighborize_to_buffer.
+void release_neighbor_buffer( neighbor_buffer *nb );
+
 /*!
   @brief Determine some form of neighbor list of a group of particles.
 
+  \deprecated Writes the list to a named pipe, use neighborize_to_buffer
+              instead.
+
   @param x         Atom positions
   @param N         Number of atoms
   @param ids       Atom ids
@@ -51,8 +85,18 @@ void neighborize( void *x, py_int N, py_int *ids,
 
 }
 
-void neighborize_block( const class block_data &b,
-                        std::vector<std::list<py_int> > &neighs );
+/*!
+  @brief Copies \p neighs into a new neighbor_buffer, with the neighbor
+         indices replaced by the matching \p ids, or kept as they are
+         if \p ids is nullptr.
+*/
+neighbor_buffer *make_neighbor_buffer( const neighbor_list &neighs,
+                                       const py_int *ids );
+
+/*!
+  @brief Makes a neighbor list of the atoms in \p b with a cut-off of 1.3.
+*/
+void neighborize_block( const class block_data &b, neighbor_list &neighs );
 
 
 /*!
@@ -70,12 +114,12 @@ void neighborize_block( const class block_data &b,
   @param xhi       Box upper bounds
   @param dims      Box dimensions
   @param method    Neighborisation method (see NEIGHBORIZE_METHODS)
-  @param neighs    Pointer to where the neigh list will be stored
+  @param neighs    List the neighbor indices are stored in
 */
 void neighborize_impl( const arr3f &x, py_int N, const arr1i &ids,
                        const arr1i &types, py_float rc, py_int periodic,
                        const py_float *xlo, const py_float *xhi, py_int dims,
-                       py_int method, std::list<py_int> *neighs,
+                       py_int method, neighbor_list &neighs,
                        py_int itype, py_int jtype );
 
 
@@ -95,18 +139,18 @@ void neighborize_impl( const arr3f &x, py_int N, const arr1i &ids,
   @param xhi       Box upper bounds
   @param dims      Box dimensions
   @param method    Neighborisation method (see NEIGHBORIZE_METHODS)
-  @param neighs    Pointer to where the neigh list will be stored
+  @param neighs    List the neighbor indices are stored in
 */
 void neighborize_dist_nsq( const arr3f &x, py_int N, const arr1i &ids,
                            const arr1i &types, py_float rc, py_int periodic,
                            const py_float *xlo, const py_float *xhi, py_int dims,
-                           std::list<py_int> *neighs, py_int itype, py_int jtype  );
+                           neighbor_list &neighs, py_int itype, py_int jtype  );
 
 /*!
-  @brief Computes a distance-based neighbor list by first binning all
-         positions, determining which atoms are likely close and then
-         computing distance r_{ij}, only for those atoms, then filtering
-         those with r_{ij} <= rc. This is faster for large systems.
+  @brief Computes a distance-based neighbor list by first sorting all
+         positions into cells at least rc wide, so that r_{ij} only
+         needs to be computed for atoms in the same or adjacent cells.
+         This is faster for large systems. See cell_list.
   \private
 
   @param x         Atom positions
@@ -118,12 +162,12 @@ void neighborize_dist_nsq( const arr3f &x, py_int N, const arr1i &ids,
   @param xlo       Box lower bounds
   @param xhi       Box upper bounds
   @param dims      Box dimensions
-  @param neighs    Pointer to where the neigh list will be stored
+  @param neighs    List the neighbor indices are stored in
 */
 void neighborize_dist_bin( const arr3f &x, py_int N, const arr1i &ids,
                            const arr1i &types, py_float rc, py_int periodic,
                            const py_float *xlo, const py_float *xhi, py_int dims,
-                           std::list<py_int> *neighs, py_int itype, py_int jtype  );
+                           neighbor_list &neighs, py_int itype, py_int jtype  );
 
 
 /*!
@@ -138,12 +182,12 @@ void neighborize_dist_bin( const arr3f &x, py_int N, const arr1i &ids,
   @param xlo       Box lower bounds
   @param xhi       Box upper bounds
   @param dims      Box dimensions
-  @param neighs    Pointer to where the neigh list will be stored
+  @param neighs    List the neighbor indices are stored in
 */
 void neighborize_delaunay( const arr3f &x, py_int N, const arr1i &ids,
                            const arr1i &types, py_int periodic,
                            const py_float *xlo, const py_float *xhi, py_int dims,
-                           std::list<py_int> *neighs, py_int itype, py_int jtype );
+                           neighbor_list &neighs, py_int itype, py_int jtype );
 
 /*!
   @brief Computes a connectivity list by computing the convex hull of the
@@ -159,12 +203,12 @@ void neighborize_delaunay( const arr3f &x, py_int N, const arr1i &ids,
   @param xlo       Box lower bounds
   @param xhi       Box upper bounds
   @param dims      Box dimensions
-  @param neighs    Pointer to where the neigh list will be stored
+  @param neighs    List the neighbor indices are stored in
 */
 void neighborize_conv_hull( const arr3f &x, py_int N, const arr1i &ids,
                             const arr1i &types, py_int periodic,
                             const py_float *xlo, const py_float *xhi, py_int dims,
-                            std::list<py_int> *neighs, py_int itype, py_int jtype  );
+                            neighbor_list &neighs, py_int itype, py_int jtype  );
 
 
 
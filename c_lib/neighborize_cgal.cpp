@@ -5,12 +5,12 @@
 void neighborize_delaunay( const arr3f &x, py_int N, const arr1i &ids,
                            const arr1i &types, py_int periodic,
                            const py_float *xlo, const py_float *xhi, py_int dims,
-                           std::list<py_int> *neighs, py_int itype, py_int jtype ) {}
+                           neighbor_list &neighs, py_int itype, py_int jtype ) {}
 
 void neighborize_conv_hull( const arr3f &x, py_int N, const arr1i &ids,
                             const arr1i &types, py_int periodic,
                             const py_float *xlo, const py_float *xhi, py_int dims,
-                            std::list<py_int> *neighs, py_int itype, py_int jtype ) {}
+                            neighbor_list &neighs, py_int itype, py_int jtype ) {}
 
 #else
 // Actual implementation using CGAL. Requires many includes...
@@ -40,17 +40,10 @@ typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
 
 static my_ostream my_out( std::cout );
 
-inline bool in_list( py_int jd, const std::list<py_int> &ni )
-{
-	return std::find( ni.begin(), ni.end(), jd ) != ni.end();
-}
-
-
-
 void neighborize_delaunay_2d( const arr3f &x, py_int N, const arr1i &ids,
                               const arr1i &types, const py_float *xlo,
                               const py_float *xhi,
-                              std::list<py_int> *neighs, py_int itype, py_int jtype )
+                              neighbor_list &neighs, py_int itype, py_int jtype )
 {
 	typedef CGAL::Triangulation_vertex_base_with_info_2<py_int, K> Vb;
 	typedef CGAL::Triangulation_data_structure_2<Vb> Tds;
@@ -90,15 +83,13 @@ void neighborize_delaunay_2d( const arr3f &x, py_int N, const arr1i &ids,
 		my_out << "    ( " << x[i][0] << ", " << x[i][1] << " ),\n"
 		          << "    ( " << x[j][0] << ", " << x[j][1] << " ),\n"
 		          << "    ( " << x[k][0] << ", " << x[k][1] << " ),\n";
-		if( !in_list( j, neighs[i] ) ) neighs[i].push_back(j);
-		if( !in_list( k, neighs[i] ) ) neighs[i].push_back(k);
-
-		if( !in_list( i, neighs[j] ) ) neighs[j].push_back(j);
-		if( !in_list( k, neighs[j] ) ) neighs[j].push_back(k);
-		
-		if( !in_list( i, neighs[k] ) ) neighs[k].push_back(i);
-		if( !in_list( j, neighs[k] ) ) neighs[k].push_back(j);
+		// Pairs of a shared edge are added twice, finalize drops
+		// the duplicates.
+		neighs.add_pair( i, j );
+		neighs.add_pair( j, k );
+		neighs.add_pair( i, k );
 	}
+	neighs.finalize();
 	// Print a gnuplottable test file:
 	std::ofstream out( "test_2d_del_gnuplot_lines.dat" );
 	std::ofstream out2( "test_2d_del_gnuplot_points.dat" );
@@ -114,7 +105,7 @@ void neighborize_delaunay_2d( const arr3f &x, py_int N, const arr1i &ids,
 void neighborize_delaunay_3d( const arr3f &x, py_int N, const arr1i &ids,
                               const arr1i &types, const py_float *xlo,
                               const py_float *xhi,
-                              std::list<py_int> *neighs, py_int itype, py_int jtype )
+                              neighbor_list &neighs, py_int itype, py_int jtype )
 {}
 
 
@@ -122,7 +113,7 @@ void neighborize_delaunay_3d( const arr3f &x, py_int N, const arr1i &ids,
 void neighborize_delaunay_p_2d( const arr3f &x, py_int N, const arr1i &ids,
                                 const arr1i &types, const py_float *xlo,
                                 const py_float *xhi,
-                                py_int periodic, std::list<py_int> *neighs, py_int itype, py_int jtype )
+                                py_int periodic, neighbor_list &neighs, py_int itype, py_int jtype )
 {
 	typedef CGAL::Periodic_2_triangulation_filtered_traits_2<K> Gt;
 	typedef CGAL::Periodic_2_triangulation_vertex_base_2<Gt> Vb_base;
@@ -172,23 +163,11 @@ void neighborize_delaunay_p_2d( const arr3f &x, py_int N, const arr1i &ids,
 		kd_no = !kd;
 		int i = im[id], j = im[jd], k = im[kd];
 		
-		if( !id_no && !jd_no ){
-			if( !in_list( j, neighs[i] ) ) neighs[i].push_back(j);	
-			if( !in_list( i, neighs[j] ) ) neighs[j].push_back(i);
-		}
-
-		if( !jd_no && !kd_no ){
-			if( !in_list( k, neighs[j] ) ) neighs[j].push_back(k);
-			if( !in_list( j, neighs[k] ) ) neighs[k].push_back(j);
-		}
-
-		if( !id_no && !kd_no ){
-			if( !in_list( k, neighs[i] ) ) neighs[i].push_back(k);
-			if( !in_list( i, neighs[k] ) ) neighs[k].push_back(i);
-		}
-
-
+		if( !id_no && !jd_no ) neighs.add_pair( i, j );
+		if( !jd_no && !kd_no ) neighs.add_pair( j, k );
+		if( !id_no && !kd_no ) neighs.add_pair( i, k );
 	}
+	neighs.finalize();
 	// Print a gnuplottable test file:
 	std::ofstream out( "test_2d_p_del_gnuplot_lines.dat" );
 	std::ofstream out2( "test_2d_p_del_gnuplot_points.dat" );
@@ -204,7 +183,7 @@ void neighborize_delaunay_p_2d( const arr3f &x, py_int N, const arr1i &ids,
 
 void neighborize_delaunay_p_3d( const arr3f &x, py_int N, const arr1i &ids,
                                 const arr1i &types, const py_float *xlo, const py_float *xhi,
-                                py_int periodic, std::list<py_int> *neighs, py_int itype, py_int jtype )
+                                py_int periodic, neighbor_list &neighs, py_int itype, py_int jtype )
 {
 
 }
@@ -214,7 +193,7 @@ void neighborize_delaunay_p_3d( const arr3f &x, py_int N, const arr1i &ids,
 void neighborize_delaunay( const arr3f &x, py_int N, const arr1i &ids,
                            const arr1i &types, py_int periodic,
                            const py_float *xlo, const py_float *xhi, py_int dims,
-                           std::list<py_int> *neighs, py_int itype, py_int jtype )
+                           neighbor_list &neighs, py_int itype, py_int jtype )
 {
 	if( (periodic != PERIODIC_NONE) && (periodic != PERIODIC_FULL) ){
 		std::cerr << "Cannot use Delaunay for semi-periodic systems!\n";
@@ -247,7 +226,7 @@ void neighborize_delaunay( const arr3f &x, py_int N, const arr1i &ids,
 void neighborize_conv_hull( const arr3f &x, py_int N, const arr1i &ids,
                             const arr1i &types, py_int periodic,
                             const py_float *xlo, const py_float *xhi, py_int dims,
-                            std::list<py_int> *neighs, py_int itype, py_int jtype )
+                            neighbor_list &neighs, py_int itype, py_int jtype )
 {
 	typedef CGAL::Polyhedron_3<K> poly;
 	typedef K::Point_3 point;
@@ -308,13 +287,13 @@ void neighborize_conv_hull( const arr3f &x, py_int N, const arr1i &ids,
 		py_int id1 = ids[i];
 		py_int id2 = ids[j];
 
-		if( !in_list( j, neighs[i] ) ) neighs[i].push_back(j);
-		if( !in_list( i, neighs[j] ) ) neighs[j].push_back(i);
+		neighs.add_pair( i, j );
 
 		out << p1[0] << " " << p1[1] << " " << p1[2] << "\n"
 		    << p2[0] << " " << p2[1] << " " << p2[2] << "\n\n\n";
 		out2 << p1[0] << " " << p1[1] << " " << p1[2] << "\n";
 	}
+	neighs.finalize();
 }
 
 
@@ -19,19 +19,33 @@ void normal_mode_analysis( dump_reader &r,  py_int N, void *eigenvalues,
 {
 	std::list< coord_block > blocks;
 	block_data b;
-	
-	while( r.next_block( b ) ){
-		id_map im( b.ids, b.N );
+	id_map im;
+	std::vector<py_int> wanted, idx;
+
+	while( !r.next_block( b ) ){
+		// Frames usually list the atoms in the same order, so the
+		// map of the last one only needs a few patches, if any.
+		im.update( b.ids, b.N );
 		py_int Nparticles = b.N;
-		
+
+		// Row i holds atom id i + 1.
+		if( static_cast<py_int>( wanted.size() ) != Nparticles ){
+			wanted.resize( Nparticles );
+			for( py_int i = 0; i < Nparticles; ++i ) wanted[i] = i + 1;
+			idx.resize( Nparticles );
+		}
+		im.map_ids( wanted.data(), idx.data(), Nparticles );
+
 		coord_block block( Nparticles );
 		for( int i = 0; i < Nparticles; ++i ){
-			int id  = i + 1;
-			int idx = im[id];
-
-			block[i][0] = b.x[i][0];
-			block[i][1] = b.x[i][1];
-			block[i][2] = b.x[i][2];
+			if( idx[i] < 0 ){
+				std::cerr << "Atom id " << i + 1 << " is missing from "
+				          << "block at t = " << b.tstep << "!\n";
+				std::terminate();
+			}
+			block[i][0] = b.x[idx[i]][0];
+			block[i][1] = b.x[idx[i]][1];
+			block[i][2] = b.x[idx[i]][2];
 		}
 
 		blocks.push_back( block );
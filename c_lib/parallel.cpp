@@ -0,0 +1,65 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+
+namespace {
+
+std::atomic<int> lib_threads( 0 );
+
+int threads_per_core()
+{
+	int n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+int threads_from_env()
+{
+	for( const char *var : { "LAMMPSTOOLS_NUM_THREADS", "OMP_NUM_THREADS" } ){
+		const char *val = std::getenv( var );
+		if( !val ) continue;
+		int n = std::atoi( val );
+		if( n > 0 ) return n;
+	}
+	return threads_per_core();
+}
+
+} // namespace
+
+
+extern "C" {
+
+void set_n_threads( py_int n )
+{
+	if( n == 0 ){
+		lib_threads = threads_from_env();
+	}else if( n < 0 ){
+		lib_threads = threads_per_core();
+	}else{
+		lib_threads = n;
+	}
+}
+
+
+py_int get_n_threads()
+{
+	int n = lib_threads;
+	if( n == 0 ){
+		// Racing first calls all store the same value.
+		n = threads_from_env();
+		lib_threads = n;
+	}
+	return n;
+}
+
+} // extern "C"
+
+
+int threads_for( std::size_t work, std::size_t min_work )
+{
+	std::size_t n = std::min<std::size_t>( get_n_threads(),
+	                                       work / std::max<std::size_t>( min_work, 1 ) );
+	return std::max<std::size_t>( n, 1 );
+}
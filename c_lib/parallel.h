@@ -0,0 +1,63 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/*!
+  \file parallel.h
+  @brief The number of threads the analysis routines use, and a helper
+         to run work on that many threads.
+
+  \ingroup cpp_lib
+*/
+
+#include "types.h"
+
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+
+extern "C" {
+
+/*!
+  @brief Sets the number of threads the analysis routines (such as the
+         neighbor list builders) use.
+
+  If \p n is 0, the number is taken from the environment variable
+  LAMMPSTOOLS_NUM_THREADS, or else OMP_NUM_THREADS, or else it is one
+  per core. This is also what happens if set_n_threads is never called.
+  If \p n is negative, it is one per core.
+*/
+void set_n_threads( py_int n );
+
+/// Returns the number of threads the analysis routines use.
+py_int get_n_threads();
+
+}
+
+
+/**
+   Returns how many threads to use for \p work items of work, so that
+   every thread gets at least \p min_work items. At least 1, at most
+   get_n_threads().
+*/
+int threads_for( std::size_t work, std::size_t min_work = 16384 );
+
+
+/**
+   Calls f(t) for t = 0, ..., n_threads - 1, each on its own thread,
+   and returns when all calls have. f(0) runs on the calling thread.
+*/
+template <typename F>
+void run_threads( int n_threads, F &&f )
+{
+	std::vector<std::thread> threads;
+	for( int t = 1; t < n_threads; ++t ){
+		threads.emplace_back( std::ref( f ), t );
+	}
+	f( 0 );
+	for( std::thread &th : threads ) th.join();
+}
+
+
+#endif /* PARALLEL_H */
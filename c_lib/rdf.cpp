@@ -6,7 +6,6 @@
 
 #include <algorithm>
 #include <cmath>
-#include <list>
 #include <iostream>
 #include <algorithm>
 #include <cassert>
@@ -19,7 +18,7 @@ void compute_rdf_impl( const arr3f &x, py_int N, const arr1i &ids,
                        const arr1i &types, py_float x0, py_float x1,
                        py_int nbins, py_int itype, py_int jtype,
                        py_float *xlo, py_float *xhi,
-                       py_int periodic, py_int dim, std::list<py_int> *neighs,
+                       py_int periodic, py_int dim, const neighbor_list &neighs,
                        arr1f &ardf, arr1f &acoord )
 {
 	double dr  = (x1 - x0) / ( nbins - 1 );
@@ -64,9 +63,7 @@ void compute_rdf_impl( const arr3f &x, py_int N, const arr1i &ids,
 		if( itype && (types[i] != itype) ) continue;
 		
 		py_int id = ids[i];
-		const std::list<py_int> &curr = neighs[i];
-		
-		for ( py_int j : curr ){
+		for ( py_int j : neighs[i] ){
 			// if( jd <= id ) continue;
 			if( ids[j] >= ids[i] ) continue;
 			if( jtype && (types[j] != jtype) ) continue;
@@ -131,7 +128,7 @@ void compute_rdf_impl( const arr3f &x, py_int N, const arr1i &ids,
 
 void compute_adf_impl( const arr3f &x, py_int N, const arr1i &ids,
                        const arr1i &types, py_int nbins, py_int itype, py_int jtype,
-                       py_float R, std::list<py_int> *neighs, arr1f &aadf, arr1f &acoord )
+                       py_float R, const neighbor_list &neighs, arr1f &aadf, arr1f &acoord )
 {
 	// First check if the atom positions are all on the sphere:
 	const double R2 = R*R;
@@ -236,16 +233,13 @@ void compute_rdf( void *px, py_int N, py_int *pids, py_int *ptypes,
 	arr1f coord( pcoord, nbins );
 
 	// Make neigh list first:
-	py_int max_id = *std::max_element( ids.begin(), ids.end() );
-	std::list<py_int> *neighs = new std::list<py_int>[max_id+1];
+	neighbor_list neighs;
 
 	neighborize_impl( x, N, ids, types, x1+0.1, periodic,
 	                  xlo, xhi, dim, method, neighs, 0, 0 );
 
 	compute_rdf_impl( x, N, ids, types, x0, x1, nbins, itype, jtype,
 	                  xlo, xhi, periodic, dim, neighs, rdf, coord );
-
-	delete [] neighs;
 }
 
 
@@ -306,23 +300,17 @@ void test_rdf()
 	py_float r0 = 0, r1 = 5.0;
 	py_float dr = (r1 - r0)/(nbins-1);
 
-	py_int max_id = *std::max_element(ids.begin(), ids.end());
-	std::list<py_int> *neighs = new std::list<py_int>[max_id+1];
+	neighbor_list neighs;
 
 	neighborize_impl( x, N, ids, types, r1+0.1, 1,
 	                  xlo, xhi, 3, DIST_BIN, neighs, 0, 0 );
 	
 	fprintf( stdout, "Neighbors:\n");
-	for( py_int i = 0; i < max_id+1; ++i ){
+	for( py_int i = 0; i < N; ++i ){
 		my_out << "neighs[ " << i << " ]: ";
-		for ( std::list<py_int>::const_iterator j = neighs[i].begin();
-		      j != neighs[i].end(); ++j ){
-			my_out << *j;
-			std::list<py_int>::const_iterator next = j;
-			next++;
-			if( next != neighs[i].end() ){
-				my_out << " --> ";
-			}
+		for( py_int k = 0; k < neighs.degree(i); ++k ){
+			if( k ) my_out << " --> ";
+			my_out << neighs[i][k];
 		}
 		my_out << "\n";
 	}
@@ -337,7 +325,6 @@ void test_rdf()
 		fprintf(stdout,"%ld  %f   %f   %f\n",i, r, rdf[i], coord[i]);
 	}
 
-	delete [] neighs;
 	delete [] rdf_data;
 	delete [] coord_data;
 	for( py_int i = 0; i < N; ++i ){
@@ -366,8 +353,7 @@ void compute_adf( void *px, py_int N, py_int *pids, py_int *ptypes,
 	arr1f coord( pcoord, nbins );
 
 	// Make neigh list first:
-	py_int max_id = *std::max_element( ids.begin(), ids.end() );
-	std::list<py_int> *neighs = new std::list<py_int>[max_id+1];
+	neighbor_list neighs;
 
 	py_float *xlo = nullptr, *xhi = nullptr;
 	
@@ -383,8 +369,6 @@ void compute_adf( void *px, py_int N, py_int *pids, py_int *ptypes,
 
 	compute_adf_impl( x, N, ids, types, nbins, itype,
 	                  jtype, R, neighs, adf, coord );
-	
-	delete [] neighs;	
 }
 	
 
@@ -24,6 +24,7 @@ py_float rmsd_fluctuations_impl( dump_reader &r, std::vector<std::array<double,4
 	id_map im0( block.ids, block.N );
 	
 	std::vector<std::array<double, 3> > x_sor( block.N );
+	std::vector<py_int> idx( block.N );
 	double alpha = 0.95;
 
 	for( py_int i = 0; i < block.N; ++i ){
@@ -43,15 +44,12 @@ py_float rmsd_fluctuations_impl( dump_reader &r, std::vector<std::array<double,4
 		std::cerr << "Done filtering, now got " << block.N
 		          << " atoms...\n";
 		// Sort the positions into the same order as im0.
+		idx.resize( block.N );
+		im0.map_ids( block.ids, idx.data(), block.N );
 		for( int i = 0; i < block.N; ++i ){
-			int id  = block.ids[i];
-			int idx = im0.id_to_index( id );
-			
-			x_sor[idx][0] = block.x[i][0];
-			x_sor[idx][1] = block.x[i][1];
-			x_sor[idx][2] = block.x[i][2];
-			
-			
+			x_sor[idx[i]][0] = block.x[i][0];
+			x_sor[idx[i]][1] = block.x[i][1];
+			x_sor[idx[i]][2] = block.x[i][2];
 		}
 
 		// Now perform the moving average:
@@ -97,11 +95,12 @@ py_float get_msd( const block_data &b1, const block_data &b0, py_float *msd )
 {
 	double tmsd = 0.0;
 	id_map im1( b1.ids, b1.N );
-	
+	std::vector<py_int> idx( b0.N );
+	im1.map_ids( b0.ids, idx.data(), b0.N );
+
 	for( int i = 0; i < b0.N; ++i ){
-		long int id0 = b0.ids[i];
 		const double* x0 = b0.x[i];
-		const double *x1 = b1.x[ im1[id0] ];
+		const double *x1 = b1.x[ idx[i] ];
 
 		double dx = x0[0] - x1[0];
 		double dy = x0[1] - x1[1];
@@ -1,12 +1,14 @@
 #include "similarity.h"
 #include "types.h"
 #include "random_pcg.h"
+#include "kd_tree.h"
 
 #include <iostream>
 #include <cmath>
 #include <armadillo>
 
 #include <memory>
+#include <vector>
 
 constexpr const static double HALF_PI = 1.57079632679490;
 constexpr const static double PI =      3.14159265358979;
@@ -421,28 +423,16 @@ py_float rotate_to_template_impl( const arr3f &xi, const arr3f &xt, py_int N,
 	// std::cerr << "Dot of major axes: " << dot(maj_ax,maj_ax_t) << ".\n";
 	// std::cerr << "Dot of minor axes: " << dot(min_ax,min_ax_t) << ".\n";
 
-	// Now determine the rmsd:
+	// Now determine the rmsd, from the nearest template particle of
+	// each rotated one:
+	kd_tree tree( xt, N );
+	std::vector<py_int> nearest( N );
+	std::vector<py_float> mr2( N );
+	tree.knn( rot_data, N, 1, nearest.data(), mr2.data() );
+
 	py_float rmsd = 0.0;
 	for( int i = 0; i < N; ++i ){
-		py_float dx, dy, dz;
-		
-		dx = rot_data[i][0] - xt[0][0];
-		dy = rot_data[i][1] - xt[0][1];
-		dz = rot_data[i][2] - xt[0][2];
-		
-		double r2 = dx*dx + dy*dy + dz*dz;
-		double mr2 = r2;
-		for( int j = 1; j < N; ++j ){
-			dx = rot_data[i][0] - xt[j][0];
-			dy = rot_data[i][1] - xt[j][1];
-			dz = rot_data[i][2] - xt[j][2];
-		
-			r2 = dx*dx + dy*dy + dz*dz;
-			if ( r2 < mr2 ){
-				mr2 = r2;
-			}
-		}
-		rmsd += mr2;
+		rmsd += mr2[i];
 	}
 
 	if ( !xrot ){
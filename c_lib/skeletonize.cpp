@@ -1,11 +1,9 @@
 #include "skeletonize.h"
 #include "dump_reader.h"
 #include "neighborize.h"
-#include "id_map.h"
 #include "triangulate.h"
 
 #include <cmath>
-#include <list>
 #include <algorithm>
 
 struct graph_vertex
@@ -47,18 +45,14 @@ double sphere_dist( const double *xi, const double *xj, double R )
 
 
 std::vector<double> get_insideness( const block_data &b,
-                                    std::vector<std::list<py_int> > *neigh_ptr )
+                                    const neighbor_list *neigh_ptr )
 {
-	std::vector< std::list<py_int> > nneighs;
-	std::vector< std::list<py_int> > *neigh_ptr2 = &nneighs;
-	if( neigh_ptr ){
-		neigh_ptr2 = neigh_ptr;
-	}
-	std::vector< std::list<py_int> > &neighs = *neigh_ptr2;
-
+	neighbor_list nneighs;
 	if( !neigh_ptr ){
-		neighborize_block( b, neighs );
+		neighborize_block( b, nneighs );
+		neigh_ptr = &nneighs;
 	}
+	const neighbor_list &neighs = *neigh_ptr;
 	
 	std::vector<double> insideness( b.N );
 	for( int i = 0; i < b.N; ++i ){
@@ -67,7 +61,7 @@ std::vector<double> get_insideness( const block_data &b,
 
 	
 	for( py_int i = 0; i < b.N; ++i ){
-		if( neighs[i].size() < 6 ){
+		if( neighs.degree(i) < 6 ){
 			insideness[i] = 0.0;
 		}
 	}
@@ -75,7 +69,6 @@ std::vector<double> get_insideness( const block_data &b,
 	// Stategy: Recursively loop over all points in network. Those that
 	// are not yet determined to be anywhere are assigned the lowest value
 	// of their neighbouring insideness plus one.
-	id_map im( b.ids, b.N );	
 	bool assigned_one = false;
 	double current_val = 0.0;
 	// std::cerr << "Finding insideness. At loop 0...";
@@ -87,9 +80,8 @@ std::vector<double> get_insideness( const block_data &b,
 			}
 			py_int idi = b.ids[i];
 
-			const std::list<py_int> &ni = neighs[i];
 			bool has_current_val = false;
-			for( py_int idx : ni ){
+			for( py_int idx : neighs[i] ){
 				int idj = b.ids[idx];
 				if( insideness[idx] == current_val ){
 					has_current_val = true;
@@ -179,7 +171,7 @@ void skeletonize_alg1( const block_data &b, std::vector<py_int> &skeleton,
 	}
 	std::cerr << "max dist = " << d_max << " for particle " << i << ".\n";
 	out[i] = true;
-	std::vector<std::list<py_int> > neighs;
+	neighbor_list neighs;
 	neighborize_block( b, neighs );
 	skeleton.push_back(i);
 	
@@ -236,7 +228,7 @@ void skeletonize_alg2( const block_data &b, std::vector<py_int> &skeleton,
 }
 
 void skeletonize_cgal( const block_data &b, std::vector<py_int> &skeleton,
-                       const std::vector<std::list<py_int> > &neighs )
+                       const neighbor_list &neighs )
 {
 	// Construct a triangulated mesh of the points:
 	for( int i = 0; i < b.N; ++i ){
@@ -272,7 +264,7 @@ void get_edge( const block_data &b, const std::vector<double> &insideness,
 	}
 }
 
-void get_local_maxima( const std::vector<std::list<py_int> > &neighs,
+void get_local_maxima( const neighbor_list &neighs,
                        const std::vector<double> &field,
                        std::vector<py_int> &max_indices )
 {
@@ -281,16 +273,16 @@ void get_local_maxima( const std::vector<std::list<py_int> > &neighs,
 }
 
 
-void get_local_maxima( const std::vector<std::list<py_int> > & neighs,
+void get_local_maxima( const neighbor_list &neighs,
                        const std::vector<double> &field,
                        std::vector<py_int> &max_indices,
                        std::function< double(double) > f )
 {
 	// d_out << "Indices of maxima:";
-	for( std::size_t idx = 0; idx < neighs.size(); ++idx ){
+	for( py_int idx = 0; idx < neighs.size(); ++idx ){
 		double vi = f( field[idx] );
 		bool largest = true;
-		for( std::size_t idj : neighs[idx] ){
+		for( py_int idj : neighs[idx] ){
 			if( f( field[idj] ) >= vi ){
 				largest = false;
 				break;
@@ -370,7 +362,7 @@ void get_stats( const std::vector<double> &values,
 void get_ribbon_data( block_data &b, ribbon_data &r_data )
 {
 	std::cerr << "This is get_ribbon_data...\n";	
-	std::vector<std::list<py_int> > neighs;
+	neighbor_list neighs;
 	neighborize_block( b, neighs );
 
 	std::vector<double> insideness = get_insideness( b, &neighs );
@@ -2,10 +2,10 @@
 #define SKELETONIZE_H
 
 #include <vector>
-#include <list>
 #include <functional>
 
 #include "types.h"
+#include "neighbor_list.h"
 
 
 struct ribbon_data
@@ -36,7 +36,7 @@ void get_euclidian_distance_transform( void *x, py_int N, py_int *ids,
 
 
 std::vector<double> get_insideness( const class block_data &b,
-                                    std::vector<std::list<py_int> > *neigh_ptr = nullptr );
+                                    const neighbor_list *neigh_ptr = nullptr );
 
 
 std::vector<double> euclidian_distance_transform( const class block_data &b,
@@ -54,11 +54,11 @@ void skeletonize( const block_data &b, std::vector<py_int> &skeleton,
                   const std::vector<double> &distance_map, double R );
 
 
-void get_local_maxima( const std::vector<std::list<py_int> > &neighs,
+void get_local_maxima( const neighbor_list &neighs,
                        const std::vector<double> &field,
                        std::vector<py_int> &max_indices );
 
-void get_local_maxima( const std::vector<std::list<py_int> > & neighs,
+void get_local_maxima( const neighbor_list &neighs,
                        const std::vector<double> &field,
                        std::vector<py_int> &max_indices,
                        std::function< double(double) > );
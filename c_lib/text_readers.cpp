@@ -1,7 +1,44 @@
 #include "text_readers.h"
+#include "bgzf.h"
+#include "zstd_seekable.h"
 
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <limits>
+
+#ifdef HAVE_LIB_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LIB_LZ4
+#include <lz4frame.h>
+#endif
+
+
+namespace {
+
+// Skips n lines of a stream. For char streams, ignore scans the
+// stream buffer with memchr, no line is copied.
+bool ignore_lines( std::istream &in, std::size_t n )
+{
+	for( std::size_t i = 0; i < n; ++i ){
+		in.ignore( std::numeric_limits<std::streamsize>::max(), '\n' );
+		if( in.gcount() == 0 ) return false;
+	}
+	return true;
+}
+
+} // namespace
+
+
+bool text_reader::skip_lines( std::size_t n )
+{
+	std::string line;
+	for( std::size_t i = 0; i < n; ++i ){
+		if( !getline( line ) ) return false;
+	}
+	return true;
+}
 
 
 
@@ -37,6 +74,26 @@ int text_reader_plain::peek()
 	return in->peek();
 }
 
+bool text_reader_plain::skip_lines( std::size_t n )
+{
+	return ignore_lines( *in, n );
+}
+
+bool text_reader_plain::seek( std::size_t offset )
+{
+	in->clear();
+	in->seekg( offset );
+	return in->good();
+}
+
+bool text_reader_plain::tell( std::size_t &offset )
+{
+	std::streampos p = in->tellg();
+	if( p < 0 ) return false;
+	offset = p;
+	return true;
+}
+
 bool text_reader_plain::eof() const
 {
 	if( in ) return in->eof();
@@ -92,6 +149,15 @@ int text_reader_gzip::peek()
 #endif
 }
 
+bool text_reader_gzip::skip_lines( std::size_t n )
+{
+#ifdef HAVE_BOOST_GZIP
+	return ignore_lines( in, n );
+#else
+	return false;
+#endif
+}
+
 bool text_reader_gzip::eof()  const
 {
 #ifdef HAVE_BOOST_GZIP
@@ -109,3 +175,322 @@ bool text_reader_gzip::good() const
 	return false;
 #endif
 }
+
+
+
+text_reader_bgzf::text_reader_bgzf( const std::string &fname, int n_threads )
+	: text_reader( fname ), in( nullptr )
+{
+	in = new bgzf_stream( fname, n_threads );
+}
+
+text_reader_bgzf::~text_reader_bgzf()
+{
+	if( in ) delete in;
+}
+
+bool text_reader_bgzf::getline( std::string &line )
+{
+	return in->getline( line );
+}
+
+int text_reader_bgzf::peek()
+{
+	return in->peek();
+}
+
+bool text_reader_bgzf::skip_lines( std::size_t n )
+{
+	return in->skip_lines( n );
+}
+
+bool text_reader_bgzf::seek( std::size_t offset )
+{
+	return in->seek( offset );
+}
+
+bool text_reader_bgzf::eof() const
+{
+	return in->eof();
+}
+
+bool text_reader_bgzf::good() const
+{
+	return in->good();
+}
+
+
+
+text_reader_decompress::text_reader_decompress( const std::string &fname )
+	: text_reader( fname ), in( nullptr ), in_buff( 1 << 17 ),
+	  in_pos( 0 ), in_size( 0 ), out_buff( 1 << 17 ), out_pos( 0 ),
+	  out_size( 0 ), eof_( false ), good_( true )
+{
+	in = std::fopen( fname.c_str(), "rb" );
+	if( !in ){
+		std::cerr << "Failed to open file " << fname << "!\n";
+		std::terminate();
+	}
+}
+
+text_reader_decompress::~text_reader_decompress()
+{
+	if( in ) std::fclose( in );
+}
+
+bool text_reader_decompress::getline( std::string &line )
+{
+	line.clear();
+	while( true ){
+		if( out_pos == out_size ){
+			if( !refill() ){
+				eof_ = true;
+				return !line.empty();
+			}
+			continue;
+		}
+		const char *p   = out_buff.data() + out_pos;
+		const char *end = out_buff.data() + out_size;
+		const char *nl  = static_cast<const char*>(
+			std::memchr( p, '\n', end - p ) );
+		if( nl ){
+			line.append( p, nl );
+			out_pos += nl - p + 1;
+			return true;
+		}
+		line.append( p, end );
+		out_pos = out_size;
+	}
+}
+
+bool text_reader_decompress::skip_lines( std::size_t n )
+{
+	// Like getline, a last line without newline counts.
+	bool in_line = false;
+	while( n > 0 ){
+		if( out_pos == out_size ){
+			if( !refill() ){
+				eof_ = true;
+				return n == 1 && in_line;
+			}
+			continue;
+		}
+		const char *p   = out_buff.data() + out_pos;
+		const char *end = out_buff.data() + out_size;
+		const char *q   = p;
+		const char *nl;
+		while( n > 0 && ( nl = static_cast<const char*>(
+			                  std::memchr( q, '\n', end - q ) ) ) ){
+			q = nl + 1;
+			--n;
+		}
+		out_pos += q - p;
+		if( n > 0 ){
+			in_line = q < end;
+			out_pos = out_size;
+		}
+	}
+	return true;
+}
+
+int text_reader_decompress::peek()
+{
+	while( out_pos == out_size ){
+		if( !refill() ){
+			eof_ = true;
+			return EOF;
+		}
+	}
+	return static_cast<unsigned char>( out_buff[out_pos] );
+}
+
+bool text_reader_decompress::eof() const
+{
+	return eof_;
+}
+
+bool text_reader_decompress::good() const
+{
+	return good_ && !eof_;
+}
+
+bool text_reader_decompress::restart( std::size_t coffset )
+{
+	in_pos = in_size = 0;
+	out_pos = out_size = 0;
+	eof_  = false;
+	good_ = std::fseek( in, coffset, SEEK_SET ) == 0;
+	return good_;
+}
+
+bool text_reader_decompress::discard( std::size_t n )
+{
+	while( n > 0 ){
+		if( out_pos == out_size && !refill() ) return false;
+		std::size_t m = std::min( n, out_size - out_pos );
+		out_pos += m;
+		n -= m;
+	}
+	return true;
+}
+
+
+
+text_reader_zstd::text_reader_zstd( const std::string &fname )
+	: text_reader_decompress( fname ), dctx( nullptr ), table( nullptr )
+{
+#ifndef HAVE_LIB_ZSTD
+	std::cerr << "Cannot read zstd files without libzstd support!\n";
+	std::terminate();
+#else
+	dctx = ZSTD_createDCtx();
+	table = new zstd_seek_table;
+	if( !table->read( in ) ){
+		delete table;
+		table = nullptr;
+	}
+	restart( 0 );
+#endif
+}
+
+text_reader_zstd::~text_reader_zstd()
+{
+#ifdef HAVE_LIB_ZSTD
+	if( dctx ) ZSTD_freeDCtx( dctx );
+#endif
+	if( table ) delete table;
+}
+
+bool text_reader_zstd::is_seekable( const std::string &fname )
+{
+	std::FILE *f = std::fopen( fname.c_str(), "rb" );
+	if( !f ) return false;
+	zstd_seek_table t;
+	bool seekable = t.read( f );
+	std::fclose( f );
+	return seekable;
+}
+
+bool text_reader_zstd::refill()
+{
+#ifdef HAVE_LIB_ZSTD
+	if( !good_ ) return false;
+	while( true ){
+		if( in_pos == in_size ){
+			in_size = std::fread( in_buff.data(), 1, in_buff.size(), in );
+			in_pos = 0;
+			if( in_size == 0 ) return false;
+		}
+		ZSTD_inBuffer  ib = { in_buff.data(), in_size, in_pos };
+		ZSTD_outBuffer ob = { out_buff.data(), out_buff.size(), 0 };
+		std::size_t ret = ZSTD_decompressStream( dctx, &ob, &ib );
+		if( ZSTD_isError( ret ) ){
+			std::cerr << "zstd decompression failed: "
+			          << ZSTD_getErrorName( ret ) << "\n";
+			good_ = false;
+			return false;
+		}
+		in_pos = ib.pos;
+		if( ob.pos > 0 ){
+			out_pos  = 0;
+			out_size = ob.pos;
+			return true;
+		}
+	}
+#else
+	return false;
+#endif // HAVE_LIB_ZSTD
+}
+
+bool text_reader_zstd::seek( std::size_t offset )
+{
+#ifdef HAVE_LIB_ZSTD
+	std::size_t frame = 0;
+	if( table ){
+		if( static_cast<py_int>( offset ) > table->uoffset( table->size() ) ){
+			return false;
+		}
+		frame = table->find( offset );
+	}else if( offset != 0 ){
+		// Without seek table only rewinding is possible.
+		return false;
+	}
+
+	ZSTD_DCtx_reset( dctx, ZSTD_reset_session_only );
+	py_int coffset = table ? table->coffset( frame ) : 0;
+	py_int uoffset = table ? table->uoffset( frame ) : 0;
+	if( !restart( coffset ) ) return false;
+	return discard( offset - uoffset );
+#else
+	return false;
+#endif // HAVE_LIB_ZSTD
+}
+
+
+
+text_reader_lz4::text_reader_lz4( const std::string &fname )
+	: text_reader_decompress( fname ), dctx( nullptr )
+{
+#ifndef HAVE_LIB_LZ4
+	std::cerr << "Cannot read lz4 files without liblz4 support!\n";
+	std::terminate();
+#else
+	if( LZ4F_isError( LZ4F_createDecompressionContext( &dctx,
+	                                                    LZ4F_VERSION ) ) ){
+		std::cerr << "Failed to set up lz4 decompression!\n";
+		std::terminate();
+	}
+#endif
+}
+
+text_reader_lz4::~text_reader_lz4()
+{
+#ifdef HAVE_LIB_LZ4
+	if( dctx ) LZ4F_freeDecompressionContext( dctx );
+#endif
+}
+
+bool text_reader_lz4::refill()
+{
+#ifdef HAVE_LIB_LZ4
+	if( !good_ ) return false;
+	while( true ){
+		if( in_pos == in_size ){
+			in_size = std::fread( in_buff.data(), 1, in_buff.size(), in );
+			in_pos = 0;
+			if( in_size == 0 ) return false;
+		}
+		std::size_t n_out = out_buff.size();
+		std::size_t n_in  = in_size - in_pos;
+		std::size_t ret = LZ4F_decompress( dctx, out_buff.data(), &n_out,
+		                                   in_buff.data() + in_pos, &n_in,
+		                                   nullptr );
+		if( LZ4F_isError( ret ) ){
+			std::cerr << "lz4 decompression failed: "
+			          << LZ4F_getErrorName( ret ) << "\n";
+			good_ = false;
+			return false;
+		}
+		in_pos += n_in;
+		if( n_out > 0 ){
+			out_pos  = 0;
+			out_size = n_out;
+			return true;
+		}
+	}
+#else
+	return false;
+#endif // HAVE_LIB_LZ4
+}
+
+bool text_reader_lz4::seek( std::size_t offset )
+{
+#ifdef HAVE_LIB_LZ4
+	// LZ4 frames have no seek table, so only rewinding is possible.
+	if( offset != 0 ) return false;
+	LZ4F_resetDecompressionContext( dctx );
+	return restart( 0 );
+#else
+	return false;
+#endif // HAVE_LIB_LZ4
+}
@@ -1,14 +1,21 @@
 #ifndef TEXT_READERS_H
 #define TEXT_READERS_H
 
+#include <cstdio>
 #include <iosfwd>
 #include <string>
+#include <vector>
 
 #ifdef HAVE_BOOST_GZIP
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #endif
 
+class bgzf_stream;
+class zstd_seek_table;
+struct ZSTD_DCtx_s;
+struct LZ4F_dctx_s;
+
 /** 
     A general interface to read in text files.
 */
@@ -19,6 +26,13 @@ public:
 	virtual ~text_reader(){}
 	virtual bool getline( std::string &line ){ return 0; }
 	virtual int  peek(){ return 0; }
+	/// Moves past the next n lines without copying them anywhere.
+	/// Returns false if the file has fewer lines left.
+	virtual bool skip_lines( std::size_t n );
+	virtual bool seek( std::size_t offset ){ return false; }
+	/// Stores the offset of the next line in \p offset. Returns false
+	/// if the reader does not know it.
+	virtual bool tell( std::size_t &offset ){ return false; }
 
 	virtual bool eof()  const = 0;
 	virtual bool good() const = 0;
@@ -34,6 +48,9 @@ public:
 	virtual ~text_reader_plain();
 	virtual bool getline( std::string &line );
 	virtual int peek();
+	virtual bool skip_lines( std::size_t n );
+	virtual bool seek( std::size_t offset );
+	virtual bool tell( std::size_t &offset );
 
 	virtual bool eof()  const;
 	virtual bool good() const;
@@ -54,6 +71,7 @@ public:
 
 	virtual bool getline( std::string &line );
 	virtual int peek();
+	virtual bool skip_lines( std::size_t n );
 
 	virtual bool eof()  const;
 	virtual bool good() const;
@@ -67,6 +85,108 @@ private:
 
 
 
+/**
+    Reads in block-gzipped (BGZF) text files. The blocks are
+    decompressed on background threads and the reader can seek.
+*/
+class text_reader_bgzf : public text_reader
+{
+public:
+	/// n_threads is the number of decompressing threads,
+	/// see bgzf_stream.
+	text_reader_bgzf( const std::string &fname, int n_threads = 0 );
+	virtual ~text_reader_bgzf();
+
+	virtual bool getline( std::string &line );
+	virtual int peek();
+	virtual bool skip_lines( std::size_t n );
+	virtual bool seek( std::size_t offset );
+
+	virtual bool eof()  const;
+	virtual bool good() const;
+
+private:
+	bgzf_stream *in;
+};
+
+
+/**
+    Base for text readers that decompress the file into a buffer
+    themselves. Derived classes only need to implement refill.
+*/
+class text_reader_decompress : public text_reader
+{
+public:
+	text_reader_decompress( const std::string &fname );
+	virtual ~text_reader_decompress();
+
+	virtual bool getline( std::string &line );
+	virtual int peek();
+	virtual bool skip_lines( std::size_t n );
+
+	virtual bool eof()  const;
+	virtual bool good() const;
+
+protected:
+	std::FILE *in;
+	std::vector<char> in_buff;   ///< Compressed data read from in
+	std::size_t in_pos, in_size;
+	std::vector<char> out_buff;  ///< Decompressed data
+	std::size_t out_pos, out_size;
+	bool eof_, good_;
+
+	/// Decompresses the next piece of the file into out_buff.
+	/// Returns false at the end of the file or on errors.
+	virtual bool refill() = 0;
+
+	/// Moves to compressed offset coffset and drops all buffers.
+	bool restart( std::size_t coffset );
+	/// Drops the next n bytes of decompressed data.
+	bool discard( std::size_t n );
+};
+
+
+/**
+    Reads in zstd-compressed text files. Files in the seekable zstd
+    format can seek to any offset, others can only rewind.
+*/
+class text_reader_zstd : public text_reader_decompress
+{
+public:
+	text_reader_zstd( const std::string &fname );
+	virtual ~text_reader_zstd();
+
+	virtual bool seek( std::size_t offset );
+
+	/// True if fname has a seek table.
+	static bool is_seekable( const std::string &fname );
+
+private:
+	ZSTD_DCtx_s *dctx;
+	zstd_seek_table *table;
+
+	virtual bool refill();
+};
+
+
+/**
+    Reads in LZ4-compressed text files (LZ4 frame format).
+    Can only seek back to the start.
+*/
+class text_reader_lz4 : public text_reader_decompress
+{
+public:
+	text_reader_lz4( const std::string &fname );
+	virtual ~text_reader_lz4();
+
+	virtual bool seek( std::size_t offset );
+
+private:
+	LZ4F_dctx_s *dctx;
+
+	virtual bool refill();
+};
+
 
 
 #endif // TEXT_READERS_H
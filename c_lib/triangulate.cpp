@@ -1,6 +1,5 @@
 #include "triangulate.h"
 #include "neighborize.h"
-#include "communication.h"
 #include "util.h"
 #include "dump_reader.h"
 
@@ -12,20 +11,54 @@
 
 
 
-void triangulate_impl(const arr3f &, py_int , py_int *, py_int *,
-                      py_float , py_int, const py_float *, const py_float *,
-                      py_int , py_int , const char * );
-
 extern "C" {
 
+triangle_buffer *triangulate_to_buffer( void *x, py_int N, py_int *ids,
+                                        py_int *types, py_float rc,
+                                        py_int periodic,
+                                        const py_float *xlo,
+                                        const py_float *xhi, py_int dims,
+                                        py_int method )
+{
+	arr3f xi(x,N);
+	std::vector<triangle> triangles;
+	triangulate_impl( xi, N, ids, types, rc, periodic, xlo, xhi,
+	                  dims, method, triangles );
+
+	triangle_buffer *tb = new triangle_buffer;
+	tb->n_triangles = triangles.size();
+	tb->indices = new py_int[3*triangles.size()];
+	for( std::size_t t = 0; t < triangles.size(); ++t ){
+		tb->indices[3*t]   = triangles[t].i1;
+		tb->indices[3*t+1] = triangles[t].i2;
+		tb->indices[3*t+2] = triangles[t].i3;
+	}
+	return tb;
+}
+
+void release_triangle_buffer( triangle_buffer *tb )
+{
+	if( tb ){
+		delete [] tb->indices;
+		delete tb;
+	}
+}
+
 void triangulate( void *x, py_int N, py_int *ids, py_int *types,
                   py_float rc, py_int periodic,
                   const py_float *xlo, const py_float *xhi, py_int dims,
                   py_int method, const char *pname )
 {
-	arr3f xi(x,3);
-	triangulate_impl( xi, N, ids, types, rc, periodic, xlo, xhi,
-	                  dims, method, pname );
+	triangle_buffer *tb = triangulate_to_buffer( x, N, ids, types, rc,
+	                                             periodic, xlo, xhi,
+	                                             dims, method );
+	std::ofstream pout( pname );
+	for( py_int t = 0; t < tb->n_triangles; ++t ){
+		pout << tb->indices[3*t] << " " << tb->indices[3*t+1] << " "
+		     << tb->indices[3*t+2] << "\n";
+	}
+	pout.close();
+	release_triangle_buffer( tb );
 }
 
 }
@@ -39,11 +72,11 @@ double vec_dist( const arr3f &x, int i, int j )
 }
 
 int insert_triangle( const arr3f &x, int i, int j, int k, int **out,
-                      std::vector<triangle> &triangles, std::list<py_int> *neighs )
+                      std::vector<triangle> &triangles, const neighbor_list &neighs )
 {
 	bool added = 0;
 	if( (i < k) && (j < k) ){
-		if( list_has(neighs[i], k) ){
+		if( neighs.has(i, k) ){
 			double rij = vec_dist( x, i, j );
 			double rik = vec_dist( x, i, k );
 			double rjk = vec_dist( x, j, k );
@@ -75,147 +108,47 @@ int insert_triangle( const arr3f &x, int i, int j, int k, int **out,
 void triangulate_impl( const arr3f &x, py_int N, py_int *ids, py_int *types,
                        py_float rc, py_int periodic, const py_float *xlo,
                        const py_float *xhi, py_int dims, py_int method,
-                       const char *pname )
+                       std::vector<triangle> &triangles )
 {
 	// Make a neighbour list first:
 	arr1i iids(ids,N);
 	arr1i ttypes(types,N);
 
-	std::list<py_int> *neighs = new std::list<py_int>[N];
+	neighbor_list neighs;
 	
 	neighborize_impl( x, N, iids, ttypes, rc, periodic, xlo, xhi,
 	                  dims, method, neighs, 0, 0 );
 
-
-
-	std::vector<py_int> v_ids( ids, ids + N );
-	py_int max_id = *std::max_element( v_ids.begin(), v_ids.end() );
-	std::vector<py_int> id_map( max_id + 1 );
-
-	std::vector<triangle> triangles;
-	
-	for( py_int i = 0; i < N; ++i ){
-		id_map[ ids[i] ] = i;
-	}
-
-	int N2 = N*N;
-	int *idx_out_  = new int[N*N];
-	int **idx_out  = new int*[N];
-	
-	
-	for( int i = 0; i < N; ++i ){
-		idx_out[i] = idx_out_ + N*i;
-		for( int j = 0; j < N; ++j ){
-			idx_out_[i + j*N] = 0;
-		}
-	}
-
-	int added = 0;
 	for( py_int ii = 0; ii < N; ++ii ){
 		// loop over all neighs of i1:
-
-		const std::list<py_int> &l = neighs[ii];
-		for( py_int j : l ){
-			if( (ii < j) && (idx_out[ii][j] < 3) ){
-				// Now you got two ids... ids[i] and j. All you need
-				// to know now is if neighs[j] contains ids that are
-				// also in neighs[i]! However, if i and j were already
-				// added twice, you can safely skip them.
+		for( py_int j : neighs[ii] ){
+			if( ii < j ){
+				// Now you got two indices, ii and j. All you need
+				// to know now is if neighs[j] contains indices
+				// that are also in neighs[ii]!
 				for( py_int k : neighs[j] ){
 					if( (ii < k) && (j < k) &&
-					    list_has( neighs[k], ii ) ){
+					    neighs.has( k, ii ) ){
 						
 						// Add triangle:
 						triangles.push_back(
 							triangle(ii,j,k,x[ii],
 							         x[j],x[k]) );
-						++added;
 					}
 				}
 			}
 			
 		}
 	}
-
-
-	std::ofstream pout( pname );
-	for( const triangle &t : triangles ){
-		pout << t.i1 << " " << t.i2 << " " << t.i3 << "\n";
-	}
-	close_pipe( pname );
-
-	
-	delete [] idx_out_;
-	delete [] idx_out;
-	
-	delete [] neighs;
 }
 
 
 void triangulate_block( block_data &b, py_float rc, py_int periodic,
                         py_int dims, py_int method, std::vector<triangle> &triangles )
 {
-	// Make a neighbour list first:
-	std::size_t N = b.N;
-	
-	arr1i iids(b.ids ,N);
-	arr1i ttypes(b.types ,N);
-	arr3f xx(b.x, N);
-	std::list<py_int> *neighs = new std::list<py_int>[N];
-	
-	neighborize_impl( xx, N, iids, ttypes, rc, periodic,
-	                  b.xlo, b.xhi, dims, method, neighs, 0, 0 );
-	std::vector<py_int> v_ids( b.ids, b.ids + N );
-	py_int max_id = *std::max_element( v_ids.begin(), v_ids.end() );
-	std::vector<py_int> id_map( max_id + 1 );
-	
-	for( py_int i = 0; i < N; ++i ){
-		id_map[ b.ids[i] ] = i;
-	}
-
-	int N2 = N*N;
-	int *idx_out_  = new int[N*N];
-	int **idx_out  = new int*[N];
-	
-	
-	for( int i = 0; i < N; ++i ){
-		idx_out[i] = idx_out_ + N*i;
-		for( int j = 0; j < N; ++j ){
-			idx_out_[i + j*N] = 0;
-		}
-	}
-
-	int added = 0;
-	for( py_int ii = 0; ii < N; ++ii ){
-		// loop over all neighs of i1:
-
-		const std::list<py_int> &l = neighs[ii];
-		for( py_int j : l ){
-			if( (ii < j) && (idx_out[ii][j] < 3) ){
-				// Now you got two ids... ids[i] and j. All you need
-				// to know now is if neighs[j] contains ids that are
-				// also in neighs[i]! However, if i and j were already
-				// added twice, you can safely skip them.
-				for( py_int k : neighs[j] ){
-					if( (ii < k) && (j < k) &&
-					    list_has( neighs[k], ii ) ){
-						
-						// Add triangle:
-						triangles.push_back(
-							triangle(ii,j,k,xx[ii],
-							         xx[j],xx[k]) );
-						++added;
-					}
-				}
-			}
-		}
-	}
-
-
-	delete [] idx_out_;
-	delete [] idx_out;
-	
-	delete [] neighs;
+	arr3f xx(b.x_, b.N);
+	triangulate_impl( xx, b.N, b.ids, b.types, rc, periodic, b.xlo, b.xhi,
+	                  dims, method, triangles );
 }
 
 
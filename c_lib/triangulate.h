@@ -146,6 +146,33 @@ struct triangle
 extern "C"
 {
 
+/**
+   Triangles owned by the library, as three atom indices per triangle.
+   Free it with release_triangle_buffer.
+*/
+struct triangle_buffer
+{
+	py_int n_triangles;  ///< Number of triangles
+	py_int *indices;     ///< 3*n_triangles atom indices
+};
+
+/**
+   Triangulates the atoms in x and returns the triangles in a buffer
+   that Python can view directly. Release it with
+   release_triangle_buffer.
+*/
+triangle_buffer *triangulate_to_buffer( void *x, py_int N, py_int *ids,
+                                        py_int *types, py_float rc,
+                                        py_int periodic,
+                                        const py_float *xlo,
+                                        const py_float *xhi, py_int dims,
+                                        py_int method );
+
+/// Frees a triangle_buffer made by triangulate_to_buffer.
+void release_triangle_buffer( triangle_buffer *tb );
+
+/// \deprecated Writes the triangles to a named pipe, use
+///             triangulate_to_buffer instead.
 void triangulate( void *x, py_int N, py_int *ids, py_int *types,
                   py_float rc, py_int periodic,
                   const py_float *xlo, const py_float *xhi, py_int dims,
@@ -156,7 +183,7 @@ void triangulate( void *x, py_int N, py_int *ids, py_int *types,
 void triangulate_impl( const arr3f &x, py_int N, py_int *ids, py_int *types,
                        py_float rc, py_int periodic, const py_float *xlo,
                        const py_float *xhi, py_int dims, py_int method,
-                       const char *pname );
+                       std::vector<triangle> &triangles );
 
 
 void triangulate_block( class block_data &b, py_float rc, py_int periodic,
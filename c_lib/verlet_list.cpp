@@ -0,0 +1,234 @@
+#include "verlet_list.h"
+#include "block_data.h"
+#include "domain.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+
+verlet_list::verlet_list( py_float rc, py_float skin, py_int dims, int extras )
+	: rc( rc ), skin_( skin ), dims( dims == 2 ? 2 : 3 ), extras( extras ),
+	  valid( false ), N( 0 ), periodic( PERIODIC_NONE ), max_disp( 0.0 ),
+	  n_builds_( 0 ), n_updates_( 0 )
+{
+	for( int d = 0; d < 3; ++d ) lo[d] = hi[d] = 0.0;
+}
+
+
+bool verlet_list::update( const arr3f &x, py_int NN, const py_int *ids,
+                          py_int pperiodic, const py_float *xlo,
+                          const py_float *xhi )
+{
+	++n_updates_;
+	if( !xlo || !xhi ) pperiodic = PERIODIC_NONE;
+
+	bool in_order = true;
+	bool rebuild = !valid || NN != N || !same_box( pperiodic, xlo, xhi ) ||
+		!same_atoms( ids, NN, in_order );
+
+	if( !rebuild ){
+		// Copy the positions into the order of the build and find the
+		// largest displacement since then. The box is the same as
+		// then, so atoms that were wrapped around count right.
+		const int n_threads = threads_for( N, 65536 );
+		std::vector<py_float> max_d2( n_threads, 0.0 );
+		run_threads( n_threads, [&]( int t )
+		{
+			const py_float L[3] = { hi[0] - lo[0], hi[1] - lo[1],
+			                        hi[2] - lo[2] };
+			py_float m = 0.0;
+			for( py_int k = N*t / n_threads; k < N*(t+1) / n_threads; ++k ){
+				const py_int i = in_order ? built_at[k] : now[ built_at[k] ];
+				current[k] = i;
+				py_float r2 = 0.0;
+				for( int d = 0; d < 3; ++d ){
+					x_now[3*k+d] = x[i][d];
+					py_float r = x[i][d] - x_build[3*k+d];
+					if( periodic & ( 1 << d ) ){
+						r -= L[d] * std::nearbyint( r / L[d] );
+					}
+					if( d < dims ) r2 += r*r;
+				}
+				m = std::max( m, r2 );
+			}
+			max_d2[t] = m;
+		} );
+		max_disp = std::sqrt( *std::max_element( max_d2.begin(), max_d2.end() ) );
+		rebuild = max_disp > 0.5*skin_;
+	}
+
+	if( rebuild ){
+		N = NN;
+		build( x, ids, pperiodic, xlo, xhi );
+	}
+	refilter();
+	return rebuild;
+}
+
+
+bool verlet_list::update( const block_data &b )
+{
+	arr3f x( b.x_, b.N );
+	return update( x, b.N, b.ids, b.periodic, b.xlo, b.xhi );
+}
+
+
+bool verlet_list::same_box( py_int pperiodic, const py_float *xlo,
+                            const py_float *xhi ) const
+{
+	if( pperiodic != periodic ) return false;
+	if( !xlo || !xhi ) return true;
+	for( int d = 0; d < 3; ++d ){
+		if( xlo[d] != lo[d] || xhi[d] != hi[d] ) return false;
+	}
+	return true;
+}
+
+
+bool verlet_list::same_atoms( const py_int *ids, py_int NN, bool &in_order )
+{
+	// Without ids, the atoms are taken to be in the same order.
+	in_order = true;
+	if( !ids ) return true;
+	if( ids_build.empty() && NN > 0 ) return false;
+	if( std::equal( ids, ids + NN, ids_build.begin() ) ) return true;
+
+	// Find where each atom of the build is now. If an id is new, or
+	// occurs twice, not every atom of the build is found.
+	in_order = false;
+	std::vector<py_int> k_of( NN );
+	map_build.map_ids( ids, k_of.data(), NN );
+	now.assign( NN, -1 );
+	for( py_int i = 0; i < NN; ++i ){
+		const py_int k = k_of[i];
+		if( k < 0 || now[k] >= 0 ) return false;
+		now[k] = i;
+	}
+	return true;
+}
+
+
+void verlet_list::build( const arr3f &x, const py_int *ids, py_int pperiodic,
+                         const py_float *xlo, const py_float *xhi )
+{
+	periodic = pperiodic;
+	for( int d = 0; d < 3; ++d ){
+		lo[d] = xlo ? xlo[d] : 0.0;
+		hi[d] = xhi ? xhi[d] : 0.0;
+	}
+
+	if( ids ){
+		ids_build.assign( ids, ids + N );
+		map_build = id_map( ids, N );
+	}else{
+		ids_build.clear();
+		map_build = id_map();
+	}
+
+	cells.build( x, N, rc + skin_, periodic, xlo, xhi, dims );
+	cells.make_pairs( outer, true, 0, 0, nullptr,
+	                  neighbor_list::INDICES_ONLY, true );
+
+	built_at.resize( N );
+	x_build.resize( 3*N );
+	for( py_int k = 0; k < N; ++k ){
+		built_at[k] = cells.atom_at( k );
+		std::copy( x[ built_at[k] ], x[ built_at[k] ] + 3, &x_build[3*k] );
+	}
+	current = built_at;
+	x_now = x_build;
+
+	max_disp = 0.0;
+	valid = true;
+	++n_builds_;
+}
+
+
+void verlet_list::refilter()
+{
+	const py_float rc2 = rc*rc;
+	const bool wrap[3] = { ( periodic & PERIODIC_X ) != 0,
+	                       ( periodic & PERIODIC_Y ) != 0,
+	                       ( periodic & PERIODIC_Z ) != 0 };
+	const py_float L[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+	const py_float L_inv[3] = { wrap[0] ? 1.0 / L[0] : 0.0,
+	                            wrap[1] ? 1.0 / L[1] : 0.0,
+	                            wrap[2] ? 1.0 / L[2] : 0.0 };
+	const py_int *offsets = outer.offsets();
+	const py_int M = outer.n_entries();
+
+	// Threads take ranges of rows with about as many pairs.
+	const int n_threads = threads_for( M, 16384 );
+	std::vector<neighbor_list> parts( n_threads - 1 );
+	neighs.reset( N, extras );
+	for( neighbor_list &p : parts ) p.reset( N, extras );
+
+	run_threads( n_threads, [&]( int t )
+	{
+		neighbor_list &out = t == 0 ? neighs : parts[t-1];
+		auto first_row = [&]( int u ){
+			if( u == n_threads ) return N;
+			return py_int( std::lower_bound( offsets, offsets + N,
+			                                 M*u / n_threads ) - offsets );
+		};
+		const py_int k0 = first_row( t ), k1 = first_row( t + 1 );
+
+		for( py_int k = k0; k < k1; ++k ){
+			for( py_int l : outer[k] ){
+				// As in cell_list::make_pairs, so that the list is
+				// exactly the one it would make.
+				py_float r[3];
+				for( int d = 0; d < 3; ++d ){
+					r[d] = x_now[3*l+d] - x_now[3*k+d];
+					if( wrap[d] ) r[d] -= L[d] * std::nearbyint( r[d] * L_inv[d] );
+				}
+				if( dims == 2 ) r[2] = 0.0;
+				py_float r2 = r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+				if( r2 > rc2 ) continue;
+
+				py_float rr = extras & neighbor_list::DISTANCES ?
+					std::sqrt( r2 ) : 0.0;
+				out.add_pair( current[k], current[l], rr, r );
+			}
+		}
+	} );
+	neighs.finalize( parts );
+}
+
+
+extern "C" {
+
+verlet_list *get_verlet_list_handle( py_float rc, py_float skin,
+                                     py_int dims )
+{
+	return new verlet_list( rc, skin, dims );
+}
+
+
+void release_verlet_list_handle( verlet_list *vl )
+{
+	delete vl;
+}
+
+
+neighbor_buffer *verlet_list_update( verlet_list *vl, void *x, py_int N,
+                                     py_int *ids, py_int periodic,
+                                     py_float *xlo, py_float *xhi,
+                                     py_int *rebuilt )
+{
+	if( !vl || !x || !ids ){
+		std::cerr << "Error! verlet_list_update got a NULL pointer!\n";
+		return nullptr;
+	}
+
+	arr3f xx( x, N );
+	bool built = vl->update( xx, N, ids, periodic, xlo, xhi );
+	if( rebuilt ) *rebuilt = built;
+
+	return make_neighbor_buffer( vl->neighbors(), ids );
+}
+
+} // extern "C"
@@ -0,0 +1,138 @@
+#ifndef VERLET_LIST_H
+#define VERLET_LIST_H
+
+/*!
+  \file verlet_list.h
+  @brief A neighbor list with a skin, reused for consecutive frames.
+
+  \ingroup cpp_lib
+*/
+
+#include "types.h"
+#include "cell_list.h"
+#include "id_map.h"
+#include "neighbor_list.h"
+#include "neighborize.h"
+
+#include <vector>
+
+
+/*! @brief Keeps a neighbor list up to date for frames in which the atoms
+           only move a little.
+
+  A list of all pairs within rc + skin is built once. As long as no atom
+  has moved more than skin / 2 since, no pair can have come from beyond
+  rc + skin to within rc. In that case, update only filters the pairs
+  in the list by their current distance, which is much cheaper than
+  finding them again.
+
+  The list is built again if an atom has moved too far, or if the
+  number of atoms, the ids, the box or the periodicity changed. If the
+  ids are given, atoms may be listed in a different order in every
+  frame, as long as the same atoms are there.
+
+  The list that neighbors() returns is the same as a full list that
+  cell_list makes with cut-off rc for the current positions.
+
+  \ingroup cpp_lib
+*/
+class verlet_list {
+public:
+	/**
+	   \param rc      Cut-off of the neighbor list
+	   \param skin    Extra distance atoms may move between builds
+	   \param dims    2 to ignore z, 3 otherwise
+	   \param extras  What the list stores besides neighbor indices,
+	                  see neighbor_list::extras
+	*/
+	verlet_list( py_float rc, py_float skin, py_int dims = 3,
+	             int extras = neighbor_list::INDICES_ONLY );
+
+	/**
+	   Brings the list up to date for the positions \p x of \p N
+	   atoms. \p ids may be nullptr if the atoms are always in the same
+	   order. Returns true if the list was built again.
+	*/
+	bool update( const arr3f &x, py_int N, const py_int *ids,
+	             py_int periodic, const py_float *xlo, const py_float *xhi );
+
+	/// Brings the list up to date for the atoms in \p b.
+	bool update( const class block_data &b );
+
+	/// Makes the next update build the list again.
+	void invalidate() { valid = false; }
+
+	/// Neighbors within rc, as indices into the last positions given
+	const neighbor_list &neighbors() const { return neighs; }
+
+	/// Largest distance any atom moved since the last build
+	py_float max_displacement() const { return max_disp; }
+
+	py_int n_builds()  const { return n_builds_; }   ///< Times built
+	py_int n_updates() const { return n_updates_; }  ///< Times updated
+
+	py_float cutoff() const { return rc; }
+	py_float skin()   const { return skin_; }
+
+private:
+	py_float rc, skin_;
+	py_int dims;
+	int extras;
+
+	bool valid;
+	py_int N, periodic;
+	py_float lo[3], hi[3];
+	py_float max_disp;
+	py_int n_builds_, n_updates_;
+
+	// The atoms are kept in the cell order of the last build, so that
+	// the atoms of a pair are close together in memory.
+	std::vector<py_int> ids_build;  ///< Ids at the last build
+	id_map map_build;               ///< Index at the last build of each id
+	std::vector<py_int> now;        ///< Current index of atom k of the build
+	std::vector<py_int> built_at;   ///< Index at the build of place k
+	std::vector<py_int> current;    ///< Current index of place k
+	std::vector<py_float> x_build;  ///< Positions at the build, by place
+	std::vector<py_float> x_now;    ///< Current positions, by place
+
+	cell_list cells;
+	neighbor_list outer;            ///< Half list within rc + skin, by place
+	neighbor_list neighs;           ///< Full list within rc
+
+	bool same_atoms( const py_int *ids, py_int N, bool &in_order );
+	bool same_box( py_int periodic, const py_float *xlo,
+	               const py_float *xhi ) const;
+	void build( const arr3f &x, const py_int *ids, py_int periodic,
+	            const py_float *xlo, const py_float *xhi );
+	void refilter();
+};
+
+
+extern "C" {
+
+/**
+   Returns a new verlet_list with cut-off \p rc and skin \p skin. Free
+   it with release_verlet_list_handle.
+*/
+verlet_list *get_verlet_list_handle( py_float rc, py_float skin,
+                                     py_int dims );
+
+/// Frees a verlet_list made by get_verlet_list_handle.
+void release_verlet_list_handle( verlet_list *vl );
+
+/**
+   Brings \p vl up to date for the positions \p x of the \p N atoms with
+   ids \p ids, see verlet_list::update, and returns its list in a
+   buffer. Release the buffer with release_neighbor_buffer.
+   \p rebuilt, if not NULL, is set to 1 if the list was built again
+   and to 0 otherwise.
+*/
+neighbor_buffer *verlet_list_update( verlet_list *vl, void *x, py_int N,
+                                     py_int *ids, py_int periodic,
+                                     py_float *xlo, py_float *xhi,
+                                     py_int *rebuilt );
+
+}
+
+
+#endif /* VERLET_LIST_H */
@@ -0,0 +1,195 @@
+#include "zstd_seekable.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+#ifdef HAVE_LIB_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+
+namespace {
+
+const uint32_t skippable_magic = 0x184D2A5E;
+const uint32_t seekable_magic  = 0x8F92EAB1;
+// Number_Of_Frames, Seek_Table_Descriptor and Seekable_Magic_Number.
+const std::size_t footer_size  = 9;
+const std::size_t max_frames   = 0x8000000;
+
+
+inline uint32_t read_le32( const unsigned char *p )
+{
+	return static_cast<uint32_t>( p[0] ) |
+		( static_cast<uint32_t>( p[1] ) << 8 ) |
+		( static_cast<uint32_t>( p[2] ) << 16 ) |
+		( static_cast<uint32_t>( p[3] ) << 24 );
+}
+
+inline void write_le32( unsigned char *p, uint32_t v )
+{
+	p[0] = v & 0xff;
+	p[1] = ( v >> 8 ) & 0xff;
+	p[2] = ( v >> 16 ) & 0xff;
+	p[3] = ( v >> 24 ) & 0xff;
+}
+
+} // namespace
+
+
+bool zstd_seek_table::read( std::FILE *f )
+{
+	coffsets.clear();
+	uoffsets.clear();
+
+	unsigned char footer[footer_size];
+	if( std::fseek( f, -static_cast<long>( footer_size ), SEEK_END ) ||
+	    std::fread( footer, 1, footer_size, f ) != footer_size ||
+	    read_le32( footer + 5 ) != seekable_magic ){
+		return false;
+	}
+	std::size_t n_frames = read_le32( footer );
+	bool checksums = footer[4] & 0x80;
+	std::size_t entry_size = checksums ? 12 : 8;
+	if( n_frames > max_frames ) return false;
+
+	// The table is a skippable frame with an 8-byte header.
+	long table_size = n_frames*entry_size + footer_size;
+	std::vector<unsigned char> table( table_size + 8 );
+	if( std::fseek( f, -static_cast<long>( table.size() ), SEEK_END ) ||
+	    std::fread( table.data(), 1, table.size(), f ) != table.size() ||
+	    read_le32( table.data() ) != skippable_magic ||
+	    read_le32( table.data() + 4 ) != table_size ){
+		return false;
+	}
+
+	coffsets.push_back( 0 );
+	uoffsets.push_back( 0 );
+	for( std::size_t i = 0; i < n_frames; ++i ){
+		const unsigned char *e = table.data() + 8 + i*entry_size;
+		coffsets.push_back( coffsets.back() + read_le32( e ) );
+		uoffsets.push_back( uoffsets.back() + read_le32( e + 4 ) );
+	}
+	return true;
+}
+
+
+std::size_t zstd_seek_table::find( py_int u ) const
+{
+	auto it = std::upper_bound( uoffsets.begin(), uoffsets.end(), u );
+	if( it == uoffsets.begin() ) return 0;
+	std::size_t i = it - uoffsets.begin() - 1;
+	// Offsets at the very end belong to no frame.
+	return std::min( i, size() );
+}
+
+
+
+extern "C" {
+
+int zstd_recompress_seekable( const char *in_name, const char *out_name,
+                              py_int level, py_int frame_size )
+{
+#ifndef HAVE_LIB_ZSTD
+	std::cerr << "Cannot write zstd files without libzstd support!\n";
+	return -1;
+#else
+	if( frame_size <= 0 || frame_size > 0x40000000 ){
+		std::cerr << "Invalid zstd frame size " << frame_size << "!\n";
+		return -1;
+	}
+
+#ifdef HAVE_ZLIB
+	// gzread also reads files that are not compressed.
+	gzFile in = gzopen( in_name, "rb" );
+#else
+	std::FILE *in = std::fopen( in_name, "rb" );
+#endif
+	if( !in ){
+		std::cerr << "Failed to open " << in_name << "!\n";
+		return -1;
+	}
+	std::FILE *out = std::fopen( out_name, "wb" );
+	if( !out ){
+		std::cerr << "Failed to open " << out_name << " for writing!\n";
+#ifdef HAVE_ZLIB
+		gzclose( in );
+#else
+		std::fclose( in );
+#endif
+		return -1;
+	}
+
+	ZSTD_CCtx *cctx = ZSTD_createCCtx();
+	std::vector<char> buff( frame_size );
+	std::vector<char> cbuff( ZSTD_compressBound( frame_size ) );
+	std::vector<unsigned char> table;
+	uint32_t n_frames = 0;
+	int status = 0;
+
+	while( !status ){
+		// Fill a whole frame, reads may return less.
+		std::size_t n = 0;
+		while( n < buff.size() ){
+#ifdef HAVE_ZLIB
+			int m = gzread( in, buff.data() + n, buff.size() - n );
+#else
+			long m = std::fread( buff.data() + n, 1, buff.size() - n, in );
+#endif
+			if( m < 0 ) status = -1;
+			if( m <= 0 ) break;
+			n += m;
+		}
+		if( status || n == 0 ) break;
+
+		std::size_t c = ZSTD_compressCCtx( cctx, cbuff.data(), cbuff.size(),
+		                                   buff.data(), n, level );
+		if( ZSTD_isError( c ) ||
+		    std::fwrite( cbuff.data(), 1, c, out ) != c ){
+			status = -1;
+			break;
+		}
+
+		unsigned char entry[8];
+		write_le32( entry, c );
+		write_le32( entry + 4, n );
+		table.insert( table.end(), entry, entry + 8 );
+		++n_frames;
+	}
+	ZSTD_freeCCtx( cctx );
+#ifdef HAVE_ZLIB
+	gzclose( in );
+#else
+	std::fclose( in );
+#endif
+
+	if( !status ){
+		unsigned char header[8], footer[footer_size];
+		write_le32( header, skippable_magic );
+		write_le32( header + 4, table.size() + footer_size );
+		write_le32( footer, n_frames );
+		footer[4] = 0;  // No checksums.
+		write_le32( footer + 5, seekable_magic );
+
+		if( std::fwrite( header, 1, 8, out ) != 8 ||
+		    std::fwrite( table.data(), 1, table.size(), out ) !=
+		    table.size() ||
+		    std::fwrite( footer, 1, footer_size, out ) != footer_size ){
+			status = -1;
+		}
+	}
+	if( std::fclose( out ) ) status = -1;
+
+	if( status ){
+		std::cerr << "Failed to compress " << in_name << " to "
+		          << out_name << "!\n";
+		std::remove( out_name );
+	}
+	return status;
+#endif // HAVE_LIB_ZSTD
+}
+
+}
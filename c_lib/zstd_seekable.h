@@ -0,0 +1,73 @@
+#ifndef ZSTD_SEEKABLE_H
+#define ZSTD_SEEKABLE_H
+
+/*!
+  \file zstd_seekable.h
+  @brief Support for the seekable zstd format.
+
+  A seekable zstd file is a series of independent zstd frames followed
+  by a skippable frame with a seek table, which lists the compressed and
+  uncompressed size of every frame. Ordinary zstd tools read these
+  files as usual and skip the table.
+
+  Writing needs libzstd (HAVE_LIB_ZSTD).
+
+  \ingroup cpp_lib
+*/
+
+#include "types.h"
+
+#include <cstdio>
+#include <vector>
+
+
+/*!
+  @brief The seek table of a seekable zstd file.
+
+  \ingroup cpp_lib
+*/
+class zstd_seek_table
+{
+public:
+	/// Reads the seek table from the end of f.
+	/// Returns false if f has none.
+	bool read( std::FILE *f );
+
+	/// Number of frames.
+	std::size_t size() const
+	{ return coffsets.empty() ? 0 : coffsets.size() - 1; }
+
+	/// Offset of frame i in the compressed file, i == size() is the end.
+	py_int coffset( std::size_t i ) const { return coffsets[i]; }
+	/// Offset of frame i in the uncompressed data.
+	py_int uoffset( std::size_t i ) const { return uoffsets[i]; }
+
+	/// Returns the frame that contains uncompressed offset u.
+	std::size_t find( py_int u ) const;
+
+private:
+	std::vector<py_int> coffsets;
+	std::vector<py_int> uoffsets;
+};
+
+
+extern "C" {
+
+/**
+   Compresses a (gzipped or plain) file into the seekable zstd format.
+
+   \param in_name     The file to compress. Gzipped input needs zlib.
+   \param out_name    The seekable zstd file to write.
+   \param level       zstd compression level.
+   \param frame_size  Uncompressed size of each frame. Smaller frames
+                      make seeking cheaper but compress worse.
+
+   \returns 0 on success, negative on failure.
+*/
+int zstd_recompress_seekable( const char *in_name, const char *out_name,
+                              py_int level, py_int frame_size );
+
+}
+
+
+#endif // ZSTD_SEEKABLE_H
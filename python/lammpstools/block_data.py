@@ -377,9 +377,10 @@ def write_block_data_cpp( bh, file_name, file_format, data_format ):
     @param b            Block data to write.
     @param fname        File name to write to.
     @param file_format  File format to write. Currently supported:
-                        'PLAIN', 'GZIP', 'BIN'
+                        'PLAIN', 'GZIP', 'BIN', and for LTRAJ 'ZSTD'
+                        or 'QUANTIZED:<precision>' (lossy positions)
     @param data_format  Data format to write. Currently supported:
-                        'LAMMPS', 'HOOMD'
+                        'LAMMPS', 'HOOMD', 'LTRAJ'
     """
     
     lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
@@ -16,6 +16,7 @@ from ctypes import *
 import ctypes
 
 from lammpstools.block_data import *
+from lammpstools.typecasts import library_array
 
 
 
@@ -26,11 +27,53 @@ class dumpreader_cpp:
     flexibility.
     """
     
-    def __init__(self, fname, dformat = None, fformat = None):
+    def __init__(self, fname, dformat = None, fformat = None,
+                 n_workers = 0, queue_depth = 0, prefetch = None,
+                 columns = None, follow = False, follow_timeout = -1,
+                 zero_copy = False):
         ## This is the constructor for the dump reader.
-        #  @arg fname   Dump file name
-        #  @arg dformat Dump format (0 = LAMMPS, 1 = GSD, 2 = DCD)
-        #  @arg fformat File format (0 = plain text, 1 = GZipped, 3 = binary)
+        #  @arg fname   Dump file name. For dumps split into one file per
+        #               time step, a glob pattern like 'dump.*.gz' or a
+        #               printf pattern like 'dump.%d.gz'. The files are
+        #               read as one dump in the order of their numbers.
+        #  @arg dformat Dump format (0 = LAMMPS, 1 = GSD, 2 = DCD,
+        #                3 = ltraj, see convert_to_ltraj)
+        #  @arg fformat File format (0 = plain text, 1 = GZipped, 3 = binary,
+        #                4 = memory-mapped plain text,
+        #                5 = block-gzipped (BGZF), see recompress_bgzf,
+        #                6 = zstd, 7 = lz4)
+        #  @arg n_workers   Number of threads that parse frames. 0 reads
+        #                   serially, negative uses one thread per core.
+        #                   Only LAMMPS text dumps can be read in parallel.
+        #                   For BGZF files, this many threads decompress.
+        #                   For split dumps, this many files are read at
+        #                   the same time, and 0 means one per core.
+        #  @arg queue_depth Maximum number of frames parsed ahead
+        #                   (default is twice the number of workers).
+        #  @arg prefetch    Number of blocks to read ahead on a background
+        #                   thread while Python works on the current one.
+        #                   Defaults to 2 for serial reading and to 0 when
+        #                   n_workers is set, as that reads ahead already,
+        #                   or when following.
+        #  @arg columns     List of columns to parse in LAMMPS text dumps,
+        #                   e.g. ['id', 'type', 'x', 'y', 'z']. The others
+        #                   are skipped, which is faster for wide dumps.
+        #                   'x' also selects xs, xu or xsu, and so on.
+        #                   Arrays of columns left out are zero.
+        #                   Defaults to all columns. For GSD files, these
+        #                   are the particle chunks to read besides
+        #                   positions and types, e.g. ['velocity'].
+        #  @arg follow      If True, follow a dump that a simulation is
+        #                   still writing: iterating waits for new frames
+        #                   at the end of the file instead of stopping.
+        #                   Only for plain or memory-mapped LAMMPS dumps.
+        #  @arg follow_timeout  Stop following once the file has not
+        #                   grown for this many seconds. Negative waits
+        #                   forever.
+        #  @arg zero_copy   If True, the arrays of the blocks are read-only
+        #                   views of the memory the C++ reader parsed
+        #                   them into, instead of copies. That memory is
+        #                   freed once no array of the block is left.
         #
         #  It opens a handle to an instance of a C++ dump_reader which does
         #  all of the heavy lifting. The handle is released in the destructor
@@ -45,12 +88,26 @@ class dumpreader_cpp:
         if fformat is None:
             fformat = -1
 
-        self.handle = lammpstools.get_dump_reader_handle( fname.encode(),
-                                                          dformat, fformat )
+        if columns is None:
+            columns = []
+        self.handle = lammpstools.get_dump_reader_handle_columns(
+            fname.encode(), dformat, fformat, n_workers, queue_depth,
+            " ".join(columns).encode() )
+
+        if follow:
+            if not lammpstools.dump_reader_follow( self.handle, 1,
+                                                   c_double(follow_timeout) ):
+                raise RuntimeError("Dump " + fname + " cannot be followed!")
+
+        if prefetch is None:
+            prefetch = 2 if n_workers == 0 and not follow else 0
+        if prefetch > 0:
+            lammpstools.dump_reader_set_prefetch( self.handle, prefetch )
             
         print("Opened dump reader handle @ ", hex(self.handle),
               file = sys.stderr)
         self.at_eof = False
+        self.zero_copy = zero_copy
         
 
     def __del__(self):
@@ -111,11 +168,6 @@ class dumpreader_cpp:
                                                 byref(atom_style) )
         
         box_line = str( box_line_buff, 'ascii' )
-        x     = np.empty( [N.value, 3], dtype = float )
-        ids   = np.empty( N.value, dtype = int )
-        types = np.empty( N.value, dtype = int )
-        mol   = np.zeros( N.value, dtype = int )
-
 
         if atom_style.value == 0:
             atom_style_named = "atomic"
@@ -124,21 +176,50 @@ class dumpreader_cpp:
         else:
             raise RuntimeError("Unknown atom style ", atom_style.value,
                                " encountered!")
-        
+
+        dom  = domain_data( xlo, xhi, periodic.value, box_line )
+        meta = block_meta( tstep.value, N.value, dom )
+        meta.atom_style = atom_style_named
+
+        if self.zero_copy and N.value > 0:
+            x, ids, types, mol = self._borrow_arrays( N.value )
+            return block_data( meta, ids, types, x, mol )
+
+        x     = np.empty( [N.value, 3], dtype = float )
+        ids   = np.empty( N.value, dtype = int )
+        types = np.empty( N.value, dtype = int )
+        mol   = np.zeros( N.value, dtype = int )
+
         lammpstools.dump_reader_get_block_data(
             self.handle, N, x.ctypes.data_as(ctypes.POINTER(ctypes.c_double)),
             ids.ctypes.data_as(ctypes.POINTER(ctypes.c_longlong)),
             types.ctypes.data_as(ctypes.POINTER(ctypes.c_longlong)),
             mol.ctypes.data_as(ctypes.POINTER(ctypes.c_longlong)) )
-        
-        
-        dom  = domain_data( xlo, xhi, periodic.value, box_line )
-        meta = block_meta( tstep.value, N.value, dom )
-        meta.atom_style = atom_style_named
 
         b = block_data( meta, ids, types, x, mol )
         return b
 
+    def _borrow_arrays(self, N):
+        ## Takes the last block from the C++ reader and returns read-only
+        ## views of its x, ids, types and mol arrays.
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.dump_reader_take_block.restype = ctypes.c_void_p
+        block = _borrowed_block( lammpstools.dump_reader_take_block(
+            self.handle ) )
+
+        x, ids, types, mol = ( ctypes.c_void_p() for i in range(4) )
+        lammpstools.dump_reader_block_arrays( ctypes.c_void_p(block.ptr),
+                                              byref(x), byref(ids),
+                                              byref(types), byref(mol) )
+        views = [ library_array( block, x.value, (N, 3), np.float64 ),
+                  library_array( block, ids.value, (N,), np.int64 ),
+                  library_array( block, types.value, (N,), np.int64 ) ]
+        if mol.value:
+            views.append( library_array( block, mol.value, (N,), np.int64 ) )
+        else:
+            views.append( np.zeros( N, dtype = int ) )
+        return views
+
     
     def fast_forward(self,Nblocks=1):
         ## Fast-forwards a number of blocks.
@@ -150,13 +231,105 @@ class dumpreader_cpp:
 
         lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
 
-        success = lammpstools.dump_reader_fast_forward( self.handle, Nblocks )
-        if success:
-            pass
-        else:
+        status = lammpstools.dump_reader_fast_forward( self.handle, Nblocks )
+        if status != 0:
             print("Fast-forward failed, probably encountered EOF.", file = sys.stderr)
             self.at_eof = True
 
+    def read_frames(self, n_frames, stride = 1, ids = None):
+        ## Reads up to n_frames blocks in one call into numpy arrays.
+        #  @arg n_frames  The maximum number of blocks to read.
+        #  @arg stride    Only read every stride-th block.
+        #  @arg ids       Atom ids to keep, in the order they should be
+        #                 in. Defaults to all atoms of the next block,
+        #                 sorted by id. Every block must have them.
+        #
+        #  Returns the positions as an array of shape [F, N, 3], the
+        #  time steps [F] and the boxes [F, 6] (xlo, ylo, zlo, xhi,
+        #  yhi, zhi), where F is the number of blocks read. That is
+        #  less than n_frames if the dump ended.
+        #
+        #  Sorting and copying is done in C without holding the GIL,
+        #  while the reader (or its prefetcher) parses the next blocks.
+        ##
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.dump_reader_read_frames.restype = ctypes.c_longlong
+
+        first = None
+        if ids is None:
+            # The ids of the first block decide the size of x.
+            first = self.getblock()
+            if first is None:
+                return ( np.empty( [0, 0, 3] ), np.empty( 0, dtype = int ),
+                         np.empty( [0, 6] ) )
+            order = np.argsort( first.ids )
+            ids = first.ids[order]
+        ids = np.ascontiguousarray( ids, dtype = np.int64 )
+        n_ids = len(ids)
+
+        x      = np.empty( [n_frames, n_ids, 3], dtype = float )
+        tsteps = np.empty( n_frames, dtype = np.int64 )
+        boxes  = np.empty( [n_frames, 6], dtype = float )
+
+        n_read = 0
+        if first is not None and n_frames > 0:
+            x[0] = first.x[order]
+            tsteps[0] = first.meta.t
+            boxes[0,:3] = first.meta.domain.xlo
+            boxes[0,3:] = first.meta.domain.xhi
+            n_read = 1
+            if n_frames > 1 and stride > 1:
+                self.fast_forward( stride - 1 )
+
+        if n_read < n_frames and not self.at_eof:
+            status = lammpstools.dump_reader_read_frames(
+                self.handle, ctypes.c_longlong(n_frames - n_read),
+                ctypes.c_longlong(stride),
+                ids.ctypes.data_as(ctypes.POINTER(ctypes.c_longlong)),
+                ctypes.c_longlong(n_ids),
+                x[n_read:].ctypes.data_as(ctypes.POINTER(ctypes.c_double)),
+                tsteps[n_read:].ctypes.data_as(ctypes.POINTER(ctypes.c_longlong)),
+                boxes[n_read:].ctypes.data_as(ctypes.POINTER(ctypes.c_double)) )
+            if status < 0:
+                raise RuntimeError("Failed to read frames!")
+            if status < n_frames - n_read:
+                self.at_eof = True
+            n_read += status
+
+        return x[:n_read], tsteps[:n_read], boxes[:n_read]
+
+    def seek_block(self, n):
+        ## Moves to block n (counting from 0), using the frame index.
+        #  @arg n  The block to move to.
+        #
+        #  The index is built on first use and stored next to the dump
+        #  file, so later seeks in the same file are cheap.
+        #  Returns True on success.
+        ##
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        status = lammpstools.dump_reader_seek_block( self.handle,
+                                                     ctypes.c_longlong(n) )
+        self.at_eof = status != 0
+        return status == 0
+
+    def seek_timestep(self, t):
+        ## Moves to the first block with time step >= t, using the frame index.
+        #  @arg t  The time step to move to.
+        #
+        #  Returns True on success.
+        ##
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        status = lammpstools.dump_reader_seek_timestep( self.handle,
+                                                        ctypes.c_longlong(t) )
+        self.at_eof = status != 0
+        return status == 0
+
+    def block_count(self):
+        ## Returns the number of blocks in the dump file.
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.dump_reader_block_count.restype = ctypes.c_longlong
+        return lammpstools.dump_reader_block_count( self.handle )
+
     def get_all_blocks(self):
         ## Returns Returns all blocks in the data file in a list of blocks.
         ## This can be very memory-heavy!
@@ -166,3 +339,70 @@ class dumpreader_cpp:
         return all_data
 
         
+
+
+class _borrowed_block:
+    ## A block_data taken from the C++ reader. It is deleted once the
+    #  last array view of it is gone, see library_array.
+    def __init__(self, ptr):
+        self.ptr = ptr
+
+    def __del__(self):
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.dump_reader_release_block( ctypes.c_void_p(self.ptr) )
+
+
+def recompress_bgzf(in_name, out_name, level = 6):
+    ## Re-compresses a gzipped dump file into block-gzipped (BGZF) format.
+    #  @arg in_name   The gzipped (or plain text) file to recompress.
+    #  @arg out_name  The name of the BGZF file to write.
+    #  @arg level     Compression level (1-9).
+    #
+    #  The result is still a valid gzip file, but dumpreader_cpp can seek
+    #  in it and decompress it with several threads.
+    #  Returns True on success.
+    ##
+    lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+    status = lammpstools.bgzf_recompress( in_name.encode(), out_name.encode(),
+                                          ctypes.c_longlong(level) )
+    return status == 0
+
+
+def recompress_zstd(in_name, out_name, level = 3, frame_size = 4 << 20):
+    ## Compresses a (gzipped) dump file into the seekable zstd format.
+    #  @arg in_name     The file to compress.
+    #  @arg out_name    The name of the zstd file to write.
+    #  @arg level       zstd compression level.
+    #  @arg frame_size  Uncompressed size of the independent frames.
+    #
+    #  zstd decompresses much faster than gzip, and dumpreader_cpp can
+    #  seek in the result. Returns True on success.
+    ##
+    lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+    status = lammpstools.zstd_recompress_seekable( in_name.encode(),
+                                                   out_name.encode(),
+                                                   ctypes.c_longlong(level),
+                                                   ctypes.c_longlong(frame_size) )
+    return status == 0
+
+
+def convert_to_ltraj(in_name, out_name, compress = False, precision = 0):
+    ## Converts a dump file into the native columnar ltraj format.
+    #  @arg in_name    Any dump file dumpreader_cpp can read.
+    #  @arg out_name   The name of the ltraj file to write.
+    #  @arg compress   If True, compress the columns with zstd.
+    #  @arg precision  If > 0, store positions rounded to multiples of
+    #                  this (e.g. 1e-3). This is lossy, but the file is
+    #                  several times smaller.
+    #
+    #  ltraj files need no parsing and can be seeked, which makes them
+    #  the fastest format to analyse the same trajectory repeatedly.
+    #  Returns the number of frames written, or a negative number on
+    #  failure.
+    ##
+    lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+    lammpstools.ltraj_convert.restype = ctypes.c_longlong
+    codec = 1 if compress else 0
+    return lammpstools.ltraj_convert( in_name.encode(), out_name.encode(),
+                                      ctypes.c_longlong(codec),
+                                      ctypes.c_double(precision) )
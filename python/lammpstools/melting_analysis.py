@@ -5,6 +5,7 @@ This file contains some analysis stuff related to melting.
 """
 
 import lammpstools
+from lammpstools.neighborize import kd_tree
 import dumpreader
 import numpy as np
 import math
@@ -13,26 +14,21 @@ import sys
 import matplotlib.pyplot as plt
 
 def get_avg_shortest_dist( b ):
-    """ !Finds the shortest distance for each particle to another. Expensive! """
-    N = b.meta.N
-    dists = np.ones(N) * 100000
-    for i in range(0,N):
-        for j in range(0,N):
-            if i == j: continue
-            
-            rij, rvec = lammpstools.distance( b, i, j )
-            if rij < dists[i]:
-                dists[i] = rij
-    a0 = np.average(dists)
-    
-    dists = []
-    for i in range(0,N):
-        for j in range(0,N):
-            if i == j: continue
-            
-            rij, rvec = lammpstools.distance( b, i, j )
-            if rij < 1.2*a0:
-                dists.append(rij)
+    """ !Finds the average distance of particles to their neighbors, i.e.,
+        those closer than 1.2 times the average nearest distance. """
+    dom = b.meta.domain
+    tree = kd_tree( b.x, dom.periodic, dom.xlo, dom.xhi )
+    idx, nearest = tree.knn( b.x, 1, skip_self = True )
+    a0 = np.average( nearest )
+
+    offsets, neighs = tree.radius( b.x, 1.2*a0, skip_self = True )
+    rows = np.repeat( np.arange( b.meta.N ), np.diff( offsets ) )
+    r = b.x[neighs] - b.x[rows]
+    for d in range(0,3):
+        if dom.periodic & (1 << d):
+            L = dom.xhi[d] - dom.xlo[d]
+            r[:,d] -= L * np.round( r[:,d] / L )
+    dists = np.sqrt( np.sum( r*r, axis = 1 ) )
 
     a = np.average(dists)
     fp = open("distances.dat","w")
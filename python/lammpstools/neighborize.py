@@ -6,7 +6,8 @@ Contains some routines relating to nearest neighbours and the like.
 \inpackage lammpstools
 """
 
-import os, multiprocessing, struct
+import sys, math
+import numpy as np
 from ctypes import *
 
 from lammpstools.typecasts import *
@@ -81,15 +82,36 @@ def compute_adf( b, R, nbins, itype, jtype, method = None ):
     return pts, adf, coords
 
 
-# Makes a neighbor list of all particles in block.
-# 
+class neighbor_buffer(Structure):
+    ## Mirrors struct neighbor_buffer in neighborize.h.
+    _fields_ = [ ("N", c_longlong),
+                 ("offsets", c_void_p),
+                 ("neighs", c_void_p) ]
+
+
+class _neighbor_buffer_owner:
+    ## Releases a neighbor_buffer once no array view of it is left.
+    def __init__(self, ptr):
+        self.ptr = ptr
+
+    def __del__(self):
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.release_neighbor_buffer( c_void_p(self.ptr) )
+
+
+# Makes a neighbor list of all particles in block in compressed sparse
+# row form: The neighbors of atom i (its index in b) are the ids
+# neighs[offsets[i]:offsets[i+1]].
+#
 # @param b         Block of data to neighborize
 # @param rc        Cut-off for distance criterion (ignored if not needed)
 # @param dims      DImensions of simulation box
-# @param method    Neighborization method to use. 
-# 
-def neighborize( b, rc, dims, method = None, itype = 0, jtype = 0,
-                 quiet = True ):
+# @param method    Neighborization method to use.
+#
+# Returns offsets and neighs, read-only views of the buffer the C++ lib
+# wrote the list into. It is freed when both arrays are gone.
+#
+def neighborize_csr( b, rc, dims, method = None, itype = 0, jtype = 0 ):
     if method is None:
         # Guess a good method based on b.meta.N:
         if b.meta.N < 200: method = 0
@@ -101,67 +123,189 @@ def neighborize( b, rc, dims, method = None, itype = 0, jtype = 0,
         else:
             rc = 0.0 # Set to dummy value
 
+    lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+    lammpstools.neighborize_to_buffer.restype = POINTER(neighbor_buffer)
+    nb = lammpstools.neighborize_to_buffer(void_ptr(b.x), c_longlong(b.meta.N),
+                                           void_ptr(b.ids), void_ptr(b.types),
+                                           c_double(rc),
+                                           c_longlong(b.meta.domain.periodic),
+                                           void_ptr(b.meta.domain.xlo),
+                                           void_ptr(b.meta.domain.xhi),
+                                           c_longlong(dims), c_longlong(method),
+                                           c_longlong(itype), c_longlong(jtype))
+    if not nb:
+        raise RuntimeError("Failed to neighborize!")
+
+    owner = _neighbor_buffer_owner( cast(nb, c_void_p).value )
+    N = nb.contents.N
+    offsets = library_array( owner, nb.contents.offsets, (N+1,), np.int64 )
+    neighs  = library_array( owner, nb.contents.neighs, (offsets[-1],),
+                             np.int64 )
+    return offsets, neighs
+
 
-    pname_base = '/tmp/lammpstools_neighborize_pipe_'
-    pname = pname_base + str(os.getpid())
+# Makes a neighbor list of all particles in block.
+# 
+# @param b         Block of data to neighborize
+# @param rc        Cut-off for distance criterion (ignored if not needed)
+# @param dims      DImensions of simulation box
+# @param method    Neighborization method to use. 
+# 
+# Returns a list with for every atom a list of its id followed by the
+# ids of its neighbors. See neighborize_csr for a faster form.
+#
+def neighborize( b, rc, dims, method = None, itype = 0, jtype = 0,
+                 quiet = True ):
+    csr = neighborize_csr( b, rc, dims, method, itype, jtype )
+    if csr is None:
+        return
+    offsets, nl = csr
 
-    os.mkfifo(pname)
     neighs = []
-    
-    try:
-        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
-        pname_buffer = create_string_buffer( pname.encode('ascii') )
-
-        def start_neigh():
-            # Make the child neighborize while the main thread reads from the pipe
-            lammpstools.neighborize(void_ptr(b.x), c_longlong(b.meta.N),
-                                    void_ptr(b.ids), void_ptr(b.types),
-                                    c_double(rc), c_longlong(b.meta.domain.periodic),
-                                    void_ptr(b.meta.domain.xlo),
-                                    void_ptr(b.meta.domain.xhi), c_longlong(dims),
-                                    c_longlong(method), pname_buffer,
-                                    c_longlong(itype), c_longlong(jtype))
-
-        p = multiprocessing.Process(target = start_neigh)
-        p.start()
-
-        # Read in the file and store in neighs
-        current_l = []
-        int_size = 8
-        int_fmt  = 'q'
-        ints_read = 0
-        i = 0
-
-        with open(pname,"rb") as fifo:
-            byte = b'        '
-            while True:
-                byte = fifo.read(int_size)
-                
-                if byte == '' or byte == b'':
-                    # Out of data apparently.
-                    break
-
-                x = struct.unpack(int_fmt,byte)[0]
-                ints_read += 1
-            
-                if x > 0:
-                    current_l.append(x)
-                else:
-                    neighs.append(current_l)
-                    current_l = []
-        p.join()
-
-    finally:
-        if not quiet:
-            print("Received %d ints (%d b.meta.tes) through named pipe %s" \
-                  % (ints_read, int_size*ints_read, pname), file = sys.stderr)
-
-        if os.path.exists( pname ):
-            os.unlink( pname )
-            # time.sleep(0.1)
+    for i in range(0, b.meta.N):
+        neighs.append( [ b.ids[i] ] + nl[offsets[i]:offsets[i+1]].tolist() )
+
+    if not quiet:
+        print("Received %d neighbors of %d atoms" % (len(nl), b.meta.N),
+              file = sys.stderr)
     return neighs
 
 
+## A neighbor list that is kept up to date over consecutive frames.
+#
+#  It lists all pairs within rc + skin, and only finds them again once
+#  an atom moved more than skin/2 since, or the atoms or the box changed.
+#  In between, update just filters the pairs by their current distance.
+#  Use it in a loop over a dump:
+#
+#      vl = verlet_list( 1.3, 0.3 )
+#      for b in d:
+#          offsets, neighs = vl.update( b )
+#
+class verlet_list:
+    ## Makes an empty list.
+    #
+    #  \param rc    Cut-off for neighbors
+    #  \param skin  Extra distance atoms may move before a rebuild
+    #  \param dims  Dimensions of the simulation box
+    #
+    def __init__(self, rc, skin, dims = 3):
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.get_verlet_list_handle.restype = c_void_p
+        self.handle = lammpstools.get_verlet_list_handle( c_double(rc),
+                                                          c_double(skin),
+                                                          c_longlong(dims) )
+        ## True if the last update built the list again.
+        self.rebuilt = False
+
+    def __del__(self):
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.release_verlet_list_handle( c_void_p(self.handle) )
+
+    ## Brings the list up to date for block b and returns it like
+    #  neighborize_csr does: offsets into neighs, and neighbor ids.
+    def update(self, b):
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.verlet_list_update.restype = POINTER(neighbor_buffer)
+        rebuilt = c_longlong(0)
+        nb = lammpstools.verlet_list_update( c_void_p(self.handle),
+                                             void_ptr(b.x),
+                                             c_longlong(b.meta.N),
+                                             void_ptr(b.ids),
+                                             c_longlong(b.meta.domain.periodic),
+                                             void_ptr(b.meta.domain.xlo),
+                                             void_ptr(b.meta.domain.xhi),
+                                             byref(rebuilt) )
+        if not nb:
+            raise RuntimeError("Failed to update Verlet list!")
+        self.rebuilt = bool(rebuilt.value)
+
+        owner = _neighbor_buffer_owner( cast(nb, c_void_p).value )
+        N = nb.contents.N
+        offsets = library_array( owner, nb.contents.offsets, (N+1,), np.int64 )
+        neighs  = library_array( owner, nb.contents.neighs, (offsets[-1],),
+                                 np.int64 )
+        return offsets, neighs
+
+
+## A k-d tree over a set of points, for finding the nearest points, or
+#  all points within some distance, of other points.
+#
+#  Along the periodic directions of the box, distances are
+#  minimum-image distances. Use it like
+#
+#      tree = kd_tree( b.x, b.meta.domain.periodic,
+#                      b.meta.domain.xlo, b.meta.domain.xhi )
+#      idx, dist = tree.knn( b.x, 12, skip_self = True )
+#
+class kd_tree:
+    ## Builds the tree.
+    #
+    #  \param x         Positions of the points, N x 3
+    #  \param periodic  Periodicity bits of the box, as in domain.periodic
+    #  \param xlo       Lower corner of the box, or None if not periodic
+    #  \param xhi       Upper corner of the box, or None if not periodic
+    #  \param dims      Dimensions of the box; for 2, z is ignored
+    #
+    def __init__(self, x, periodic = 0, xlo = None, xhi = None, dims = 3):
+        x = np.ascontiguousarray( x, dtype = np.float64 )
+        self.N = x.shape[0]
+        if xlo is None or xhi is None:
+            periodic, box_lo, box_hi = 0, None, None
+        else:
+            box_lo = void_ptr( np.ascontiguousarray( xlo, dtype = np.float64 ) )
+            box_hi = void_ptr( np.ascontiguousarray( xhi, dtype = np.float64 ) )
+
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.get_kd_tree_handle.restype = c_void_p
+        self.handle = lammpstools.get_kd_tree_handle( void_ptr(x),
+                                                      c_longlong(self.N),
+                                                      c_longlong(periodic),
+                                                      box_lo, box_hi,
+                                                      c_longlong(dims) )
+
+    def __del__(self):
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.release_kd_tree_handle( c_void_p(self.handle) )
+
+    ## Finds the k nearest points of each point in q. Returns their
+    #  indices and distances, both M x k and nearest first. Where fewer
+    #  than k points exist, the index is -1 and the distance infinite.
+    #  If skip_self, q are the points of the tree, and no point finds
+    #  itself.
+    def knn(self, q, k, skip_self = False):
+        q = np.ascontiguousarray( q, dtype = np.float64 )
+        M = q.shape[0]
+        idx  = np.empty( (M, k), dtype = np.int64 )
+        dist = np.empty( (M, k), dtype = np.float64 )
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.kd_tree_knn( c_void_p(self.handle), void_ptr(q),
+                                 c_longlong(M), c_longlong(k),
+                                 c_longlong(skip_self), void_ptr(idx),
+                                 void_ptr(dist) )
+        return idx, dist
+
+    ## Finds all points within distance r of each point in q. Returns
+    #  them like neighborize_csr does, but as indices into the points
+    #  of the tree: those near q[i] are neighs[offsets[i]:offsets[i+1]].
+    def radius(self, q, r, skip_self = False):
+        q = np.ascontiguousarray( q, dtype = np.float64 )
+        M = q.shape[0]
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.kd_tree_radius.restype = POINTER(neighbor_buffer)
+        nb = lammpstools.kd_tree_radius( c_void_p(self.handle), void_ptr(q),
+                                         c_longlong(M), c_double(r),
+                                         c_longlong(skip_self) )
+        if not nb:
+            raise RuntimeError("Failed to query k-d tree!")
+
+        owner = _neighbor_buffer_owner( cast(nb, c_void_p).value )
+        offsets = library_array( owner, nb.contents.offsets, (M+1,), np.int64 )
+        neighs  = library_array( owner, nb.contents.neighs, (offsets[-1],),
+                                 np.int64 )
+        return offsets, neighs
+
+
 ## Attempts to identify clusters, based on a threshold criterion.
 # 
 #  \param neighs  Neighbor list to identify clusters in
@@ -6,60 +6,53 @@ Routines for performing a triangulation and analysing it.
 """
 
 
+import math
+import numpy as np
+from ctypes import *
+
+from lammpstools.typecasts import *
+from lammpstools.util import make_id_map
+
+
+class triangle_buffer(Structure):
+    ## Mirrors struct triangle_buffer in triangulate.h.
+    _fields_ = [ ("n_triangles", c_longlong),
+                 ("indices", c_void_p) ]
+
+
+class _triangle_buffer_owner:
+    ## Releases a triangle_buffer once no array view of it is left.
+    def __init__(self, ptr):
+        self.ptr = ptr
+
+    def __del__(self):
+        lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+        lammpstools.release_triangle_buffer( c_void_p(self.ptr) )
+
 
 def triangulate( b, rc, dims, method = None ):
-    """ ! Triangulates given block. """
+    """ ! Triangulates given block.
+
+    Returns an (n, 3) array of the atom indices of the triangles, a
+    read-only view of the buffer the C++ lib wrote them into.
+    """
+    if method is None: method = 0
 
     lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+    lammpstools.triangulate_to_buffer.restype = POINTER(triangle_buffer)
+    tb = lammpstools.triangulate_to_buffer(void_ptr(b.x), c_longlong(b.meta.N),
+                                           void_ptr(b.ids), void_ptr(b.types),
+                                           c_double(rc),
+                                           c_longlong(b.meta.domain.periodic),
+                                           void_ptr(b.meta.domain.xlo),
+                                           void_ptr(b.meta.domain.xhi),
+                                           c_longlong(dims), c_longlong(method))
+    if not tb:
+        raise RuntimeError("Failed to triangulate!")
 
-    pname_base = '/tmp/lammpstools_triangulate_pipe_'
-    pname = pname_base + str(os.getpid())
-
-    os.mkfifo(pname)
-    triangles = []
-    
-    try:
-
-        def start_triangulate():
-            # Make the child neighborize while the main thread reads from the pipe
-            lammpstools.triangulate(void_ptr(b.x), c_longlong(b.meta.N), void_ptr(b.ids),
-                                    void_ptr(b.types), c_double(rc),
-                                    c_longlong(b.meta.domain.periodic),
-                                    void_ptr(b.meta.domain.xlo), void_ptr(b.meta.domain.xhi),
-                                    c_longlong(dims), c_longlong(method), c_char_p(pname))
-            
-        p = Process(target = start_triangulate)
-        p.start()
-
-        # Read in the file and store in neighs
-        current_l = []
-        int_size = 8
-        int_fmt  = 'q'
-        ints_read = 0
-        i = 0
-        lc = 1
-        with open(pname,"rb") as fifo:
-            while True:
-                line = fifo.readline()
-
-                if line == '':
-                    # Out of data apparently.
-                    break
-                words = line.split()
-                t1 = int(words[0])
-                t2 = int(words[1])
-                t3 = int(words[2])
-                
-                triangles.append( [ t1, t2, t3 ] )
-                lc += 1
-        p.join()
-
-    finally:
-        if os.path.exists( pname ):
-            os.unlink( pname )
-            # time.sleep(0.1)
-
-    return triangles
+    owner = _triangle_buffer_owner( cast(tb, c_void_p).value )
+    return library_array( owner, tb.contents.indices,
+                          (tb.contents.n_triangles, 3), np.int64 )
 
 
 def triangulation_area( b, triangles ):
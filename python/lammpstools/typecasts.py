@@ -19,3 +19,24 @@ def ctype_arr_to_np(ptr,Nx,Ny):
 def void_ptr(a):
     "Casts a to a c_type void_ptr"
     return a.ctypes.data_as(ctypes.c_void_p)
+
+
+class _library_memory:
+    ## Exposes memory owned by the C++ lib to numpy, read-only. The arrays
+    #  numpy makes from it keep it, and so its owner, alive. The owner
+    #  frees the memory when it is deleted.
+    def __init__(self, owner, ptr, shape, typestr):
+        self.owner = owner
+        self.__array_interface__ = { 'data' : (ptr, True),
+                                     'shape' : shape,
+                                     'typestr' : typestr,
+                                     'version' : 3 }
+
+
+def library_array(owner, ptr, shape, dtype):
+    "Returns a read-only numpy view of memory at address ptr that is \
+owned by the C++ lib and freed once owner is deleted."
+    if ptr is None or np.prod(shape) == 0:
+        return np.empty( shape, dtype = dtype )
+    return np.asarray( _library_memory( owner, ptr, shape,
+                                        np.dtype(dtype).str ) )
@@ -32,6 +32,26 @@ def make_id_map( ids, largest_id = None ):
 
 
 
+## Sets the number of threads the C++ library uses, for example to
+#  build neighbor lists.
+#
+#  \param n  Number of threads. 0 means the value of the environment
+#            variable LAMMPSTOOLS_NUM_THREADS (or OMP_NUM_THREADS), or
+#            one per core if neither is set. Negative means one per core.
+#
+def set_n_threads( n ):
+    lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+    lammpstools.set_n_threads( c_longlong(n) )
+
+
+## Returns the number of threads the C++ library uses.
+def get_n_threads():
+    lammpstools = cdll.LoadLibrary("/usr/local/lib/liblammpstools.so")
+    lammpstools.get_n_threads.restype = c_longlong
+    return lammpstools.get_n_threads()
+
+
+
 ## Generates an ensemble of particles on given manifold.
 # 
 # @param N              Number of particles to create
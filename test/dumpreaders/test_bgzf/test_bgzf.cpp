@@ -0,0 +1,163 @@
+#include "bgzf.h"
+#include "dump_reader.h"
+#include "mapped_file.h"
+#include "util.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// Recompresses a dump into BGZF and checks that reading it, serially,
+// with several threads and through the boost gzip reader, gives the
+// same blocks as the plain text dump.
+int compare( const std::string &fname, const std::string &bgzf_name,
+             int fformat, int n_workers )
+{
+	dump_reader d_plain( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	dump_reader d_gz( bgzf_name, dump_reader::LAMMPS, fformat, n_workers, 0 );
+	block_data b_plain, b_gz;
+
+	int n_blocks = 0;
+	int n_errors = 0;
+	while( !d_plain.next_block( b_plain ) ){
+		if( d_gz.next_block( b_gz ) ){
+			std::cerr << "BGZF reader ran out of blocks early!\n";
+			return 1;
+		}
+		++n_blocks;
+		if( b_plain.tstep != b_gz.tstep || b_plain.N != b_gz.N ){
+			std::cerr << "Meta mismatch at block " << n_blocks << "!\n";
+			return 1;
+		}
+		for( py_int i = 0; i < b_plain.N; ++i ){
+			if( b_plain.ids[i] != b_gz.ids[i] ||
+			    b_plain.x_[3*i] != b_gz.x_[3*i] ) ++n_errors;
+		}
+	}
+	if( !d_gz.next_block( b_gz ) ){
+		std::cerr << "BGZF reader has more blocks than plain reader!\n";
+		return 1;
+	}
+	std::cerr << dump_reader::fformat_to_str( fformat ) << ", "
+	          << n_workers << " workers: compared " << n_blocks
+	          << " blocks, " << n_errors << " atoms differed.\n";
+	return n_errors;
+}
+
+
+#ifdef HAVE_ZLIB
+// Inflates every block, including the empty EOF marker, into a buffer
+// that was not used before.
+int check_blocks( const std::string &bgzf_name )
+{
+	mapped_file file( bgzf_name );
+	bgzf_index index;
+	if( !file.good() || !index.build( file.data(), file.size() ) ){
+		std::cerr << "Cannot index " << bgzf_name << "!\n";
+		return 1;
+	}
+	bgzf_inflater inflater;
+	int n_errors = 0;
+	for( std::size_t i = 0; i < index.size(); ++i ){
+		std::vector<char> out;
+		if( inflater.inflate( file.data(), index[i], out ) ){
+			std::cerr << "Block " << i << " of " << index.size()
+			          << " does not inflate!\n";
+			++n_errors;
+		}
+	}
+	return n_errors;
+}
+#endif // HAVE_ZLIB
+
+
+// Indexes a dump that ends in the middle of a box line.
+int check_truncated( const std::string &fname )
+{
+	const std::string trunc_name = "melt_trunc.dump";
+	const std::string bgzf_name = "melt_trunc.dump.gz";
+	std::ifstream in( fname );
+	std::ofstream out( trunc_name );
+	std::string line;
+	int n_frames = 0;
+	while( std::getline( in, line ) ){
+		if( starts_with( line, "ITEM: BOX BOUNDS" ) && ++n_frames == 4 ){
+			out << line << "\n-1.5 -";
+			break;
+		}
+		out << line << "\n";
+	}
+	out.close();
+
+	int n_errors = 0;
+	if( bgzf_recompress( trunc_name.c_str(), bgzf_name.c_str(), 6 ) ){
+		std::cerr << "Recompressing failed!\n";
+		++n_errors;
+	}else{
+		dump_reader d( bgzf_name );
+		if( d.block_count() != 3 ){
+			std::cerr << "Truncated dump has " << d.block_count()
+			          << " instead of 3 blocks!\n";
+			++n_errors;
+		}
+	}
+	std::remove( trunc_name.c_str() );
+	std::remove( bgzf_name.c_str() );
+	std::remove( bgzf_index::sidecar_name( bgzf_name ).c_str() );
+	std::remove( dump_index::sidecar_name( bgzf_name ).c_str() );
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+#ifndef HAVE_ZLIB
+	std::cerr << "Built without zlib, nothing to test.\n";
+	return 0;
+#else
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+	std::string bgzf_name = "melt_bgzf.dump.gz";
+
+	if( bgzf_recompress( fname.c_str(), bgzf_name.c_str(), 6 ) ){
+		std::cerr << "Recompressing failed!\n";
+		return 1;
+	}
+	if( !bgzf_is_bgzf( bgzf_name ) ){
+		std::cerr << "Output is not recognised as BGZF!\n";
+		return 1;
+	}
+
+	int n_errors = 0;
+	n_errors += compare( fname, bgzf_name, dump_reader::BGZF, 0 );
+	n_errors += compare( fname, bgzf_name, dump_reader::BGZF, 3 );
+	// Still readable as ordinary gzip.
+	n_errors += compare( fname, bgzf_name, dump_reader::GZIP, 0 );
+	n_errors += check_blocks( bgzf_name );
+	n_errors += check_truncated( fname );
+
+	// Seeking through the frame index:
+	dump_reader d( bgzf_name );
+	block_data b, b_plain;
+	dump_reader d_plain( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	std::size_t n_blocks = d.block_count();
+	d_plain.skip_blocks( n_blocks - 1 );
+	d_plain.next_block( b_plain );
+	if( d.seek_block( n_blocks - 1 ) || d.next_block( b ) ||
+	    b.tstep != b_plain.tstep || b.x_[0] != b_plain.x_[0] ){
+		std::cerr << "Seeking to the last block failed!\n";
+		++n_errors;
+	}
+	if( d.seek_block( 1 ) || d.next_block( b ) || d.next_block( b ) ){
+		std::cerr << "Seeking back failed!\n";
+		++n_errors;
+	}
+
+	std::remove( bgzf_name.c_str() );
+	std::remove( bgzf_index::sidecar_name( bgzf_name ).c_str() );
+	std::remove( dump_index::sidecar_name( bgzf_name ).c_str() );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+#endif // HAVE_ZLIB
+}
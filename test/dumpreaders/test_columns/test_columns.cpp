@@ -0,0 +1,155 @@
+#include "dump_reader.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Copies a dump and adds the columns vx and c_pe to the ATOMS lines.
+bool add_columns( const std::string &fname, const std::string &out_name )
+{
+	std::ifstream in( fname );
+	std::ofstream out( out_name );
+	if( !in || !out ) return false;
+
+	std::string line;
+	bool atoms = false;
+	while( std::getline( in, line ) ){
+		if( starts_with( line, "ITEM: ATOMS" ) ){
+			out << line << " vx c_pe\n";
+			atoms = true;
+		}else if( starts_with( line, "ITEM:" ) ){
+			out << line << "\n";
+			atoms = false;
+		}else if( atoms ){
+			std::stringstream ss( line );
+			py_int id;
+			ss >> id;
+			out << line << " " << 0.25*id << " " << -0.5*id << "\n";
+		}else{
+			out << line << "\n";
+		}
+	}
+	return true;
+}
+
+
+const dump_col *find_col( const block_data &b, const std::string &name )
+{
+	for( const dump_col &c : b.other_cols ){
+		if( c.header == name ) return &c;
+	}
+	return nullptr;
+}
+
+
+// Reads the dump with a selection of columns and checks that the
+// selected ones match a full read and that the others are left out.
+int check_selection( const std::string &fname, int fformat, int n_workers,
+                     const std::vector<std::string> &columns )
+{
+	dump_reader d_all( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	dump_reader d_sel( fname, dump_reader::LAMMPS, fformat, n_workers, 0,
+	                   columns );
+	block_data b_all, b_sel;
+
+	auto selected = [&columns]( const std::string &c ){
+		for( const std::string &s : columns ){
+			if( s == c ) return true;
+		}
+		return columns.empty();
+	};
+	// Scaled positions are selected by their own name too.
+	bool want_x  = ( selected( "x" ) || selected( "xs" ) ) &&
+		( selected( "y" ) || selected( "ys" ) ) &&
+		( selected( "z" ) || selected( "zs" ) );
+	bool want_pe = selected( "c_pe" );
+
+	int n_blocks = 0;
+	int n_errors = 0;
+	while( !d_all.next_block( b_all ) ){
+		if( d_sel.next_block( b_sel ) ){
+			std::cerr << "Reader ran out of blocks early!\n";
+			return 1;
+		}
+		++n_blocks;
+		if( b_all.tstep != b_sel.tstep || b_all.N != b_sel.N ||
+		    b_all.xhi[0] != b_sel.xhi[0] ){
+			std::cerr << "Meta mismatch at block " << n_blocks << "!\n";
+			return 1;
+		}
+
+		const dump_col *pe = find_col( b_sel, "c_pe" );
+		const dump_col *vx = find_col( b_sel, "vx" );
+		if( ( pe != nullptr ) != want_pe ||
+		    ( vx != nullptr ) != selected( "vx" ) ){
+			std::cerr << "Wrong other columns in block "
+			          << n_blocks << "!\n";
+			return 1;
+		}
+		const dump_col *pe_all = find_col( b_all, "c_pe" );
+		for( py_int i = 0; i < b_all.N; ++i ){
+			if( b_sel.ids[i] != ( selected( "id" ) ? b_all.ids[i] : 0 ) ){
+				++n_errors;
+			}
+			for( int d = 0; d < 3; ++d ){
+				if( b_sel.x[i][d] != ( want_x ? b_all.x[i][d] : 0.0 ) ){
+					++n_errors;
+				}
+			}
+			if( pe && pe->data[i] != pe_all->data[i] ) ++n_errors;
+		}
+	}
+	if( !d_sel.next_block( b_sel ) ){
+		std::cerr << "Reader has too many blocks!\n";
+		return 1;
+	}
+
+	std::cerr << dump_reader::fformat_to_str( fformat ) << ", "
+	          << n_workers << " workers, columns {";
+	for( const std::string &c : columns ) std::cerr << " " << c;
+	std::cerr << " }: compared " << n_blocks << " blocks, "
+	          << n_errors << " atoms differed.\n";
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+	std::string out_name = "melt_columns.dump";
+	if( !add_columns( fname, out_name ) ){
+		std::cerr << "Failed to write " << out_name << "!\n";
+		return 1;
+	}
+
+	std::vector<std::vector<std::string> > selections = {
+		{},
+		{ "id", "type", "x", "y", "z" },
+		{ "id", "type", "xs", "ys", "zs", "c_pe" },
+		{ "id", "c_pe" },
+		{ "id" }
+	};
+	int n_errors = 0;
+	for( const std::vector<std::string> &s : selections ){
+		n_errors += check_selection( out_name, dump_reader::PLAIN, 0, s );
+		n_errors += check_selection( out_name, dump_reader::MMAP, 0, s );
+		n_errors += check_selection( out_name, dump_reader::PLAIN, 2, s );
+	}
+
+	// A column that is not in the dump is an error.
+	dump_reader d( out_name, dump_reader::LAMMPS, dump_reader::MMAP, 0, 0,
+	               { "id", "c_ke" } );
+	block_data b;
+	if( d.next_block( b ) >= 0 ){
+		std::cerr << "Selecting a missing column did not fail!\n";
+		++n_errors;
+	}
+
+	std::remove( out_name.c_str() );
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
@@ -0,0 +1,153 @@
+#include "dump_reader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Writes DCD records, optionally in the other byte order.
+struct record_writer
+{
+	std::FILE *out;
+	bool swap;
+
+	void put( const void *data, std::size_t size, std::size_t word )
+	{
+		const char *p = static_cast<const char*>( data );
+		for( std::size_t i = 0; i < size; i += word ){
+			char w[8];
+			std::memcpy( w, p + i, word );
+			if( swap ) std::reverse( w, w + word );
+			std::fwrite( w, 1, word, out );
+		}
+	}
+
+	void record( const void *data, std::size_t size, std::size_t word )
+	{
+		int32_t len = size;
+		put( &len, 4, 4 );
+		put( data, size, word );
+		put( &len, 4, 4 );
+	}
+};
+
+
+py_float position( int frame, int atom, int d )
+{
+	return 0.25 * atom + 1.5 * d + 0.125 * frame;
+}
+
+
+void write_dcd( const std::string &fname, bool swap, int n_frames, int N )
+{
+	record_writer w = { std::fopen( fname.c_str(), "wb" ), swap };
+
+	int32_t icntrl[20] = {};
+	icntrl[0]  = n_frames;
+	icntrl[1]  = 1000;   // First time step
+	icntrl[2]  = 50;     // Steps between frames
+	icntrl[10] = 1;      // Unit cell
+	icntrl[19] = 24;     // CHARMM version
+	// Write "CORD" as it is and swap the ints.
+	int32_t len = 84;
+	w.put( &len, 4, 4 );
+	std::fwrite( "CORD", 1, 4, w.out );
+	w.put( icntrl, sizeof(icntrl), 4 );
+	w.put( &len, 4, 4 );
+
+	char title[4 + 80] = {};
+	int32_t n_titles = 1;
+	std::memcpy( title, &n_titles, 4 );
+	std::strcpy( title + 4, "Test DCD file" );
+	w.record( title, sizeof(title), 1 );
+
+	int32_t NN = N;
+	w.record( &NN, 4, 4 );
+
+	for( int f = 0; f < n_frames; ++f ){
+		double cell[6] = { 10.0 + f, 90, 11.0, 90, 90, 12.0 };
+		w.record( cell, sizeof(cell), 8 );
+		for( int d = 0; d < 3; ++d ){
+			std::vector<float> plane( N );
+			for( int i = 0; i < N; ++i ){
+				plane[i] = position( f, i, d );
+			}
+			w.record( plane.data(), 4*N, 4 );
+		}
+	}
+	std::fclose( w.out );
+}
+
+
+int check_dcd( bool swap )
+{
+	const int n_frames = 5, N = 7;
+	std::string fname = "test_dcd_out.dcd";
+	write_dcd( fname, swap, n_frames, N );
+
+	int n_errors = 0;
+	dump_reader r( fname );
+	block_data b;
+	for( int f = 0; f < n_frames; ++f ){
+		if( r.next_block( b ) || b.N != N || b.tstep != 1000 + 50*f ||
+		    b.xhi[0] != 10.0 + f || b.xhi[1] != 11.0 ||
+		    b.xhi[2] != 12.0 || b.periodic != 7 ){
+			std::cerr << "Frame " << f << " is wrong!\n";
+			++n_errors;
+			continue;
+		}
+		for( int i = 0; i < N; ++i ){
+			for( int d = 0; d < 3; ++d ){
+				if( b.x[i][d] != static_cast<float>(
+					    position( f, i, d ) ) ){
+					std::cerr << "Atom " << i << " of frame "
+					          << f << " is wrong!\n";
+					++n_errors;
+				}
+			}
+			if( b.ids[i] != i + 1 ) ++n_errors;
+		}
+	}
+	if( !r.next_block( b ) ){
+		std::cerr << "Could read past last frame!\n";
+		++n_errors;
+	}
+
+	if( r.block_count() != n_frames ){
+		std::cerr << "block_count is " << r.block_count() << "!\n";
+		++n_errors;
+	}
+	for( int f = n_frames; f-- > 0; ){
+		if( r.seek_block( f ) || r.next_block( b ) ||
+		    b.tstep != 1000 + 50*f ||
+		    b.x[3][1] != static_cast<float>( position( f, 3, 1 ) ) ){
+			std::cerr << "seek_block( " << f << " ) failed!\n";
+			++n_errors;
+		}
+	}
+	if( r.seek_timestep( 1120 ) || r.next_block( b ) || b.tstep != 1150 ){
+		std::cerr << "seek_timestep failed!\n";
+		++n_errors;
+	}
+	r.rewind();
+	if( r.skip_blocks( 2 ) || r.next_block( b ) || b.tstep != 1100 ){
+		std::cerr << "skip_blocks failed!\n";
+		++n_errors;
+	}
+
+	std::remove( fname.c_str() );
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	int n_errors = check_dcd( false );
+	n_errors += check_dcd( true );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
@@ -0,0 +1,114 @@
+#include "dump_reader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+// Appends the frames of a dump to a file in pieces, cutting them in the
+// middle of the header and in the middle of an atom line, like a
+// simulation that is still writing would.
+void write_slowly( const std::string &text, const std::string &name )
+{
+	std::vector<std::size_t> starts;
+	for( std::size_t p = text.find( "ITEM: TIMESTEP" );
+	     p != std::string::npos; p = text.find( "ITEM: TIMESTEP", p + 1 ) ){
+		starts.push_back( p );
+	}
+	starts.push_back( text.size() );
+
+	std::ofstream out( name, std::ios::app | std::ios::binary );
+	for( std::size_t f = 0; f + 1 < starts.size(); ++f ){
+		std::size_t a = starts[f], e = starts[f+1];
+		std::size_t cuts[] = { a, a + 20, ( a + e ) / 2 + 3, e };
+		for( int k = 0; k < 3; ++k ){
+			out.write( text.data() + cuts[k], cuts[k+1] - cuts[k] );
+			out.flush();
+			std::this_thread::sleep_for( std::chrono::milliseconds( 30 ) );
+		}
+	}
+}
+
+
+int check_follow( const std::string &fname, int fformat )
+{
+	std::vector<py_int> tsteps;
+	std::vector<py_float> x_last;
+	dump_reader d_plain( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	block_data b;
+	while( !d_plain.next_block( b ) ){
+		tsteps.push_back( b.tstep );
+		x_last.push_back( b.x_[3*b.N - 1] );
+	}
+
+	std::ifstream in( fname, std::ios::binary );
+	std::string text( ( std::istreambuf_iterator<char>( in ) ),
+	                  std::istreambuf_iterator<char>() );
+
+	std::string name = "test_follow_out.dump";
+	std::ofstream( name ).close();
+
+	int n_errors = 0;
+	dump_reader d( name, dump_reader::LAMMPS, fformat );
+	if( !d.follow( true, 1.0 ) ){
+		std::cerr << "Cannot follow "
+		          << dump_reader::fformat_to_str( fformat ) << "!\n";
+		return 1;
+	}
+
+	std::thread writer( write_slowly, std::cref( text ), std::cref( name ) );
+	std::size_t n = 0;
+	for( ; n < tsteps.size(); ++n ){
+		// Skip one frame to check that skipping waits too.
+		if( n == 1 ){
+			if( d.skip_block() ){
+				std::cerr << "Skipping block 1 failed!\n";
+				++n_errors;
+				break;
+			}
+			continue;
+		}
+		if( d.next_block( b ) ){
+			std::cerr << "Reading block " << n << " failed!\n";
+			++n_errors;
+			break;
+		}
+		if( b.tstep != tsteps[n] || b.x_[3*b.N - 1] != x_last[n] ){
+			std::cerr << "Block " << n << " is wrong!\n";
+			++n_errors;
+		}
+	}
+	writer.join();
+
+	// Nothing more is written, so reading ends after the time out.
+	auto start = std::chrono::steady_clock::now();
+	int status = d.next_block( b );
+	double waited = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start ).count();
+	if( status <= 0 || waited < 0.9 || waited > 5.0 ){
+		std::cerr << "Reading past the end returned " << status
+		          << " after " << waited << " s!\n";
+		++n_errors;
+	}
+
+	std::remove( name.c_str() );
+	std::cerr << dump_reader::fformat_to_str( fformat ) << ": followed "
+	          << n << " blocks, " << n_errors << " errors.\n";
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	int n_errors = check_follow( fname, dump_reader::PLAIN );
+	n_errors += check_follow( fname, dump_reader::MMAP );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
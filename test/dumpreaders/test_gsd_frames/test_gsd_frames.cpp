@@ -0,0 +1,143 @@
+#include "domain.h"
+#include "dump_reader.h"
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "gsd/gsd.h"
+
+// Writes a GSD file like HOOMD does: frame 0 has everything except the
+// step, which defaults to 0, and later frames only store the step and
+// the positions, the rest is taken from frame 0.
+void write_gsd( const std::string &fname, int n_frames, uint32_t N )
+{
+	gsd_handle gh;
+	gsd_create_and_open( &gh, fname.c_str(), "test", "hoomd",
+	                     gsd_make_version( 1, 1 ), GSD_OPEN_READWRITE, 0 );
+	for( int f = 0; f < n_frames; ++f ){
+		std::vector<float> x( 3*N );
+		for( uint32_t i = 0; i < 3*N; ++i ) x[i] = 0.01f*i + f;
+
+		if( f > 0 ){
+			uint64_t step = 1000*f;
+			gsd_write_chunk( &gh, "configuration/step", GSD_TYPE_UINT64,
+			                 1, 1, 0, &step );
+		}else{
+			float box[6] = { 10, 12, 14, 0, 0, 0 };
+			gsd_write_chunk( &gh, "configuration/box", GSD_TYPE_FLOAT,
+			                 6, 1, 0, box );
+			gsd_write_chunk( &gh, "particles/N", GSD_TYPE_UINT32,
+			                 1, 1, 0, &N );
+			std::vector<uint32_t> types( N );
+			std::vector<float> v( 3*N );
+			for( uint32_t i = 0; i < N; ++i ){
+				types[i] = i % 2;
+				v[3*i] = i;
+				v[3*i+1] = -1.0f*i;
+				v[3*i+2] = 0.5f;
+			}
+			gsd_write_chunk( &gh, "particles/typeid", GSD_TYPE_UINT32,
+			                 N, 1, 0, types.data() );
+			gsd_write_chunk( &gh, "particles/velocity", GSD_TYPE_FLOAT,
+			                 N, 3, 0, v.data() );
+		}
+		gsd_write_chunk( &gh, "particles/position", GSD_TYPE_FLOAT,
+		                 N, 3, 0, x.data() );
+		gsd_end_frame( &gh );
+	}
+	gsd_close( &gh );
+}
+
+
+int check_frame( const block_data &b, int f, uint32_t N, bool extra )
+{
+	if( b.N != N || b.tstep != 1000*f || b.xlo[1] != -6.0 ||
+	    b.xhi[2] != 7.0 || b.periodic != PERIODIC_FULL ){
+		std::cerr << "Wrong meta in frame " << f << "!\n";
+		return 1;
+	}
+	int n_errors = 0;
+	for( uint32_t i = 0; i < N; ++i ){
+		if( b.ids[i] != i + 1 || b.types[i] != i % 2 + 1 ||
+		    b.x[i][1] != 0.01f*( 3*i + 1 ) + f ) ++n_errors;
+	}
+	if( !extra ){
+		if( !b.other_cols.empty() ) ++n_errors;
+		return n_errors;
+	}
+	// Velocities are taken from frame 0, masses are not in the file
+	// and get the default of 1.
+	if( b.other_cols.size() != 4 || b.other_cols[0].header != "vx" ||
+	    b.other_cols[3].header != "mass" ){
+		std::cerr << "Wrong other columns in frame " << f << "!\n";
+		return n_errors + 1;
+	}
+	for( uint32_t i = 0; i < N; ++i ){
+		if( b.other_cols[0].data[i] != i ||
+		    b.other_cols[1].data[i] != -1.0*i ||
+		    b.other_cols[2].data[i] != 0.5 ||
+		    b.other_cols[3].data[i] != 1.0 ) ++n_errors;
+	}
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	const int n_frames = 5;
+	const uint32_t N = 20;
+	std::string fname = "test_gsd_frames_out.gsd";
+	write_gsd( fname, n_frames, N );
+
+	int n_errors = 0;
+	block_data b;
+	{
+		dump_reader r( fname );
+		for( int f = 0; f < n_frames; ++f ){
+			if( r.next_block( b ) ){
+				std::cerr << "Failed to read frame " << f << "!\n";
+				++n_errors;
+				break;
+			}
+			n_errors += check_frame( b, f, N, false );
+		}
+		if( r.next_block( b ) != 1 ){
+			std::cerr << "No EOF after the last frame!\n";
+			++n_errors;
+		}
+		if( r.block_count() != n_frames ){
+			std::cerr << "Wrong block count!\n";
+			++n_errors;
+		}
+		if( r.seek_timestep( 2500 ) || r.next_block( b ) ){
+			std::cerr << "seek_timestep failed!\n";
+			++n_errors;
+		}else{
+			n_errors += check_frame( b, 3, N, false );
+		}
+		r.rewind();
+		if( r.skip_blocks( 2 ) || r.next_block( b ) ){
+			std::cerr << "skip_blocks failed!\n";
+			++n_errors;
+		}else{
+			n_errors += check_frame( b, 2, N, false );
+		}
+	}
+	{
+		dump_reader r( fname, dump_reader::GSD, dump_reader::BIN, 0, 0,
+		               { "id", "x", "particles/velocity", "mass" } );
+		for( int f = 0; f < n_frames; ++f ){
+			if( r.next_block( b ) ){
+				std::cerr << "Failed to read frame " << f << "!\n";
+				++n_errors;
+				break;
+			}
+			n_errors += check_frame( b, f, N, true );
+		}
+	}
+
+	std::remove( fname.c_str() );
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
@@ -0,0 +1,119 @@
+#include "dump_reader.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Checks random access through the frame index against sequential reads.
+int check_format( const std::string &fname, int fformat )
+{
+	std::vector<py_int> tsteps;
+	block_data b;
+	dump_reader seq( fname, dump_reader::LAMMPS, fformat );
+	while( !seq.next_block( b ) ) tsteps.push_back( b.tstep );
+
+	int n_errors = 0;
+	dump_reader d( fname, dump_reader::LAMMPS, fformat );
+	if( d.block_count() != tsteps.size() ){
+		std::cerr << "block_count is " << d.block_count()
+		          << ", expected " << tsteps.size() << "!\n";
+		++n_errors;
+	}
+
+	// Seek backwards through the file.
+	for( std::size_t i = tsteps.size(); i-- > 0; ){
+		if( d.seek_block( i ) || d.next_block( b ) ||
+		    b.tstep != tsteps[i] ){
+			std::cerr << "seek_block( " << i << " ) failed!\n";
+			++n_errors;
+		}
+	}
+
+	if( d.seek_timestep( tsteps[2] ) || d.next_block( b ) ||
+	    b.tstep != tsteps[2] ){
+		std::cerr << "seek_timestep failed!\n";
+		++n_errors;
+	}
+	if( d.seek_timestep( tsteps.back() + 1 ) <= 0 ){
+		std::cerr << "seek_timestep past the end did not fail!\n";
+		++n_errors;
+	}
+
+	d.rewind();
+	if( d.skip_blocks( 3 ) || d.next_block( b ) || b.tstep != tsteps[3] ){
+		std::cerr << "skip_blocks( 3 ) failed!\n";
+		++n_errors;
+	}
+	// Skipping to the end works as without an index, past it does not.
+	d.rewind();
+	if( d.skip_blocks( tsteps.size() ) || d.next_block( b ) <= 0 ){
+		std::cerr << "skip_blocks to the end failed!\n";
+		++n_errors;
+	}
+	d.rewind();
+	if( d.skip_blocks( tsteps.size() + 1 ) <= 0 ){
+		std::cerr << "skip_blocks past the end did not fail!\n";
+		++n_errors;
+	}
+	if( d.last_block( b ) || b.tstep != tsteps.back() ){
+		std::cerr << "last_block failed!\n";
+		++n_errors;
+	}
+	if( !d.next_block( b ) ){
+		std::cerr << "Could read past last block!\n";
+		++n_errors;
+	}
+
+	return n_errors;
+}
+
+// An index file whose entry count does not fit its size is not loaded.
+int check_bad_count( const std::string &fname )
+{
+	std::string idx_name = dump_index::sidecar_name( fname );
+	dump_index idx;
+	if( !idx.build( fname ) || !idx.save( idx_name ) ){
+		std::cerr << "Could not write the index!\n";
+		return 1;
+	}
+
+	// The count follows the magic, file size and modification time.
+	int n_errors = 0;
+	for( py_int count : { py_int(1) << 60, py_int( idx.size() + 1 ),
+	                      py_int( -1 ) } ){
+		{
+			std::fstream f( idx_name, std::ios::in | std::ios::out |
+			                std::ios::binary );
+			f.seekp( 8 + 2*sizeof(py_int) );
+			f.write( reinterpret_cast<const char*>( &count ),
+			         sizeof(count) );
+		}
+		dump_index loaded;
+		if( loaded.load( idx_name, fname ) ){
+			std::cerr << "Loaded an index with " << count
+			          << " entries!\n";
+			++n_errors;
+		}
+	}
+	std::remove( idx_name.c_str() );
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+	std::remove( dump_index::sidecar_name( fname ).c_str() );
+
+	int n_errors = check_format( fname, dump_reader::PLAIN );
+	// Second run uses the sidecar index written by the first.
+	n_errors += check_format( fname, dump_reader::MMAP );
+	n_errors += check_bad_count( fname );
+
+	std::remove( dump_index::sidecar_name( fname ).c_str() );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
@@ -0,0 +1,219 @@
+#include "domain.h"
+#include "dump_reader.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Writes binary dumps like LAMMPS dump atom/custom does, in the old
+// layout and in the newer one with magic string and column names.
+struct bin_writer
+{
+	std::FILE *out;
+	bool new_layout;
+
+	template <typename T>
+	void put( const T &v ){ std::fwrite( &v, sizeof(T), 1, out ); }
+
+	void put_string( const std::string &s )
+	{
+		int len = s.size();
+		put( len );
+		std::fwrite( s.data(), 1, len, out );
+	}
+
+	void frame( int64_t tstep, int N, bool triclinic,
+	            const std::string &columns, int n_chunks, bool first )
+	{
+		if( new_layout ){
+			std::string magic = "DUMPCUSTOM";
+			put( -static_cast<int64_t>( magic.size() ) );
+			std::fwrite( magic.data(), 1, magic.size(), out );
+			put( int( 1 ) );       // Endianness
+			put( int( 2 ) );       // Revision
+		}
+		put( tstep );
+		put( static_cast<int64_t>( N ) );
+		put( int( triclinic ) );
+		int boundary[6] = { 0, 0, 0, 0, 1, 2 };
+		std::fwrite( boundary, sizeof(int), 6, out );
+		for( int d = 0; d < 3; ++d ){
+			put( double( -1.0 - d ) );
+			put( double( 10.0 + d ) );
+		}
+		if( triclinic ){
+			put( 0.5 );
+			put( 0.25 );
+			put( 0.125 );
+		}
+		int n_cols = new_layout ? 7 : 5;
+		put( n_cols );
+		if( new_layout ){
+			put_string( first ? "lj" : "" );
+			put( char( 1 ) );
+			put( 0.005 * tstep );
+			put_string( columns );
+		}
+		put( n_chunks );
+
+		// Spread the atoms unevenly over the chunks.
+		int start = 0;
+		for( int c = 0; c < n_chunks; ++c ){
+			int end = c == n_chunks - 1 ? N : start + ( N - start ) / 3;
+			put( ( end - start ) * n_cols );
+			for( int i = start; i < end; ++i ){
+				std::vector<double> v = values( tstep, i );
+				std::fwrite( v.data(), sizeof(double), n_cols, out );
+			}
+			start = end;
+		}
+	}
+
+	std::vector<double> values( int64_t tstep, int i ) const
+	{
+		if( new_layout ){
+			// id type mol xs ys zs c_pe
+			return { double( i + 1 ), double( i % 3 + 1 ), double( i / 4 ),
+			         0.01 * i, 0.5, 0.25, -0.5 * i - tstep };
+		}
+		return { double( i + 1 ), double( i % 3 + 1 ),
+		         0.1 * i + tstep, 1.0, 2.0 };
+	}
+};
+
+const std::string new_columns = "id type mol xs ys zs c_pe";
+
+
+void write_dump( const std::string &fname, bool new_layout, int n_frames,
+                 int N )
+{
+	bin_writer w = { std::fopen( fname.c_str(), "wb" ), new_layout };
+	for( int f = 0; f < n_frames; ++f ){
+		w.frame( 100*f, N, f % 2, new_columns, f + 1, f == 0 );
+	}
+	std::fclose( w.out );
+}
+
+
+int check_frame( const block_data &b, bool new_layout, int f, int N )
+{
+	int n_errors = 0;
+	if( b.N != N || b.tstep != 100*f ){
+		std::cerr << "Wrong meta in frame " << f << "!\n";
+		return 1;
+	}
+	if( b.periodic != PERIODIC_X + PERIODIC_Y ||
+	    b.xlo[2] != -3.0 || b.xhi[2] != 12.0 ){
+		std::cerr << "Wrong box in frame " << f << "!\n";
+		++n_errors;
+	}
+	std::string boxline = f % 2 ? "ITEM: BOX BOUNDS xy xz yz pp pp fs"
+		: "ITEM: BOX BOUNDS pp pp fs";
+	if( b.boxline != boxline ){
+		std::cerr << "Wrong box line '" << b.boxline << "'!\n";
+		++n_errors;
+	}
+
+	bin_writer w = { nullptr, new_layout };
+	for( int i = 0; i < N; ++i ){
+		std::vector<double> v = w.values( 100*f, i );
+		if( b.ids[i] != v[0] || b.types[i] != v[1] ) ++n_errors;
+		if( new_layout ){
+			// Scaled positions are unscaled.
+			double x = -1.0 + 11.0 * v[3];
+			if( b.mol[i] != v[2] || b.x[i][0] != x ||
+			    b.x[i][1] != -2.0 + 13.0 * v[4] ||
+			    b.other_cols.size() != 1 ||
+			    b.other_cols[0].header != "c_pe" ||
+			    b.other_cols[0].data[i] != v[6] ) ++n_errors;
+		}else{
+			if( b.x[i][0] != v[2] || b.x[i][1] != v[3] ||
+			    b.x[i][2] != v[4] ) ++n_errors;
+		}
+	}
+	if( new_layout != ( b.atom_style == atom_styles::MOLECULAR ) ){
+		++n_errors;
+	}
+	return n_errors;
+}
+
+
+int check_dump( bool new_layout )
+{
+	const int n_frames = 4, N = 50;
+	std::string fname = "test_lammps_bin_out.dump.bin";
+	write_dump( fname, new_layout, n_frames, N );
+
+	int n_errors = 0;
+	dump_reader r( fname );
+	block_data b;
+	for( int f = 0; f < n_frames; ++f ){
+		if( r.next_block( b ) ){
+			std::cerr << "Failed to read frame " << f << "!\n";
+			return n_errors + 1;
+		}
+		n_errors += check_frame( b, new_layout, f, N );
+	}
+	if( r.next_block( b ) != 1 ){
+		std::cerr << "No EOF after the last frame!\n";
+		++n_errors;
+	}
+
+	r.rewind();
+	if( r.skip_blocks( 3 ) || r.next_block( b ) ){
+		std::cerr << "Skipping failed!\n";
+		++n_errors;
+	}else{
+		n_errors += check_frame( b, new_layout, 3, N );
+	}
+
+	std::remove( fname.c_str() );
+	std::cerr << ( new_layout ? "New" : "Old" ) << " layout: "
+	          << n_errors << " errors.\n";
+	return n_errors;
+}
+
+
+// A cut-off last frame cannot be skipped either.
+int check_truncated()
+{
+	const int n_frames = 4, N = 50;
+	std::string fname = "test_lammps_bin_trunc.dump.bin";
+	write_dump( fname, true, n_frames, N );
+
+	std::FILE *in = std::fopen( fname.c_str(), "rb" );
+	std::vector<char> data;
+	int c;
+	while( ( c = std::fgetc( in ) ) != EOF ) data.push_back( c );
+	std::fclose( in );
+	std::FILE *out = std::fopen( fname.c_str(), "wb" );
+	std::fwrite( data.data(), 1, data.size() - 8, out );
+	std::fclose( out );
+
+	int n_errors = 0;
+	dump_reader r( fname );
+	if( r.skip_blocks( 3 ) ){
+		std::cerr << "Failed to skip the complete frames!\n";
+		++n_errors;
+	}
+	if( r.skip_blocks( 1 ) >= 0 ){
+		std::cerr << "Skipped the incomplete frame!\n";
+		++n_errors;
+	}
+	std::remove( fname.c_str() );
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	int n_errors = check_dump( false );
+	n_errors += check_dump( true );
+	n_errors += check_truncated();
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
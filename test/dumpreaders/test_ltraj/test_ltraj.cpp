@@ -0,0 +1,301 @@
+#include "block_data_writers.h"
+#include "dump_reader.h"
+#include "dump_interpreter_ltraj.h"
+#include "ltraj.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+// Compares two blocks field by field.
+int compare_blocks( const block_data &a, const block_data &b )
+{
+	if( a.N != b.N || a.tstep != b.tstep || a.boxline != b.boxline ||
+	    a.atom_style != b.atom_style || a.periodic != b.periodic ){
+		return 1;
+	}
+	for( int d = 0; d < 3; ++d ){
+		if( a.xlo[d] != b.xlo[d] || a.xhi[d] != b.xhi[d] ) return 1;
+	}
+	for( py_int i = 0; i < a.N; ++i ){
+		if( a.ids[i] != b.ids[i] || a.types[i] != b.types[i] ) return 1;
+		for( int d = 0; d < 3; ++d ){
+			if( a.x[i][d] != b.x[i][d] ) return 1;
+		}
+	}
+	if( a.other_cols.size() != b.other_cols.size() ) return 1;
+	for( std::size_t j = 0; j < a.other_cols.size(); ++j ){
+		if( a.other_cols[j].header != b.other_cols[j].header ||
+		    a.other_cols[j].data != b.other_cols[j].data ){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+// Writes the dump to ltraj with given codec and reads it back.
+int check_codec( const std::deque<block_data> &blocks,
+                 const std::string &ltraj_name, int codec )
+{
+	int n_errors = 0;
+	{
+		ltraj_writer w( ltraj_name, codec );
+		for( const block_data &b : blocks ) w.write( b );
+		if( !w.close() ){
+			std::cerr << "Failed to write " << ltraj_name << "!\n";
+			return 1;
+		}
+	}
+
+	dump_reader r( ltraj_name );
+	block_data b;
+	for( std::size_t i = 0; i < blocks.size(); ++i ){
+		if( r.next_block( b ) || compare_blocks( b, blocks[i] ) ){
+			std::cerr << "Block " << i << " differs!\n";
+			++n_errors;
+		}
+	}
+	if( !r.next_block( b ) ){
+		std::cerr << "Could read past last block!\n";
+		++n_errors;
+	}
+
+	// Random access through the footer index.
+	if( r.block_count() != blocks.size() ){
+		std::cerr << "block_count is " << r.block_count() << "!\n";
+		++n_errors;
+	}
+	for( std::size_t i = blocks.size(); i-- > 0; ){
+		if( r.seek_block( i ) || r.next_block( b ) ||
+		    b.tstep != blocks[i].tstep ){
+			std::cerr << "seek_block( " << i << " ) failed!\n";
+			++n_errors;
+		}
+	}
+	if( r.seek_timestep( blocks[2].tstep ) || r.next_block( b ) ||
+	    b.tstep != blocks[2].tstep ){
+		std::cerr << "seek_timestep failed!\n";
+		++n_errors;
+	}
+
+	// Views of uncompressed columns point into the aligned file.
+	dump_interpreter_ltraj interp( ltraj_name );
+	ltraj_frame_view v;
+	if( interp.read_frame( 1, v ) ){
+		std::cerr << "read_frame failed!\n";
+		return n_errors + 1;
+	}
+	const ltraj_column_view *x = v.column( "x" );
+	if( !x || x->N != blocks[1].N || x->width != 3 ||
+	    x->floats()[3*7+1] != blocks[1].x[7][1] ){
+		std::cerr << "View of column x is wrong!\n";
+		++n_errors;
+	}
+	if( codec == LTRAJ_CODEC_NONE &&
+	    reinterpret_cast<std::uintptr_t>( x->data ) % ltraj_alignment ){
+		std::cerr << "Column x is not aligned!\n";
+		++n_errors;
+	}
+	return n_errors;
+}
+
+
+// Positions rounded to a precision, everything else exact.
+int check_quantized( const std::deque<block_data> &blocks,
+                     const std::string &ltraj_name, py_float precision )
+{
+	{
+		ltraj_writer w( ltraj_name, LTRAJ_CODEC_NONE, 3, precision );
+		for( const block_data &b : blocks ) w.write( b );
+	}
+
+	int n_errors = 0;
+	dump_reader r( ltraj_name );
+	block_data b;
+	for( std::size_t i = 0; i < blocks.size(); ++i ){
+		const block_data &o = blocks[i];
+		if( r.next_block( b ) || b.N != o.N || b.tstep != o.tstep ){
+			std::cerr << "Quantized block " << i << " is wrong!\n";
+			++n_errors;
+			continue;
+		}
+		py_float max_err = 0;
+		for( py_int j = 0; j < 3*b.N; ++j ){
+			max_err = std::max( max_err,
+			                    std::fabs( b.x_[j] - o.x_[j] ) );
+		}
+		bool same = b.other_cols.size() == 1 &&
+			b.other_cols[0].data == o.other_cols[0].data;
+		for( py_int j = 0; j < b.N; ++j ){
+			same = same && b.ids[j] == o.ids[j] &&
+				b.types[j] == o.types[j];
+		}
+		if( max_err > 0.5001 * precision || !same ){
+			std::cerr << "Quantized block " << i << " differs, "
+			          << "position error is " << max_err << "!\n";
+			++n_errors;
+		}
+	}
+	return n_errors;
+}
+
+
+// A file without footer, as left by a writer that crashed.
+int check_truncated( const std::string &ltraj_name, std::size_t n_blocks )
+{
+	std::FILE *in = std::fopen( ltraj_name.c_str(), "rb" );
+	std::vector<char> data;
+	int c;
+	while( ( c = std::fgetc( in ) ) != EOF ) data.push_back( c );
+	std::fclose( in );
+
+	std::size_t footer = n_blocks * sizeof(ltraj_index_entry) +
+		sizeof(ltraj_trailer);
+	std::string trunc_name = ltraj_name + ".trunc.ltraj";
+	std::FILE *out = std::fopen( trunc_name.c_str(), "wb" );
+	std::fwrite( data.data(), 1, data.size() - footer, out );
+	std::fclose( out );
+
+	int n_errors = 0;
+	dump_reader r( trunc_name );
+	if( r.block_count() != n_blocks ){
+		std::cerr << "Scanning found " << r.block_count()
+		          << " blocks instead of " << n_blocks << "!\n";
+		++n_errors;
+	}
+	std::remove( trunc_name.c_str() );
+	return n_errors;
+}
+
+
+// Copies the file with one number replaced and returns the copy's name.
+std::string patched_copy( const std::string &ltraj_name, std::size_t pos,
+                          py_int value )
+{
+	std::FILE *in = std::fopen( ltraj_name.c_str(), "rb" );
+	std::vector<char> data;
+	int c;
+	while( ( c = std::fgetc( in ) ) != EOF ) data.push_back( c );
+	std::fclose( in );
+
+	std::memcpy( data.data() + pos, &value, sizeof(value) );
+	std::string name = ltraj_name + ".corrupt.ltraj";
+	std::FILE *out = std::fopen( name.c_str(), "wb" );
+	std::fwrite( data.data(), 1, data.size(), out );
+	std::fclose( out );
+	return name;
+}
+
+
+// Frame counts and column widths that would overflow are rejected.
+int check_corrupt( const std::string &ltraj_name, std::size_t n_blocks )
+{
+	int n_errors = 0;
+	std::FILE *in = std::fopen( ltraj_name.c_str(), "rb" );
+	std::fseek( in, 0, SEEK_END );
+	std::size_t size = std::ftell( in );
+	std::fclose( in );
+
+	// A footer with too many frames is ignored and the frames are
+	// found by scanning. Adding 2^61 frames makes the index size wrap
+	// around to the right one.
+	std::size_t n_frames_pos = size - sizeof(ltraj_trailer) +
+		offsetof( ltraj_trailer, n_frames );
+	py_int wrap = py_int(1) << 61;
+	for( py_int n : { py_int( n_blocks ) + wrap, py_int( n_blocks + 1 ) } ){
+		std::string name = patched_copy( ltraj_name, n_frames_pos, n );
+		dump_reader r( name );
+		if( r.block_count() != n_blocks ){
+			std::cerr << "Footer with " << n << " frames gave "
+			          << r.block_count() << " blocks!\n";
+			++n_errors;
+		}
+		std::remove( name.c_str() );
+	}
+
+	// The first column of the first frame, which starts after the
+	// file header. Again, adding 2^61 to the width makes the column size
+	// wrap around to the stored size.
+	std::size_t width_pos = ltraj_alignment + sizeof(ltraj_frame_header) +
+		offsetof( ltraj_column, width );
+	py_int width = 0;
+	in = std::fopen( ltraj_name.c_str(), "rb" );
+	std::fseek( in, width_pos, SEEK_SET );
+	if( std::fread( &width, sizeof(width), 1, in ) != 1 ) ++n_errors;
+	std::fclose( in );
+	for( py_int w : { py_int(0), py_int(-3), width + wrap } ){
+		std::string name = patched_copy( ltraj_name, width_pos, w );
+		dump_reader r( name );
+		block_data b;
+		if( r.next_block( b ) >= 0 ){
+			std::cerr << "Read a column of width " << w << "!\n";
+			++n_errors;
+		}
+		std::remove( name.c_str() );
+	}
+	return n_errors;
+}
+
+
+// Bad precisions in the format given to write_block_to_file are
+// rejected and nothing is written.
+int check_bad_precision( const block_data &b, const std::string &ltraj_name )
+{
+	int n_errors = 0;
+	const char *specs[] = { "QUANTIZED:abc", "QUANTIZED:-1", "QUANTIZED:",
+	                        "QUANTIZED:1e-3x" };
+	for( const char *spec : specs ){
+		std::remove( ltraj_name.c_str() );
+		write_block_to_file( &b, ltraj_name.c_str(), spec, "LTRAJ" );
+		std::FILE *f = std::fopen( ltraj_name.c_str(), "rb" );
+		if( f ){
+			std::cerr << "Wrote a file for " << spec << "!\n";
+			std::fclose( f );
+			++n_errors;
+		}
+	}
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	// A deque, because growing a vector would copy the blocks.
+	std::deque<block_data> blocks;
+	dump_reader d( fname );
+	block_data b;
+	while( !d.next_block( b ) ){
+		// Add a custom column to check those too.
+		b.other_cols.resize( 1 );
+		b.other_cols[0].header = "c_pe";
+		b.other_cols[0].data.resize( b.N );
+		for( py_int i = 0; i < b.N; ++i ){
+			b.other_cols[0].data[i] = 0.5 * b.ids[i] + b.tstep;
+		}
+		blocks.emplace_back();
+		blocks.back().swap( b );
+	}
+
+	std::string ltraj_name = "test_ltraj_out.ltraj";
+	int n_errors = check_codec( blocks, ltraj_name, LTRAJ_CODEC_NONE );
+	n_errors += check_truncated( ltraj_name, blocks.size() );
+	n_errors += check_corrupt( ltraj_name, blocks.size() );
+#ifdef HAVE_LIB_ZSTD
+	n_errors += check_codec( blocks, ltraj_name, LTRAJ_CODEC_ZSTD );
+#endif
+	n_errors += check_quantized( blocks, ltraj_name, 1e-3 );
+	n_errors += check_bad_precision( blocks.front(), ltraj_name );
+	std::remove( ltraj_name.c_str() );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
@@ -0,0 +1,61 @@
+#include "dump_reader.h"
+#include "my_timer.hpp"
+
+#include <cmath>
+#include <iostream>
+
+// Reads the same dump with the istream-based and the memory-mapped
+// interpreter and checks that they agree.
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	dump_reader d_plain( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	dump_reader d_mmap ( fname, dump_reader::LAMMPS, dump_reader::MMAP );
+	block_data b_plain, b_mmap;
+
+	int n_blocks = 0;
+	int n_errors = 0;
+	while( !d_plain.next_block( b_plain ) ){
+		if( d_mmap.next_block( b_mmap ) ){
+			std::cerr << "mmap reader ran out of blocks early!\n";
+			return -1;
+		}
+		++n_blocks;
+		if( b_plain.tstep != b_mmap.tstep || b_plain.N != b_mmap.N ){
+			std::cerr << "Meta mismatch at block " << n_blocks << "!\n";
+			return -1;
+		}
+		for( py_int i = 0; i < b_plain.N; ++i ){
+			bool same = ( b_plain.ids[i] == b_mmap.ids[i] ) &&
+				( b_plain.types[i] == b_mmap.types[i] );
+			for( int d = 0; d < 3; ++d ){
+				// The plain reader converts through float.
+				double dx = b_plain.x[i][d] - b_mmap.x[i][d];
+				if( std::fabs( dx ) > 1e-5 ) same = false;
+			}
+			if( !same ) ++n_errors;
+		}
+	}
+	if( !d_mmap.next_block( b_mmap ) ){
+		std::cerr << "mmap reader has more blocks than plain reader!\n";
+		return -1;
+	}
+	std::cerr << "Compared " << n_blocks << " blocks, " << n_errors
+	          << " atoms differed.\n";
+
+	// Time both readers:
+	my_timer timer( std::cerr );
+	dump_reader d1( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	timer.tic();
+	while( !d1.next_block( b_plain ) );
+	timer.toc( "Plain text reader" );
+
+	dump_reader d2( fname, dump_reader::LAMMPS, dump_reader::MMAP );
+	timer.tic();
+	while( !d2.next_block( b_mmap ) );
+	timer.toc( "Memory-mapped reader" );
+
+	return n_errors ? -1 : 0;
+}
@@ -0,0 +1,82 @@
+#include "dump_reader.h"
+#include "my_timer.hpp"
+
+#include <iostream>
+
+// Checks that the parallel reader returns the same blocks, in the same
+// order, as the serial memory-mapped reader.
+int compare( const std::string &fname, int n_workers, int queue_depth )
+{
+	dump_reader d_serial( fname, dump_reader::LAMMPS, dump_reader::MMAP );
+	dump_reader d_par( fname, dump_reader::LAMMPS, dump_reader::MMAP,
+	                   n_workers, queue_depth );
+	block_data b_serial, b_par;
+
+	int n_blocks = 0;
+	int n_errors = 0;
+	while( !d_serial.next_block( b_serial ) ){
+		if( d_par.next_block( b_par ) ){
+			std::cerr << "Parallel reader ran out of blocks early!\n";
+			return 1;
+		}
+		++n_blocks;
+		if( b_serial.tstep != b_par.tstep || b_serial.N != b_par.N ){
+			std::cerr << "Meta mismatch at block " << n_blocks << "!\n";
+			return 1;
+		}
+		for( py_int i = 0; i < b_serial.N; ++i ){
+			bool same = ( b_serial.ids[i] == b_par.ids[i] ) &&
+				( b_serial.types[i] == b_par.types[i] ) &&
+				( b_serial.x_[3*i]   == b_par.x_[3*i] ) &&
+				( b_serial.x_[3*i+1] == b_par.x_[3*i+1] ) &&
+				( b_serial.x_[3*i+2] == b_par.x_[3*i+2] );
+			if( !same ) ++n_errors;
+		}
+	}
+	if( d_par.next_block( b_par ) <= 0 || !d_par.eof() ){
+		std::cerr << "Parallel reader did not end at EOF!\n";
+		return 1;
+	}
+
+	// Rewinding restarts the workers.
+	d_par.rewind();
+	d_par.skip_blocks( 2 );
+	d_serial.rewind();
+	d_serial.skip_blocks( 2 );
+	if( d_par.next_block( b_par ) || d_serial.next_block( b_serial ) ||
+	    b_par.tstep != b_serial.tstep ){
+		std::cerr << "Rewind and skip of parallel reader failed!\n";
+		return 1;
+	}
+
+	std::cerr << n_workers << " workers, queue depth " << queue_depth
+	          << ": compared " << n_blocks << " blocks, " << n_errors
+	          << " atoms differed.\n";
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	int n_errors = 0;
+	n_errors += compare( fname, 1, 1 );
+	n_errors += compare( fname, 3, 2 );
+	n_errors += compare( fname, -1, 0 );
+
+	block_data b;
+	my_timer timer( std::cerr );
+	dump_reader d1( fname, dump_reader::LAMMPS, dump_reader::MMAP );
+	timer.tic();
+	while( !d1.next_block( b ) );
+	timer.toc( "Serial reader" );
+
+	dump_reader d2( fname, dump_reader::LAMMPS, dump_reader::MMAP, -1, 0 );
+	timer.tic();
+	while( !d2.next_block( b ) );
+	timer.toc( "Parallel reader" );
+
+	return n_errors;
+}
@@ -0,0 +1,99 @@
+#include "dump_reader.h"
+#include "dump_reader_prefetch.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Checks that reading through a dump_reader_prefetch gives the same
+// blocks as reading directly, and that the block memory is recycled.
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+	int depth = 2;
+
+	std::vector<py_int> tsteps;
+	std::vector<py_float> x_sums;
+	block_data b;
+	dump_reader d_direct( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	while( !d_direct.next_block( b ) ){
+		tsteps.push_back( b.tstep );
+		py_float sum = 0.0;
+		for( py_int i = 0; i < 3*b.N; ++i ) sum += b.x_[i];
+		x_sums.push_back( sum );
+	}
+
+	int n_errors = 0;
+	dump_reader d( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	dump_reader_prefetch pf( d, depth );
+	std::set<py_float*> buffers;
+	std::size_t n = 0;
+	while( !pf.next_block( b ) ){
+		py_float sum = 0.0;
+		for( py_int i = 0; i < 3*b.N; ++i ) sum += b.x_[i];
+		if( n >= tsteps.size() || b.tstep != tsteps[n] ||
+		    sum != x_sums[n] ){
+			std::cerr << "Block " << n << " differs!\n";
+			++n_errors;
+		}
+		buffers.insert( b.x_ );
+		++n;
+	}
+	if( n != tsteps.size() || !pf.eof() ){
+		std::cerr << "Read " << n << " blocks instead of "
+		          << tsteps.size() << "!\n";
+		++n_errors;
+	}
+	// The caller's block and the ring are all that is ever used.
+	if( buffers.size() > static_cast<std::size_t>( depth + 1 ) ){
+		std::cerr << "Used " << buffers.size()
+		          << " different buffers for " << n << " blocks!\n";
+		++n_errors;
+	}
+
+	pf.rewind();
+	if( pf.next_block( b ) || b.tstep != tsteps[0] ){
+		std::cerr << "Rewind failed!\n";
+		++n_errors;
+	}
+	if( pf.skip_blocks( 3 ) || pf.next_block( b ) || b.tstep != tsteps[4] ){
+		std::cerr << "skip_blocks failed!\n";
+		++n_errors;
+	}
+	if( pf.current_block() != 5 ){
+		std::cerr << "current_block is " << pf.current_block()
+		          << " instead of 5!\n";
+		++n_errors;
+	}
+
+	// A failed seek keeps the blocks read ahead. Wait a bit so that
+	// there are some.
+	pf.rewind();
+	pf.next_block( b );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+	if( pf.seek_block( tsteps.size() + 3 ) == 0 ||
+	    pf.seek_timestep( tsteps.back() + 1 ) == 0 ){
+		std::cerr << "Seeking past the end did not fail!\n";
+		++n_errors;
+	}
+	if( pf.next_block( b ) || b.tstep != tsteps[1] ){
+		std::cerr << "Failed seek lost blocks, got time step " << b.tstep
+		          << " instead of " << tsteps[1] << "!\n";
+		++n_errors;
+	}
+
+	if( pf.skip_blocks( tsteps.size() ) <= 0 ){
+		std::cerr << "Skipping past the end did not fail!\n";
+		++n_errors;
+	}
+
+	// The seeks saved an index next to the dump.
+	std::remove( dump_index::sidecar_name( fname ).c_str() );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
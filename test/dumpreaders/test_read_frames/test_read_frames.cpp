@@ -0,0 +1,137 @@
+#include "dump_reader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+// Copies a dump with the atom lines of every other frame reversed,
+// so that the atoms are not in the same order in every frame.
+void write_shuffled( const std::string &fname, const std::string &out_name )
+{
+	std::ifstream in( fname );
+	std::ofstream out( out_name );
+	std::string line;
+	int frame = -1;
+	while( std::getline( in, line ) ){
+		out << line << "\n";
+		if( line.compare( 0, 14, "ITEM: TIMESTEP" ) == 0 ) ++frame;
+		if( line.compare( 0, 11, "ITEM: ATOMS" ) != 0 ) continue;
+
+		// The number of atoms is not needed, read up to the next frame.
+		std::vector<std::string> atoms;
+		while( in.peek() != 'I' && std::getline( in, line ) ){
+			atoms.push_back( line );
+		}
+		if( frame % 2 ) std::reverse( atoms.begin(), atoms.end() );
+		for( const std::string &a : atoms ) out << a << "\n";
+	}
+}
+
+
+int check_read_frames( const std::string &name, int prefetch )
+{
+	// The expected positions of every atom id in every block.
+	std::vector<std::map<py_int, std::vector<py_float> > > frames;
+	std::vector<py_int> tsteps;
+	std::vector<py_float> xlo;
+	dump_reader d( name, dump_reader::LAMMPS, dump_reader::PLAIN );
+	block_data b;
+	while( !d.next_block( b ) ){
+		frames.emplace_back();
+		for( py_int i = 0; i < b.N; ++i ){
+			frames.back()[b.ids[i]] = { b.x[i][0], b.x[i][1], b.x[i][2] };
+		}
+		tsteps.push_back( b.tstep );
+		xlo.push_back( b.xlo[0] );
+	}
+	const py_int N = frames[0].size();
+	const py_int F = frames.size();
+
+	int n_errors = 0;
+	dump_reader_handle *dh = get_dump_reader_handle( name.c_str(),
+	                                                 dump_reader::LAMMPS,
+	                                                 dump_reader::PLAIN );
+	dump_reader_set_prefetch( dh, prefetch );
+
+	// All atoms, sorted by id. Asking for more frames than there are
+	// reads all of them.
+	std::vector<py_float> x( 3*N*(F+1) ), boxes( 6*(F+1) );
+	std::vector<py_int> t( F+1 );
+	py_int n = dump_reader_read_frames( dh, F + 1, 1, nullptr, N, x.data(),
+	                                    t.data(), boxes.data() );
+	if( n != F ){
+		std::cerr << "Read " << n << " instead of " << F << " frames!\n";
+		++n_errors;
+	}
+	for( py_int f = 0; f < std::min( n, F ); ++f ){
+		py_int s = 0;
+		for( const auto &atom : frames[f] ){
+			for( int d = 0; d < 3; ++d ){
+				if( x[3*(N*f + s) + d] != atom.second[d] ) ++n_errors;
+			}
+			++s;
+		}
+		if( t[f] != tsteps[f] || boxes[6*f] != xlo[f] ) ++n_errors;
+	}
+
+	// A few atoms of every other frame.
+	release_dump_reader_handle( dh );
+	dh = get_dump_reader_handle( name.c_str(), dump_reader::LAMMPS,
+	                             dump_reader::PLAIN );
+	dump_reader_set_prefetch( dh, prefetch );
+	std::vector<py_int> ids = { 17, 3, 1200, 4000 };
+	py_int n_ids = ids.size();
+	n = dump_reader_read_frames( dh, 2, 2, ids.data(), n_ids, x.data(),
+	                             t.data(), nullptr );
+	if( n != 2 ){
+		std::cerr << "Read " << n << " strided frames instead of 2!\n";
+		++n_errors;
+	}
+	for( py_int f = 0; f < n; ++f ){
+		for( py_int s = 0; s < n_ids; ++s ){
+			for( int d = 0; d < 3; ++d ){
+				if( x[3*(n_ids*f + s) + d] != frames[2*f][ids[s]][d] ){
+					++n_errors;
+				}
+			}
+		}
+		if( t[f] != tsteps[2*f] ) ++n_errors;
+	}
+
+	// An id that is not there fails.
+	ids[0] = 4001;
+	if( dump_reader_read_frames( dh, 1, 1, ids.data(), n_ids, x.data(),
+	                             nullptr, nullptr ) >= 0 ){
+		std::cerr << "Reading a missing atom worked!\n";
+		++n_errors;
+	}
+	release_dump_reader_handle( dh );
+
+	std::cerr << name << ", prefetch " << prefetch << ": " << n_errors
+	          << " errors.\n";
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	std::string shuffled = "test_read_frames_out.dump";
+	write_shuffled( fname, shuffled );
+
+	int n_errors = 0;
+	for( int prefetch : { 0, 2 } ){
+		n_errors += check_read_frames( fname, prefetch );
+		n_errors += check_read_frames( shuffled, prefetch );
+	}
+	std::remove( shuffled.c_str() );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
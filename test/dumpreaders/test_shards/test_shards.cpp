@@ -0,0 +1,163 @@
+#include "dump_interpreter_sharded.h"
+#include "dump_reader.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+// Writes every frame of a dump into its own file, named with the
+// pattern and time step, and returns the names.
+std::vector<std::string> split_dump( const std::string &fname,
+                                     const std::string &pattern,
+                                     const std::vector<py_int> &tsteps )
+{
+	std::ifstream in( fname, std::ios::binary );
+	std::string text( ( std::istreambuf_iterator<char>( in ) ),
+	                  std::istreambuf_iterator<char>() );
+	std::vector<std::string> names;
+	std::size_t p = text.find( "ITEM: TIMESTEP" );
+	for( py_int t : tsteps ){
+		std::size_t e = text.find( "ITEM: TIMESTEP", p + 1 );
+		if( e == std::string::npos ) e = text.size();
+		char name[256];
+		std::snprintf( name, sizeof(name), pattern.c_str(),
+		               static_cast<int>( t ) );
+		std::ofstream( name, std::ios::binary ) << text.substr( p, e - p );
+		names.push_back( name );
+		p = e;
+	}
+	return names;
+}
+
+
+int check_shards( const std::string &pattern, int n_workers,
+                  int queue_depth, const std::vector<py_int> &tsteps,
+                  const std::vector<py_float> &x_last )
+{
+	int n_errors = 0;
+	dump_reader d( pattern, dump_reader::LAMMPS, dump_reader::PLAIN,
+	               n_workers, queue_depth );
+	block_data b;
+	std::size_t n = 0;
+	while( !d.next_block( b ) ){
+		if( n >= tsteps.size() || b.tstep != tsteps[n] ||
+		    b.x_[3*b.N - 1] != x_last[n] ){
+			std::cerr << "Block " << n << " of " << pattern
+			          << " is wrong!\n";
+			++n_errors;
+		}
+		++n;
+	}
+	if( n != tsteps.size() || !d.eof() ){
+		std::cerr << "Read " << n << " blocks of " << pattern << "!\n";
+		++n_errors;
+	}
+
+	d.rewind();
+	if( d.skip_blocks( 2 ) || d.next_block( b ) || b.tstep != tsteps[2] ){
+		std::cerr << "Skipping blocks of " << pattern << " failed!\n";
+		++n_errors;
+	}
+
+	std::cerr << pattern << ", " << n_workers << " workers, depth "
+	          << queue_depth << ": " << n << " blocks, " << n_errors
+	          << " errors.\n";
+	return n_errors;
+}
+
+
+// Selecting columns mid-stream goes on at the next frame, also
+// inside a file with more than one frame.
+int check_select_midway( const std::string &fname,
+                         const std::vector<py_int> &tsteps )
+{
+	std::ifstream in( fname, std::ios::binary );
+	std::string text( ( std::istreambuf_iterator<char>( in ) ),
+	                  std::istreambuf_iterator<char>() );
+	std::vector<std::string> names;
+	std::size_t p = text.find( "ITEM: TIMESTEP" );
+	for( std::size_t i = 0; i < tsteps.size(); i += 2 ){
+		// Two frames per file.
+		std::size_t e = text.find( "ITEM: TIMESTEP", p + 1 );
+		if( e != std::string::npos ) e = text.find( "ITEM: TIMESTEP", e + 1 );
+		if( e == std::string::npos ) e = text.size();
+		names.push_back( "test_shards_c." + std::to_string( i ) + ".dump" );
+		std::ofstream( names.back(), std::ios::binary )
+			<< text.substr( p, e - p );
+		p = e;
+	}
+
+	int n_errors = 0;
+	dump_interpreter_sharded d( "test_shards_c.*.dump", names,
+	                            dump_reader::LAMMPS, dump_reader::PLAIN,
+	                            2, 0 );
+	block_data b;
+	for( int i = 0; i < 3; ++i ) n_errors += d.next_block( b ) != 0;
+	d.select_columns( { "id", "x" } );
+	if( d.next_block( b ) || b.tstep != tsteps[3] || b.types[0] != 0 ){
+		std::cerr << "Selecting columns midway restarted at t = "
+		          << b.tstep << "!\n";
+		++n_errors;
+	}
+
+	for( const std::string &name : names ) std::remove( name.c_str() );
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	std::vector<py_int> tsteps;
+	std::vector<py_float> x_last;
+	dump_reader d_plain( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	block_data b;
+	while( !d_plain.next_block( b ) ){
+		tsteps.push_back( b.tstep );
+		x_last.push_back( b.x_[3*b.N - 1] );
+	}
+
+	// Time steps 0, 50, ..., 250 sort wrong as text.
+	std::vector<std::string> names_a =
+		split_dump( fname, "test_shards_a.%d.dump", tsteps );
+	std::vector<std::string> names_b =
+		split_dump( fname, "test_shards_b.%04d.dump", tsteps );
+
+	int n_errors = 0;
+	for( int n_workers : { 0, 1, 3 } ){
+		n_errors += check_shards( "test_shards_a.*.dump", n_workers, 0,
+		                          tsteps, x_last );
+	}
+	n_errors += check_shards( "test_shards_a.*.dump", 2, 1, tsteps, x_last );
+	n_errors += check_shards( "test_shards_a.%d.dump", 2, 0, tsteps, x_last );
+	n_errors += check_shards( "test_shards_b.%04d.dump", 2, 0,
+	                          tsteps, x_last );
+
+	// The printf pattern only matches names it would print,
+	// so none of the zero-padded ones.
+	if( dump_reader( "test_shards_b.%d.dump", dump_reader::LAMMPS,
+	                 dump_reader::PLAIN, 0, 0 ).block_count() != 0 ){
+		std::cerr << "test_shards_b.%d.dump matched padded names!\n";
+		++n_errors;
+	}
+
+	// Selected columns are passed on to every file.
+	dump_reader d( "test_shards_a.*.dump", dump_reader::LAMMPS,
+	               dump_reader::PLAIN, 2, 0, { "id", "x" } );
+	if( d.next_block( b ) || b.types[0] != 0 || b.ids[0] == 0 ){
+		std::cerr << "Selecting columns of shards failed!\n";
+		++n_errors;
+	}
+
+	n_errors += check_select_midway( fname, tsteps );
+
+	for( const std::string &name : names_a ) std::remove( name.c_str() );
+	for( const std::string &name : names_b ) std::remove( name.c_str() );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
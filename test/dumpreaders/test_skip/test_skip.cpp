@@ -0,0 +1,123 @@
+#include "bgzf.h"
+#include "dump_reader.h"
+#include "my_timer.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#ifdef HAVE_LIB_ZSTD
+#include <zstd.h>
+#endif
+
+// Skips blocks without parsing them and checks that the next block
+// read is the same as when reading every block of the plain dump.
+int check_skip( const std::string &fname, const std::string &name,
+                int fformat, int n_workers )
+{
+	std::vector<py_int> tsteps;
+	std::vector<py_float> x0;
+	dump_reader d_plain( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	block_data b;
+	while( !d_plain.next_block( b ) ){
+		tsteps.push_back( b.tstep );
+		x0.push_back( b.x_[0] );
+	}
+	std::size_t n_blocks = tsteps.size();
+
+	int n_errors = 0;
+	for( std::size_t n = 0; n < n_blocks; ++n ){
+		dump_reader d( name, dump_reader::LAMMPS, fformat, n_workers, 0 );
+		if( d.skip_blocks( n ) || d.current_block() != n ||
+		    d.next_block( b ) ||
+		    b.tstep != tsteps[n] || b.x_[0] != x0[n] ){
+			std::cerr << "Skipping " << n << " blocks of " << name
+			          << " failed!\n";
+			++n_errors;
+		}
+	}
+
+	// Skipping past the end fails and leaves the reader at the end.
+	dump_reader d( name, dump_reader::LAMMPS, fformat, n_workers, 0 );
+	if( d.skip_blocks( n_blocks ) || d.skip_blocks( 1 ) <= 0 ||
+	    !d.next_block( b ) ){
+		std::cerr << "Skipping past the end of " << name << " worked!\n";
+		++n_errors;
+	}
+
+	std::cerr << dump_reader::fformat_to_str( fformat ) << ", "
+	          << n_workers << " workers: skipped up to " << n_blocks
+	          << " blocks, " << n_errors << " errors.\n";
+	return n_errors;
+}
+
+
+#ifdef HAVE_LIB_ZSTD
+bool zstd_compress( const std::string &fname, const std::string &out_name )
+{
+	std::ifstream in( fname, std::ios::binary );
+	std::vector<char> data( ( std::istreambuf_iterator<char>( in ) ),
+	                        std::istreambuf_iterator<char>() );
+	std::vector<char> out( ZSTD_compressBound( data.size() ) );
+	std::size_t n = ZSTD_compress( out.data(), out.size(),
+	                               data.data(), data.size(), 3 );
+	if( ZSTD_isError( n ) ) return false;
+	std::ofstream o( out_name, std::ios::binary );
+	o.write( out.data(), n );
+	return static_cast<bool>( o );
+}
+#endif // HAVE_LIB_ZSTD
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	int n_errors = 0;
+	n_errors += check_skip( fname, fname, dump_reader::PLAIN, 0 );
+	n_errors += check_skip( fname, fname, dump_reader::MMAP, 0 );
+	n_errors += check_skip( fname, fname, dump_reader::PLAIN, 2 );
+
+#ifdef HAVE_ZLIB
+	std::string bgzf_name = "melt_skip.dump.gz";
+	if( bgzf_recompress( fname.c_str(), bgzf_name.c_str(), 6 ) ){
+		std::cerr << "Compressing the dump with BGZF failed!\n";
+		++n_errors;
+	}else{
+		n_errors += check_skip( fname, bgzf_name, dump_reader::BGZF, 0 );
+		n_errors += check_skip( fname, bgzf_name, dump_reader::GZIP, 0 );
+	}
+	std::remove( bgzf_name.c_str() );
+	std::remove( bgzf_index::sidecar_name( bgzf_name ).c_str() );
+#endif // HAVE_ZLIB
+
+#ifdef HAVE_LIB_ZSTD
+	std::string zstd_name = "melt_skip.dump.zst";
+	if( !zstd_compress( fname, zstd_name ) ){
+		std::cerr << "Compressing the dump with zstd failed!\n";
+		++n_errors;
+	}else{
+		n_errors += check_skip( fname, zstd_name, dump_reader::ZSTD, 0 );
+	}
+	std::remove( zstd_name.c_str() );
+#endif // HAVE_LIB_ZSTD
+
+	// Skipping through the whole dump should be much faster than
+	// reading it.
+	my_timer timer( std::cerr );
+	block_data b;
+	timer.tic();
+	dump_reader d_read( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	while( !d_read.next_block( b ) );
+	timer.toc( "Reading all blocks" );
+	timer.tic();
+	dump_reader d_skip( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	while( !d_skip.skip_block() );
+	timer.toc( "Skipping all blocks" );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
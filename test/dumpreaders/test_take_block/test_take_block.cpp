@@ -0,0 +1,60 @@
+#include "dump_reader.h"
+
+#include <iostream>
+#include <vector>
+
+// Takes every block from a handle and checks that it matches what a
+// plain dump_reader reads, also after the handle has moved on.
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	std::vector<block_data> expected;
+	dump_reader d( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	block_data b;
+	while( !d.next_block( b ) ) expected.push_back( b );
+
+	int n_errors = 0;
+	for( int prefetch : { 0, 2 } ){
+		dump_reader_handle *dh = get_dump_reader_handle(
+			fname.c_str(), dump_reader::LAMMPS, dump_reader::PLAIN );
+		dump_reader_set_prefetch( dh, prefetch );
+
+		std::vector<block_data*> taken;
+		while( !dump_reader_next_block( dh ) ){
+			taken.push_back( dump_reader_take_block( dh ) );
+		}
+		// The blocks outlive the handle.
+		release_dump_reader_handle( dh );
+
+		if( taken.size() != expected.size() ){
+			std::cerr << "Took " << taken.size() << " blocks!\n";
+			++n_errors;
+		}
+		for( std::size_t f = 0; f < taken.size(); ++f ){
+			py_float *x;
+			py_int *ids, *types, *mol;
+			dump_reader_block_arrays( taken[f], &x, &ids, &types, &mol );
+			const block_data &e = expected[f];
+			if( taken[f]->N != e.N || taken[f]->tstep != e.tstep || mol ){
+				std::cerr << "Block " << f << " is wrong!\n";
+				++n_errors;
+				continue;
+			}
+			for( py_int i = 0; i < e.N; ++i ){
+				if( ids[i] != e.ids[i] || types[i] != e.types[i] ||
+				    x[3*i] != e.x[i][0] || x[3*i+1] != e.x[i][1] ||
+				    x[3*i+2] != e.x[i][2] ){
+					++n_errors;
+				}
+			}
+			dump_reader_release_block( taken[f] );
+		}
+		std::cerr << "Prefetch " << prefetch << ": took " << taken.size()
+		          << " blocks, " << n_errors << " errors.\n";
+	}
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
@@ -0,0 +1,183 @@
+#include "dump_reader.h"
+#include "text_readers.h"
+#include "zstd_seekable.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#ifdef HAVE_LIB_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef HAVE_LIB_ZSTD
+#include <zstd.h>
+#endif
+
+// Compresses a dump with zstd (seekable and not) and lz4 and checks that
+// dump_reader reads the same blocks from them as from the plain dump.
+int compare( const std::string &fname, const std::string &cname )
+{
+	dump_reader d_plain( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	dump_reader d_c( cname );
+	block_data b_plain, b_c;
+
+	int n_blocks = 0;
+	int n_errors = 0;
+	while( !d_plain.next_block( b_plain ) ){
+		if( d_c.next_block( b_c ) ){
+			std::cerr << cname << " ran out of blocks early!\n";
+			return 1;
+		}
+		++n_blocks;
+		if( b_plain.tstep != b_c.tstep || b_plain.N != b_c.N ){
+			std::cerr << "Meta mismatch at block " << n_blocks << "!\n";
+			return 1;
+		}
+		for( py_int i = 0; i < b_plain.N; ++i ){
+			if( b_plain.ids[i] != b_c.ids[i] ||
+			    b_plain.x_[3*i] != b_c.x_[3*i] ) ++n_errors;
+		}
+	}
+	if( !d_c.next_block( b_c ) ){
+		std::cerr << cname << " has more blocks than the plain dump!\n";
+		return 1;
+	}
+
+	// Rewinding works for all of them.
+	d_c.rewind();
+	d_plain.rewind();
+	if( d_c.next_block( b_c ) || d_plain.next_block( b_plain ) ||
+	    b_c.tstep != b_plain.tstep ){
+		std::cerr << "Rewinding " << cname << " failed!\n";
+		++n_errors;
+	}
+
+	std::cerr << cname << ": compared " << n_blocks << " blocks, "
+	          << n_errors << " atoms differed.\n";
+	return n_errors;
+}
+
+
+// Skips lines in a file of two lines, the first of which crosses
+// buffers of the reader.
+template <typename reader_type>
+int check_long_line( const std::string &cname )
+{
+	int n_errors = 0;
+	reader_type r( cname );
+	if( !r.skip_lines( 2 ) ){
+		std::cerr << cname << ": could not skip two lines!\n";
+		++n_errors;
+	}
+	reader_type r3( cname );
+	if( r3.skip_lines( 3 ) ){
+		std::cerr << cname << ": skipped three lines of two!\n";
+		++n_errors;
+	}
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	std::ifstream in( fname, std::ios::binary );
+	std::vector<char> text( ( std::istreambuf_iterator<char>( in ) ),
+	                        std::istreambuf_iterator<char>() );
+	// Two lines, the first longer than the buffers of the readers.
+	std::string long_line( 300000, 'a' );
+	long_line += "\nb\n";
+	int n_errors = 0;
+
+#ifdef HAVE_LIB_ZSTD
+	// Plain zstd, one frame:
+	std::vector<char> c( ZSTD_compressBound( text.size() ) );
+	std::size_t n = ZSTD_compress( c.data(), c.size(), text.data(),
+	                               text.size(), 3 );
+	std::ofstream( "melt_test.dump.zst", std::ios::binary ).write( c.data(), n );
+
+	// Seekable zstd with small frames, so frames are split:
+	if( zstd_recompress_seekable( fname.c_str(),
+	                              "melt_seekable.dump.zst", 3, 100000 ) ){
+		std::cerr << "Writing seekable zstd failed!\n";
+		return 1;
+	}
+
+	n_errors += compare( fname, "melt_test.dump.zst" );
+	n_errors += compare( fname, "melt_seekable.dump.zst" );
+
+	// Only the seekable one supports random access:
+	dump_reader d_seek( "melt_seekable.dump.zst" );
+	dump_reader d_plain( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	block_data b, b_plain;
+	d_plain.skip_blocks( 4 );
+	d_plain.next_block( b_plain );
+	if( d_seek.seek_block( 4 ) || d_seek.next_block( b ) ||
+	    b.tstep != b_plain.tstep || b.x_[0] != b_plain.x_[0] ){
+		std::cerr << "Seeking in seekable zstd failed!\n";
+		++n_errors;
+	}
+	dump_reader d_noseek( "melt_test.dump.zst" );
+	if( d_noseek.seek_block( 4 ) >= 0 ){
+		std::cerr << "Seeking in plain zstd did not fail!\n";
+		++n_errors;
+	}
+
+	c.resize( ZSTD_compressBound( long_line.size() ) );
+	n = ZSTD_compress( c.data(), c.size(), long_line.data(),
+	                   long_line.size(), 3 );
+	std::ofstream( "long_line.zst", std::ios::binary ).write( c.data(), n );
+	n_errors += check_long_line<text_reader_zstd>( "long_line.zst" );
+#else
+	std::cerr << "Built without zstd, not testing it.\n";
+#endif // HAVE_LIB_ZSTD
+
+#ifdef HAVE_LIB_LZ4
+	// lz4 frame:
+	std::vector<char> c4( LZ4F_compressFrameBound( text.size(), nullptr ) );
+	std::size_t n4 = LZ4F_compressFrame( c4.data(), c4.size(), text.data(),
+	                                     text.size(), nullptr );
+	std::ofstream( "melt_test.dump.lz4", std::ios::binary ).write( c4.data(), n4 );
+
+	n_errors += compare( fname, "melt_test.dump.lz4" );
+
+	// Without an index, last_block reads through the dump, and reports
+	// a malformed last frame instead of returning it half read.
+	std::string bad( text.begin(), text.end() );
+	std::size_t atoms = bad.rfind( "ITEM: ATOMS" );
+	bad.resize( bad.find( '\n', atoms ) + 1 );
+	bad += "1 1 abc\n";
+	c4.resize( LZ4F_compressFrameBound( bad.size(), nullptr ) );
+	n4 = LZ4F_compressFrame( c4.data(), c4.size(), bad.data(), bad.size(),
+	                         nullptr );
+	std::ofstream( "melt_bad.dump.lz4", std::ios::binary ).write( c4.data(), n4 );
+	dump_reader d_bad( "melt_bad.dump.lz4" );
+	block_data b_last;
+	if( d_bad.last_block( b_last ) >= 0 ){
+		std::cerr << "last_block did not report the malformed frame!\n";
+		++n_errors;
+	}
+
+	c4.resize( LZ4F_compressFrameBound( long_line.size(), nullptr ) );
+	n4 = LZ4F_compressFrame( c4.data(), c4.size(), long_line.data(),
+	                         long_line.size(), nullptr );
+	std::ofstream( "long_line.lz4", std::ios::binary ).write( c4.data(), n4 );
+	n_errors += check_long_line<text_reader_lz4>( "long_line.lz4" );
+#else
+	std::cerr << "Built without lz4, not testing it.\n";
+#endif // HAVE_LIB_LZ4
+
+	const char *files[] = { "melt_test.dump.zst", "melt_test.dump.lz4",
+	                        "melt_bad.dump.lz4", "long_line.zst",
+	                        "long_line.lz4",
+	                        "melt_seekable.dump.zst",
+	                        "melt_seekable.dump.zst.idx" };
+	for( const char *f : files ) std::remove( f );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
@@ -0,0 +1,132 @@
+#include "block_data.h"
+
+#include <cstdint>
+#include <iostream>
+#include <utility>
+
+
+bool aligned( const void *p )
+{
+	return reinterpret_cast<std::uintptr_t>( p ) % block_data::ALIGNMENT == 0;
+}
+
+
+void fill( block_data &b, py_int N )
+{
+	b.resize( N );
+	b.atom_style = atom_styles::MOLECULAR;
+	for( py_int i = 0; i < N; ++i ){
+		b.x[i][0] = i;
+		b.x[i][1] = 2*i;
+		b.x[i][2] = 3*i;
+		b.ids[i]   = i + 1;
+		b.types[i] = i % 3 + 1;
+		b.mol[i]   = i / 10;
+	}
+	b.other_cols.resize( 2 );
+	b.other_cols[0].header = "vx";
+	b.other_cols[1].header = "q";
+	for( dump_col &c : b.other_cols ){
+		c.resize( N );
+		for( py_int i = 0; i < N; ++i ) c.data[i] = 0.5*i;
+	}
+}
+
+
+int check( const block_data &b, py_int N, const char *what )
+{
+	int n_errors = 0;
+	if( b.N != N ){
+		std::cerr << what << ": N = " << b.N << " instead of " << N << "!\n";
+		return 1;
+	}
+	if( N && ( !aligned( b.x_ ) || !aligned( b.ids ) ||
+	           !aligned( b.types ) || !aligned( b.mol ) ) ){
+		std::cerr << what << ": Arrays are not aligned!\n";
+		++n_errors;
+	}
+	for( py_int i = 0; i < N; ++i ){
+		if( b.x[i] != b.x_ + 3*i || b.x[i][0] != i || b.x[i][2] != 3*i ||
+		    b.ids[i] != i + 1 || b.types[i] != i % 3 + 1 ||
+		    b.mol[i] != i / 10 ){
+			std::cerr << what << ": Atom " << i << " differs!\n";
+			++n_errors;
+			break;
+		}
+	}
+	if( b.other_cols.size() != 2 || b.other_cols[1].header != "q" ||
+	    b.other_cols[1].data.size() != static_cast<std::size_t>( N ) ){
+		std::cerr << what << ": Other columns differ!\n";
+		++n_errors;
+	}
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	int n_errors = 0;
+	const py_int N = 1000;
+
+	block_data a;
+	fill( a, N );
+	n_errors += check( a, N, "fill" );
+
+	// The copy used to run off the end of other_cols.
+	block_data b( a );
+	n_errors += check( b, N, "copy" );
+	if( b.x_ == a.x_ ){
+		std::cerr << "Copy shares the arrays!\n";
+		++n_errors;
+	}
+
+	const py_float *arena = b.x_;
+	block_data c( std::move( b ) );
+	n_errors += check( c, N, "move" );
+	if( c.x_ != arena || b.x_ || b.N ){
+		std::cerr << "Move constructor copied the arrays!\n";
+		++n_errors;
+	}
+
+	block_data d;
+	d = std::move( c );
+	n_errors += check( d, N, "move assignment" );
+	if( d.x_ != arena ){
+		std::cerr << "Move assignment copied the arrays!\n";
+		++n_errors;
+	}
+
+	// Shrinking and growing back within the capacity keeps the arena,
+	// growing past it keeps the contents.
+	d.resize( 10 );
+	d.resize( N );
+	if( d.x_ != arena ){
+		std::cerr << "Resize within capacity reallocated!\n";
+		++n_errors;
+	}
+	d.resize( 2*N );
+	d.resize( N );
+	n_errors += check( d, N, "grow" );
+	if( d.capacity() < 2*N ){
+		std::cerr << "Capacity is " << d.capacity() << "!\n";
+		++n_errors;
+	}
+
+	// Released blocks come back from the pool with their arrays.
+	block_pool pool( 1 );
+	block_data *p = pool.acquire();
+	p->resize( N );
+	const py_float *pooled = p->x_;
+	pool.release( p );
+	block_data *q = pool.acquire();
+	if( q != p || q->x_ != pooled ){
+		std::cerr << "Pool did not recycle the block!\n";
+		++n_errors;
+	}
+	block_data *r = pool.acquire();
+	pool.release( q );
+	pool.release( r );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
@@ -0,0 +1,187 @@
+#include "dump_reader.h"
+#include "domain.h"
+#include "cell_list.h"
+#include "neighborize.h"
+#include "neighbor_list.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+
+
+// Compares a half and a full list made by a cell list with brute force,
+// including distances and displacements.
+int compare_brute_force( const arr3f &x, py_int N, py_float rc,
+                         py_int periodic, const py_float *xlo,
+                         const py_float *xhi, py_int dims, const char *what )
+{
+	int n_errors = 0;
+	const int all = neighbor_list::DISTANCES | neighbor_list::DISPLACEMENTS;
+	cell_list cells;
+	cells.build( x, N, rc, periodic, xlo, xhi, dims );
+	neighbor_list full, half;
+	cells.make_pairs( full, false, 0, 0, nullptr, all );
+	cells.make_pairs( half, true );
+
+	for( py_int i = 0; i < N; ++i ){
+		std::set<py_int> expect, expect_half;
+		for( py_int j = 0; j < N; ++j ){
+			py_float r[3];
+			distance_wrap( r, x[i], x[j], xlo, xhi, periodic );
+			if( dims == 2 ) r[2] = 0.0;
+			if( j == i || r[0]*r[0] + r[1]*r[1] + r[2]*r[2] > rc*rc ){
+				continue;
+			}
+			expect.insert( j );
+			if( j > i ) expect_half.insert( j );
+
+			const py_int *row = full[i].begin();
+			py_int k = std::lower_bound( row, full[i].end(), j ) - row;
+			if( k == full.degree( i ) ) continue;
+			const py_float *dx = full.displacements( i ) + 3*k;
+			py_float rr = std::sqrt( r[0]*r[0] + r[1]*r[1] + r[2]*r[2] );
+			if( std::fabs( full.distances( i )[k] - rr ) > 1e-12 ||
+			    std::fabs( dx[0] - r[0] ) > 1e-12 ||
+			    std::fabs( dx[1] - r[1] ) > 1e-12 ||
+			    std::fabs( dx[2] - r[2] ) > 1e-12 ){
+				std::cerr << what << ": distance from " << i << " to "
+				          << j << " is wrong!\n";
+				++n_errors;
+			}
+		}
+		std::set<py_int> got( full[i].begin(), full[i].end() );
+		std::set<py_int> got_half( half[i].begin(), half[i].end() );
+		if( got != expect || got_half != expect_half ){
+			std::cerr << what << ": neighbors of atom " << i << " differ!\n";
+			++n_errors;
+		}
+	}
+	if( full.n_entries() != 2*half.n_entries() ){
+		std::cerr << what << ": full list is not twice the half list!\n";
+		++n_errors;
+	}
+	return n_errors;
+}
+
+
+// Random atoms in small boxes, so that some directions have fewer than
+// three cells and cells are adjacent to each other on both sides.
+int test_small_boxes()
+{
+	int n_errors = 0;
+	std::mt19937 gen( 1234 );
+	std::uniform_real_distribution<py_float> u( 0.0, 1.0 );
+
+	const py_float xlo[3] = { 0.0, 0.0, 0.0 };
+	const py_float boxes[][3] = { { 2.5, 2.5, 2.5 }, { 1.5, 4.0, 7.0 },
+	                              { 3.1, 1.2, 5.5 } };
+	for( const py_float *xhi : boxes ){
+		const py_int N = 200;
+		std::vector<py_float> xs( 3*N );
+		for( py_int i = 0; i < N; ++i ){
+			for( int d = 0; d < 3; ++d ) xs[3*i+d] = xhi[d]*u( gen );
+		}
+		arr3f x( xs.data(), N );
+		n_errors += compare_brute_force( x, N, 1.0, PERIODIC_FULL, xlo, xhi,
+		                                 3, "small periodic box" );
+		n_errors += compare_brute_force( x, N, 1.0, PERIODIC_X | PERIODIC_Z,
+		                                 xlo, xhi, 3, "small mixed box" );
+		n_errors += compare_brute_force( x, N, 0.6, PERIODIC_X | PERIODIC_Y,
+		                                 xlo, xhi, 2, "small 2d box" );
+		n_errors += compare_brute_force( x, N, 1.0, PERIODIC_NONE,
+		                                 nullptr, nullptr, 3, "no box" );
+	}
+	return n_errors;
+}
+
+
+// Lists built with several threads should be the same as with one.
+int test_threads( const block_data &b, py_float rc )
+{
+	int n_errors = 0;
+	const int all = neighbor_list::DISTANCES | neighbor_list::DISPLACEMENTS;
+	arr3f x( b.x_, b.N );
+	arr1i ids( b.ids, b.N ), types( b.types, b.N );
+
+	neighbor_list lists[2][3];
+	const py_int threads[2] = { 1, 4 };
+	for( int k = 0; k < 2; ++k ){
+		set_n_threads( threads[k] );
+		cell_list cells;
+		cells.build( x, b.N, rc, b.periodic, b.xlo, b.xhi, 3 );
+		cells.make_pairs( lists[k][0], false, 0, 0, nullptr, all );
+		neighborize_impl( x, b.N, ids, types, rc, b.periodic, b.xlo, b.xhi,
+		                  3, DIST_NSQ, lists[k][1], 0, 0 );
+		neighborize_impl( x, b.N, ids, types, rc, b.periodic, b.xlo, b.xhi,
+		                  3, DIST_BIN, lists[k][2], 1, 2 );
+	}
+	set_n_threads( 0 );
+
+	for( int m = 0; m < 3; ++m ){
+		const neighbor_list &a = lists[0][m], &c = lists[1][m];
+		bool same = a.n_entries() == c.n_entries() &&
+			std::equal( a.offsets(), a.offsets() + b.N + 1, c.offsets() ) &&
+			std::equal( a.indices(), a.indices() + a.n_entries(), c.indices() );
+		if( same && a.has_distances() ){
+			same = std::equal( a.distances( 0 ),
+			                   a.distances( 0 ) + a.n_entries(),
+			                   c.distances( 0 ) ) &&
+				std::equal( a.displacements( 0 ),
+				            a.displacements( 0 ) + 3*a.n_entries(),
+				            c.displacements( 0 ) );
+		}
+		if( !same ){
+			std::cerr << "List " << m << " depends on the number of threads!\n";
+			++n_errors;
+		}
+	}
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../../dumpreaders/test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	int n_errors = test_small_boxes();
+
+	dump_reader d( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	block_data b;
+	d.next_block( b );
+
+	const py_float rc = 1.3;
+	arr3f x( b.x_, b.N );
+	arr1i ids( b.ids, b.N ), types( b.types, b.N );
+	n_errors += compare_brute_force( x, b.N, rc, b.periodic, b.xlo, b.xhi,
+	                                 3, "melt" );
+
+	// The binned and the N^2 method should give the same lists.
+	neighbor_list nl_bin, nl_nsq;
+	neighborize_impl( x, b.N, ids, types, rc, b.periodic, b.xlo, b.xhi,
+	                  3, DIST_BIN, nl_bin, 0, 0 );
+	neighborize_impl( x, b.N, ids, types, rc, b.periodic, b.xlo, b.xhi,
+	                  3, DIST_NSQ, nl_nsq, 0, 0 );
+	if( nl_bin.n_entries() != nl_nsq.n_entries() ){
+		std::cerr << "Binned list has " << nl_bin.n_entries()
+		          << " entries instead of " << nl_nsq.n_entries() << "!\n";
+		++n_errors;
+	}
+	for( py_int i = 0; i < b.N; ++i ){
+		std::vector<py_int> r_bin( nl_bin[i].begin(), nl_bin[i].end() );
+		std::vector<py_int> r_nsq( nl_nsq[i].begin(), nl_nsq[i].end() );
+		if( r_bin != r_nsq ){
+			std::cerr << "Binned neighbors of atom " << i << " differ!\n";
+			++n_errors;
+		}
+	}
+
+	n_errors += test_threads( b, rc );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
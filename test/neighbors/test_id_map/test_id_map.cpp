@@ -0,0 +1,120 @@
+#include "id_map.h"
+#include "my_timer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+
+// Checks an id_map against a std::map for all ids in ids and some
+// that are not.
+int compare( const id_map &im, const std::vector<py_int> &ids,
+             const char *what )
+{
+	std::map<py_int, py_int> ref;
+	for( std::size_t i = 0; i < ids.size(); ++i ) ref[ids[i]] = i;
+
+	int n_errors = 0;
+	std::vector<py_int> probe( ids );
+	probe.push_back( -7 );
+	probe.push_back( 123456789012 );
+	if( !ids.empty() ){
+		probe.push_back( *std::max_element( ids.begin(), ids.end() ) + 1 );
+	}
+
+	std::vector<py_int> idx( probe.size() );
+	im.map_ids( probe.data(), idx.data(), probe.size() );
+	for( std::size_t i = 0; i < probe.size(); ++i ){
+		auto it = ref.find( probe[i] );
+		py_int expect = it == ref.end() ? -1 : it->second;
+		if( im[probe[i]] != expect || idx[i] != expect ){
+			std::cerr << what << ": id " << probe[i] << " maps to "
+			          << im[probe[i]] << " and " << idx[i]
+			          << " instead of " << expect << "!\n";
+			++n_errors;
+			if( n_errors > 5 ) break;
+		}
+	}
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	int n_errors = 0;
+	const py_int N = 100000;
+	std::mt19937 rng( 42 );
+
+	std::vector<py_int> dense( N ), sparse( N );
+	for( py_int i = 0; i < N; ++i ){
+		dense[i]  = i + 1;
+		sparse[i] = 1000003 * i + 17;
+	}
+	std::shuffle( dense.begin(), dense.end(), rng );
+	std::shuffle( sparse.begin(), sparse.end(), rng );
+
+	id_map imd( dense.data(), N ), ims( sparse.data(), N );
+	if( imd.hashed() || !ims.hashed() ){
+		std::cerr << "Wrong storage chosen!\n";
+		++n_errors;
+	}
+	n_errors += compare( imd, dense,  "dense" );
+	n_errors += compare( ims, sparse, "sparse" );
+	n_errors += compare( id_map(), std::vector<py_int>(), "empty" );
+
+	// Move a few atoms around and replace some, like in the next
+	// frame of a dump, then patch the maps.
+	for( std::vector<py_int> *ids : { &dense, &sparse } ){
+		id_map im( ids->data(), N );
+		for( int k = 0; k < 50; ++k ){
+			std::swap( (*ids)[ rng() % N ], (*ids)[ rng() % N ] );
+		}
+		(*ids)[ rng() % N ] = ids == &dense ? N + 3 : 999999999999;
+
+		py_int changed = im.update( ids->data(), N );
+		if( changed == 0 || changed > 101 ){
+			std::cerr << "Update saw " << changed << " changes!\n";
+			++n_errors;
+		}
+		n_errors += compare( im, *ids, "update" );
+		if( im.update( ids->data(), N ) != 0 ){
+			std::cerr << "Update of the same ids changed something!\n";
+			++n_errors;
+		}
+	}
+
+	// Compare the speed of bulk look-ups with std::map.
+	std::map<py_int, py_int> ref;
+	for( py_int i = 0; i < N; ++i ) ref[dense[i]] = i;
+	std::vector<py_int> idx( N );
+	py_int sum_map = 0, sum_bulk = 0;
+
+	my_timer timer( std::cerr );
+	timer.tic();
+	for( int r = 0; r < 20; ++r ){
+		for( py_int i = 0; i < N; ++i ){
+			auto it = ref.find( sparse[i] % N + 1 );
+			sum_map += it == ref.end() ? -1 : it->second;
+		}
+	}
+	timer.toc( "std::map look-ups" );
+
+	id_map im( dense.data(), N );
+	std::vector<py_int> wanted( N );
+	for( py_int i = 0; i < N; ++i ) wanted[i] = sparse[i] % N + 1;
+	timer.tic();
+	for( int r = 0; r < 20; ++r ){
+		im.map_ids( wanted.data(), idx.data(), N );
+		for( py_int i = 0; i < N; ++i ) sum_bulk += idx[i];
+	}
+	timer.toc( "id_map::map_ids" );
+	if( sum_map != sum_bulk ){
+		std::cerr << "Bulk look-ups differ from std::map!\n";
+		++n_errors;
+	}
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
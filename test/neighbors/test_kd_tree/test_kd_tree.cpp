@@ -0,0 +1,198 @@
+#include "dump_reader.h"
+#include "domain.h"
+#include "cell_list.h"
+#include "kd_tree.h"
+#include "neighbor_list.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+
+// Squared minimum-image distance between x and y.
+py_float brute_dist2( const py_float *x, const py_float *y, py_int periodic,
+                      const py_float *xlo, const py_float *xhi, py_int dims )
+{
+	py_float r[3];
+	if( xlo && xhi ){
+		distance_wrap( r, x, y, xlo, xhi, periodic );
+	}else{
+		distance( r, x, y );
+	}
+	if( dims == 2 ) r[2] = 0.0;
+	return r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+}
+
+
+// Compares nearest neighbors and radius queries with brute force.
+int compare_brute_force( const arr3f &x, py_int N, const arr3f &q, py_int M,
+                         py_int periodic, const py_float *xlo,
+                         const py_float *xhi, py_int dims, bool self,
+                         const char *what )
+{
+	int n_errors = 0;
+	const py_int k = 7;
+	const py_float rc = 1.1;
+	kd_tree tree( x, N, periodic, xlo, xhi, dims );
+
+	std::vector<py_int> idx( M*k );
+	std::vector<py_float> r2( M*k );
+	tree.knn( q, M, k, idx.data(), r2.data(), self );
+	neighbor_list within;
+	tree.radius( q, M, rc, within, self );
+
+	for( py_int i = 0; i < M; ++i ){
+		std::vector<std::pair<py_float, py_int> > all;
+		std::vector<py_int> expect_within;
+		for( py_int j = 0; j < N; ++j ){
+			if( self && j == i ) continue;
+			py_float d2 = brute_dist2( x[j], q[i], periodic, xlo, xhi, dims );
+			all.push_back( std::make_pair( d2, j ) );
+			if( d2 <= rc*rc ) expect_within.push_back( j );
+		}
+		std::sort( all.begin(), all.end() );
+		for( py_int m = 0; m < k; ++m ){
+			bool found = m < py_int( all.size() );
+			py_int j = found ? all[m].second : -1;
+			if( idx[k*i+m] != j ||
+			    ( found && std::fabs( r2[k*i+m] - all[m].first ) > 1e-9 ) ||
+			    ( !found && !std::isinf( r2[k*i+m] ) ) ){
+				std::cerr << what << ": neighbor " << m << " of query "
+				          << i << " is " << idx[k*i+m] << " instead of "
+				          << j << "!\n";
+				++n_errors;
+				break;
+			}
+		}
+		std::vector<py_int> got( within[i].begin(), within[i].end() );
+		if( got != expect_within ){
+			std::cerr << what << ": points within " << rc << " of query "
+			          << i << " differ!\n";
+			++n_errors;
+		}
+	}
+	return n_errors;
+}
+
+
+int test_random_points()
+{
+	int n_errors = 0;
+	std::mt19937 gen( 2024 );
+	std::uniform_real_distribution<py_float> u( 0.0, 1.0 );
+
+	const py_float xlo[3] = { -1.0, 0.0, 2.0 };
+	const py_float xhi[3] = { 4.0, 3.0, 5.5 };
+	const py_int N = 600, M = 200;
+	std::vector<py_float> xs( 3*N ), qs( 3*M );
+	for( py_int i = 0; i < N; ++i ){
+		for( int d = 0; d < 3; ++d ){
+			xs[3*i+d] = xlo[d] + ( xhi[d] - xlo[d] )*u( gen );
+		}
+	}
+	// Some queries lie outside of the box.
+	for( py_int i = 0; i < M; ++i ){
+		for( int d = 0; d < 3; ++d ){
+			qs[3*i+d] = xlo[d] + ( xhi[d] - xlo[d] )*( 1.4*u( gen ) - 0.2 );
+		}
+	}
+	arr3f x( xs.data(), N ), q( qs.data(), M );
+
+	const py_int periodics[] = { PERIODIC_FULL, PERIODIC_X | PERIODIC_Z,
+	                             PERIODIC_NONE };
+	for( py_int p : periodics ){
+		for( py_int dims : { 2, 3 } ){
+			n_errors += compare_brute_force( x, N, q, M, p, xlo, xhi, dims,
+			                                 false, "queries" );
+			n_errors += compare_brute_force( x, N, x, N, p, xlo, xhi, dims,
+			                                 true, "own points" );
+		}
+	}
+	n_errors += compare_brute_force( x, N, q, M, PERIODIC_FULL, nullptr,
+	                                 nullptr, 3, false, "no box" );
+
+	// Fewer points than neighbors asked for.
+	n_errors += compare_brute_force( x, 5, q, M, PERIODIC_FULL, xlo, xhi, 3,
+	                                 false, "few points" );
+	return n_errors;
+}
+
+
+// Trees built on one and on several threads find the same neighbors.
+int test_threads()
+{
+	int n_errors = 0;
+	std::mt19937 gen( 7 );
+	std::uniform_real_distribution<py_float> u( 0.0, 30.0 );
+	const py_float xlo[3] = { 0.0, 0.0, 0.0 };
+	const py_float xhi[3] = { 30.0, 30.0, 30.0 };
+	const py_int N = 60000, k = 5;
+	std::vector<py_float> xs( 3*N );
+	for( py_float &v : xs ) v = u( gen );
+	arr3f x( xs.data(), N );
+
+	std::vector<py_int> idx[2];
+	std::vector<py_float> r2[2];
+	const py_int threads[2] = { 1, 4 };
+	for( int t = 0; t < 2; ++t ){
+		set_n_threads( threads[t] );
+		kd_tree tree( x, N, PERIODIC_FULL, xlo, xhi, 3 );
+		idx[t].resize( N*k );
+		r2[t].resize( N*k );
+		tree.knn( x, N, k, idx[t].data(), r2[t].data(), true );
+	}
+	set_n_threads( 0 );
+	if( idx[0] != idx[1] || r2[0] != r2[1] ){
+		std::cerr << "Nearest neighbors depend on the number of threads!\n";
+		++n_errors;
+	}
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../../dumpreaders/test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	int n_errors = test_random_points();
+	n_errors += test_threads();
+
+	// Radius queries of a dump against its neighbor list, with one and
+	// with several threads.
+	dump_reader d( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	block_data b;
+	d.next_block( b );
+	arr3f x( b.x_, b.N );
+	const py_float rc = 1.3;
+
+	cell_list cells;
+	cells.build( x, b.N, rc, b.periodic, b.xlo, b.xhi, 3 );
+	neighbor_list expect;
+	cells.make_pairs( expect, false );
+
+	for( py_int threads : { 1, 4 } ){
+		set_n_threads( threads );
+		kd_tree tree( x, b.N, b.periodic, b.xlo, b.xhi, 3 );
+		neighbor_list got;
+		tree.radius( x, b.N, rc, got, true );
+		bool same = got.n_entries() == expect.n_entries() &&
+			std::equal( got.offsets(), got.offsets() + b.N + 1,
+			            expect.offsets() ) &&
+			std::equal( got.indices(), got.indices() + got.n_entries(),
+			            expect.indices() );
+		if( !same ){
+			std::cerr << "Radius query with " << threads << " threads "
+			          << "differs from the neighbor list!\n";
+			++n_errors;
+		}
+	}
+	set_n_threads( 0 );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
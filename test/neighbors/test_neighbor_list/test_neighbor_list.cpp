@@ -0,0 +1,104 @@
+#include "dump_reader.h"
+#include "domain.h"
+#include "neighborize.h"
+#include "neighbor_list.h"
+
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <vector>
+
+
+// Checks the rows of a list made from pairs given in random order with
+// duplicates, with and without distances and displacements.
+int test_build()
+{
+	int n_errors = 0;
+	const int all = neighbor_list::DISTANCES | neighbor_list::DISPLACEMENTS;
+	for( int extras : { int( neighbor_list::INDICES_ONLY ), all } ){
+		neighbor_list nl( 5, extras );
+		const py_float dx[3] = { 1.0, 2.0, 3.0 };
+		nl.add_pair( 3, 1, 0.5, dx );
+		nl.add_pair( 0, 4, 1.5, dx );
+		nl.add_pair( 1, 0, 2.5, dx );
+		nl.add_pair( 1, 3, 0.5, dx );
+		nl.add( 3, 0 );
+		nl.finalize();
+
+		const std::vector<std::vector<py_int> > expect = {
+			{ 1, 4 }, { 0, 3 }, {}, { 0, 1 }, { 0 } };
+		if( nl.n_entries() != 7 ){
+			std::cerr << "List has " << nl.n_entries() << " entries!\n";
+			++n_errors;
+		}
+		for( py_int i = 0; i < 5; ++i ){
+			std::vector<py_int> row( nl[i].begin(), nl[i].end() );
+			if( row != expect[i] ){
+				std::cerr << "Row " << i << " is wrong!\n";
+				++n_errors;
+			}
+		}
+		if( !nl.has( 3, 1 ) || nl.has( 2, 1 ) || nl.has( 4, 1 ) ){
+			std::cerr << "has() is wrong!\n";
+			++n_errors;
+		}
+		if( nl.has_distances() ){
+			// Row 1 is 0, 3. Of duplicates the first one added is
+			// kept, so the vector to 3 is the one from 3 to 1, negated.
+			const py_float *r  = nl.distances( 1 );
+			const py_float *dd = nl.displacements( 1 );
+			if( r[0] != 2.5 || r[1] != 0.5 || dd[0] != 1.0 ||
+			    dd[3] != -1.0 || nl.displacements( 3 )[5] != 3.0 ){
+				std::cerr << "Distances or displacements are wrong!\n";
+				++n_errors;
+			}
+		}
+	}
+	return n_errors;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../../dumpreaders/test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	int n_errors = test_build();
+
+	dump_reader d( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	block_data b;
+	d.next_block( b );
+
+	const py_float rc = 1.3;
+	arr3f x( b.x_, b.N );
+	arr1i ids( b.ids, b.N ), types( b.types, b.N );
+	neighbor_list nl;
+	neighborize_impl( x, b.N, ids, types, rc, b.periodic, b.xlo, b.xhi,
+	                  3, DIST_NSQ, nl, 0, 0 );
+
+	py_int n_pairs = 0;
+	for( py_int i = 0; i < b.N; ++i ){
+		std::set<py_int> expect;
+		for( py_int j = 0; j < b.N; ++j ){
+			py_float r[3];
+			distance_wrap( r, x[i], x[j], b.xlo, b.xhi );
+			if( j != i && r[0]*r[0] + r[1]*r[1] + r[2]*r[2] <= rc*rc ){
+				expect.insert( j );
+			}
+		}
+		std::set<py_int> got( nl[i].begin(), nl[i].end() );
+		n_pairs += expect.size();
+		if( got != expect || nl.degree( i ) != py_int( expect.size() ) ){
+			std::cerr << "Neighbors of atom " << i << " differ!\n";
+			++n_errors;
+		}
+	}
+	if( nl.n_entries() != n_pairs ){
+		std::cerr << "List has " << nl.n_entries() << " entries instead of "
+		          << n_pairs << "!\n";
+		++n_errors;
+	}
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}
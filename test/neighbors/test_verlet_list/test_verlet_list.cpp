@@ -0,0 +1,151 @@
+#include "dump_reader.h"
+#include "domain.h"
+#include "cell_list.h"
+#include "neighbor_list.h"
+#include "verlet_list.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+
+const int all = neighbor_list::DISTANCES | neighbor_list::DISPLACEMENTS;
+
+
+// Checks that vl has the list a cell list makes for these positions.
+int compare_fresh( const verlet_list &vl, const py_float *xs, py_int N,
+                   py_int periodic, const py_float *xlo,
+                   const py_float *xhi, const char *what )
+{
+	arr3f x( const_cast<py_float*>( xs ), N );
+	cell_list cells;
+	cells.build( x, N, vl.cutoff(), periodic, xlo, xhi, 3 );
+	neighbor_list fresh;
+	cells.make_pairs( fresh, false, 0, 0, nullptr, all );
+
+	const neighbor_list &a = vl.neighbors();
+	bool same = a.size() == N && a.n_entries() == fresh.n_entries() &&
+		std::equal( a.offsets(), a.offsets() + N + 1, fresh.offsets() ) &&
+		std::equal( a.indices(), a.indices() + a.n_entries(),
+		            fresh.indices() ) &&
+		std::equal( a.distances( 0 ), a.distances( 0 ) + a.n_entries(),
+		            fresh.distances( 0 ) ) &&
+		std::equal( a.displacements( 0 ),
+		            a.displacements( 0 ) + 3*a.n_entries(),
+		            fresh.displacements( 0 ) );
+	if( !same ){
+		std::cerr << what << ": list differs from a fresh one!\n";
+		return 1;
+	}
+	return 0;
+}
+
+
+int check_rebuilt( bool rebuilt, bool expect, const char *what )
+{
+	if( rebuilt != expect ){
+		std::cerr << what << ": list was " << ( rebuilt ? "" : "not " )
+		          << "built again!\n";
+		return 1;
+	}
+	return 0;
+}
+
+
+int main( int argc, char **argv )
+{
+	std::string fname = "../../dumpreaders/test_dumpreader/melt.dump";
+	if( argc > 1 ) fname = argv[1];
+
+	int n_errors = 0;
+	const py_float rc = 1.3, skin = 0.3;
+
+	// All frames of a dump, as in an analysis loop.
+	dump_reader d( fname, dump_reader::LAMMPS, dump_reader::PLAIN );
+	block_data b;
+	verlet_list vl( rc, skin, 3, all );
+	int n_frames = 0;
+	while( d.next_block( b ) == 0 ){
+		vl.update( b );
+		n_errors += compare_fresh( vl, b.x_, b.N, b.periodic, b.xlo, b.xhi,
+		                           "dump frame" );
+		++n_frames;
+	}
+	if( vl.n_updates() != n_frames || vl.n_builds() < 1 ){
+		std::cerr << "Counted " << vl.n_updates() << " updates and "
+		          << vl.n_builds() << " builds for " << n_frames
+		          << " frames!\n";
+		++n_errors;
+	}
+
+	// Small moves of the last frame do not need a new list. Three steps
+	// of at most 0.02 per direction move an atom at most 0.104.
+	const py_int N = b.N;
+	std::vector<py_float> xs( b.x_, b.x_ + 3*N );
+	std::vector<py_int> ids( b.ids, b.ids + N );
+	std::mt19937 gen( 42 );
+	std::uniform_real_distribution<py_float> u( -0.02, 0.02 );
+
+	verlet_list moving( rc, skin, 3, all );
+	arr3f x( xs.data(), N );
+	n_errors += check_rebuilt( moving.update( x, N, ids.data(), b.periodic,
+	                                          b.xlo, b.xhi ), true, "first" );
+	for( int step = 0; step < 3; ++step ){
+		for( py_float &v : xs ) v += u( gen );
+		bool rebuilt = moving.update( x, N, ids.data(), b.periodic,
+		                              b.xlo, b.xhi );
+		n_errors += check_rebuilt( rebuilt, false, "small move" );
+		n_errors += compare_fresh( moving, xs.data(), N, b.periodic,
+		                           b.xlo, b.xhi, "small move" );
+	}
+	if( moving.max_displacement() <= 0.0 ||
+	    moving.max_displacement() > 0.5*skin ){
+		std::cerr << "Maximum displacement " << moving.max_displacement()
+		          << " is wrong!\n";
+		++n_errors;
+	}
+
+	// The same atoms in another order.
+	std::vector<py_int> perm( N );
+	std::iota( perm.begin(), perm.end(), 0 );
+	std::shuffle( perm.begin(), perm.end(), gen );
+	std::vector<py_float> xs2( 3*N );
+	std::vector<py_int> ids2( N );
+	for( py_int i = 0; i < N; ++i ){
+		std::copy( xs.begin() + 3*perm[i], xs.begin() + 3*perm[i] + 3,
+		           xs2.begin() + 3*i );
+		ids2[i] = ids[perm[i]];
+	}
+	arr3f x2( xs2.data(), N );
+	n_errors += check_rebuilt( moving.update( x2, N, ids2.data(), b.periodic,
+	                                          b.xlo, b.xhi ), false,
+	                           "shuffled" );
+	n_errors += compare_fresh( moving, xs2.data(), N, b.periodic,
+	                           b.xlo, b.xhi, "shuffled" );
+
+	// One atom moving more than half the skin.
+	xs2[0] += 0.6*skin;
+	n_errors += check_rebuilt( moving.update( x2, N, ids2.data(), b.periodic,
+	                                          b.xlo, b.xhi ), true,
+	                           "large move" );
+	n_errors += compare_fresh( moving, xs2.data(), N, b.periodic,
+	                           b.xlo, b.xhi, "large move" );
+
+	// An atom that was not there before.
+	ids2[5] = *std::max_element( ids2.begin(), ids2.end() ) + 1;
+	n_errors += check_rebuilt( moving.update( x2, N, ids2.data(), b.periodic,
+	                                          b.xlo, b.xhi ), true,
+	                           "new atom" );
+
+	// Fewer atoms.
+	n_errors += check_rebuilt( moving.update( x2, N - 1, ids2.data(),
+	                                          b.periodic, b.xlo, b.xhi ),
+	                           true, "fewer atoms" );
+	n_errors += compare_fresh( moving, xs2.data(), N - 1, b.periodic,
+	                           b.xlo, b.xhi, "fewer atoms" );
+
+	std::cerr << n_errors << " errors.\n";
+	return n_errors;
+}